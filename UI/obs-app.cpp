@@ -76,6 +76,8 @@ string opt_starting_collection;
 string opt_starting_profile;
 string opt_starting_scene;
 
+static string opt_profiler_trace;
+
 // AMD PowerXpress High Performance Flags
 #ifdef _MSC_VER
 extern "C" __declspec(dllexport) int AmdPowerXpressRequestHighPerformance = 1;
@@ -1325,6 +1327,8 @@ static int run_program(fstream &logFile, int argc, char *argv[])
 				ProfilerFree);
 
 	profiler_start();
+	if (!opt_profiler_trace.empty())
+		profiler_trace_start(opt_profiler_trace.c_str());
 	profile_register_root(run_program_init, 0);
 
 	ScopeProfiler prof{run_program_init};
@@ -1900,6 +1904,9 @@ int main(int argc, char *argv[])
 		} else if (arg_is(argv[i], "--allow-opengl", nullptr)) {
 			opt_allow_opengl = true;
 
+		} else if (arg_is(argv[i], "--profiler-trace", nullptr)) {
+			if (++i < argc) opt_profiler_trace = argv[i];
+
 		} else if (arg_is(argv[i], "--help", "-h")) {
 			std::cout <<
 			"--help, -h: Get list of available commands.\n\n" << 
@@ -1918,6 +1925,8 @@ int main(int argc, char *argv[])
 			"--always-on-top: Start in 'always on top' mode.\n\n" <<
 			"--unfiltered_log: Make log unfiltered.\n\n" <<
 			"--allow-opengl: Allow OpenGL on Windows.\n\n" <<
+			"--profiler-trace <file>: Write a Chrome trace of "
+				"profiler events to <file>.\n\n" <<
 			"--version, -V: Get current version.\n";
 
 			exit(0);
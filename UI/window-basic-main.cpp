@@ -1107,6 +1107,7 @@ bool OBSBasic::InitBasicConfigDefaults()
 	config_set_default_uint  (basicConfig, "Video", "FPSNum", 30);
 	config_set_default_uint  (basicConfig, "Video", "FPSDen", 1);
 	config_set_default_string(basicConfig, "Video", "ScaleType", "bicubic");
+	config_set_default_uint  (basicConfig, "Video", "PipelineDepth", 2);
 	config_set_default_string(basicConfig, "Video", "ColorFormat", "NV12");
 	config_set_default_string(basicConfig, "Video", "ColorSpace", "601");
 	config_set_default_string(basicConfig, "Video", "ColorRange",
@@ -1120,6 +1121,8 @@ bool OBSBasic::InitBasicConfigDefaults()
 	config_set_default_uint  (basicConfig, "Audio", "SampleRate", 44100);
 	config_set_default_string(basicConfig, "Audio", "ChannelSetup",
 			"Stereo");
+	config_set_default_uint  (basicConfig, "Audio", "BlockFrames",
+			AUDIO_OUTPUT_FRAMES);
 
 	return true;
 }
@@ -2790,6 +2793,8 @@ int OBSBasic::ResetVideo()
 	ovi.adapter        = 0;
 	ovi.gpu_conversion = true;
 	ovi.scale_type     = GetScaleType(basicConfig);
+	ovi.pipeline_depth = (uint32_t)config_get_uint(basicConfig,
+			"Video", "PipelineDepth");
 
 	if (ovi.base_width == 0 || ovi.base_height == 0) {
 		ovi.base_width = 1920;
@@ -2844,6 +2849,8 @@ bool OBSBasic::ResetAudio()
 	struct obs_audio_info ai;
 	ai.samples_per_sec = config_get_uint(basicConfig, "Audio",
 			"SampleRate");
+	ai.block_frames = (uint32_t)config_get_uint(basicConfig, "Audio",
+			"BlockFrames");
 
 	const char *channelSetupStr = config_get_string(basicConfig,
 			"Audio", "ChannelSetup");
@@ -0,0 +1,118 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "null-subsystem.h"
+
+/* like the other subsystems, static buffer data is released as soon as it
+ * would have been uploaded */
+
+gs_vertbuffer_t *device_vertexbuffer_create(gs_device_t *device,
+		struct gs_vb_data *data, uint32_t flags)
+{
+	struct gs_vertex_buffer *vb = bzalloc(sizeof(struct gs_vertex_buffer));
+	vb->device  = device;
+	vb->data    = data;
+	vb->num     = data->num;
+	vb->dynamic = (flags & GS_DYNAMIC) != 0;
+
+	if (!vb->dynamic) {
+		gs_vbdata_destroy(vb->data);
+		vb->data = NULL;
+	}
+
+	return vb;
+}
+
+void gs_vertexbuffer_destroy(gs_vertbuffer_t *vb)
+{
+	if (vb) {
+		if (vb->device->cur_vertex_buffer == vb)
+			vb->device->cur_vertex_buffer = NULL;
+
+		gs_vbdata_destroy(vb->data);
+		bfree(vb);
+	}
+}
+
+void gs_vertexbuffer_flush(gs_vertbuffer_t *vb)
+{
+	if (!vb->dynamic)
+		blog(LOG_ERROR, "gs_vertexbuffer_flush (null) failed: "
+		                "vertex buffer is not dynamic");
+}
+
+struct gs_vb_data *gs_vertexbuffer_get_data(const gs_vertbuffer_t *vb)
+{
+	return vb->data;
+}
+
+/* ------------------------------------------------------------------------- */
+
+gs_indexbuffer_t *device_indexbuffer_create(gs_device_t *device,
+		enum gs_index_type type, void *indices, size_t num,
+		uint32_t flags)
+{
+	struct gs_index_buffer *ib = bzalloc(sizeof(struct gs_index_buffer));
+	size_t width = type == GS_UNSIGNED_LONG ? sizeof(long) : sizeof(short);
+
+	ib->device  = device;
+	ib->data    = indices;
+	ib->dynamic = (flags & GS_DYNAMIC) != 0;
+	ib->num     = num;
+	ib->width   = width;
+	ib->type    = type;
+
+	if (!ib->dynamic) {
+		bfree(ib->data);
+		ib->data = NULL;
+	}
+
+	return ib;
+}
+
+void gs_indexbuffer_destroy(gs_indexbuffer_t *ib)
+{
+	if (ib) {
+		if (ib->device->cur_index_buffer == ib)
+			ib->device->cur_index_buffer = NULL;
+
+		bfree(ib->data);
+		bfree(ib);
+	}
+}
+
+void gs_indexbuffer_flush(gs_indexbuffer_t *ib)
+{
+	if (!ib->dynamic)
+		blog(LOG_ERROR, "gs_indexbuffer_flush (null) failed: "
+		                "Index buffer is not dynamic");
+}
+
+void *gs_indexbuffer_get_data(const gs_indexbuffer_t *ib)
+{
+	return ib->data;
+}
+
+size_t gs_indexbuffer_get_num_indices(const gs_indexbuffer_t *ib)
+{
+	return ib->num;
+}
+
+enum gs_index_type gs_indexbuffer_get_type(const gs_indexbuffer_t *ib)
+{
+	return ib->type;
+}
@@ -0,0 +1,728 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <inttypes.h>
+#include <graphics/vec4.h>
+#include "null-subsystem.h"
+
+const char *device_get_name(void)
+{
+	return "Null";
+}
+
+int device_get_type(void)
+{
+	return GS_DEVICE_NULL;
+}
+
+bool device_enum_adapters(
+		bool (*callback)(void *param, const char *name, uint32_t id),
+		void *param)
+{
+	if (callback(param, "Null (no pixel operations)",
+				NULL_ADAPTER_NO_PIXELS))
+		callback(param, "Null (software copies)",
+				NULL_ADAPTER_SOFTWARE);
+	return true;
+}
+
+const char *device_preprocessor_name(void)
+{
+	return "_NULL";
+}
+
+int device_create(gs_device_t **p_device, uint32_t adapter)
+{
+	struct gs_device *device = bzalloc(sizeof(struct gs_device));
+
+	device->adapter = adapter;
+	device->cur_cull_mode = GS_BACK;
+	device->cur_blend.enabled = true;
+
+	matrix4_identity(&device->cur_proj);
+	matrix4_identity(&device->cur_view);
+	matrix4_identity(&device->cur_viewproj);
+
+	blog(LOG_INFO, "---------------------------------");
+	blog(LOG_INFO, "Initializing null graphics (%s)...",
+			null_software(device) ?
+			"software copies" : "no pixel operations");
+
+	*p_device = device;
+	return GS_SUCCESS;
+}
+
+static void log_stats(const struct null_stats *stats)
+{
+	blog(LOG_INFO, "Null graphics totals:");
+	blog(LOG_INFO, "\tscenes:                %"PRIu64, stats->scenes);
+	blog(LOG_INFO, "\tdraws:                 %"PRIu64, stats->draws);
+	blog(LOG_INFO, "\tvertices:              %"PRIu64, stats->vertices);
+	blog(LOG_INFO, "\trender target changes: %"PRIu64,
+			stats->render_target_changes);
+	blog(LOG_INFO, "\tshader changes:        %"PRIu64,
+			stats->shader_changes);
+	blog(LOG_INFO, "\tparam uploads:         %"PRIu64,
+			stats->param_uploads);
+	blog(LOG_INFO, "\ttextures created:      %"PRIu64,
+			stats->textures_created);
+	blog(LOG_INFO, "\ttexture maps:          %"PRIu64,
+			stats->texture_maps);
+	blog(LOG_INFO, "\tcopies:                %"PRIu64, stats->copies);
+	blog(LOG_INFO, "\tstages:                %"PRIu64, stats->stages);
+}
+
+void device_destroy(gs_device_t *device)
+{
+	if (device) {
+		log_stats(&device->stats);
+		da_free(device->proj_stack);
+		bfree(device);
+	}
+}
+
+void device_enter_context(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_leave_context(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+gs_swapchain_t *device_swapchain_create(gs_device_t *device,
+		const struct gs_init_data *info)
+{
+	struct gs_swap_chain *swap = bzalloc(sizeof(struct gs_swap_chain));
+
+	swap->device = device;
+	swap->info   = *info;
+	return swap;
+}
+
+void device_resize(gs_device_t *device, uint32_t cx, uint32_t cy)
+{
+	if (device->cur_swap) {
+		device->cur_swap->info.cx = cx;
+		device->cur_swap->info.cy = cy;
+	} else {
+		blog(LOG_WARNING, "device_resize (null): No active swap");
+	}
+}
+
+void device_get_size(const gs_device_t *device, uint32_t *cx, uint32_t *cy)
+{
+	if (device->cur_swap) {
+		*cx = device->cur_swap->info.cx;
+		*cy = device->cur_swap->info.cy;
+	} else {
+		blog(LOG_WARNING, "device_get_size (null): No active swap");
+		*cx = 0;
+		*cy = 0;
+	}
+}
+
+uint32_t device_get_width(const gs_device_t *device)
+{
+	if (device->cur_swap) {
+		return device->cur_swap->info.cx;
+	} else {
+		blog(LOG_WARNING, "device_get_width (null): No active swap");
+		return 0;
+	}
+}
+
+uint32_t device_get_height(const gs_device_t *device)
+{
+	if (device->cur_swap) {
+		return device->cur_swap->info.cy;
+	} else {
+		blog(LOG_WARNING, "device_get_height (null): No active swap");
+		return 0;
+	}
+}
+
+enum gs_texture_type device_get_texture_type(const gs_texture_t *texture)
+{
+	return texture->type;
+}
+
+void device_load_vertexbuffer(gs_device_t *device, gs_vertbuffer_t *vb)
+{
+	device->cur_vertex_buffer = vb;
+}
+
+void device_load_indexbuffer(gs_device_t *device, gs_indexbuffer_t *ib)
+{
+	device->cur_index_buffer = ib;
+}
+
+void device_load_texture(gs_device_t *device, gs_texture_t *tex, int unit)
+{
+	device->cur_textures[unit] = tex;
+}
+
+void device_load_samplerstate(gs_device_t *device,
+		gs_samplerstate_t *ss, int unit)
+{
+	device->cur_samplers[unit] = ss;
+}
+
+void device_load_vertexshader(gs_device_t *device, gs_shader_t *vertshader)
+{
+	if (device->cur_vertex_shader == vertshader)
+		return;
+
+	if (vertshader && vertshader->type != GS_SHADER_VERTEX) {
+		blog(LOG_ERROR, "device_load_vertexshader (null): "
+		                "Specified shader is not a vertex shader");
+		return;
+	}
+
+	device->cur_vertex_shader = vertshader;
+	device->stats.shader_changes++;
+}
+
+void device_load_pixelshader(gs_device_t *device, gs_shader_t *pixelshader)
+{
+	if (device->cur_pixel_shader == pixelshader)
+		return;
+
+	if (pixelshader && pixelshader->type != GS_SHADER_PIXEL) {
+		blog(LOG_ERROR, "device_load_pixelshader (null): "
+		                "Specified shader is not a pixel shader");
+		return;
+	}
+
+	device->cur_pixel_shader = pixelshader;
+	device->stats.shader_changes++;
+}
+
+void device_load_default_samplerstate(gs_device_t *device, bool b_3d, int unit)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(b_3d);
+	UNUSED_PARAMETER(unit);
+}
+
+gs_shader_t *device_get_vertex_shader(const gs_device_t *device)
+{
+	return device->cur_vertex_shader;
+}
+
+gs_shader_t *device_get_pixel_shader(const gs_device_t *device)
+{
+	return device->cur_pixel_shader;
+}
+
+gs_texture_t *device_get_render_target(const gs_device_t *device)
+{
+	return device->cur_render_target;
+}
+
+gs_zstencil_t *device_get_zstencil_target(const gs_device_t *device)
+{
+	return device->cur_zstencil_buffer;
+}
+
+static void set_target(gs_device_t *device, gs_texture_t *tex, int side,
+		gs_zstencil_t *zs)
+{
+	if (device->cur_render_target == tex &&
+	    device->cur_zstencil_buffer == zs &&
+	    device->cur_render_side == side)
+		return;
+
+	device->cur_render_target   = tex;
+	device->cur_render_side     = side;
+	device->cur_zstencil_buffer = zs;
+	device->stats.render_target_changes++;
+}
+
+void device_set_render_target(gs_device_t *device, gs_texture_t *tex,
+		gs_zstencil_t *zstencil)
+{
+	if (tex) {
+		if (tex->type != GS_TEXTURE_2D) {
+			blog(LOG_ERROR, "Texture is not a 2D texture");
+			goto fail;
+		}
+
+		if (!tex->is_render_target) {
+			blog(LOG_ERROR, "Texture is not a render target");
+			goto fail;
+		}
+	}
+
+	set_target(device, tex, 0, zstencil);
+	return;
+
+fail:
+	blog(LOG_ERROR, "device_set_render_target (null) failed");
+}
+
+void device_set_cube_render_target(gs_device_t *device, gs_texture_t *cubetex,
+		int side, gs_zstencil_t *zstencil)
+{
+	if (cubetex) {
+		if (cubetex->type != GS_TEXTURE_CUBE) {
+			blog(LOG_ERROR, "Texture is not a cube texture");
+			goto fail;
+		}
+
+		if (!cubetex->is_render_target) {
+			blog(LOG_ERROR, "Texture is not a render target");
+			goto fail;
+		}
+	}
+
+	set_target(device, cubetex, side, zstencil);
+	return;
+
+fail:
+	blog(LOG_ERROR, "device_set_cube_render_target (null) failed");
+}
+
+void device_begin_scene(gs_device_t *device)
+{
+	device->stats.scenes++;
+}
+
+static inline bool can_render(const gs_device_t *device)
+{
+	if (!device->cur_vertex_shader) {
+		blog(LOG_ERROR, "No vertex shader specified");
+		return false;
+	}
+
+	if (!device->cur_pixel_shader) {
+		blog(LOG_ERROR, "No pixel shader specified");
+		return false;
+	}
+
+	if (!device->cur_vertex_buffer) {
+		blog(LOG_ERROR, "No vertex buffer specified");
+		return false;
+	}
+
+	if (!device->cur_swap && !device->cur_render_target) {
+		blog(LOG_ERROR, "No active swap chain or render target");
+		return false;
+	}
+
+	return true;
+}
+
+static void update_viewproj_matrix(struct gs_device *device)
+{
+	struct gs_shader *vs = device->cur_vertex_shader;
+
+	gs_matrix_get(&device->cur_view);
+
+	matrix4_mul(&device->cur_viewproj, &device->cur_view,
+			&device->cur_proj);
+	matrix4_transpose(&device->cur_viewproj, &device->cur_viewproj);
+
+	if (vs->viewproj)
+		gs_shader_set_matrix4(vs->viewproj, &device->cur_viewproj);
+}
+
+static bool read_first_pixel(const gs_texture_t *tex, int side, float *px)
+{
+	const uint8_t *data = tex->data + tex->face_size * side;
+
+	switch (tex->format) {
+	case GS_RGBA:
+		for (size_t i = 0; i < 4; i++)
+			px[i] = (float)data[i] / 255.0f;
+		return true;
+	case GS_BGRA:
+	case GS_BGRX:
+		px[0] = (float)data[2] / 255.0f;
+		px[1] = (float)data[1] / 255.0f;
+		px[2] = (float)data[0] / 255.0f;
+		px[3] = tex->format == GS_BGRA ? (float)data[3] / 255.0f : 1.0f;
+		return true;
+	default:
+		return false;
+	}
+}
+
+static void write_first_pixel(gs_texture_t *tex, int side, const float *px)
+{
+	uint8_t *data = tex->data + tex->face_size * side;
+	uint8_t val[4];
+
+	for (size_t i = 0; i < 4; i++)
+		val[i] = (uint8_t)(px[i] * 255.0f + 0.5f);
+
+	if (tex->format == GS_RGBA) {
+		memcpy(data, val, 4);
+	} else {
+		data[0] = val[2];
+		data[1] = val[1];
+		data[2] = val[0];
+		data[3] = val[3];
+	}
+}
+
+static float blend_factor(enum gs_blend_type type, const float *src,
+		const float *dst, size_t channel)
+{
+	switch (type) {
+	case GS_BLEND_ZERO:        return 0.0f;
+	case GS_BLEND_ONE:         return 1.0f;
+	case GS_BLEND_SRCCOLOR:    return src[channel];
+	case GS_BLEND_INVSRCCOLOR: return 1.0f - src[channel];
+	case GS_BLEND_SRCALPHA:    return src[3];
+	case GS_BLEND_INVSRCALPHA: return 1.0f - src[3];
+	case GS_BLEND_DSTCOLOR:    return dst[channel];
+	case GS_BLEND_INVDSTCOLOR: return 1.0f - dst[channel];
+	case GS_BLEND_DSTALPHA:    return dst[3];
+	case GS_BLEND_INVDSTALPHA: return 1.0f - dst[3];
+	case GS_BLEND_SRCALPHASAT:
+		if (channel == 3)
+			return 1.0f;
+		return src[3] < 1.0f - dst[3] ? src[3] : 1.0f - dst[3];
+	}
+
+	return 0.0f;
+}
+
+static gs_texture_t *get_pixel_shader_texture(const gs_device_t *device)
+{
+	const gs_shader_t *ps = device->cur_pixel_shader;
+
+	for (size_t i = 0; i < ps->params.num; i++) {
+		const struct gs_shader_param *param = &ps->params.array[i];
+
+		if (param->type == GS_SHADER_PARAM_TEXTURE && param->texture)
+			return param->texture;
+	}
+
+	return NULL;
+}
+
+static void blend_first_pixel(gs_device_t *device)
+{
+	const struct gs_blend_state *blend = &device->cur_blend;
+	gs_texture_t *target = device->cur_render_target;
+	gs_texture_t *tex = get_pixel_shader_texture(device);
+	float src[4], dst[4], out[4];
+
+	if (!target || !tex || !read_first_pixel(tex, 0, src) ||
+	    !read_first_pixel(target, device->cur_render_side, dst))
+		return;
+
+	for (size_t i = 0; i < 4; i++) {
+		float s, d;
+
+		if (!blend->enabled) {
+			out[i] = src[i];
+			continue;
+		}
+
+		s = blend_factor(i < 3 ? blend->src_c  : blend->src_a,
+				src, dst, i);
+		d = blend_factor(i < 3 ? blend->dest_c : blend->dest_a,
+				src, dst, i);
+
+		out[i] = src[i] * s + dst[i] * d;
+		if (out[i] > 1.0f)
+			out[i] = 1.0f;
+	}
+
+	write_first_pixel(target, device->cur_render_side, out);
+}
+
+void device_draw(gs_device_t *device, enum gs_draw_mode draw_mode,
+		uint32_t start_vert, uint32_t num_verts)
+{
+	struct gs_index_buffer *ib = device->cur_index_buffer;
+	gs_effect_t *effect = gs_get_effect();
+
+	if (!can_render(device)) {
+		blog(LOG_ERROR, "device_draw (null) failed");
+		return;
+	}
+
+	if (effect)
+		gs_effect_update_params(effect);
+
+	update_viewproj_matrix(device);
+
+	if (num_verts == 0)
+		num_verts = ib ? (uint32_t)ib->num :
+			(uint32_t)device->cur_vertex_buffer->num;
+
+	device->stats.draws++;
+	device->stats.vertices += num_verts;
+	device->stats.param_uploads +=
+		device->cur_vertex_shader->params.num +
+		device->cur_pixel_shader->params.num;
+
+	if (null_software(device))
+		blend_first_pixel(device);
+
+	UNUSED_PARAMETER(draw_mode);
+	UNUSED_PARAMETER(start_vert);
+}
+
+void device_end_scene(gs_device_t *device)
+{
+	/* does nothing */
+	UNUSED_PARAMETER(device);
+}
+
+void device_load_swapchain(gs_device_t *device, gs_swapchain_t *swapchain)
+{
+	device->cur_swap = swapchain;
+}
+
+static inline uint32_t pack_color(const struct vec4 *color)
+{
+	uint8_t r = (uint8_t)(color->x * 255.0f);
+	uint8_t g = (uint8_t)(color->y * 255.0f);
+	uint8_t b = (uint8_t)(color->z * 255.0f);
+	uint8_t a = (uint8_t)(color->w * 255.0f);
+	return (uint32_t)r | ((uint32_t)g << 8) | ((uint32_t)b << 16) |
+		((uint32_t)a << 24);
+}
+
+/* only 32bit RGBA/BGRA targets are cleared; they are all that libobs renders
+ * to, and the channel order does not matter for clearing to black */
+static void clear_target(gs_texture_t *tex, int side, const struct vec4 *color)
+{
+	uint8_t *face = tex->data + tex->face_size * side;
+	uint32_t val = pack_color(color);
+
+	if (gs_get_format_bpp(tex->format) != 32)
+		return;
+
+	for (uint32_t y = 0; y < tex->height; y++) {
+		uint32_t *pixel = (uint32_t*)(face + y * tex->linesize);
+		for (uint32_t x = 0; x < tex->width; x++)
+			pixel[x] = val;
+	}
+}
+
+void device_clear(gs_device_t *device, uint32_t clear_flags,
+		const struct vec4 *color, float depth, uint8_t stencil)
+{
+	if ((clear_flags & GS_CLEAR_COLOR) != 0 && null_software(device) &&
+	    device->cur_render_target)
+		clear_target(device->cur_render_target,
+				device->cur_render_side, color);
+
+	UNUSED_PARAMETER(depth);
+	UNUSED_PARAMETER(stencil);
+}
+
+void device_present(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_flush(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_set_cull_mode(gs_device_t *device, enum gs_cull_mode mode)
+{
+	device->cur_cull_mode = mode;
+}
+
+enum gs_cull_mode device_get_cull_mode(const gs_device_t *device)
+{
+	return device->cur_cull_mode;
+}
+
+void device_enable_blending(gs_device_t *device, bool enable)
+{
+	device->cur_blend.enabled = enable;
+}
+
+void device_enable_depth_test(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_stencil_test(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_stencil_write(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_color(gs_device_t *device, bool red, bool green,
+		bool blue, bool alpha)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(red);
+	UNUSED_PARAMETER(green);
+	UNUSED_PARAMETER(blue);
+	UNUSED_PARAMETER(alpha);
+}
+
+void device_blend_function(gs_device_t *device, enum gs_blend_type src,
+		enum gs_blend_type dest)
+{
+	device_blend_function_separate(device, src, dest, src, dest);
+}
+
+void device_blend_function_separate(gs_device_t *device,
+		enum gs_blend_type src_c, enum gs_blend_type dest_c,
+		enum gs_blend_type src_a, enum gs_blend_type dest_a)
+{
+	device->cur_blend.src_c  = src_c;
+	device->cur_blend.dest_c = dest_c;
+	device->cur_blend.src_a  = src_a;
+	device->cur_blend.dest_a = dest_a;
+}
+
+void device_depth_function(gs_device_t *device, enum gs_depth_test test)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(test);
+}
+
+void device_stencil_function(gs_device_t *device, enum gs_stencil_side side,
+		enum gs_depth_test test)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(side);
+	UNUSED_PARAMETER(test);
+}
+
+void device_stencil_op(gs_device_t *device, enum gs_stencil_side side,
+		enum gs_stencil_op_type fail, enum gs_stencil_op_type zfail,
+		enum gs_stencil_op_type zpass)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(side);
+	UNUSED_PARAMETER(fail);
+	UNUSED_PARAMETER(zfail);
+	UNUSED_PARAMETER(zpass);
+}
+
+void device_set_viewport(gs_device_t *device, int x, int y, int width,
+		int height)
+{
+	device->cur_viewport.x  = x;
+	device->cur_viewport.y  = y;
+	device->cur_viewport.cx = width;
+	device->cur_viewport.cy = height;
+}
+
+void device_get_viewport(const gs_device_t *device, struct gs_rect *rect)
+{
+	*rect = device->cur_viewport;
+}
+
+void device_set_scissor_rect(gs_device_t *device, const struct gs_rect *rect)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(rect);
+}
+
+void device_ortho(gs_device_t *device, float left, float right,
+		float top, float bottom, float near, float far)
+{
+	struct matrix4 *dst = &device->cur_proj;
+
+	float rml = right-left;
+	float bmt = bottom-top;
+	float fmn = far-near;
+
+	vec4_zero(&dst->x);
+	vec4_zero(&dst->y);
+	vec4_zero(&dst->z);
+	vec4_zero(&dst->t);
+
+	dst->x.x =         2.0f /  rml;
+	dst->t.x = (left+right) / -rml;
+
+	dst->y.y =         2.0f / -bmt;
+	dst->t.y = (bottom+top) /  bmt;
+
+	dst->z.z =        -2.0f /  fmn;
+	dst->t.z =   (far+near) / -fmn;
+
+	dst->t.w = 1.0f;
+}
+
+void device_frustum(gs_device_t *device, float left, float right,
+		float top, float bottom, float near, float far)
+{
+	struct matrix4 *dst = &device->cur_proj;
+
+	float rml    = right-left;
+	float tmb    = top-bottom;
+	float nmf    = near-far;
+	float nearx2 = 2.0f*near;
+
+	vec4_zero(&dst->x);
+	vec4_zero(&dst->y);
+	vec4_zero(&dst->z);
+	vec4_zero(&dst->t);
+
+	dst->x.x =            nearx2 / rml;
+	dst->z.x =      (left+right) / rml;
+
+	dst->y.y =            nearx2 / tmb;
+	dst->z.y =      (bottom+top) / tmb;
+
+	dst->z.z =        (far+near) / nmf;
+	dst->t.z = 2.0f * (near*far) / nmf;
+
+	dst->z.w = -1.0f;
+}
+
+void device_projection_push(gs_device_t *device)
+{
+	da_push_back(device->proj_stack, &device->cur_proj);
+}
+
+void device_projection_pop(gs_device_t *device)
+{
+	struct matrix4 *end;
+	if (!device->proj_stack.num)
+		return;
+
+	end = da_end(device->proj_stack);
+	device->cur_proj = *end;
+	da_pop_back(device->proj_stack);
+}
+
+void gs_swapchain_destroy(gs_swapchain_t *swapchain)
+{
+	if (!swapchain)
+		return;
+
+	if (swapchain->device->cur_swap == swapchain)
+		device_load_swapchain(swapchain->device, NULL);
+
+	bfree(swapchain);
+}
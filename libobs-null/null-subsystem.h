@@ -0,0 +1,171 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <util/darray.h>
+#include <util/threading.h>
+#include <graphics/graphics.h>
+#include <graphics/device-exports.h>
+#include <graphics/matrix4.h>
+
+/*
+ * Null graphics subsystem
+ *
+ *   Implements the graphics exports without a GPU so that the full render
+ * pipeline (ticking, scene rendering, filters, effects and outputs) can run
+ * on machines without a display.  Resources only live in system memory and
+ * nothing is rasterized, so the time spent rendering is purely the CPU side
+ * overhead of libobs.
+ *
+ *   Adapter 0 does no pixel work at all.  Adapter 1 additionally clears,
+ * copies and stages texture data so that outputs receive actual frames, at
+ * the cost of the memory bandwidth that this takes.  It also blends the first
+ * pixel of the render target for each draw as if the draw covered it with the
+ * first texel of its texture, which is enough to check blend states.
+ */
+
+#define NULL_ADAPTER_NO_PIXELS 0
+#define NULL_ADAPTER_SOFTWARE  1
+
+struct gs_texture {
+	gs_device_t          *device;
+	enum gs_texture_type type;
+	enum gs_color_format format;
+	uint32_t             width;
+	uint32_t             height;
+	uint32_t             levels;
+	bool                 is_dynamic;
+	bool                 is_render_target;
+
+	/* level 0 of each face, faces stored one after another */
+	uint32_t             linesize;
+	size_t               face_size;
+	uint8_t              *data;
+};
+
+struct gs_stage_surface {
+	gs_device_t          *device;
+	enum gs_color_format format;
+	uint32_t             width;
+	uint32_t             height;
+	uint32_t             linesize;
+	uint8_t              *data;
+};
+
+struct gs_zstencil_buffer {
+	gs_device_t             *device;
+	uint32_t                width;
+	uint32_t                height;
+	enum gs_zstencil_format format;
+};
+
+struct gs_sampler_state {
+	gs_device_t            *device;
+	struct gs_sampler_info info;
+};
+
+struct gs_vertex_buffer {
+	gs_device_t          *device;
+	struct gs_vb_data    *data;
+	size_t               num;
+	bool                 dynamic;
+};
+
+struct gs_index_buffer {
+	gs_device_t          *device;
+	enum gs_index_type   type;
+	void                 *data;
+	size_t               num;
+	size_t               width;
+	bool                 dynamic;
+};
+
+struct gs_shader_param {
+	enum gs_shader_param_type type;
+
+	char                 *name;
+	gs_shader_t          *shader;
+	gs_samplerstate_t    *next_sampler;
+	int                  array_count;
+
+	struct gs_texture    *texture;
+
+	DARRAY(uint8_t)      cur_value;
+	DARRAY(uint8_t)      def_value;
+};
+
+struct gs_shader {
+	gs_device_t          *device;
+	enum gs_shader_type  type;
+
+	struct gs_shader_param  *viewproj;
+	struct gs_shader_param  *world;
+
+	DARRAY(struct gs_shader_param) params;
+};
+
+struct gs_swap_chain {
+	gs_device_t          *device;
+	struct gs_init_data  info;
+};
+
+/* totals reported when the device is destroyed */
+struct null_stats {
+	uint64_t             draws;
+	uint64_t             vertices;
+	uint64_t             render_target_changes;
+	uint64_t             shader_changes;
+	uint64_t             param_uploads;
+	uint64_t             textures_created;
+	uint64_t             texture_maps;
+	uint64_t             copies;
+	uint64_t             stages;
+	uint64_t             scenes;
+};
+
+struct gs_device {
+	uint32_t             adapter;
+
+	gs_texture_t         *cur_render_target;
+	gs_zstencil_t        *cur_zstencil_buffer;
+	int                  cur_render_side;
+	gs_texture_t         *cur_textures[GS_MAX_TEXTURES];
+	gs_samplerstate_t    *cur_samplers[GS_MAX_TEXTURES];
+	gs_vertbuffer_t      *cur_vertex_buffer;
+	gs_indexbuffer_t     *cur_index_buffer;
+	gs_shader_t          *cur_vertex_shader;
+	gs_shader_t          *cur_pixel_shader;
+	gs_swapchain_t       *cur_swap;
+
+	enum gs_cull_mode    cur_cull_mode;
+	struct gs_blend_state cur_blend;
+	struct gs_rect       cur_viewport;
+
+	struct matrix4       cur_proj;
+	struct matrix4       cur_view;
+	struct matrix4       cur_viewproj;
+
+	DARRAY(struct matrix4) proj_stack;
+
+	struct null_stats    stats;
+};
+
+static inline bool null_software(const gs_device_t *device)
+{
+	return device->adapter == NULL_ADAPTER_SOFTWARE;
+}
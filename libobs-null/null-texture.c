@@ -0,0 +1,419 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "null-subsystem.h"
+
+static inline uint32_t get_linesize(enum gs_color_format format,
+		uint32_t width)
+{
+	uint32_t linesize = width * gs_get_format_bpp(format) / 8;
+	return (linesize + 3) & 0xFFFFFFFC;
+}
+
+static gs_texture_t *texture_create(gs_device_t *device,
+		enum gs_texture_type type, uint32_t width, uint32_t height,
+		uint32_t faces, enum gs_color_format color_format,
+		uint32_t levels, const uint8_t **data, uint32_t flags)
+{
+	struct gs_texture *tex = bzalloc(sizeof(struct gs_texture));
+
+	tex->device           = device;
+	tex->type             = type;
+	tex->format           = color_format;
+	tex->width            = width;
+	tex->height           = height;
+	tex->levels           = levels;
+	tex->is_dynamic       = (flags & GS_DYNAMIC) != 0;
+	tex->is_render_target = (flags & GS_RENDER_TARGET) != 0;
+	tex->linesize         = get_linesize(color_format, width);
+	tex->face_size        = (size_t)tex->linesize * height;
+	tex->data             = bzalloc(tex->face_size * faces);
+
+	/* source data is tightly packed and has all mip levels of a face
+	 * before the next face */
+	if (data) {
+		uint32_t row_size = width * gs_get_format_bpp(color_format) / 8;
+
+		for (uint32_t face = 0; face < faces; face++) {
+			const uint8_t *src = *data;
+			uint8_t *dst = tex->data + tex->face_size * face;
+
+			if (!src)
+				break;
+
+			for (uint32_t y = 0; y < height; y++)
+				memcpy(dst + y * tex->linesize,
+						src + y * row_size, row_size);
+
+			data += levels ? levels : 1;
+		}
+	}
+
+	device->stats.textures_created++;
+	return tex;
+}
+
+gs_texture_t *device_texture_create(gs_device_t *device, uint32_t width,
+		uint32_t height, enum gs_color_format color_format,
+		uint32_t levels, const uint8_t **data, uint32_t flags)
+{
+	return texture_create(device, GS_TEXTURE_2D, width, height, 1,
+			color_format, levels, data, flags);
+}
+
+gs_texture_t *device_cubetexture_create(gs_device_t *device, uint32_t size,
+		enum gs_color_format color_format, uint32_t levels,
+		const uint8_t **data, uint32_t flags)
+{
+	return texture_create(device, GS_TEXTURE_CUBE, size, size, 6,
+			color_format, levels, data, flags);
+}
+
+gs_texture_t *device_voltexture_create(gs_device_t *device, uint32_t width,
+		uint32_t height, uint32_t depth,
+		enum gs_color_format color_format, uint32_t levels,
+		const uint8_t **data, uint32_t flags)
+{
+	/* not supported by any of the other subsystems either */
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(width);
+	UNUSED_PARAMETER(height);
+	UNUSED_PARAMETER(depth);
+	UNUSED_PARAMETER(color_format);
+	UNUSED_PARAMETER(levels);
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(flags);
+	return NULL;
+}
+
+static inline bool is_texture_2d(const gs_texture_t *tex, const char *func)
+{
+	bool is_tex2d = tex->type == GS_TEXTURE_2D;
+	if (!is_tex2d)
+		blog(LOG_ERROR, "%s (null) failed: Not a 2D texture", func);
+	return is_tex2d;
+}
+
+void gs_texture_destroy(gs_texture_t *tex)
+{
+	if (!tex)
+		return;
+
+	for (size_t i = 0; i < GS_MAX_TEXTURES; i++) {
+		if (tex->device->cur_textures[i] == tex)
+			tex->device->cur_textures[i] = NULL;
+	}
+
+	if (tex->device->cur_render_target == tex)
+		tex->device->cur_render_target = NULL;
+
+	bfree(tex->data);
+	bfree(tex);
+}
+
+uint32_t gs_texture_get_width(const gs_texture_t *tex)
+{
+	if (!is_texture_2d(tex, "gs_texture_get_width"))
+		return 0;
+	return tex->width;
+}
+
+uint32_t gs_texture_get_height(const gs_texture_t *tex)
+{
+	if (!is_texture_2d(tex, "gs_texture_get_height"))
+		return 0;
+	return tex->height;
+}
+
+enum gs_color_format gs_texture_get_color_format(const gs_texture_t *tex)
+{
+	return tex->format;
+}
+
+bool gs_texture_map(gs_texture_t *tex, uint8_t **ptr, uint32_t *linesize)
+{
+	if (!is_texture_2d(tex, "gs_texture_map"))
+		goto fail;
+
+	if (!tex->is_dynamic) {
+		blog(LOG_ERROR, "Texture is not dynamic");
+		goto fail;
+	}
+
+	tex->device->stats.texture_maps++;
+
+	*ptr      = tex->data;
+	*linesize = tex->linesize;
+	return true;
+
+fail:
+	blog(LOG_ERROR, "gs_texture_map (null) failed");
+	return false;
+}
+
+void gs_texture_unmap(gs_texture_t *tex)
+{
+	UNUSED_PARAMETER(tex);
+}
+
+void *gs_texture_get_obj(gs_texture_t *tex)
+{
+	return tex->data;
+}
+
+void gs_cubetexture_destroy(gs_texture_t *cubetex)
+{
+	gs_texture_destroy(cubetex);
+}
+
+uint32_t gs_cubetexture_get_size(const gs_texture_t *cubetex)
+{
+	if (cubetex->type != GS_TEXTURE_CUBE) {
+		blog(LOG_ERROR, "gs_cubetexture_get_size (null) failed: "
+		                "Not a cube texture");
+		return 0;
+	}
+
+	return cubetex->width;
+}
+
+enum gs_color_format gs_cubetexture_get_color_format(
+		const gs_texture_t *cubetex)
+{
+	return cubetex->format;
+}
+
+void gs_voltexture_destroy(gs_texture_t *voltex)
+{
+	gs_texture_destroy(voltex);
+}
+
+uint32_t gs_voltexture_get_width(const gs_texture_t *voltex)
+{
+	UNUSED_PARAMETER(voltex);
+	return 0;
+}
+
+uint32_t gs_voltexture_get_height(const gs_texture_t *voltex)
+{
+	UNUSED_PARAMETER(voltex);
+	return 0;
+}
+
+uint32_t gs_voltexture_get_depth(const gs_texture_t *voltex)
+{
+	UNUSED_PARAMETER(voltex);
+	return 0;
+}
+
+enum gs_color_format gs_voltexture_get_color_format(const gs_texture_t *voltex)
+{
+	UNUSED_PARAMETER(voltex);
+	return GS_UNKNOWN;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline bool can_copy(const gs_texture_t *dst, const gs_texture_t *src,
+		uint32_t dst_x, uint32_t dst_y, uint32_t src_x, uint32_t src_y,
+		uint32_t src_w, uint32_t src_h)
+{
+	if (dst->format != src->format) {
+		blog(LOG_ERROR, "Source and destination formats do not match");
+		return false;
+	}
+
+	return src_x + src_w <= src->width && src_y + src_h <= src->height &&
+	       dst_x + src_w <= dst->width && dst_y + src_h <= dst->height;
+}
+
+void device_copy_texture_region(gs_device_t *device,
+		gs_texture_t *dst, uint32_t dst_x, uint32_t dst_y,
+		gs_texture_t *src, uint32_t src_x, uint32_t src_y,
+		uint32_t src_w, uint32_t src_h)
+{
+	uint32_t bytes_per_pixel;
+
+	if (!src || !dst) {
+		blog(LOG_ERROR, "device_copy_texture_region (null) failed: "
+		                "Source or destination is NULL");
+		return;
+	}
+
+	if (src_w == 0)
+		src_w = src->width - src_x;
+	if (src_h == 0)
+		src_h = src->height - src_y;
+
+	if (!can_copy(dst, src, dst_x, dst_y, src_x, src_y, src_w, src_h)) {
+		blog(LOG_ERROR, "device_copy_texture_region (null) failed");
+		return;
+	}
+
+	device->stats.copies++;
+
+	if (!null_software(device))
+		return;
+
+	bytes_per_pixel = gs_get_format_bpp(src->format) / 8;
+
+	for (uint32_t y = 0; y < src_h; y++) {
+		uint8_t *dst_row = dst->data +
+			(dst_y + y) * dst->linesize + dst_x * bytes_per_pixel;
+		const uint8_t *src_row = src->data +
+			(src_y + y) * src->linesize + src_x * bytes_per_pixel;
+
+		memcpy(dst_row, src_row, src_w * bytes_per_pixel);
+	}
+}
+
+void device_copy_texture(gs_device_t *device, gs_texture_t *dst,
+		gs_texture_t *src)
+{
+	device_copy_texture_region(device, dst, 0, 0, src, 0, 0, 0, 0);
+}
+
+/* ------------------------------------------------------------------------- */
+
+gs_stagesurf_t *device_stagesurface_create(gs_device_t *device, uint32_t width,
+		uint32_t height, enum gs_color_format color_format)
+{
+	struct gs_stage_surface *surf = bzalloc(sizeof(struct gs_stage_surface));
+
+	surf->device   = device;
+	surf->format   = color_format;
+	surf->width    = width;
+	surf->height   = height;
+	surf->linesize = width * gs_get_format_bpp(color_format) / 8;
+	surf->data     = bzalloc((size_t)surf->linesize * height);
+	return surf;
+}
+
+void gs_stagesurface_destroy(gs_stagesurf_t *stagesurf)
+{
+	if (stagesurf) {
+		bfree(stagesurf->data);
+		bfree(stagesurf);
+	}
+}
+
+uint32_t gs_stagesurface_get_width(const gs_stagesurf_t *stagesurf)
+{
+	return stagesurf->width;
+}
+
+uint32_t gs_stagesurface_get_height(const gs_stagesurf_t *stagesurf)
+{
+	return stagesurf->height;
+}
+
+enum gs_color_format gs_stagesurface_get_color_format(
+		const gs_stagesurf_t *stagesurf)
+{
+	return stagesurf->format;
+}
+
+bool gs_stagesurface_map(gs_stagesurf_t *stagesurf, uint8_t **data,
+		uint32_t *linesize)
+{
+	*data     = stagesurf->data;
+	*linesize = stagesurf->linesize;
+	return true;
+}
+
+void gs_stagesurface_unmap(gs_stagesurf_t *stagesurf)
+{
+	UNUSED_PARAMETER(stagesurf);
+}
+
+void device_stage_texture(gs_device_t *device, gs_stagesurf_t *dst,
+		gs_texture_t *src)
+{
+	if (!src || !is_texture_2d(src, "device_stage_texture"))
+		goto fail;
+
+	if (src->format != dst->format) {
+		blog(LOG_ERROR, "Source and destination formats do not match");
+		goto fail;
+	}
+
+	if (src->width != dst->width || src->height != dst->height) {
+		blog(LOG_ERROR, "Source and destination must have the same "
+		                "dimensions");
+		goto fail;
+	}
+
+	device->stats.stages++;
+
+	if (null_software(device)) {
+		for (uint32_t y = 0; y < dst->height; y++)
+			memcpy(dst->data + y * dst->linesize,
+					src->data + y * src->linesize,
+					dst->linesize);
+	}
+
+	return;
+
+fail:
+	blog(LOG_ERROR, "device_stage_texture (null) failed");
+}
+
+/* ------------------------------------------------------------------------- */
+
+gs_zstencil_t *device_zstencil_create(gs_device_t *device, uint32_t width,
+		uint32_t height, enum gs_zstencil_format format)
+{
+	struct gs_zstencil_buffer *zs = bzalloc(sizeof(*zs));
+
+	zs->device = device;
+	zs->width  = width;
+	zs->height = height;
+	zs->format = format;
+	return zs;
+}
+
+void gs_zstencil_destroy(gs_zstencil_t *zs)
+{
+	if (zs) {
+		if (zs->device->cur_zstencil_buffer == zs)
+			zs->device->cur_zstencil_buffer = NULL;
+		bfree(zs);
+	}
+}
+
+gs_samplerstate_t *device_samplerstate_create(gs_device_t *device,
+		const struct gs_sampler_info *info)
+{
+	struct gs_sampler_state *ss = bzalloc(sizeof(struct gs_sampler_state));
+
+	ss->device = device;
+	ss->info   = *info;
+	return ss;
+}
+
+void gs_samplerstate_destroy(gs_samplerstate_t *ss)
+{
+	if (!ss)
+		return;
+
+	for (size_t i = 0; i < GS_MAX_TEXTURES; i++) {
+		if (ss->device->cur_samplers[i] == ss)
+			ss->device->cur_samplers[i] = NULL;
+	}
+
+	bfree(ss);
+}
@@ -18,6 +18,7 @@
 
 #include "../util/bmem.h"
 #include "../util/base.h"
+#include "../util/threading.h"
 
 #include "calldata.h"
 
@@ -65,10 +66,12 @@ static inline const char *cd_serialize_string(uint8_t **pos)
 	return (size != 0) ? str : NULL;
 }
 
-static bool cd_getparam(const calldata_t *data, const char *name,
-		uint8_t **pos)
+/* finds the parameter by name, returning its index in p_idx if found */
+static bool cd_getparam_sized(const calldata_t *data, const char *name,
+		size_t size, uint8_t **pos, long *p_idx)
 {
 	size_t name_size;
+	long idx = 0;
 
 	if (!data->size)
 		return false;
@@ -81,19 +84,68 @@ static bool cd_getparam(const calldata_t *data, const char *name,
 		size_t param_size;
 
 		*pos += name_size;
-		if (strcmp(param_name, name) == 0)
+		if (name_size == size && memcmp(param_name, name, size) == 0) {
+			if (p_idx)
+				*p_idx = idx;
 			return true;
+		}
 
 		param_size = cd_serialize_size(pos);
 		*pos += param_size;
 
 		name_size = cd_serialize_size(pos);
+		idx++;
 	}
 
 	*pos -= sizeof(size_t);
 	return false;
 }
 
+static inline bool cd_getparam(const calldata_t *data, const char *name,
+		uint8_t **pos)
+{
+	return cd_getparam_sized(data, name, strlen(name) + 1, pos, NULL);
+}
+
+/* checks the parameter the key was last found at before searching, which
+ * only has to skip over the sizes of the parameters before it */
+static bool cd_getparam_key(const calldata_t *data, calldata_key_t *key,
+		uint8_t **pos)
+{
+	long hint = os_atomic_load_long(&key->index);
+	long idx;
+	size_t name_size;
+
+	if (!data->size)
+		return false;
+
+	*pos = data->stack;
+	name_size = cd_serialize_size(pos);
+
+	for (idx = 0; idx < hint && name_size != 0; idx++) {
+		size_t param_size;
+
+		*pos += name_size;
+		param_size = cd_serialize_size(pos);
+		*pos += param_size;
+
+		name_size = cd_serialize_size(pos);
+	}
+
+	if (idx == hint && name_size == key->name_size &&
+	    memcmp(*pos, key->name, name_size) == 0) {
+		*pos += name_size;
+		return true;
+	}
+
+	if (!cd_getparam_sized(data, key->name, key->name_size, pos, &idx))
+		return false;
+
+	if (idx != hint)
+		os_atomic_set_long(&key->index, idx);
+	return true;
+}
+
 static inline void cd_copy_string(uint8_t **pos, const char *str, size_t len)
 {
 	if (!len)
@@ -235,6 +287,41 @@ void calldata_set_data(calldata_t *data, const char *name, const void *in,
 	}
 }
 
+bool calldata_get_data_key(const calldata_t *data, calldata_key_t *key,
+		void *out, size_t size)
+{
+	uint8_t *pos;
+	size_t data_size;
+
+	if (!data || !key || !key->name)
+		return false;
+
+	if (!cd_getparam_key(data, key, &pos))
+		return false;
+
+	data_size = cd_serialize_size(&pos);
+	if (data_size != size)
+		return false;
+
+	memcpy(out, pos, size);
+	return true;
+}
+
+bool calldata_get_string_key(const calldata_t *data, calldata_key_t *key,
+		const char **str)
+{
+	uint8_t *pos;
+
+	if (!data || !key || !key->name)
+		return false;
+
+	if (!cd_getparam_key(data, key, &pos))
+		return false;
+
+	*str = cd_serialize_string(&pos);
+	return true;
+}
+
 bool calldata_get_string(const calldata_t *data, const char *name,
 		const char **str)
 {
@@ -160,6 +160,81 @@ static inline const char *calldata_string(const calldata_t *data,
 
 /* ------------------------------------------------------------------------- */
 
+/* Parameter keys
+ *
+ *   A key remembers where its parameter was found last time.  Signals are
+ * nearly always built with the same parameters in the same order, so
+ * handlers that are called often can use a static key instead of a name
+ * to avoid comparing against every parameter name each call:
+ *
+ *     static calldata_key_t volume_key = CALLDATA_KEY("volume");
+ *     double volume = calldata_float_key(data, &volume_key);
+ */
+
+struct calldata_key {
+	const char    *name;
+	size_t        name_size; /* includes the null terminator */
+	volatile long index;     /* where the parameter was last found */
+};
+
+typedef struct calldata_key calldata_key_t;
+
+#define CALLDATA_KEY(name) {name, sizeof(name), 0}
+
+static inline void calldata_key_init(calldata_key_t *key, const char *name)
+{
+	key->name = name;
+	key->name_size = strlen(name) + 1;
+	key->index = 0;
+}
+
+EXPORT bool calldata_get_data_key(const calldata_t *data, calldata_key_t *key,
+		void *out, size_t size);
+EXPORT bool calldata_get_string_key(const calldata_t *data,
+		calldata_key_t *key, const char **str);
+
+static inline long long calldata_int_key(const calldata_t *data,
+		calldata_key_t *key)
+{
+	long long val = 0;
+	calldata_get_data_key(data, key, &val, sizeof(val));
+	return val;
+}
+
+static inline double calldata_float_key(const calldata_t *data,
+		calldata_key_t *key)
+{
+	double val = 0.0;
+	calldata_get_data_key(data, key, &val, sizeof(val));
+	return val;
+}
+
+static inline bool calldata_bool_key(const calldata_t *data,
+		calldata_key_t *key)
+{
+	bool val = false;
+	calldata_get_data_key(data, key, &val, sizeof(val));
+	return val;
+}
+
+static inline void *calldata_ptr_key(const calldata_t *data,
+		calldata_key_t *key)
+{
+	void *val = NULL;
+	calldata_get_data_key(data, key, &val, sizeof(val));
+	return val;
+}
+
+static inline const char *calldata_string_key(const calldata_t *data,
+		calldata_key_t *key)
+{
+	const char *val = NULL;
+	calldata_get_string_key(data, key, &val);
+	return val;
+}
+
+/* ------------------------------------------------------------------------- */
+
 static inline void calldata_set_int   (calldata_t *data, const char *name,
 		long long val)
 {
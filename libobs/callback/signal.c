@@ -32,6 +32,9 @@ struct signal_info {
 	pthread_mutex_t                mutex;
 	bool                           signalling;
 
+	/* lets signals with nothing connected return without locking */
+	volatile long                  num_callbacks;
+
 	struct signal_info             *next;
 };
 
@@ -50,6 +53,7 @@ static inline struct signal_info *signal_info_create(struct decl_info *info)
 	si->func       = *info;
 	si->next       = NULL;
 	si->signalling = false;
+	si->num_callbacks = 0;
 	da_init(si->callbacks);
 
 	if (pthread_mutex_init(&si->mutex, &attr) != 0) {
@@ -199,7 +203,8 @@ void signal_handler_connect(signal_handler_t *handler, const char *signal,
 	idx = signal_get_callback_idx(sig, callback, data);
 	if (idx == DARRAY_INVALID)
 		da_push_back(sig->callbacks, &cb_data);
-	
+
+	os_atomic_set_long(&sig->num_callbacks, (long)sig->callbacks.num);
 	pthread_mutex_unlock(&sig->mutex);
 }
 
@@ -236,17 +241,34 @@ void signal_handler_disconnect(signal_handler_t *handler, const char *signal,
 		else
 			da_erase(sig->callbacks, idx);
 	}
-	
+
+	os_atomic_set_long(&sig->num_callbacks, (long)sig->callbacks.num);
 	pthread_mutex_unlock(&sig->mutex);
 }
 
+signal_handle_t *signal_handler_get_handle(signal_handler_t *handler,
+		const char *signal)
+{
+	struct signal_info *sig = getsignal_locked(handler, signal);
+
+	if (!sig && handler)
+		blog(LOG_WARNING, "signal_handler_get_handle: "
+		                  "signal '%s' not found", signal);
+	return sig;
+}
+
 void signal_handler_signal(signal_handler_t *handler, const char *signal,
 		calldata_t *params)
 {
-	struct signal_info *sig = getsignal_locked(handler, signal);
+	signal_handle_signal(getsignal_locked(handler, signal), params);
+}
 
+void signal_handle_signal(signal_handle_t *sig, calldata_t *params)
+{
 	if (!sig)
 		return;
+	if (!os_atomic_load_long(&sig->num_callbacks))
+		return;
 
 	pthread_mutex_lock(&sig->mutex);
 	sig->signalling = true;
@@ -263,6 +285,7 @@ void signal_handler_signal(signal_handler_t *handler, const char *signal,
 			da_erase(sig->callbacks, i-1);
 	}
 
+	os_atomic_set_long(&sig->num_callbacks, (long)sig->callbacks.num);
 	sig->signalling = false;
 	pthread_mutex_unlock(&sig->mutex);
 }
@@ -63,6 +63,20 @@ EXPORT void signal_handler_disconnect(signal_handler_t *handler,
 EXPORT void signal_handler_signal(signal_handler_t *handler, const char *signal,
 		calldata_t *params);
 
+/*
+ * Signal handles
+ *
+ *   Looks up a signal once so that it can be emitted without searching for
+ * it by name each time.  A handle stays valid for as long as the signal
+ * handler it came from.
+ */
+
+typedef struct signal_info signal_handle_t;
+
+EXPORT signal_handle_t *signal_handler_get_handle(signal_handler_t *handler,
+		const char *signal);
+EXPORT void signal_handle_signal(signal_handle_t *handle, calldata_t *params);
+
 #ifdef __cplusplus
 }
 #endif
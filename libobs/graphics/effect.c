@@ -114,32 +114,37 @@ void gs_technique_end(gs_technique_t *tech)
 	struct gs_effect_param *params = effect->params.array;
 	size_t i;
 
-	gs_load_vertexshader(NULL);
-	gs_load_pixelshader(NULL);
+	if (!gs_sprite_batch_end_technique(effect)) {
+		gs_load_vertexshader(NULL);
+		gs_load_pixelshader(NULL);
+	}
 
 	tech->effect->cur_technique = NULL;
 	tech->effect->graphics->cur_effect = NULL;
 
+	/* values go back to their defaults for the next user of the effect.
+	 * the old value is kept if it's already the default so that the pass
+	 * shaders don't need it uploaded again. */
 	for (i = 0; i < effect->params.num; i++) {
 		struct gs_effect_param *param = params+i;
+		size_t size = param->default_val.num;
 
-		da_free(param->cur_val);
-		param->changed = false;
-		if (param->next_sampler)
-			param->next_sampler = NULL;
-	}
-}
-
-static inline void reset_params(struct darray *shaderparams)
-{
-	struct pass_shaderparam *params = shaderparams->array;
-	size_t i;
+		if (param->cur_val.num != size || (size &&
+		    memcmp(param->cur_val.array, param->default_val.array,
+			    size) != 0)) {
+			da_copy(param->cur_val, param->default_val);
+			param->version++;
+		}
 
-	for (i = 0; i < shaderparams->num; i++)
-		params[i].eparam->changed = false;
+		param->next_sampler = NULL;
+	}
 }
 
-static void upload_shader_params(struct darray *pass_params, bool changed_only)
+/* only values that changed since they were last uploaded to the pass's
+ * shaders are uploaded.  textures are always set when a pass begins as
+ * ending a pass clears them. */
+static void upload_shader_params(struct gs_effect *effect,
+		struct darray *pass_params, bool pass_begin)
 {
 	struct pass_shaderparam *params = pass_params->array;
 	size_t i;
@@ -152,9 +157,12 @@ static void upload_shader_params(struct darray *pass_params, bool changed_only)
 		if (eparam->next_sampler)
 			gs_shader_set_next_sampler(sparam, eparam->next_sampler);
 
-		if (changed_only && !eparam->changed)
+		if (param->version == eparam->version &&
+		    !(pass_begin && eparam->type == GS_SHADER_PARAM_TEXTURE))
 			continue;
 
+		param->version = eparam->version;
+
 		if (!eparam->cur_val.num) {
 			if (eparam->default_val.num)
 				da_copy(eparam->cur_val, eparam->default_val);
@@ -164,11 +172,14 @@ static void upload_shader_params(struct darray *pass_params, bool changed_only)
 
 		gs_shader_set_val(sparam, eparam->cur_val.array,
 				eparam->cur_val.num);
+
+		if (effect->graphics)
+			effect->graphics->effect_stats.param_uploads++;
 	}
 }
 
 static inline void upload_parameters(struct gs_effect *effect,
-		bool changed_only)
+		bool pass_begin)
 {
 	struct darray *vshader_params, *pshader_params;
 
@@ -178,16 +189,14 @@ static inline void upload_parameters(struct gs_effect *effect,
 	vshader_params = &effect->cur_pass->vertshader_params.da;
 	pshader_params = &effect->cur_pass->pixelshader_params.da;
 
-	upload_shader_params(vshader_params, changed_only);
-	upload_shader_params(pshader_params, changed_only);
-	reset_params(vshader_params);
-	reset_params(pshader_params);
+	upload_shader_params(effect, vshader_params, pass_begin);
+	upload_shader_params(effect, pshader_params, pass_begin);
 }
 
-void gs_effect_update_params(gs_effect_t *effect)	
+void gs_effect_update_params(gs_effect_t *effect)
 {
 	if (effect)
-		upload_parameters(effect, true);
+		upload_parameters(effect, false);
 }
 
 bool gs_technique_begin_pass(gs_technique_t *tech, size_t idx)
@@ -202,9 +211,14 @@ bool gs_technique_begin_pass(gs_technique_t *tech, size_t idx)
 	cur_pass = passes+idx;
 
 	tech->effect->cur_pass = cur_pass;
+
+	/* still loaded for sprites of the same pass that haven't been drawn */
+	if (gs_sprite_batch_resume_pass(tech->effect, cur_pass))
+		return true;
+
 	gs_load_vertexshader(cur_pass->vertshader);
 	gs_load_pixelshader(cur_pass->pixelshader);
-	upload_parameters(tech->effect, false);
+	upload_parameters(tech->effect, true);
 
 	return true;
 }
@@ -248,9 +262,89 @@ void gs_technique_end_pass(gs_technique_t *tech)
 	if (!pass)
 		return;
 
+	if (!gs_sprite_batch_end_pass(pass))
+		effect_pass_clear_textures(pass);
+	tech->effect->cur_pass = NULL;
+}
+
+void effect_pass_clear_textures(struct gs_effect_pass *pass)
+{
 	clear_tex_params(&pass->vertshader_params.da);
 	clear_tex_params(&pass->pixelshader_params.da);
-	tech->effect->cur_pass = NULL;
+}
+
+static inline const struct darray *param_value(
+		const struct gs_effect_param *eparam)
+{
+	return eparam->cur_val.num ?
+		&eparam->cur_val.da : &eparam->default_val.da;
+}
+
+static bool save_params(const struct darray *pass_params, struct darray *dst)
+{
+	const struct pass_shaderparam *params = pass_params->array;
+
+	for (size_t i = 0; i < pass_params->num; i++) {
+		const struct gs_effect_param *eparam = params[i].eparam;
+		const struct darray *val = param_value(eparam);
+		uint32_t size = (uint32_t)val->num;
+
+		if (eparam->next_sampler)
+			return false;
+
+		darray_push_back_array(1, dst, &size, sizeof(size));
+		if (size)
+			darray_push_back_array(1, dst, val->array, size);
+	}
+
+	return true;
+}
+
+static bool params_equal(const struct darray *pass_params,
+		const struct darray *saved, size_t *offset)
+{
+	const struct pass_shaderparam *params = pass_params->array;
+	const uint8_t *data = saved->array;
+
+	for (size_t i = 0; i < pass_params->num; i++) {
+		const struct gs_effect_param *eparam = params[i].eparam;
+		const struct darray *val = param_value(eparam);
+		uint32_t size;
+
+		if (eparam->next_sampler)
+			return false;
+		if (*offset + sizeof(size) + val->num > saved->num)
+			return false;
+
+		memcpy(&size, data + *offset, sizeof(size));
+		*offset += sizeof(size);
+
+		if (size != val->num || (size &&
+		    memcmp(data + *offset, val->array, size) != 0))
+			return false;
+
+		*offset += val->num;
+	}
+
+	return true;
+}
+
+bool effect_pass_save_params(const struct gs_effect_pass *pass,
+		struct darray *dst)
+{
+	darray_resize(1, dst, 0);
+	return save_params(&pass->vertshader_params.da, dst) &&
+	       save_params(&pass->pixelshader_params.da, dst);
+}
+
+bool effect_pass_params_equal(const struct gs_effect_pass *pass,
+		const struct darray *saved)
+{
+	size_t offset = 0;
+
+	return params_equal(&pass->vertshader_params.da, saved, &offset) &&
+	       params_equal(&pass->pixelshader_params.da, saved, &offset) &&
+	       offset == saved->num;
 }
 
 size_t gs_effect_get_num_params(const gs_effect_t *effect)
@@ -275,17 +369,37 @@ gs_eparam_t *gs_effect_get_param_by_name(const gs_effect_t *effect,
 	if (!effect) return NULL;
 
 	struct gs_effect_param *params = effect->params.array;
+	uint32_t hash = effect_param_name_hash(name);
+
+	if (effect->graphics)
+		effect->graphics->effect_stats.param_lookups++;
 
 	for (size_t i = 0; i < effect->params.num; i++) {
 		struct gs_effect_param *param = params+i;
 
-		if (strcmp(param->name, name) == 0)
+		if (param->name_hash == hash && strcmp(param->name, name) == 0)
 			return param;
 	}
 
 	return NULL;
 }
 
+void gs_effect_get_stats(struct gs_effect_stats *stats)
+{
+	graphics_t *graphics = gs_get_context();
+
+	if (!stats)
+		return;
+
+	if (!graphics) {
+		memset(stats, 0, sizeof(*stats));
+		return;
+	}
+
+	*stats = graphics->effect_stats;
+	memset(&graphics->effect_stats, 0, sizeof(graphics->effect_stats));
+}
+
 gs_eparam_t *gs_effect_get_viewproj_matrix(const gs_effect_t *effect)
 {
 	return effect ? effect->view_proj : NULL;
@@ -328,7 +442,7 @@ static inline void effect_setval_inline(gs_eparam_t *param,
 
 	if (size_changed || memcmp(param->cur_val.array, data, size) != 0) {
 		memcpy(param->cur_val.array, data, size);
-		param->changed = true;
+		param->version++;
 	}
 }
 
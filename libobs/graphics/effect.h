@@ -48,11 +48,13 @@ enum effect_section {
 
 struct gs_effect_param {
 	char *name;
+	uint32_t name_hash;
 	enum effect_section section;
 
 	enum gs_shader_param_type type;
 
-	bool changed;
+	/* incremented whenever the value the shaders should have changes */
+	uint32_t version;
 	DARRAY(uint8_t) cur_val;
 	DARRAY(uint8_t) default_val;
 
@@ -63,6 +65,19 @@ struct gs_effect_param {
 	float scroller_min, scroller_max, scroller_inc, scroller_mul;*/
 };
 
+/* FNV-1a, used to skip most name compares when looking up parameters */
+static inline uint32_t effect_param_name_hash(const char *name)
+{
+	uint32_t hash = 2166136261U;
+
+	while (*name) {
+		hash ^= (uint8_t)*(name++);
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
 static inline void effect_param_init(struct gs_effect_param *param)
 {
 	memset(param, 0, sizeof(struct gs_effect_param));
@@ -84,6 +99,9 @@ EXPORT void effect_param_parse_property(gs_eparam_t *param,
 struct pass_shaderparam {
 	struct gs_effect_param *eparam;
 	gs_sparam_t *sparam;
+
+	/* eparam->version last uploaded to sparam */
+	uint32_t version;
 };
 
 struct gs_effect_pass {
@@ -110,6 +128,15 @@ static inline void effect_pass_free(struct gs_effect_pass *pass)
 	gs_shader_destroy(pass->pixelshader);
 }
 
+/* used by sprite batching: saves/compares the values the parameters of a pass
+ * would be uploaded with, and clears the pass textures after a delayed pass
+ * end.  saving fails if a parameter has a sampler override. */
+extern bool effect_pass_save_params(const struct gs_effect_pass *pass,
+		struct darray *dst);
+extern bool effect_pass_params_equal(const struct gs_effect_pass *pass,
+		const struct darray *saved);
+extern void effect_pass_clear_textures(struct gs_effect_pass *pass);
+
 /* ------------------------------------------------------------------------- */
 
 struct gs_effect_technique {
@@ -178,10 +205,6 @@ static inline void effect_free(gs_effect_t *effect)
 	effect->effect_dir = NULL;
 }
 
-EXPORT void effect_upload_params(gs_effect_t *effect, bool changed_only);
-EXPORT void effect_upload_shader_params(gs_effect_t *effect,
-		gs_shader_t *shader, struct darray *pass_params,
-		bool changed_only);
 
 #ifdef __cplusplus
 }
@@ -268,6 +268,49 @@ struct blend_state {
 	enum gs_blend_type dest_a;
 };
 
+/* render target owned by the texrender pool */
+struct gs_texrender_target {
+	gs_texture_t            *tex;
+	gs_zstencil_t           *zs;
+	uint32_t                cx, cy;
+	enum gs_color_format    format;
+	enum gs_zstencil_format zsformat;
+	uint64_t                last_used;
+};
+
+struct gs_texrender_pool {
+	pthread_mutex_t                    mutex;
+	DARRAY(struct gs_texrender_target) targets;
+	uint64_t                           frame;
+	struct gs_texrender_pool_stats     stats;
+};
+
+extern void gs_texrender_pool_free(struct gs_texrender_pool *pool);
+
+/* sprites of the same effect pass and parameter values, with the matrix
+ * already applied to their vertices, waiting to be drawn together */
+struct gs_sprite_batch {
+	gs_vertbuffer_t        *vertbuffer;
+	size_t                 num;
+
+	struct gs_effect       *effect;
+	struct gs_effect_pass  *pass;
+	DARRAY(uint8_t)        params;
+
+	/* the pass/technique of the batch has ended, but its shaders and
+	 * textures are kept loaded until the batch is drawn */
+	bool                   pass_ended;
+	bool                   technique_ended;
+
+	bool                   drawing;
+	bool                   disabled;
+};
+
+extern bool gs_sprite_batch_end_pass(struct gs_effect_pass *pass);
+extern bool gs_sprite_batch_end_technique(struct gs_effect *effect);
+extern bool gs_sprite_batch_resume_pass(struct gs_effect *effect,
+		struct gs_effect_pass *pass);
+
 struct graphics_subsystem {
 	void                   *module;
 	gs_device_t            *device;
@@ -282,6 +325,7 @@ struct graphics_subsystem {
 	struct gs_effect       *cur_effect;
 
 	gs_vertbuffer_t        *sprite_buffer;
+	struct gs_sprite_batch sprite_batch;
 
 	bool                   using_immediate;
 	struct gs_vb_data      *vbd;
@@ -299,4 +343,9 @@ struct graphics_subsystem {
 
 	struct blend_state     cur_blend_state;
 	DARRAY(struct blend_state) blend_state_stack;
+
+	struct gs_effect_stats effect_stats;
+	struct gs_draw_stats   draw_stats;
+
+	struct gs_texrender_pool texrender_pool;
 };
@@ -71,6 +71,30 @@ static inline bool gs_valid(const char *f)
 
 #define IMMEDIATE_COUNT 512
 
+#define MAX_BATCH_SPRITES 256
+#define BATCH_SPRITE_VERTS 6
+
+static void sprite_batch_draw(graphics_t *graphics);
+
+/* draws pending sprites before state they depend on changes.  creating or
+ * updating resources can change the bindings of the graphics API as well (GL
+ * binds and then unbinds the texture it uploads to), so those flush too */
+static inline void flush_sprites(graphics_t *graphics)
+{
+	if (graphics->sprite_batch.num && !graphics->sprite_batch.drawing)
+		sprite_batch_draw(graphics);
+}
+
+static inline bool blend_state_changes(const graphics_t *graphics,
+		enum gs_blend_type src_c, enum gs_blend_type dest_c,
+		enum gs_blend_type src_a, enum gs_blend_type dest_a)
+{
+	const struct blend_state *state = &graphics->cur_blend_state;
+
+	return state->src_c != src_c || state->dest_c != dest_c ||
+	       state->src_a != src_a || state->dest_a != dest_a;
+}
+
 void gs_enum_adapters(
 		bool (*callback)(void *param, const char *name, uint32_t id),
 		void *param)
@@ -144,6 +168,27 @@ static bool graphics_init_sprite_vb(struct graphics_subsystem *graphics)
 	return true;
 }
 
+static bool graphics_init_sprite_batch_vb(struct graphics_subsystem *graphics)
+{
+	struct gs_vb_data *vbd;
+	size_t num = MAX_BATCH_SPRITES * BATCH_SPRITE_VERTS;
+
+	vbd = gs_vbdata_create();
+	vbd->num     = num;
+	vbd->points  = bzalloc(sizeof(struct vec3) * num);
+	vbd->num_tex = 1;
+	vbd->tvarray = bmalloc(sizeof(struct gs_tvertarray));
+	vbd->tvarray[0].width = 2;
+	vbd->tvarray[0].array = bzalloc(sizeof(struct vec2) * num);
+
+	graphics->sprite_batch.vertbuffer = graphics->exports.
+		device_vertexbuffer_create(graphics->device, vbd, GS_DYNAMIC);
+	if (!graphics->sprite_batch.vertbuffer)
+		return false;
+
+	return true;
+}
+
 static bool graphics_init(struct graphics_subsystem *graphics)
 {
 	struct matrix4 top_mat;
@@ -157,10 +202,14 @@ static bool graphics_init(struct graphics_subsystem *graphics)
 		return false;
 	if (!graphics_init_sprite_vb(graphics))
 		return false;
+	if (!graphics_init_sprite_batch_vb(graphics))
+		return false;
 	if (pthread_mutex_init(&graphics->mutex, NULL) != 0)
 		return false;
 	if (pthread_mutex_init(&graphics->effect_mutex, NULL) != 0)
 		return false;
+	if (pthread_mutex_init(&graphics->texrender_pool.mutex, NULL) != 0)
+		return false;
 
 	graphics->exports.device_blend_function_separate(graphics->device,
 			GS_BLEND_SRCALPHA, GS_BLEND_INVSRCALPHA,
@@ -184,6 +233,7 @@ int gs_create(graphics_t **pgraphics, const char *module, uint32_t adapter)
 	graphics_t *graphics = bzalloc(sizeof(struct graphics_subsystem));
 	pthread_mutex_init_value(&graphics->mutex);
 	pthread_mutex_init_value(&graphics->effect_mutex);
+	pthread_mutex_init_value(&graphics->texrender_pool.mutex);
 
 	graphics->module = os_dlopen(module);
 	if (!graphics->module) {
@@ -234,8 +284,12 @@ void gs_destroy(graphics_t *graphics)
 			effect = next;
 		}
 
+		gs_texrender_pool_free(&graphics->texrender_pool);
+
 		graphics->exports.gs_vertexbuffer_destroy(
 				graphics->sprite_buffer);
+		graphics->exports.gs_vertexbuffer_destroy(
+				graphics->sprite_batch.vertbuffer);
 		graphics->exports.gs_vertexbuffer_destroy(
 				graphics->immediate_vertbuffer);
 		graphics->exports.device_destroy(graphics->device);
@@ -245,6 +299,9 @@ void gs_destroy(graphics_t *graphics)
 
 	pthread_mutex_destroy(&graphics->mutex);
 	pthread_mutex_destroy(&graphics->effect_mutex);
+	pthread_mutex_destroy(&graphics->texrender_pool.mutex);
+	da_free(graphics->texrender_pool.targets);
+	da_free(graphics->sprite_batch.params);
 	da_free(graphics->matrix_stack);
 	da_free(graphics->viewport_stack);
 	da_free(graphics->blend_state_stack);
@@ -278,6 +335,8 @@ void gs_enter_context(graphics_t *graphics)
 void gs_leave_context(void)
 {
 	if (gs_valid("gs_leave_context")) {
+		flush_sprites(thread_graphics);
+
 		if (!os_atomic_dec_long(&thread_graphics->ref)) {
 			graphics_t *graphics = thread_graphics;
 
@@ -1001,6 +1060,254 @@ static inline void build_sprite_rect(struct gs_vb_data *data, gs_texture_t *tex,
 	build_sprite(data, fcx, fcy, start_u, end_u, start_v, end_v);
 }
 
+/* ------------------------------------------------------------------------- */
+/* sprite batching                                                           */
+
+/*
+ *   Sprites are drawn with the current matrix applied to their vertices on the
+ * CPU, so sprites with different matrices can share a draw call.  A batch
+ * keeps the effect pass of its sprites and the parameter values they were
+ * uploaded with; the next sprite joins the batch if both are unchanged.
+ *
+ *   Ending the pass or technique of a batch keeps its shaders and textures
+ * loaded until the batch is drawn, so the next loop of the same pass (the
+ * next scene item drawn with the default effect, for example) can resume it
+ * instead of drawing it.
+ */
+
+static inline bool matrix_is_affine(const struct matrix4 *m)
+{
+	return m->x.w == 0.0f && m->y.w == 0.0f && m->z.w == 0.0f &&
+	       m->t.w == 1.0f;
+}
+
+static inline void transform_sprite_point(struct vec3 *dst,
+		const struct vec3 *v, const struct matrix4 *m)
+{
+	vec3_set(dst,
+		v->x * m->x.x + v->y * m->y.x + m->t.x,
+		v->x * m->x.y + v->y * m->y.y + m->t.y,
+		v->x * m->x.z + v->y * m->y.z + m->t.z);
+}
+
+/* triangle list order of the four sprite vertices */
+static const size_t sprite_batch_order[BATCH_SPRITE_VERTS] = {0, 1, 2, 2, 1, 3};
+
+static void sprite_batch_draw(graphics_t *graphics)
+{
+	struct gs_sprite_batch *batch = &graphics->sprite_batch;
+	struct gs_effect *cur_effect = graphics->cur_effect;
+	struct gs_vb_data *data = gs_vertexbuffer_get_data(batch->vertbuffer);
+	enum gs_draw_mode mode = GS_TRIS;
+	uint32_t num_verts = (uint32_t)(batch->num * BATCH_SPRITE_VERTS);
+	size_t capacity;
+
+	batch->drawing = true;
+
+	if (batch->num == 1) {
+		/* drawn as a strip of four vertices like unbatched sprites */
+		struct vec2 *tv = data->tvarray[0].array;
+
+		vec3_copy(data->points + 3, data->points + 5);
+		vec2_copy(tv + 3, tv + 5);
+		mode      = GS_TRISTRIP;
+		num_verts = 4;
+	} else {
+		graphics->draw_stats.batched_sprites += batch->num;
+	}
+
+	/* only the vertices of the batch are uploaded */
+	capacity  = data->num;
+	data->num = num_verts;
+	gs_vertexbuffer_flush(batch->vertbuffer);
+	data->num = capacity;
+
+	gs_load_vertexbuffer(batch->vertbuffer);
+	gs_load_indexbuffer(NULL);
+
+	/* parameters were uploaded when the batch started, and may have been
+	 * changed since for the next sprites */
+	graphics->cur_effect = NULL;
+	gs_matrix_push();
+	gs_matrix_identity();
+	gs_draw(mode, 0, num_verts);
+	gs_matrix_pop();
+	graphics->cur_effect = cur_effect;
+
+	if (batch->pass_ended)
+		effect_pass_clear_textures(batch->pass);
+	if (batch->technique_ended) {
+		gs_load_vertexshader(NULL);
+		gs_load_pixelshader(NULL);
+	}
+
+	batch->num             = 0;
+	batch->effect          = NULL;
+	batch->pass            = NULL;
+	batch->pass_ended      = false;
+	batch->technique_ended = false;
+	batch->drawing         = false;
+}
+
+/* adds the sprite in the sprite buffer to the batch, or returns false if it
+ * has to be drawn on its own */
+static bool sprite_batch_add(graphics_t *graphics)
+{
+	struct gs_sprite_batch *batch = &graphics->sprite_batch;
+	struct gs_effect *effect = graphics->cur_effect;
+	struct gs_effect_pass *pass = effect ? effect->cur_pass : NULL;
+	struct matrix4 *mat = top_matrix(graphics);
+	struct gs_vb_data *sprite, *data;
+	struct vec2 *sprite_tv, *tv;
+	size_t start;
+
+	if (batch->disabled || !pass || !mat || !matrix_is_affine(mat)) {
+		flush_sprites(graphics);
+		return false;
+	}
+
+	if (batch->num && (batch->effect != effect || batch->pass != pass ||
+	                   batch->num == MAX_BATCH_SPRITES ||
+	                   !effect_pass_params_equal(pass,
+				   &batch->params.da)))
+		sprite_batch_draw(graphics);
+
+	if (!batch->num) {
+		if (!effect_pass_save_params(pass, &batch->params.da))
+			return false;
+
+		gs_effect_update_params(effect);
+		batch->effect = effect;
+		batch->pass   = pass;
+	}
+
+	sprite    = gs_vertexbuffer_get_data(graphics->sprite_buffer);
+	data      = gs_vertexbuffer_get_data(batch->vertbuffer);
+	sprite_tv = sprite->tvarray[0].array;
+	tv        = data->tvarray[0].array;
+	start     = batch->num * BATCH_SPRITE_VERTS;
+
+	for (size_t i = 0; i < BATCH_SPRITE_VERTS; i++) {
+		size_t idx = sprite_batch_order[i];
+
+		transform_sprite_point(data->points + start + i,
+				sprite->points + idx, mat);
+		vec2_copy(tv + start + i, sprite_tv + idx);
+	}
+
+	batch->num++;
+	return true;
+}
+
+static void draw_sprite_buffer(graphics_t *graphics)
+{
+	graphics->draw_stats.sprites++;
+
+	if (sprite_batch_add(graphics))
+		return;
+
+	gs_vertexbuffer_flush(graphics->sprite_buffer);
+	gs_load_vertexbuffer(graphics->sprite_buffer);
+	gs_load_indexbuffer(NULL);
+
+	gs_draw(GS_TRISTRIP, 0, 0);
+}
+
+bool gs_sprite_batch_end_pass(struct gs_effect_pass *pass)
+{
+	graphics_t *graphics = thread_graphics;
+	struct gs_sprite_batch *batch;
+
+	if (!graphics)
+		return false;
+
+	batch = &graphics->sprite_batch;
+	if (!batch->num || batch->drawing || batch->pass != pass)
+		return false;
+
+	batch->pass_ended = true;
+	return true;
+}
+
+bool gs_sprite_batch_end_technique(struct gs_effect *effect)
+{
+	graphics_t *graphics = thread_graphics;
+	struct gs_sprite_batch *batch;
+
+	if (!graphics)
+		return false;
+
+	batch = &graphics->sprite_batch;
+	if (!batch->num || batch->drawing || batch->effect != effect ||
+	    !batch->pass_ended)
+		return false;
+
+	batch->technique_ended = true;
+	return true;
+}
+
+bool gs_sprite_batch_resume_pass(struct gs_effect *effect,
+		struct gs_effect_pass *pass)
+{
+	graphics_t *graphics = thread_graphics;
+	struct gs_sprite_batch *batch;
+
+	if (!graphics)
+		return false;
+
+	batch = &graphics->sprite_batch;
+	if (!batch->num || batch->drawing)
+		return false;
+
+	if (batch->pass_ended && batch->effect == effect &&
+	    batch->pass == pass) {
+		batch->pass_ended      = false;
+		batch->technique_ended = false;
+		return true;
+	}
+
+	sprite_batch_draw(graphics);
+	return false;
+}
+
+void gs_enable_sprite_batching(bool enable)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid("gs_enable_sprite_batching"))
+		return;
+
+	flush_sprites(graphics);
+	graphics->sprite_batch.disabled = !enable;
+}
+
+bool gs_sprite_batching_enabled(void)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid("gs_sprite_batching_enabled"))
+		return false;
+
+	return !graphics->sprite_batch.disabled;
+}
+
+void gs_get_draw_stats(struct gs_draw_stats *stats)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!stats)
+		return;
+
+	if (!graphics) {
+		memset(stats, 0, sizeof(*stats));
+		return;
+	}
+
+	*stats = graphics->draw_stats;
+}
+
+/* ------------------------------------------------------------------------- */
+
 void gs_draw_sprite(gs_texture_t *tex, uint32_t flip, uint32_t width,
 		uint32_t height)
 {
@@ -1030,11 +1337,7 @@ void gs_draw_sprite(gs_texture_t *tex, uint32_t flip, uint32_t width,
 	else
 		build_sprite_norm(data, fcx, fcy, flip);
 
-	gs_vertexbuffer_flush(graphics->sprite_buffer);
-	gs_load_vertexbuffer(graphics->sprite_buffer);
-	gs_load_indexbuffer(NULL);
-
-	gs_draw(GS_TRISTRIP, 0, 0);
+	draw_sprite_buffer(graphics);
 }
 
 void gs_draw_sprite_subregion(gs_texture_t *tex, uint32_t flip,
@@ -1061,11 +1364,7 @@ void gs_draw_sprite_subregion(gs_texture_t *tex, uint32_t flip,
 			(float)sub_cx, (float)sub_cy,
 			fcx, fcy, flip);
 
-	gs_vertexbuffer_flush(graphics->sprite_buffer);
-	gs_load_vertexbuffer(graphics->sprite_buffer);
-	gs_load_indexbuffer(NULL);
-
-	gs_draw(GS_TRISTRIP, 0, 0);
+	draw_sprite_buffer(graphics);
 }
 
 void gs_draw_cube_backdrop(gs_texture_t *cubetex, const struct quat *rot,
@@ -1147,6 +1446,8 @@ void gs_texture_set_image(gs_texture_t *tex, const uint8_t *data,
 	if (!gs_valid_p2("gs_texture_set_image", tex, data))
 		return;
 
+	flush_sprites(thread_graphics);
+
 	height = (int32_t)gs_texture_get_height(tex);
 
 	if (!gs_texture_map(tex, &ptr, &linesize_out))
@@ -1192,6 +1493,8 @@ void gs_perspective(float angle, float aspect, float near, float far)
 	if (!gs_valid("gs_perspective"))
 		return;
 
+	flush_sprites(graphics);
+
 	ymax = near * tanf(RAD(angle)*0.5f);
 	ymin = -ymax;
 
@@ -1231,6 +1534,20 @@ void gs_blend_state_pop(void)
 	da_pop_back(graphics->blend_state_stack);
 }
 
+void gs_get_blend_state(struct gs_blend_state *state)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid_p("gs_get_blend_state", state))
+		return;
+
+	state->enabled = graphics->cur_blend_state.enabled;
+	state->src_c   = graphics->cur_blend_state.src_c;
+	state->dest_c  = graphics->cur_blend_state.dest_c;
+	state->src_a   = graphics->cur_blend_state.src_a;
+	state->dest_a  = graphics->cur_blend_state.dest_a;
+}
+
 void gs_reset_blend_state(void)
 {
 	graphics_t *graphics = thread_graphics;
@@ -1270,6 +1587,8 @@ gs_swapchain_t *gs_swapchain_create(const struct gs_init_data *data)
 	if (!gs_valid_p("gs_swapchain_create", data))
 		return NULL;
 
+	flush_sprites(graphics);
+
 	if (new_data.num_backbuffers == 0)
 		new_data.num_backbuffers = 1;
 
@@ -1284,6 +1603,8 @@ void gs_resize(uint32_t x, uint32_t y)
 	if (!gs_valid("gs_resize"))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_resize(graphics->device, x, y);
 }
 
@@ -1333,6 +1654,8 @@ gs_texture_t *gs_texture_create(uint32_t width, uint32_t height,
 	if (!gs_valid("gs_texture_create"))
 		return NULL;
 
+	flush_sprites(graphics);
+
 	if (uses_mipmaps && !pow2tex) {
 		blog(LOG_WARNING, "Cannot use mipmaps with a "
 		                  "non-power-of-two texture.  Disabling "
@@ -1365,6 +1688,8 @@ gs_texture_t *gs_cubetexture_create(uint32_t size,
 	if (!gs_valid("gs_cubetexture_create"))
 		return NULL;
 
+	flush_sprites(graphics);
+
 	if (uses_mipmaps && !pow2tex) {
 		blog(LOG_WARNING, "Cannot use mipmaps with a "
 		                  "non-power-of-two texture.  Disabling "
@@ -1396,6 +1721,8 @@ gs_texture_t *gs_voltexture_create(uint32_t width, uint32_t height,
 	if (!gs_valid("gs_voltexture_create"))
 		return NULL;
 
+	flush_sprites(graphics);
+
 	return graphics->exports.device_voltexture_create(graphics->device,
 			width, height, depth, color_format, levels, data,
 			flags);
@@ -1409,6 +1736,8 @@ gs_zstencil_t *gs_zstencil_create(uint32_t width, uint32_t height,
 	if (!gs_valid("gs_zstencil_create"))
 		return NULL;
 
+	flush_sprites(graphics);
+
 	return graphics->exports.device_zstencil_create(graphics->device,
 			width, height, format);
 }
@@ -1421,6 +1750,8 @@ gs_stagesurf_t *gs_stagesurface_create(uint32_t width, uint32_t height,
 	if (!gs_valid("gs_stagesurface_create"))
 		return NULL;
 
+	flush_sprites(graphics);
+
 	return graphics->exports.device_stagesurface_create(graphics->device,
 			width, height, color_format);
 }
@@ -1432,6 +1763,8 @@ gs_samplerstate_t *gs_samplerstate_create(const struct gs_sampler_info *info)
 	if (!gs_valid_p("gs_samplerstate_create", info))
 		return NULL;
 
+	flush_sprites(graphics);
+
 	return graphics->exports.device_samplerstate_create(graphics->device,
 			info);
 }
@@ -1444,6 +1777,8 @@ gs_shader_t *gs_vertexshader_create(const char *shader, const char *file,
 	if (!gs_valid_p("gs_vertexshader_create", shader))
 		return NULL;
 
+	flush_sprites(graphics);
+
 	return graphics->exports.device_vertexshader_create(graphics->device,
 			shader, file, error_string);
 }
@@ -1456,6 +1791,8 @@ gs_shader_t *gs_pixelshader_create(const char *shader,
 	if (!gs_valid_p("gs_pixelshader_create", shader))
 		return NULL;
 
+	flush_sprites(graphics);
+
 	return graphics->exports.device_pixelshader_create(graphics->device,
 			shader, file, error_string);
 }
@@ -1468,6 +1805,8 @@ gs_vertbuffer_t *gs_vertexbuffer_create(struct gs_vb_data *data,
 	if (!gs_valid("gs_vertexbuffer_create"))
 		return NULL;
 
+	flush_sprites(graphics);
+
 	return graphics->exports.device_vertexbuffer_create(graphics->device,
 			data, flags);
 }
@@ -1480,6 +1819,8 @@ gs_indexbuffer_t *gs_indexbuffer_create(enum gs_index_type type,
 	if (!gs_valid("gs_indexbuffer_create"))
 		return NULL;
 
+	flush_sprites(graphics);
+
 	return graphics->exports.device_indexbuffer_create(graphics->device,
 			type, indices, num, flags);
 }
@@ -1501,6 +1842,8 @@ void gs_load_vertexbuffer(gs_vertbuffer_t *vertbuffer)
 	if (!gs_valid("gs_load_vertexbuffer"))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_load_vertexbuffer(graphics->device,
 			vertbuffer);
 }
@@ -1512,6 +1855,8 @@ void gs_load_indexbuffer(gs_indexbuffer_t *indexbuffer)
 	if (!gs_valid("gs_load_indexbuffer"))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_load_indexbuffer(graphics->device,
 			indexbuffer);
 }
@@ -1523,6 +1868,8 @@ void gs_load_texture(gs_texture_t *tex, int unit)
 	if (!gs_valid("gs_load_texture"))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_load_texture(graphics->device, tex, unit);
 }
 
@@ -1533,6 +1880,8 @@ void gs_load_samplerstate(gs_samplerstate_t *samplerstate, int unit)
 	if (!gs_valid("gs_load_samplerstate"))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_load_samplerstate(graphics->device,
 			samplerstate, unit);
 }
@@ -1544,6 +1893,8 @@ void gs_load_vertexshader(gs_shader_t *vertshader)
 	if (!gs_valid("gs_load_vertexshader"))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_load_vertexshader(graphics->device,
 			vertshader);
 }
@@ -1555,6 +1906,8 @@ void gs_load_pixelshader(gs_shader_t *pixelshader)
 	if (!gs_valid("gs_load_pixelshader"))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_load_pixelshader(graphics->device,
 			pixelshader);
 }
@@ -1566,6 +1919,8 @@ void gs_load_default_samplerstate(bool b_3d, int unit)
 	if (!gs_valid("gs_load_default_samplerstate"))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_load_default_samplerstate(graphics->device,
 			b_3d, unit);
 }
@@ -1617,6 +1972,8 @@ void gs_set_render_target(gs_texture_t *tex, gs_zstencil_t *zstencil)
 	if (!gs_valid("gs_set_render_target"))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_set_render_target(graphics->device, tex,
 			zstencil);
 }
@@ -1629,6 +1986,8 @@ void gs_set_cube_render_target(gs_texture_t *cubetex, int side,
 	if (!gs_valid("gs_set_cube_render_target"))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_set_cube_render_target(graphics->device,
 			cubetex, side, zstencil);
 }
@@ -1640,6 +1999,8 @@ void gs_copy_texture(gs_texture_t *dst, gs_texture_t *src)
 	if (!gs_valid_p2("gs_copy_texture", dst, src))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_copy_texture(graphics->device, dst, src);
 }
 
@@ -1652,6 +2013,8 @@ void gs_copy_texture_region(gs_texture_t *dst, uint32_t dst_x, uint32_t dst_y,
 	if (!gs_valid_p("gs_copy_texture_region", dst))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_copy_texture_region(graphics->device,
 			dst, dst_x, dst_y,
 			src, src_x, src_y, src_w, src_h);
@@ -1664,6 +2027,8 @@ void gs_stage_texture(gs_stagesurf_t *dst, gs_texture_t *src)
 	if (!gs_valid("gs_stage_texture"))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_stage_texture(graphics->device, dst, src);
 }
 
@@ -1674,6 +2039,8 @@ void gs_begin_scene(void)
 	if (!gs_valid("gs_begin_scene"))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_begin_scene(graphics->device);
 }
 
@@ -1685,6 +2052,9 @@ void gs_draw(enum gs_draw_mode draw_mode, uint32_t start_vert,
 	if (!gs_valid("gs_draw"))
 		return;
 
+	flush_sprites(graphics);
+	graphics->draw_stats.draw_calls++;
+
 	graphics->exports.device_draw(graphics->device, draw_mode,
 			start_vert, num_verts);
 }
@@ -1696,6 +2066,8 @@ void gs_end_scene(void)
 	if (!gs_valid("gs_end_scene"))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_end_scene(graphics->device);
 }
 
@@ -1706,6 +2078,8 @@ void gs_load_swapchain(gs_swapchain_t *swapchain)
 	if (!gs_valid("gs_load_swapchain"))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_load_swapchain(graphics->device, swapchain);
 }
 
@@ -1717,6 +2091,8 @@ void gs_clear(uint32_t clear_flags, const struct vec4 *color, float depth,
 	if (!gs_valid("gs_clear"))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_clear(graphics->device, clear_flags, color,
 			depth, stencil);
 }
@@ -1728,6 +2104,8 @@ void gs_present(void)
 	if (!gs_valid("gs_present"))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_present(graphics->device);
 }
 
@@ -1738,6 +2116,8 @@ void gs_flush(void)
 	if (!gs_valid("gs_flush"))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_flush(graphics->device);
 }
 
@@ -1748,6 +2128,8 @@ void gs_set_cull_mode(enum gs_cull_mode mode)
 	if (!gs_valid("gs_set_cull_mode"))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_set_cull_mode(graphics->device, mode);
 }
 
@@ -1768,6 +2150,9 @@ void gs_enable_blending(bool enable)
 	if (!gs_valid("gs_enable_blending"))
 		return;
 
+	if (graphics->cur_blend_state.enabled != enable)
+		flush_sprites(graphics);
+
 	graphics->cur_blend_state.enabled = enable;
 	graphics->exports.device_enable_blending(graphics->device, enable);
 }
@@ -1779,6 +2164,8 @@ void gs_enable_depth_test(bool enable)
 	if (!gs_valid("gs_enable_depth_test"))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_enable_depth_test(graphics->device, enable);
 }
 
@@ -1789,6 +2176,8 @@ void gs_enable_stencil_test(bool enable)
 	if (!gs_valid("gs_enable_stencil_test"))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_enable_stencil_test(graphics->device, enable);
 }
 
@@ -1799,6 +2188,8 @@ void gs_enable_stencil_write(bool enable)
 	if (!gs_valid("gs_enable_stencil_write"))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_enable_stencil_write(graphics->device, enable);
 }
 
@@ -1809,6 +2200,8 @@ void gs_enable_color(bool red, bool green, bool blue, bool alpha)
 	if (!gs_valid("gs_enable_color"))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_enable_color(graphics->device, red, green,
 			blue, alpha);
 }
@@ -1820,6 +2213,9 @@ void gs_blend_function(enum gs_blend_type src, enum gs_blend_type dest)
 	if (!gs_valid("gs_blend_function"))
 		return;
 
+	if (blend_state_changes(graphics, src, dest, src, dest))
+		flush_sprites(graphics);
+
 	graphics->cur_blend_state.src_c  = src;
 	graphics->cur_blend_state.dest_c = dest;
 	graphics->cur_blend_state.src_a  = src;
@@ -1836,6 +2232,9 @@ void gs_blend_function_separate(
 	if (!gs_valid("gs_blend_function_separate"))
 		return;
 
+	if (blend_state_changes(graphics, src_c, dest_c, src_a, dest_a))
+		flush_sprites(graphics);
+
 	graphics->cur_blend_state.src_c  = src_c;
 	graphics->cur_blend_state.dest_c = dest_c;
 	graphics->cur_blend_state.src_a  = src_a;
@@ -1851,6 +2250,8 @@ void gs_depth_function(enum gs_depth_test test)
 	if (!gs_valid("gs_depth_function"))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_depth_function(graphics->device, test);
 }
 
@@ -1861,6 +2262,8 @@ void gs_stencil_function(enum gs_stencil_side side, enum gs_depth_test test)
 	if (!gs_valid("gs_stencil_function"))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_stencil_function(graphics->device, side, test);
 }
 
@@ -1872,6 +2275,8 @@ void gs_stencil_op(enum gs_stencil_side side, enum gs_stencil_op_type fail,
 	if (!gs_valid("gs_stencil_op"))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_stencil_op(graphics->device, side, fail, zfail,
 			zpass);
 }
@@ -1883,6 +2288,8 @@ void gs_set_viewport(int x, int y, int width, int height)
 	if (!gs_valid("gs_set_viewport"))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_set_viewport(graphics->device, x, y, width,
 			height);
 }
@@ -1904,6 +2311,8 @@ void gs_set_scissor_rect(const struct gs_rect *rect)
 	if (!gs_valid("gs_set_scissor_rect"))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_set_scissor_rect(graphics->device, rect);
 }
 
@@ -1915,6 +2324,8 @@ void gs_ortho(float left, float right, float top, float bottom, float znear,
 	if (!gs_valid("gs_ortho"))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_ortho(graphics->device, left, right, top,
 			bottom, znear, zfar);
 }
@@ -1927,6 +2338,8 @@ void gs_frustum(float left, float right, float top, float bottom, float znear,
 	if (!gs_valid("gs_frustum"))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_frustum(graphics->device, left, right, top,
 			bottom, znear, zfar);
 }
@@ -1948,6 +2361,8 @@ void gs_projection_pop(void)
 	if (!gs_valid("gs_projection_pop"))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.device_projection_pop(graphics->device);
 }
 
@@ -1972,6 +2387,8 @@ void gs_shader_destroy(gs_shader_t *shader)
 	if (!shader)
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.gs_shader_destroy(shader);
 }
 
@@ -2043,6 +2460,8 @@ void gs_shader_set_bool(gs_sparam_t *param, bool val)
 	if (!gs_valid_p("gs_shader_set_bool", param))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.gs_shader_set_bool(param, val);
 }
 
@@ -2053,6 +2472,8 @@ void gs_shader_set_float(gs_sparam_t *param, float val)
 	if (!gs_valid_p("gs_shader_set_float", param))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.gs_shader_set_float(param, val);
 }
 
@@ -2063,6 +2484,8 @@ void gs_shader_set_int(gs_sparam_t *param, int val)
 	if (!gs_valid_p("gs_shader_set_int", param))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.gs_shader_set_int(param, val);
 }
 
@@ -2073,6 +2496,8 @@ void gs_shader_set_matrix3(gs_sparam_t *param, const struct matrix3 *val)
 	if (!gs_valid_p2("gs_shader_set_matrix3", param, val))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.gs_shader_set_matrix3(param, val);
 }
 
@@ -2083,6 +2508,8 @@ void gs_shader_set_matrix4(gs_sparam_t *param, const struct matrix4 *val)
 	if (!gs_valid_p2("gs_shader_set_matrix4", param, val))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.gs_shader_set_matrix4(param, val);
 }
 
@@ -2093,6 +2520,8 @@ void gs_shader_set_vec2(gs_sparam_t *param, const struct vec2 *val)
 	if (!gs_valid_p2("gs_shader_set_vec2", param, val))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.gs_shader_set_vec2(param, val);
 }
 
@@ -2103,6 +2532,8 @@ void gs_shader_set_vec3(gs_sparam_t *param, const struct vec3 *val)
 	if (!gs_valid_p2("gs_shader_set_vec3", param, val))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.gs_shader_set_vec3(param, val);
 }
 
@@ -2113,6 +2544,8 @@ void gs_shader_set_vec4(gs_sparam_t *param, const struct vec4 *val)
 	if (!gs_valid_p2("gs_shader_set_vec4", param, val))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.gs_shader_set_vec4(param, val);
 }
 
@@ -2123,6 +2556,8 @@ void gs_shader_set_texture(gs_sparam_t *param, gs_texture_t *val)
 	if (!gs_valid_p("gs_shader_set_texture", param))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.gs_shader_set_texture(param, val);
 }
 
@@ -2133,6 +2568,8 @@ void gs_shader_set_val(gs_sparam_t *param, const void *val, size_t size)
 	if (!gs_valid_p2("gs_shader_set_val", param, val))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.gs_shader_set_val(param, val, size);
 }
 
@@ -2143,6 +2580,8 @@ void gs_shader_set_default(gs_sparam_t *param)
 	if (!gs_valid_p("gs_shader_set_default", param))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.gs_shader_set_default(param);
 }
 
@@ -2153,6 +2592,8 @@ void gs_shader_set_next_sampler(gs_sparam_t *param, gs_samplerstate_t *sampler)
 	if (!gs_valid_p("gs_shader_set_next_sampler", param))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.gs_shader_set_next_sampler(param, sampler);
 }
 
@@ -2165,6 +2606,8 @@ void gs_texture_destroy(gs_texture_t *tex)
 	if (!tex)
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.gs_texture_destroy(tex);
 }
 
@@ -2205,6 +2648,8 @@ bool gs_texture_map(gs_texture_t *tex, uint8_t **ptr, uint32_t *linesize)
 	if (!gs_valid_p3("gs_texture_map", tex, ptr, linesize))
 		return false;
 
+	flush_sprites(graphics);
+
 	return graphics->exports.gs_texture_map(tex, ptr, linesize);
 }
 
@@ -2215,6 +2660,8 @@ void gs_texture_unmap(gs_texture_t *tex)
 	if (!gs_valid_p("gs_texture_unmap", tex))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.gs_texture_unmap(tex);
 }
 
@@ -2250,6 +2697,8 @@ void gs_cubetexture_destroy(gs_texture_t *cubetex)
 	if (!cubetex)
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.gs_cubetexture_destroy(cubetex);
 }
 
@@ -2283,6 +2732,8 @@ void gs_voltexture_destroy(gs_texture_t *voltex)
 	if (!voltex)
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.gs_voltexture_destroy(voltex);
 }
 
@@ -2335,6 +2786,8 @@ void gs_stagesurface_destroy(gs_stagesurf_t *stagesurf)
 	if (!stagesurf)
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.gs_stagesurface_destroy(stagesurf);
 }
 
@@ -2377,6 +2830,8 @@ bool gs_stagesurface_map(gs_stagesurf_t *stagesurf, uint8_t **data,
 	if (!gs_valid_p3("gs_stagesurface_map", stagesurf, data, linesize))
 		return 0;
 
+	flush_sprites(graphics);
+
 	return graphics->exports.gs_stagesurface_map(stagesurf, data, linesize);
 }
 
@@ -2387,6 +2842,8 @@ void gs_stagesurface_unmap(gs_stagesurf_t *stagesurf)
 	if (!gs_valid_p("gs_stagesurface_unmap", stagesurf))
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.gs_stagesurface_unmap(stagesurf);
 }
 
@@ -2397,6 +2854,8 @@ void gs_zstencil_destroy(gs_zstencil_t *zstencil)
 	if (!zstencil)
 		return;
 
+	flush_sprites(thread_graphics);
+
 	thread_graphics->exports.gs_zstencil_destroy(zstencil);
 }
 
@@ -2407,6 +2866,8 @@ void gs_samplerstate_destroy(gs_samplerstate_t *samplerstate)
 	if (!samplerstate)
 		return;
 
+	flush_sprites(thread_graphics);
+
 	thread_graphics->exports.gs_samplerstate_destroy(samplerstate);
 }
 
@@ -2419,6 +2880,8 @@ void gs_vertexbuffer_destroy(gs_vertbuffer_t *vertbuffer)
 	if (!vertbuffer)
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.gs_vertexbuffer_destroy(vertbuffer);
 }
 
@@ -2427,6 +2890,8 @@ void gs_vertexbuffer_flush(gs_vertbuffer_t *vertbuffer)
 	if (!gs_valid_p("gs_vertexbuffer_flush", vertbuffer))
 		return;
 
+	flush_sprites(thread_graphics);
+
 	thread_graphics->exports.gs_vertexbuffer_flush(vertbuffer);
 }
 
@@ -2447,6 +2912,8 @@ void gs_indexbuffer_destroy(gs_indexbuffer_t *indexbuffer)
 	if (!indexbuffer)
 		return;
 
+	flush_sprites(graphics);
+
 	graphics->exports.gs_indexbuffer_destroy(indexbuffer);
 }
 
@@ -2455,6 +2922,8 @@ void   gs_indexbuffer_flush(gs_indexbuffer_t *indexbuffer)
 	if (!gs_valid_p("gs_indexbuffer_flush", indexbuffer))
 		return;
 
+	flush_sprites(thread_graphics);
+
 	thread_graphics->exports.gs_indexbuffer_flush(indexbuffer);
 }
 
@@ -2495,6 +2964,8 @@ gs_texture_t *gs_texture_create_from_iosurface(void *iosurf)
 	if (!graphics->exports.device_texture_create_from_iosurface)
 		return NULL;
 
+	flush_sprites(graphics);
+
 	return graphics->exports.device_texture_create_from_iosurface(
 			graphics->device, iosurf);
 }
@@ -2508,6 +2979,8 @@ bool gs_texture_rebind_iosurface(gs_texture_t *texture, void *iosurf)
 	if (!graphics->exports.gs_texture_rebind_iosurface)
 		return false;
 
+	flush_sprites(graphics);
+
 	return graphics->exports.gs_texture_rebind_iosurface(texture, iosurf);
 }
 
@@ -2572,6 +3045,8 @@ bool gs_duplicator_update_frame(gs_duplicator_t *duplicator)
 	if (!thread_graphics->exports.gs_duplicator_get_texture)
 		return false;
 
+	flush_sprites(thread_graphics);
+
 	return thread_graphics->exports.gs_duplicator_update_frame(duplicator);
 }
 
@@ -2593,9 +3068,11 @@ gs_texture_t *gs_texture_create_gdi(uint32_t width, uint32_t height)
 	if (!gs_valid("gs_texture_create_gdi"))
 		return NULL;
 
-	if (graphics->exports.device_texture_create_gdi)
+	if (graphics->exports.device_texture_create_gdi) {
+		flush_sprites(graphics);
 		return graphics->exports.device_texture_create_gdi(
 				graphics->device, width, height);
+	}
 	return NULL;
 }
 
@@ -2604,6 +3081,8 @@ void *gs_texture_get_dc(gs_texture_t *gdi_tex)
 	if (!gs_valid_p("gs_texture_release_dc", gdi_tex))
 		return NULL;
 
+	flush_sprites(thread_graphics);
+
 	if (thread_graphics->exports.gs_texture_get_dc)
 		return thread_graphics->exports.gs_texture_get_dc(gdi_tex);
 	return NULL;
@@ -2624,9 +3103,11 @@ gs_texture_t *gs_texture_open_shared(uint32_t handle)
 	if (!gs_valid("gs_texture_open_shared"))
 		return NULL;
 
-	if (graphics->exports.device_texture_open_shared)
+	if (graphics->exports.device_texture_open_shared) {
+		flush_sprites(graphics);
 		return graphics->exports.device_texture_open_shared(
 				graphics->device, handle);
+	}
 	return NULL;
 }
 
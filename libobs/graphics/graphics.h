@@ -384,6 +384,15 @@ EXPORT gs_eparam_t *gs_effect_get_world_matrix(const gs_effect_t *effect);
 
 EXPORT void gs_effect_get_param_info(const gs_eparam_t *param,
 		struct gs_effect_param_info *info);
+
+struct gs_effect_stats {
+	uint64_t param_lookups; /* gs_effect_get_param_by_name calls */
+	uint64_t param_uploads; /* parameter values sent to shaders */
+};
+
+/** Gets the effect parameter counters of the current context since the
+ * last call, and resets them */
+EXPORT void gs_effect_get_stats(struct gs_effect_stats *stats);
 EXPORT void gs_effect_set_bool(gs_eparam_t *param, bool val);
 EXPORT void gs_effect_set_float(gs_eparam_t *param, float val);
 EXPORT void gs_effect_set_int(gs_eparam_t *param, int val);
@@ -402,8 +411,26 @@ EXPORT void gs_effect_set_next_sampler(gs_eparam_t *param,
  * texture render helper functions
  * --------------------------------------------------- */
 
+/*
+ *   Render targets of texrenders come from a pool shared by all texrenders of
+ * the graphics context, keyed by size and format.  A texrender returns its
+ * target to the pool when it is resized or destroyed, and transient
+ * texrenders also return it on every gs_texrender_reset, so their texture is
+ * only valid between gs_texrender_begin and the next reset.  Idle targets
+ * are destroyed by gs_texrender_pool_trim.
+ */
+
+struct gs_texrender_pool_stats {
+	uint64_t hits;         /* targets reused from the pool */
+	uint64_t misses;       /* targets that had to be created */
+	uint64_t bytes_held;   /* idle targets in the pool */
+	uint64_t bytes_in_use; /* targets used by texrenders */
+};
+
 EXPORT gs_texrender_t *gs_texrender_create(enum gs_color_format format,
 		enum gs_zstencil_format zsformat);
+EXPORT gs_texrender_t *gs_texrender_create_transient(
+		enum gs_color_format format, enum gs_zstencil_format zsformat);
 EXPORT void gs_texrender_destroy(gs_texrender_t *texrender);
 EXPORT bool gs_texrender_begin(gs_texrender_t *texrender, uint32_t cx,
 		uint32_t cy);
@@ -411,6 +438,14 @@ EXPORT void gs_texrender_end(gs_texrender_t *texrender);
 EXPORT void gs_texrender_reset(gs_texrender_t *texrender);
 EXPORT gs_texture_t *gs_texrender_get_texture(const gs_texrender_t *texrender);
 
+/** Destroys the pooled render targets of the current context that have been
+ * idle for more than max_idle_frames calls (libobs calls this every frame) */
+EXPORT void gs_texrender_pool_trim(uint32_t max_idle_frames);
+
+/** Gets the render target pool counters of the current context.  Hits and
+ * misses are totals since the context was created, byte counts are current */
+EXPORT void gs_texrender_pool_get_stats(struct gs_texrender_pool_stats *stats);
+
 /* ---------------------------------------------------
  * graphics subsystem
  * --------------------------------------------------- */
@@ -451,6 +486,7 @@ struct gs_init_data {
 
 #define GS_DEVICE_OPENGL      1
 #define GS_DEVICE_DIRECT3D_11 2
+#define GS_DEVICE_NULL        3
 
 EXPORT const char *gs_get_device_name(void);
 EXPORT int gs_get_device_type(void);
@@ -521,6 +557,12 @@ EXPORT uint8_t *gs_create_texture_file_data(const char *file,
  *   If width or height is 0, the width or height of the texture will be used.
  * The flip value specifies whether the texture should be flipped on the U or V
  * axis with GS_FLIP_U and GS_FLIP_V.
+ *
+ *   Sprites are batched: consecutive sprites drawn with the same effect pass
+ * and parameter values are drawn together with one draw call.  A batch is
+ * drawn before anything changes the state it depends on (render target,
+ * blending, shaders, viewport, projection and so on), so this is not visible
+ * to callers.
  */
 EXPORT void gs_draw_sprite(gs_texture_t *tex, uint32_t flip, uint32_t width,
 		uint32_t height);
@@ -528,6 +570,21 @@ EXPORT void gs_draw_sprite(gs_texture_t *tex, uint32_t flip, uint32_t width,
 EXPORT void gs_draw_sprite_subregion(gs_texture_t *tex, uint32_t flip,
 		uint32_t x, uint32_t y, uint32_t cx, uint32_t cy);
 
+/** Enables or disables sprite batching for the current context (enabled by
+ * default) */
+EXPORT void gs_enable_sprite_batching(bool enable);
+EXPORT bool gs_sprite_batching_enabled(void);
+
+struct gs_draw_stats {
+	uint64_t draw_calls;      /* draws sent to the graphics module */
+	uint64_t sprites;         /* sprites drawn */
+	uint64_t batched_sprites; /* sprites drawn in batches of two or more */
+};
+
+/** Gets the draw counters of the current context, totals since the context
+ * was created */
+EXPORT void gs_get_draw_stats(struct gs_draw_stats *stats);
+
 EXPORT void gs_draw_cube_backdrop(gs_texture_t *cubetex, const struct quat *rot,
 		float left, float right, float top, float bottom, float znear);
 
@@ -549,9 +606,18 @@ EXPORT void gs_cubetexture_set_image(gs_texture_t *cubetex, uint32_t side,
 
 EXPORT void gs_perspective(float fovy, float aspect, float znear, float zfar);
 
+struct gs_blend_state {
+	bool               enabled;
+	enum gs_blend_type src_c;
+	enum gs_blend_type dest_c;
+	enum gs_blend_type src_a;
+	enum gs_blend_type dest_a;
+};
+
 EXPORT void gs_blend_state_push(void);
 EXPORT void gs_blend_state_pop(void);
 EXPORT void gs_reset_blend_state(void);
+EXPORT void gs_get_blend_state(struct gs_blend_state *state);
 
 /* -------------------------- */
 /* library-specific functions */
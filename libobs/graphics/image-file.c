@@ -18,6 +18,7 @@
 #include "image-file.h"
 #include "../util/base.h"
 #include "../util/platform.h"
+#include "../util/threading.h"
 
 #define blog(level, format, ...) \
 	blog(level, "%s: " format, __FUNCTION__, __VA_ARGS__)
@@ -54,16 +55,277 @@ static void bi_def_bitmap_modified(void *bitmap)
 	UNUSED_PARAMETER(bitmap);
 }
 
-static inline int get_full_decoded_gif_size(gs_image_file_t *image)
+/* ------------------------------------------------------------------------- */
+/* gif streaming                                                             */
+
+struct gif_frame_slot {
+	uint8_t *data;
+	int frame;
+	bool decoding;
+};
+
+struct gs_image_gif_stream {
+	pthread_t thread;
+	bool thread_active;
+	os_event_t *event;
+	pthread_mutex_t mutex;
+	volatile bool stop;
+
+	struct gif_frame_slot *slots;
+	uint8_t *slot_data;
+	size_t num_slots;
+
+	/* first frame of the window to keep decoded */
+	int want;
+
+	/* only used by the decoder thread (or before it starts) */
+	int last_decoded;
+
+	/* only used by the graphics thread */
+	int uploaded;
+};
+
+static inline size_t get_frame_size(gs_image_file_t *image)
+{
+	return (size_t)image->gif.width * (size_t)image->gif.height * 4;
+}
+
+static inline struct gif_frame_slot *find_ready_slot(
+		struct gs_image_gif_stream *stream, int frame)
+{
+	for (size_t i = 0; i < stream->num_slots; i++) {
+		struct gif_frame_slot *slot = &stream->slots[i];
+		if (slot->frame == frame && !slot->decoding)
+			return slot;
+	}
+
+	return NULL;
+}
+
+static inline bool in_window(struct gs_image_gif_stream *stream, int frame,
+		int frame_count)
+{
+	int offset = (frame - stream->want + frame_count) % frame_count;
+	return (size_t)offset < stream->num_slots;
+}
+
+/* free slots first, then slots holding frames that left the window */
+static struct gif_frame_slot *find_reusable_slot(
+		struct gs_image_gif_stream *stream, int frame_count)
+{
+	struct gif_frame_slot *stale = NULL;
+
+	for (size_t i = 0; i < stream->num_slots; i++) {
+		struct gif_frame_slot *slot = &stream->slots[i];
+		if (slot->decoding)
+			continue;
+
+		if (slot->frame == -1)
+			return slot;
+		if (!stale && !in_window(stream, slot->frame, frame_count))
+			stale = slot;
+	}
+
+	return stale;
+}
+
+/* leaves frame decoded in gif.frame_image.  frames can only be composited
+ * in order, so going backwards starts over from frame 0. */
+static void stream_decode_frame(gs_image_file_t *image, int frame)
+{
+	struct gs_image_gif_stream *stream = image->stream;
+	int first;
+
+	if (frame == stream->last_decoded)
+		return;
+
+	first = (frame < stream->last_decoded) ?
+		0 : stream->last_decoded + 1;
+
+	for (int i = first; i <= frame; i++)
+		gif_decode_frame(&image->gif, i);
+
+	stream->last_decoded = frame;
+}
+
+static bool stream_decode_next(gs_image_file_t *image)
+{
+	struct gs_image_gif_stream *stream = image->stream;
+	int frame_count = (int)image->gif.frame_count;
+	struct gif_frame_slot *slot = NULL;
+	int frame = -1;
+
+	pthread_mutex_lock(&stream->mutex);
+
+	for (size_t i = 0; i < stream->num_slots; i++) {
+		int cur = (stream->want + (int)i) % frame_count;
+		if (!find_ready_slot(stream, cur)) {
+			frame = cur;
+			break;
+		}
+	}
+
+	if (frame != -1)
+		slot = find_reusable_slot(stream, frame_count);
+	if (slot) {
+		slot->frame = -1;
+		slot->decoding = true;
+	}
+
+	pthread_mutex_unlock(&stream->mutex);
+
+	if (!slot)
+		return false;
+
+	stream_decode_frame(image, frame);
+	memcpy(slot->data, image->gif.frame_image, get_frame_size(image));
+
+	pthread_mutex_lock(&stream->mutex);
+	slot->frame = frame;
+	slot->decoding = false;
+	pthread_mutex_unlock(&stream->mutex);
+	return true;
+}
+
+static void *gif_stream_thread(void *data)
 {
-	return image->gif.width * image->gif.height * 4 * image->gif.frame_count;
+	gs_image_file_t *image = data;
+	struct gs_image_gif_stream *stream = image->stream;
+
+	os_set_thread_name("image-file: gif stream decode");
+
+	while (os_event_wait(stream->event) == 0) {
+		if (stream->stop)
+			break;
+
+		while (!stream->stop && stream_decode_next(image));
+	}
+
+	return NULL;
+}
+
+static void gif_stream_destroy(gs_image_file_t *image)
+{
+	struct gs_image_gif_stream *stream = image->stream;
+
+	if (!stream)
+		return;
+
+	if (stream->thread_active) {
+		stream->stop = true;
+		os_event_signal(stream->event);
+		pthread_join(stream->thread, NULL);
+	}
+
+	os_event_destroy(stream->event);
+	pthread_mutex_destroy(&stream->mutex);
+	bfree(stream->slot_data);
+	bfree(stream->slots);
+	bfree(stream);
+	image->stream = NULL;
 }
 
-static bool init_animated_gif(gs_image_file_t *image, const char *path)
+static bool init_gif_stream(gs_image_file_t *image, uint64_t budget)
+{
+	struct gs_image_gif_stream *stream;
+	size_t frame_size = get_frame_size(image);
+	uint64_t num_slots = budget / frame_size;
+
+	if (num_slots < 2)
+		num_slots = 2;
+	if (num_slots > image->gif.frame_count)
+		num_slots = image->gif.frame_count;
+
+	stream = bzalloc(sizeof(*stream));
+	stream->num_slots = (size_t)num_slots;
+	stream->slots = bzalloc(stream->num_slots * sizeof(*stream->slots));
+	stream->slot_data = bmalloc(stream->num_slots * frame_size);
+	stream->last_decoded = -1;
+	stream->uploaded = -1;
+	pthread_mutex_init_value(&stream->mutex);
+	image->stream = stream;
+
+	for (size_t i = 0; i < stream->num_slots; i++) {
+		stream->slots[i].data = stream->slot_data + i * frame_size;
+		stream->slots[i].frame = -1;
+	}
+
+	if (pthread_mutex_init(&stream->mutex, NULL) != 0)
+		return false;
+	if (os_event_init(&stream->event, OS_EVENT_TYPE_AUTO) != 0)
+		return false;
+
+	/* frame 0 is needed right away for the texture */
+	stream_decode_frame(image, 0);
+	memcpy(stream->slots[0].data, image->gif.frame_image, frame_size);
+	stream->slots[0].frame = 0;
+
+	if (pthread_create(&stream->thread, NULL, gif_stream_thread,
+				image) != 0)
+		return false;
+
+	stream->thread_active = true;
+	os_event_signal(stream->event);
+
+	image->mem_usage += stream->num_slots * frame_size;
+	return true;
+}
+
+static void gif_stream_request(struct gs_image_gif_stream *stream, int frame)
+{
+	bool changed;
+
+	pthread_mutex_lock(&stream->mutex);
+	changed = stream->want != frame;
+	stream->want = frame;
+	pthread_mutex_unlock(&stream->mutex);
+
+	if (changed)
+		os_event_signal(stream->event);
+}
+
+static bool gif_stream_frame_pending(gs_image_file_t *image)
+{
+	struct gs_image_gif_stream *stream = image->stream;
+	bool ready;
+
+	if (stream->uploaded == image->cur_frame)
+		return false;
+
+	pthread_mutex_lock(&stream->mutex);
+	ready = find_ready_slot(stream, image->cur_frame) != NULL;
+	pthread_mutex_unlock(&stream->mutex);
+	return ready;
+}
+
+static void gif_stream_upload(gs_image_file_t *image)
+{
+	struct gs_image_gif_stream *stream = image->stream;
+	struct gif_frame_slot *slot;
+
+	if (!image->texture || stream->uploaded == image->cur_frame)
+		return;
+
+	pthread_mutex_lock(&stream->mutex);
+	slot = find_ready_slot(stream, image->cur_frame);
+	if (slot)
+		gs_texture_set_image(image->texture, slot->data,
+				image->gif.width * 4, false);
+	pthread_mutex_unlock(&stream->mutex);
+
+	if (slot)
+		stream->uploaded = image->cur_frame;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void decode_new_frame(gs_image_file_t *image, int new_frame);
+
+static bool init_animated_gif(gs_image_file_t *image, const char *path,
+		uint64_t budget)
 {
 	bool is_animated_gif = true;
 	gif_result result;
-	uint64_t max_size;
 	size_t size;
 	FILE *file;
 
@@ -104,35 +366,31 @@ static bool init_animated_gif(gs_image_file_t *image, const char *path)
 		goto fail;
 	}
 
-	max_size = (uint64_t)image->gif.width * (uint64_t)image->gif.height *
-		(uint64_t)image->gif.frame_count * 4LLU;
-
-	if ((uint64_t)get_full_decoded_gif_size(image) != max_size) {
-		blog(LOG_WARNING, "Gif '%s' overflowed maximum pointer size",
-				path);
-		goto fail;
-	}
-
 	image->is_animated_gif = (image->gif.frame_count > 1 && result >= 0);
 	if (image->is_animated_gif) {
-		gif_decode_frame(&image->gif, 0);
-
-		image->animation_frame_cache = bzalloc(
-				image->gif.frame_count * sizeof(uint8_t*));
-		image->animation_frame_data = bzalloc(
-				get_full_decoded_gif_size(image));
-
-		for (unsigned int i = 0; i < image->gif.frame_count; i++) {
-			if (gif_decode_frame(&image->gif, i) != GIF_OK)
-				blog(LOG_WARNING, "Couldn't decode frame %u "
-						"of '%s'", i, path);
-		}
-
-		gif_decode_frame(&image->gif, 0);
+		uint64_t frame_size = get_frame_size(image);
+		uint64_t full_size = frame_size * image->gif.frame_count;
 
 		image->cx = (uint32_t)image->gif.width;
 		image->cy = (uint32_t)image->gif.height;
 		image->format = GS_RGBA;
+		image->mem_usage = size + frame_size;
+
+		if (full_size <= budget && (size_t)full_size == full_size) {
+			image->animation_frame_cache = bzalloc(
+					image->gif.frame_count *
+					sizeof(uint8_t*));
+			image->animation_frame_data = bzalloc(
+					(size_t)full_size);
+			image->mem_usage += full_size;
+
+			decode_new_frame(image, 0);
+
+		} else if (!init_gif_stream(image, budget)) {
+			blog(LOG_WARNING, "Failed to start decoding '%s'",
+					path);
+			goto fail;
+		}
 	} else {
 		gif_finalise(&image->gif);
 		bfree(image->gif_data);
@@ -153,8 +411,10 @@ not_animated:
 	return is_animated_gif;
 }
 
-void gs_image_file_init(gs_image_file_t *image, const char *file)
+void gs_image_file_init_with_budget(gs_image_file_t *image,
+		const char *file, uint64_t gif_mem_budget)
 {
+	uint64_t start_time;
 	size_t len;
 
 	if (!image)
@@ -165,11 +425,14 @@ void gs_image_file_init(gs_image_file_t *image, const char *file)
 	if (!file)
 		return;
 
+	start_time = os_gettime_ns();
 	len = strlen(file);
 
 	if (len > 4 && strcmp(file + len - 4, ".gif") == 0) {
-		if (init_animated_gif(image, file))
+		if (init_animated_gif(image, file, gif_mem_budget)) {
+			image->load_time_ns = os_gettime_ns() - start_time;
 			return;
+		}
 	}
 
 	image->texture_data = gs_create_texture_file_data(file,
@@ -179,7 +442,18 @@ void gs_image_file_init(gs_image_file_t *image, const char *file)
 	if (!image->loaded) {
 		blog(LOG_WARNING, "Failed to load file '%s'", file);
 		gs_image_file_free(image);
+		return;
 	}
+
+	image->mem_usage = (uint64_t)image->cx * (uint64_t)image->cy *
+		gs_get_format_bpp(image->format) / 8;
+	image->load_time_ns = os_gettime_ns() - start_time;
+}
+
+void gs_image_file_init(gs_image_file_t *image, const char *file)
+{
+	gs_image_file_init_with_budget(image, file,
+			GS_IMAGE_FILE_DEFAULT_GIF_BUDGET);
 }
 
 void gs_image_file_free(gs_image_file_t *image)
@@ -187,6 +461,8 @@ void gs_image_file_free(gs_image_file_t *image)
 	if (!image)
 		return;
 
+	gif_stream_destroy(image);
+
 	if (image->loaded) {
 		if (image->is_animated_gif) {
 			gif_finalise(&image->gif);
@@ -207,7 +483,14 @@ void gs_image_file_init_texture(gs_image_file_t *image)
 	if (!image->loaded)
 		return;
 
-	if (image->is_animated_gif) {
+	if (image->stream) {
+		image->texture = gs_texture_create(
+				image->cx, image->cy, image->format, 1,
+				NULL, GS_DYNAMIC);
+		image->stream->uploaded = -1;
+		gif_stream_upload(image);
+
+	} else if (image->is_animated_gif) {
 		image->texture = gs_texture_create(
 				image->cx, image->cy, image->format, 1,
 				(const uint8_t**)&image->gif.frame_image,
@@ -219,6 +502,7 @@ void gs_image_file_init_texture(gs_image_file_t *image)
 				(const uint8_t**)&image->texture_data, 0);
 		bfree(image->texture_data);
 		image->texture_data = NULL;
+		image->mem_usage = 0;
 	}
 }
 
@@ -305,12 +589,19 @@ bool gs_image_file_tick(gs_image_file_t *image, uint64_t elapsed_time_ns)
 				loops);
 
 		if (new_frame != image->cur_frame) {
-			decode_new_frame(image, new_frame);
-			return true;
+			if (!image->stream) {
+				decode_new_frame(image, new_frame);
+				return true;
+			}
+
+			image->cur_frame = new_frame;
+			gif_stream_request(image->stream, new_frame);
 		}
 	}
 
-	return false;
+	/* a streamed frame may not have been decoded in time; it is
+	 * shown as soon as the decoder catches up */
+	return image->stream ? gif_stream_frame_pending(image) : false;
 }
 
 void gs_image_file_update_texture(gs_image_file_t *image)
@@ -318,6 +609,12 @@ void gs_image_file_update_texture(gs_image_file_t *image)
 	if (!image->is_animated_gif || !image->loaded)
 		return;
 
+	if (image->stream) {
+		gif_stream_request(image->stream, image->cur_frame);
+		gif_stream_upload(image);
+		return;
+	}
+
 	if (!image->animation_frame_cache[image->cur_frame])
 		decode_new_frame(image, image->cur_frame);
 
@@ -20,6 +20,16 @@
 #include "graphics.h"
 #include "libnsgif/libnsgif.h"
 
+/*
+ * Animated gifs whose decoded frames fit in the memory budget are cached in
+ * full as they are first shown.  Larger gifs are streamed instead: only a
+ * window of upcoming frames (at least two) is kept in memory, and a
+ * background thread decodes ahead into it from the compressed file data.
+ */
+#define GS_IMAGE_FILE_DEFAULT_GIF_BUDGET (256ULL * 1024ULL * 1024ULL)
+
+struct gs_image_gif_stream;
+
 struct gs_image_file {
 	gs_texture_t *texture;
 	enum gs_color_format format;
@@ -38,13 +48,20 @@ struct gs_image_file {
 	int cur_loop;
 	int last_decoded_frame;
 
+	struct gs_image_gif_stream *stream;
+
 	uint8_t *texture_data;
 	gif_bitmap_callback_vt bitmap_callbacks;
+
+	uint64_t load_time_ns;
+	uint64_t mem_usage;
 };
 
 typedef struct gs_image_file gs_image_file_t;
 
 EXPORT void gs_image_file_init(gs_image_file_t *image, const char *file);
+EXPORT void gs_image_file_init_with_budget(gs_image_file_t *image,
+		const char *file, uint64_t gif_mem_budget);
 EXPORT void gs_image_file_free(gs_image_file_t *image);
 
 EXPORT void gs_image_file_init_texture(gs_image_file_t *image);
@@ -21,7 +21,7 @@
  */
 
 #include <assert.h>
-#include "graphics.h"
+#include "graphics-internal.h"
 
 struct gs_texture_render {
 	gs_texture_t  *target, *prev_target;
@@ -32,61 +32,243 @@ struct gs_texture_render {
 	enum gs_color_format    format;
 	enum gs_zstencil_format zsformat;
 
+	/* context the target came from */
+	graphics_t *graphics;
+
+	bool transient;
 	bool rendered;
 };
 
-gs_texrender_t *gs_texrender_create(enum gs_color_format format,
-		enum gs_zstencil_format zsformat)
+/* ------------------------------------------------------------------------- */
+/* render target pool                                                        */
+
+static inline uint64_t zstencil_size(enum gs_zstencil_format format)
 {
-	struct gs_texture_render *texrender;
-	texrender = bzalloc(sizeof(struct gs_texture_render));
-	texrender->format   = format;
-	texrender->zsformat = zsformat;
+	switch (format) {
+	case GS_ZS_NONE:        return 0;
+	case GS_Z16:            return 2;
+	case GS_Z24_S8:         return 4;
+	case GS_Z32F:           return 4;
+	case GS_Z32F_S8X24:     return 8;
+	}
 
-	return texrender;
+	return 0;
 }
 
-void gs_texrender_destroy(gs_texrender_t *texrender)
+static inline uint64_t target_size(uint32_t cx, uint32_t cy,
+		enum gs_color_format format, enum gs_zstencil_format zsformat)
 {
-	if (texrender) {
-		gs_texture_destroy(texrender->target);
-		gs_zstencil_destroy(texrender->zs);
-		bfree(texrender);
-	}
+	uint64_t pixels = (uint64_t)cx * (uint64_t)cy;
+	return pixels * gs_get_format_bpp(format) / 8 +
+		pixels * zstencil_size(zsformat);
 }
 
-static bool texrender_resetbuffer(gs_texrender_t *texrender, uint32_t cx,
+/* takes an idle target of the texrender's size and format from the pool, or
+ * creates one.  must be called with the graphics context active. */
+static bool texrender_checkout(gs_texrender_t *texrender, uint32_t cx,
 		uint32_t cy)
 {
-	if (!texrender)
+	graphics_t *graphics = gs_get_context();
+	struct gs_texrender_pool *pool;
+	uint64_t size;
+	bool found = false;
+
+	if (!graphics)
 		return false;
 
-	gs_texture_destroy(texrender->target);
-	gs_zstencil_destroy(texrender->zs);
+	pool = &graphics->texrender_pool;
+	size = target_size(cx, cy, texrender->format, texrender->zsformat);
 
-	texrender->target = NULL;
-	texrender->zs     = NULL;
-	texrender->cx     = cx;
-	texrender->cy     = cy;
+	pthread_mutex_lock(&pool->mutex);
 
-	texrender->target = gs_texture_create(cx, cy, texrender->format,
-			1, NULL, GS_RENDER_TARGET);
-	if (!texrender->target)
-		return false;
+	/* most recently returned first */
+	for (size_t i = pool->targets.num; i > 0; i--) {
+		struct gs_texrender_target *target =
+			pool->targets.array + (i - 1);
 
-	if (texrender->zsformat != GS_ZS_NONE) {
-		texrender->zs = gs_zstencil_create(cx, cy, texrender->zsformat);
-		if (!texrender->zs) {
-			gs_texture_destroy(texrender->target);
-			texrender->target = NULL;
+		if (target->cx == cx && target->cy == cy &&
+		    target->format == texrender->format &&
+		    target->zsformat == texrender->zsformat) {
+			texrender->target = target->tex;
+			texrender->zs     = target->zs;
+			da_erase(pool->targets, i - 1);
+			found = true;
+			break;
+		}
+	}
+
+	if (found) {
+		pool->stats.hits++;
+		pool->stats.bytes_held -= size;
+	} else {
+		pool->stats.misses++;
+	}
+
+	pthread_mutex_unlock(&pool->mutex);
 
+	if (!found) {
+		texrender->target = gs_texture_create(cx, cy,
+				texrender->format, 1, NULL, GS_RENDER_TARGET);
+		if (!texrender->target)
 			return false;
+
+		if (texrender->zsformat != GS_ZS_NONE) {
+			texrender->zs = gs_zstencil_create(cx, cy,
+					texrender->zsformat);
+			if (!texrender->zs) {
+				gs_texture_destroy(texrender->target);
+				texrender->target = NULL;
+				return false;
+			}
 		}
 	}
 
+	pthread_mutex_lock(&pool->mutex);
+	pool->stats.bytes_in_use += size;
+	pthread_mutex_unlock(&pool->mutex);
+
+	texrender->graphics = graphics;
+	texrender->cx       = cx;
+	texrender->cy       = cy;
 	return true;
 }
 
+/* gives the texrender's target back to the pool.  does not call into the
+ * graphics module, so it's safe without the graphics context. */
+static void texrender_return(gs_texrender_t *texrender)
+{
+	struct gs_texrender_target target;
+	struct gs_texrender_pool *pool;
+	uint64_t size;
+
+	if (!texrender->target)
+		return;
+
+	pool = &texrender->graphics->texrender_pool;
+	size = target_size(texrender->cx, texrender->cy, texrender->format,
+			texrender->zsformat);
+
+	target.tex      = texrender->target;
+	target.zs       = texrender->zs;
+	target.cx       = texrender->cx;
+	target.cy       = texrender->cy;
+	target.format   = texrender->format;
+	target.zsformat = texrender->zsformat;
+
+	pthread_mutex_lock(&pool->mutex);
+	target.last_used = pool->frame;
+	da_push_back(pool->targets, &target);
+	pool->stats.bytes_held   += size;
+	pool->stats.bytes_in_use -= size;
+	pthread_mutex_unlock(&pool->mutex);
+
+	texrender->target = NULL;
+	texrender->zs     = NULL;
+	texrender->cx     = 0;
+	texrender->cy     = 0;
+}
+
+static inline void destroy_target(struct gs_texrender_target *target)
+{
+	gs_texture_destroy(target->tex);
+	gs_zstencil_destroy(target->zs);
+}
+
+void gs_texrender_pool_free(struct gs_texrender_pool *pool)
+{
+	for (size_t i = 0; i < pool->targets.num; i++)
+		destroy_target(pool->targets.array + i);
+
+	da_free(pool->targets);
+	pool->stats.bytes_held = 0;
+}
+
+void gs_texrender_pool_trim(uint32_t max_idle_frames)
+{
+	graphics_t *graphics = gs_get_context();
+	struct gs_texrender_pool *pool;
+	DARRAY(struct gs_texrender_target) expired;
+
+	if (!graphics)
+		return;
+
+	pool = &graphics->texrender_pool;
+	da_init(expired);
+
+	pthread_mutex_lock(&pool->mutex);
+
+	pool->frame++;
+
+	for (size_t i = pool->targets.num; i > 0; i--) {
+		struct gs_texrender_target *target =
+			pool->targets.array + (i - 1);
+
+		if (pool->frame - target->last_used > max_idle_frames) {
+			pool->stats.bytes_held -= target_size(target->cx,
+					target->cy, target->format,
+					target->zsformat);
+			da_push_back(expired, target);
+			da_erase(pool->targets, i - 1);
+		}
+	}
+
+	pthread_mutex_unlock(&pool->mutex);
+
+	for (size_t i = 0; i < expired.num; i++)
+		destroy_target(expired.array + i);
+
+	da_free(expired);
+}
+
+void gs_texrender_pool_get_stats(struct gs_texrender_pool_stats *stats)
+{
+	graphics_t *graphics = gs_get_context();
+	struct gs_texrender_pool *pool;
+
+	if (!stats)
+		return;
+
+	if (!graphics) {
+		memset(stats, 0, sizeof(*stats));
+		return;
+	}
+
+	pool = &graphics->texrender_pool;
+
+	pthread_mutex_lock(&pool->mutex);
+	*stats = pool->stats;
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+
+gs_texrender_t *gs_texrender_create(enum gs_color_format format,
+		enum gs_zstencil_format zsformat)
+{
+	struct gs_texture_render *texrender;
+	texrender = bzalloc(sizeof(struct gs_texture_render));
+	texrender->format   = format;
+	texrender->zsformat = zsformat;
+
+	return texrender;
+}
+
+gs_texrender_t *gs_texrender_create_transient(enum gs_color_format format,
+		enum gs_zstencil_format zsformat)
+{
+	gs_texrender_t *texrender = gs_texrender_create(format, zsformat);
+	texrender->transient = true;
+	return texrender;
+}
+
+void gs_texrender_destroy(gs_texrender_t *texrender)
+{
+	if (texrender) {
+		texrender_return(texrender);
+		bfree(texrender);
+	}
+}
+
 bool gs_texrender_begin(gs_texrender_t *texrender, uint32_t cx, uint32_t cy)
 {
 	if (!texrender || texrender->rendered)
@@ -95,12 +277,11 @@ bool gs_texrender_begin(gs_texrender_t *texrender, uint32_t cx, uint32_t cy)
 	if (!cx || !cy)
 		return false;
 
-	if (texrender->cx != cx || texrender->cy != cy)
-		if (!texrender_resetbuffer(texrender, cx, cy))
+	if (texrender->cx != cx || texrender->cy != cy || !texrender->target) {
+		texrender_return(texrender);
+		if (!texrender_checkout(texrender, cx, cy))
 			return false;
-
-	if (!texrender->target)
-		return false;
+	}
 
 	gs_viewport_push();
 	gs_projection_push();
@@ -132,8 +313,11 @@ void gs_texrender_end(gs_texrender_t *texrender)
 
 void gs_texrender_reset(gs_texrender_t *texrender)
 {
-	if (texrender)
+	if (texrender) {
+		if (texrender->transient)
+			texrender_return(texrender);
 		texrender->rendered = false;
+	}
 }
 
 gs_texture_t *gs_texrender_get_texture(const gs_texrender_t *texrender)
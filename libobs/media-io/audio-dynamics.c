@@ -0,0 +1,478 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#include "audio-dynamics.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || \
+    defined(__x86_64__)
+#define DYN_X86
+#include <emmintrin.h>
+#endif
+
+/* 20 / ln(10) and log2(10) / 20 */
+#define LN_TO_DB       8.6858896380650365f
+#define DB_TO_LOG2     0.1660964047443681f
+
+#define SQRT_HALF      0.7071067811865475f
+#define EXP2_MIN       -126.0f
+#define EXP2_MAX       127.0f
+
+/*
+ * The log and exp2 approximations are the single precision Cephes
+ * polynomials: ln on [sqrt(0.5), sqrt(2)) and exp2 on [-0.5, 0.5], with the
+ * exponent handled separately.
+ */
+
+#define LOG_P0         7.0376836292e-2f
+#define LOG_P1         -1.1514610310e-1f
+#define LOG_P2         1.1676998740e-1f
+#define LOG_P3         -1.2420140846e-1f
+#define LOG_P4         1.4249322787e-1f
+#define LOG_P5         -1.6668057665e-1f
+#define LOG_P6         2.0000714765e-1f
+#define LOG_P7         -2.4999993993e-1f
+#define LOG_P8         3.3333331174e-1f
+#define LOG_Q1         -2.12194440e-4f
+#define LOG_Q2         0.693359375f
+
+#define EXP2_P0        1.535336188319500e-4f
+#define EXP2_P1        1.339887440266574e-3f
+#define EXP2_P2        9.618437357674640e-3f
+#define EXP2_P3        5.550332471162809e-2f
+#define EXP2_P4        2.402264791363012e-1f
+#define EXP2_P5        6.931472028550421e-1f
+
+/* ------------------------------------------------------------------------- */
+/* scalar (used for the remainders of the vectorized versions) */
+
+union float_bits {
+	float    f;
+	uint32_t i;
+};
+
+static inline float fast_ln(float x)
+{
+	union float_bits bits;
+	float z, y, fe;
+	int e;
+
+	bits.f = x > FLT_MIN ? x : FLT_MIN;
+	e = (int)(bits.i >> 23) - 126;
+	bits.i = (bits.i & 0x007fffff) | 0x3f000000;
+	x = bits.f;
+
+	if (x < SQRT_HALF) {
+		e -= 1;
+		x = x + x - 1.0f;
+	} else {
+		x = x - 1.0f;
+	}
+
+	z = x * x;
+	y = LOG_P0;
+	y = y * x + LOG_P1;
+	y = y * x + LOG_P2;
+	y = y * x + LOG_P3;
+	y = y * x + LOG_P4;
+	y = y * x + LOG_P5;
+	y = y * x + LOG_P6;
+	y = y * x + LOG_P7;
+	y = y * x + LOG_P8;
+	y = y * x * z;
+
+	fe = (float)e;
+	y += LOG_Q1 * fe;
+	y += -0.5f * z;
+	return x + y + LOG_Q2 * fe;
+}
+
+static inline float fast_exp2(float x)
+{
+	union float_bits bits;
+	float i, p;
+
+	if (x < EXP2_MIN)
+		return 0.0f;
+	if (x > EXP2_MAX)
+		x = EXP2_MAX;
+
+	i = floorf(x + 0.5f);
+	x = x - i;
+
+	p = EXP2_P0;
+	p = p * x + EXP2_P1;
+	p = p * x + EXP2_P2;
+	p = p * x + EXP2_P3;
+	p = p * x + EXP2_P4;
+	p = p * x + EXP2_P5;
+	p = p * x + 1.0f;
+
+	bits.i = (uint32_t)((int)i + 127) << 23;
+	return p * bits.f;
+}
+
+static inline float compress_gain_c(float env, float threshold_db,
+		float slope, float output_gain)
+{
+	float gain_db = slope * (threshold_db - fast_ln(env) * LN_TO_DB);
+	gain_db = gain_db < 0.0f ? gain_db : 0.0f;
+	return fast_exp2(gain_db * DB_TO_LOG2) * output_gain;
+}
+
+static inline float envelope_step(float env, float in, float attack,
+		float release)
+{
+	const float coef = (env < in) ? attack : release;
+	return in + coef * (env - in);
+}
+
+static inline size_t get_planes(const float **planes,
+		float *const data[MAX_AV_PLANES], size_t channels)
+{
+	size_t count = 0;
+
+	for (size_t i = 0; i < channels && i < MAX_AV_PLANES; i++)
+		if (data[i])
+			planes[count++] = data[i];
+
+	return count;
+}
+
+#ifdef DYN_X86
+
+/* ------------------------------------------------------------------------- */
+/* SSE2 */
+
+static inline __m128 abs_ps(__m128 val)
+{
+	return _mm_andnot_ps(_mm_set1_ps(-0.0f), val);
+}
+
+static inline __m128 fast_ln_ps(__m128 x)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	__m128i bits, e;
+	__m128 mask, z, y, fe;
+
+	x    = _mm_max_ps(x, _mm_set1_ps(FLT_MIN));
+	bits = _mm_castps_si128(x);
+	e    = _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(126));
+	bits = _mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)),
+			_mm_set1_epi32(0x3f000000));
+	x    = _mm_castsi128_ps(bits);
+
+	/* x < sqrt(0.5): e -= 1, x = x + x - 1, otherwise x = x - 1 */
+	mask = _mm_cmplt_ps(x, _mm_set1_ps(SQRT_HALF));
+	e    = _mm_add_epi32(e, _mm_castps_si128(mask));
+	x    = _mm_add_ps(_mm_sub_ps(x, one), _mm_and_ps(mask, x));
+
+	z = _mm_mul_ps(x, x);
+	y = _mm_set1_ps(LOG_P0);
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(LOG_P1));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(LOG_P2));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(LOG_P3));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(LOG_P4));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(LOG_P5));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(LOG_P6));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(LOG_P7));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(LOG_P8));
+	y = _mm_mul_ps(_mm_mul_ps(y, x), z);
+
+	fe = _mm_cvtepi32_ps(e);
+	y  = _mm_add_ps(y, _mm_mul_ps(fe, _mm_set1_ps(LOG_Q1)));
+	y  = _mm_sub_ps(y, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+	return _mm_add_ps(_mm_add_ps(x, y),
+			_mm_mul_ps(fe, _mm_set1_ps(LOG_Q2)));
+}
+
+static inline __m128 fast_exp2_ps(__m128 x)
+{
+	__m128 valid = _mm_cmpge_ps(x, _mm_set1_ps(EXP2_MIN));
+	__m128i i;
+	__m128 p;
+
+	x = _mm_min_ps(x, _mm_set1_ps(EXP2_MAX));
+	x = _mm_max_ps(x, _mm_set1_ps(EXP2_MIN));
+	i = _mm_cvtps_epi32(x);
+	x = _mm_sub_ps(x, _mm_cvtepi32_ps(i));
+
+	p = _mm_set1_ps(EXP2_P0);
+	p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(EXP2_P1));
+	p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(EXP2_P2));
+	p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(EXP2_P3));
+	p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(EXP2_P4));
+	p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(EXP2_P5));
+	p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(1.0f));
+
+	i = _mm_slli_epi32(_mm_add_epi32(i, _mm_set1_epi32(127)), 23);
+	return _mm_and_ps(valid, _mm_mul_ps(p, _mm_castsi128_ps(i)));
+}
+
+static inline __m128 envelope_step_ps(__m128 env, __m128 in,
+		__m128 attack, __m128 release)
+{
+	__m128 rising = _mm_cmplt_ps(env, in);
+	__m128 coef = _mm_or_ps(_mm_and_ps(rising, attack),
+			_mm_andnot_ps(rising, release));
+	return _mm_add_ps(in, _mm_mul_ps(coef, _mm_sub_ps(env, in)));
+}
+
+/*
+ * The envelope is recursive, so up to four channels are followed at once,
+ * one per lane.  Four samples of each channel are loaded and transposed so
+ * each vector holds one point in time, then the envelopes are transposed
+ * back so the maximum of the channels is taken with whole vectors.
+ */
+static void envelope_group(float *env, const float **planes, size_t count,
+		size_t frames, float attack, float release, float state,
+		bool first)
+{
+	const __m128 vattack  = _mm_set1_ps(attack);
+	const __m128 vrelease = _mm_set1_ps(release);
+	const float *ch[4];
+	__m128 e = _mm_set1_ps(state);
+	float lanes[4];
+	size_t i = 0;
+
+	/* unused lanes repeat the first channel, which leaves the maximum
+	 * unchanged */
+	for (size_t c = 0; c < 4; c++)
+		ch[c] = planes[c < count ? c : 0];
+
+	for (; i + 4 <= frames; i += 4) {
+		__m128 r0 = abs_ps(_mm_loadu_ps(ch[0] + i));
+		__m128 r1 = abs_ps(_mm_loadu_ps(ch[1] + i));
+		__m128 r2 = abs_ps(_mm_loadu_ps(ch[2] + i));
+		__m128 r3 = abs_ps(_mm_loadu_ps(ch[3] + i));
+		__m128 m;
+
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+		e  = envelope_step_ps(e, r0, vattack, vrelease);
+		r0 = e;
+		e  = envelope_step_ps(e, r1, vattack, vrelease);
+		r1 = e;
+		e  = envelope_step_ps(e, r2, vattack, vrelease);
+		r2 = e;
+		e  = envelope_step_ps(e, r3, vattack, vrelease);
+		r3 = e;
+
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+		m = _mm_max_ps(_mm_max_ps(r0, r1), _mm_max_ps(r2, r3));
+		if (!first)
+			m = _mm_max_ps(m, _mm_loadu_ps(env + i));
+		_mm_storeu_ps(env + i, m);
+	}
+
+	_mm_storeu_ps(lanes, e);
+
+	for (; i < frames; i++) {
+		float m = first ? 0.0f : env[i];
+
+		for (size_t c = 0; c < count; c++) {
+			lanes[c] = envelope_step(lanes[c], fabsf(ch[c][i]),
+					attack, release);
+			m = fmaxf(m, lanes[c]);
+		}
+
+		env[i] = m;
+	}
+}
+
+void audio_dyn_envelope(float *env, float *const data[MAX_AV_PLANES],
+		size_t channels, size_t frames, float attack, float release,
+		float *state)
+{
+	const float *planes[MAX_AV_PLANES];
+	size_t count = get_planes(planes, data, channels);
+
+	if (!frames)
+		return;
+
+	if (!count)
+		memset(env, 0, frames * sizeof(float));
+
+	for (size_t c = 0; c < count; c += 4)
+		envelope_group(env, planes + c, count - c < 4 ? count - c : 4,
+				frames, attack, release, *state, c == 0);
+
+	*state = env[frames - 1];
+}
+
+void audio_dyn_compress_gain(float *gain, const float *env, size_t frames,
+		float threshold_db, float slope, float output_gain)
+{
+	const __m128 vthreshold = _mm_set1_ps(threshold_db);
+	const __m128 vslope     = _mm_set1_ps(slope);
+	const __m128 voutput    = _mm_set1_ps(output_gain);
+	const __m128 ln_to_db   = _mm_set1_ps(LN_TO_DB);
+	const __m128 db_to_log2 = _mm_set1_ps(DB_TO_LOG2);
+	size_t i = 0;
+
+	for (; i + 4 <= frames; i += 4) {
+		__m128 db = _mm_mul_ps(fast_ln_ps(_mm_loadu_ps(env + i)),
+				ln_to_db);
+		__m128 gain_db = _mm_mul_ps(vslope, _mm_sub_ps(vthreshold, db));
+
+		gain_db = _mm_min_ps(gain_db, _mm_setzero_ps());
+		_mm_storeu_ps(gain + i, _mm_mul_ps(voutput,
+				fast_exp2_ps(_mm_mul_ps(gain_db, db_to_log2))));
+	}
+
+	for (; i < frames; i++)
+		gain[i] = compress_gain_c(env[i], threshold_db, slope,
+				output_gain);
+}
+
+void audio_dyn_peak(float *dst, float *const data[MAX_AV_PLANES],
+		size_t channels, size_t frames)
+{
+	const float *planes[MAX_AV_PLANES];
+	size_t count = get_planes(planes, data, channels);
+	size_t i = 0;
+
+	if (!count) {
+		memset(dst, 0, frames * sizeof(float));
+		return;
+	}
+
+	for (; i + 4 <= frames; i += 4) {
+		__m128 m = abs_ps(_mm_loadu_ps(planes[0] + i));
+
+		for (size_t c = 1; c < count; c++)
+			m = _mm_max_ps(m, abs_ps(_mm_loadu_ps(planes[c] + i)));
+
+		_mm_storeu_ps(dst + i, m);
+	}
+
+	for (; i < frames; i++) {
+		float m = fabsf(planes[0][i]);
+
+		for (size_t c = 1; c < count; c++)
+			m = fmaxf(m, fabsf(planes[c][i]));
+
+		dst[i] = m;
+	}
+}
+
+void audio_dyn_mul_to_db(float *dst, const float *src, size_t count)
+{
+	const __m128 ln_to_db = _mm_set1_ps(LN_TO_DB);
+	const __m128 zero     = _mm_setzero_ps();
+	const __m128 neg_inf  = _mm_set1_ps(-INFINITY);
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 in = _mm_loadu_ps(src + i);
+		__m128 is_zero = _mm_cmpeq_ps(in, zero);
+		__m128 db = _mm_mul_ps(fast_ln_ps(in), ln_to_db);
+
+		db = _mm_or_ps(_mm_and_ps(is_zero, neg_inf),
+				_mm_andnot_ps(is_zero, db));
+		_mm_storeu_ps(dst + i, db);
+	}
+
+	for (; i < count; i++)
+		dst[i] = src[i] == 0.0f ? -INFINITY : fast_ln(src[i]) * LN_TO_DB;
+}
+
+void audio_dyn_db_to_mul(float *dst, const float *src, size_t count)
+{
+	const __m128 db_to_log2 = _mm_set1_ps(DB_TO_LOG2);
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 in = _mm_mul_ps(_mm_loadu_ps(src + i), db_to_log2);
+		_mm_storeu_ps(dst + i, fast_exp2_ps(in));
+	}
+
+	for (; i < count; i++)
+		dst[i] = fast_exp2(src[i] * DB_TO_LOG2);
+}
+
+#else
+
+/* ------------------------------------------------------------------------- */
+/* no SIMD */
+
+void audio_dyn_envelope(float *env, float *const data[MAX_AV_PLANES],
+		size_t channels, size_t frames, float attack, float release,
+		float *state)
+{
+	const float *planes[MAX_AV_PLANES];
+	size_t count = get_planes(planes, data, channels);
+
+	if (!frames)
+		return;
+
+	memset(env, 0, frames * sizeof(float));
+
+	for (size_t c = 0; c < count; c++) {
+		float e = *state;
+
+		for (size_t i = 0; i < frames; i++) {
+			e = envelope_step(e, fabsf(planes[c][i]), attack,
+					release);
+			env[i] = fmaxf(env[i], e);
+		}
+	}
+
+	*state = env[frames - 1];
+}
+
+void audio_dyn_compress_gain(float *gain, const float *env, size_t frames,
+		float threshold_db, float slope, float output_gain)
+{
+	for (size_t i = 0; i < frames; i++)
+		gain[i] = compress_gain_c(env[i], threshold_db, slope,
+				output_gain);
+}
+
+void audio_dyn_peak(float *dst, float *const data[MAX_AV_PLANES],
+		size_t channels, size_t frames)
+{
+	const float *planes[MAX_AV_PLANES];
+	size_t count = get_planes(planes, data, channels);
+
+	for (size_t i = 0; i < frames; i++) {
+		float m = 0.0f;
+
+		for (size_t c = 0; c < count; c++)
+			m = fmaxf(m, fabsf(planes[c][i]));
+
+		dst[i] = m;
+	}
+}
+
+void audio_dyn_mul_to_db(float *dst, const float *src, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		dst[i] = src[i] == 0.0f ? -INFINITY : fast_ln(src[i]) * LN_TO_DB;
+}
+
+void audio_dyn_db_to_mul(float *dst, const float *src, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		dst[i] = fast_exp2(src[i] * DB_TO_LOG2);
+}
+
+#endif
@@ -0,0 +1,68 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "media-io-defs.h"
+#include "../util/c99defs.h"
+
+/*
+ * Dynamics processing kernels
+ *
+ *   Vectorized (SSE2 on x86) building blocks for compressors, limiters and
+ * gates working on float planar audio.  dB conversions use polynomial
+ * log/exp approximations that are accurate to about 1e-6 relative, instead
+ * of calling log10f/powf for every sample.
+ *
+ *   Gains computed here are applied with audio_mix_gain_ramp.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Envelope follower.  Each channel follows its absolute level with the
+ * attack coefficient when rising and the release coefficient when falling,
+ * starting from *state, and env receives the highest envelope of all
+ * channels.  *state is set to the last value of env.  NULL planes are
+ * skipped.
+ */
+EXPORT void audio_dyn_envelope(float *env, float *const data[MAX_AV_PLANES],
+		size_t channels, size_t frames, float attack, float release,
+		float *state);
+
+/**
+ * Compressor gain computer:
+ *   gain[i] = output_gain * db_to_mul(min(0, slope * (threshold_db -
+ *             mul_to_db(env[i]))))
+ */
+EXPORT void audio_dyn_compress_gain(float *gain, const float *env,
+		size_t frames, float threshold_db, float slope,
+		float output_gain);
+
+/** dst[i] = highest absolute value of all channels at i */
+EXPORT void audio_dyn_peak(float *dst, float *const data[MAX_AV_PLANES],
+		size_t channels, size_t frames);
+
+/** Fast mul_to_db / db_to_mul over arrays */
+EXPORT void audio_dyn_mul_to_db(float *dst, const float *src, size_t count);
+EXPORT void audio_dyn_db_to_mul(float *dst, const float *src, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
@@ -33,16 +33,76 @@ extern profiler_name_store_t *obs_get_profiler_name_store(void);
 
 #define nop() do {int invalid = 0;} while(0)
 
+/* number of frames an input thread can fall behind by before the audio
+ * thread waits for it (~680ms at 48khz).  the queue is sized in blocks from
+ * this at open, so it covers the same time whatever the block size is. */
+#define AUDIO_INPUT_QUEUE_FRAMES (32 * AUDIO_OUTPUT_FRAMES)
+
+struct audio_input_thread;
+
 struct audio_input {
 	struct audio_convert_info conversion;
 	audio_resampler_t         *resampler;
 
 	audio_output_callback_t callback;
 	void *param;
+
+	/* if set, the input is called back on its own thread instead of
+	 * inline on the audio thread */
+	struct audio_input_thread *thread;
+};
+
+struct queued_audio {
+	uint8_t                   *data[MAX_AV_PLANES];
+	size_t                    capacity;
+	uint32_t                  frames;
+	uint64_t                  timestamp;
+	uint64_t                  queued_time;
+};
+
+/* single producer/single consumer ring of copied blocks.  the audio thread
+ * is the only writer of write_idx and the input thread the only writer of
+ * read_idx, so the audio thread only waits when the ring is full */
+struct audio_input_thread {
+	audio_output_callback_t   callback;
+	void                      *param;
+	size_t                    mix_idx;
+	size_t                    planes;
+	size_t                    block_size;
+
+	pthread_t                 thread;
+	os_sem_t                  *queued_sem;
+	os_event_t                *space_event;
+	struct queued_audio       *queue;
+	size_t                    queue_size;
+	volatile long             write_idx;
+	volatile long             read_idx;
+
+	/* a block copied while the ring was full, queued by the audio thread
+	 * once the input mutex has been released */
+	struct queued_audio       pending;
+
+	/* held by the input, and by the audio thread while it waits for
+	 * space in the ring */
+	volatile long             refs;
+
+	const char                *thread_name;
+	const char                *latency_name;
+
+	volatile bool             stop;
+	bool                      detached;
 };
 
+static void audio_input_thread_release(struct audio_input_thread *thread);
+static void audio_input_thread_stop(struct audio_input_thread *thread);
+
 static inline void audio_input_free(struct audio_input *input)
 {
+	if (input->thread) {
+		audio_input_thread_stop(input->thread);
+		input->thread = NULL;
+	}
+
 	audio_resampler_destroy(input->resampler);
 }
 
@@ -56,6 +116,7 @@ struct audio_output {
 	size_t                     block_size;
 	size_t                     channels;
 	size_t                     planes;
+	uint32_t                   block_frames;
 
 	pthread_t                  thread;
 	os_event_t                 *stop_event;
@@ -66,6 +127,9 @@ struct audio_output {
 	void                       *input_param;
 	pthread_mutex_t            input_mutex;
 	struct audio_mix           mixes[MAX_AUDIO_MIXES];
+
+	/* only used by the audio thread */
+	DARRAY(struct audio_input_thread*) pending_threads;
 };
 
 /* ------------------------------------------------------------------------- */
@@ -141,6 +205,131 @@ static bool resample_audio_output(struct audio_input *input,
 	return success;
 }
 
+/* ------------------------------------------------------------------------- */
+
+static void *audio_input_thread(void *param)
+{
+	struct audio_input_thread *thread = param;
+
+	os_set_thread_name("audio-io: input thread");
+
+	while (os_sem_wait(thread->queued_sem) == 0) {
+		long idx = os_atomic_load_long(&thread->read_idx);
+		struct queued_audio *queued =
+			&thread->queue[idx % thread->queue_size];
+		struct audio_data data = {0};
+
+		if (os_atomic_load_bool(&thread->stop))
+			break;
+
+		for (size_t i = 0; i < thread->planes; i++)
+			data.data[i] = queued->data[i];
+		data.frames    = queued->frames;
+		data.timestamp = queued->timestamp;
+
+		profile_start(thread->thread_name);
+		thread->callback(thread->param, thread->mix_idx, &data);
+		profile_end(thread->thread_name);
+
+		profile_counter_record(thread->latency_name,
+				(os_gettime_ns() - queued->queued_time) / 1000);
+
+		/* hands the slot back to the audio thread */
+		os_atomic_set_long(&thread->read_idx, idx + 1);
+		os_event_signal(thread->space_event);
+
+		profile_reenable_thread();
+
+		/* the input disconnected itself from within its callback */
+		if (os_atomic_load_bool(&thread->stop))
+			break;
+	}
+
+	if (thread->detached)
+		audio_input_thread_release(thread);
+
+	return NULL;
+}
+
+static inline bool audio_input_thread_full(struct audio_input_thread *thread)
+{
+	return os_atomic_load_long(&thread->write_idx) -
+		os_atomic_load_long(&thread->read_idx) >=
+		(long)thread->queue_size;
+}
+
+static void copy_queued_audio(struct audio_input_thread *thread,
+		struct queued_audio *queued, const struct audio_data *data)
+{
+	size_t size = thread->block_size * data->frames;
+
+	if (queued->capacity < size) {
+		for (size_t i = 0; i < thread->planes; i++) {
+			bfree(queued->data[i]);
+			queued->data[i] = bmalloc(size);
+		}
+		queued->capacity = size;
+	}
+
+	for (size_t i = 0; i < thread->planes; i++)
+		memcpy(queued->data[i], data->data[i], size);
+	queued->frames      = data->frames;
+	queued->timestamp   = data->timestamp;
+	queued->queued_time = os_gettime_ns();
+}
+
+static inline void audio_input_thread_post(struct audio_input_thread *thread)
+{
+	os_atomic_inc_long(&thread->write_idx);
+	os_sem_post(thread->queued_sem);
+}
+
+/* copies the block into the ring, or into the pending block if the ring is
+ * full.  returns false in the latter case. */
+static bool audio_input_thread_try_push(struct audio_input_thread *thread,
+		const struct audio_data *data)
+{
+	long idx = os_atomic_load_long(&thread->write_idx);
+
+	if (audio_input_thread_full(thread)) {
+		copy_queued_audio(thread, &thread->pending, data);
+		return false;
+	}
+
+	copy_queued_audio(thread, &thread->queue[idx % thread->queue_size],
+			data);
+	audio_input_thread_post(thread);
+	return true;
+}
+
+/* waits for the input to catch up and then queues its pending block, so a
+ * slow input holds up the audio thread like an inline input would rather
+ * than losing audio.  this is only done after the input mutex has been
+ * released: the input's callback may need it, and connecting or
+ * disconnecting other inputs must not have to wait. */
+static void audio_input_thread_wait_push(struct audio_input_thread *thread)
+{
+	struct queued_audio *queued;
+	struct queued_audio swap;
+
+	while (!os_atomic_load_bool(&thread->stop) &&
+	       audio_input_thread_full(thread))
+		os_event_wait(thread->space_event);
+
+	/* the input is being disconnected, so nothing will read the block */
+	if (os_atomic_load_bool(&thread->stop))
+		return;
+
+	/* swap buffers rather than copying the block again */
+	queued = &thread->queue[os_atomic_load_long(&thread->write_idx) %
+		thread->queue_size];
+	swap = *queued;
+	*queued = thread->pending;
+	thread->pending = swap;
+
+	audio_input_thread_post(thread);
+}
+
 static inline void do_audio_output(struct audio_output *audio,
 		size_t mix_idx, uint64_t timestamp, uint32_t frames)
 {
@@ -149,6 +338,8 @@ static inline void do_audio_output(struct audio_output *audio,
 
 	pthread_mutex_lock(&audio->input_mutex);
 
+	da_resize(audio->pending_threads, 0);
+
 	for (size_t i = mix->inputs.num; i > 0; i--) {
 		struct audio_input *input = mix->inputs.array+(i-1);
 
@@ -157,11 +348,30 @@ static inline void do_audio_output(struct audio_output *audio,
 		data.frames = frames;
 		data.timestamp = timestamp;
 
-		if (resample_audio_output(input, &data))
+		if (!resample_audio_output(input, &data))
+			continue;
+
+		if (input->thread) {
+			if (!audio_input_thread_try_push(input->thread,
+						&data)) {
+				os_atomic_inc_long(&input->thread->refs);
+				da_push_back(audio->pending_threads,
+						&input->thread);
+			}
+		} else {
 			input->callback(input->param, mix_idx, &data);
+		}
 	}
 
 	pthread_mutex_unlock(&audio->input_mutex);
+
+	for (size_t i = 0; i < audio->pending_threads.num; i++) {
+		struct audio_input_thread *thread =
+			audio->pending_threads.array[i];
+
+		audio_input_thread_wait_push(thread);
+		audio_input_thread_release(thread);
+	}
 }
 
 static inline void clamp_audio_output(struct audio_output *audio, size_t bytes)
@@ -192,7 +402,7 @@ static inline void clamp_audio_output(struct audio_output *audio, size_t bytes)
 static void input_and_output(struct audio_output *audio,
 		uint64_t audio_time, uint64_t prev_time)
 {
-	size_t bytes = AUDIO_OUTPUT_FRAMES * audio->block_size;
+	size_t bytes = audio->block_frames * audio->block_size;
 	struct audio_output_data data[MAX_AUDIO_MIXES];
 	uint32_t active_mixes = 0;
 	uint64_t new_ts = 0;
@@ -217,8 +427,8 @@ static void input_and_output(struct audio_output *audio,
 	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
 		struct audio_mix *mix = &audio->mixes[mix_idx];
 
-		memset(mix->buffer[0], 0, AUDIO_OUTPUT_FRAMES *
-				MAX_AUDIO_CHANNELS * sizeof(float));
+		for (size_t i = 0; i < audio->planes; i++)
+			memset(mix->buffer[i], 0, bytes);
 
 		for (size_t i = 0; i < audio->planes; i++)
 			data[mix_idx].data[i] = mix->buffer[i];
@@ -235,7 +445,7 @@ static void input_and_output(struct audio_output *audio,
 
 	/* output */
 	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++)
-		do_audio_output(audio, i, new_ts, AUDIO_OUTPUT_FRAMES);
+		do_audio_output(audio, i, new_ts, audio->block_frames);
 }
 
 static void *audio_thread(void *param)
@@ -246,9 +456,6 @@ static void *audio_thread(void *param)
 	uint64_t start_time = os_gettime_ns();
 	uint64_t prev_time = start_time;
 	uint64_t audio_time = prev_time;
-	uint32_t audio_wait_time =
-		(uint32_t)(audio_frames_to_ns(rate, AUDIO_OUTPUT_FRAMES) /
-				1000000);
 
 	os_set_thread_name("audio-io: audio thread");
 
@@ -259,13 +466,16 @@ static void *audio_thread(void *param)
 	while (os_event_try(audio->stop_event) == EAGAIN) {
 		uint64_t cur_time;
 
-		os_sleep_ms(audio_wait_time);
+		/* sleep until the exact time the next tick is due rather than
+		 * a rounded number of milliseconds, which would add up to a
+		 * millisecond of jitter on top of scheduler latency */
+		os_sleepto_ns(audio_time);
 
 		profile_start(audio_thread_name);
 
 		cur_time = os_gettime_ns();
 		while (audio_time <= cur_time) {
-			samples += AUDIO_OUTPUT_FRAMES;
+			samples += audio->block_frames;
 			audio_time = start_time +
 				audio_frames_to_ns(rate, samples);
 
@@ -329,8 +539,101 @@ static inline bool audio_input_init(struct audio_input *input,
 	return true;
 }
 
-bool audio_output_connect(audio_t *audio, size_t mi,
-		const struct audio_convert_info *conversion,
+static void audio_input_thread_destroy(struct audio_input_thread *thread)
+{
+	for (size_t i = 0; i < thread->queue_size; i++) {
+		for (size_t j = 0; j < MAX_AV_PLANES; j++)
+			bfree(thread->queue[i].data[j]);
+	}
+
+	for (size_t j = 0; j < MAX_AV_PLANES; j++)
+		bfree(thread->pending.data[j]);
+
+	os_event_destroy(thread->space_event);
+	os_sem_destroy(thread->queued_sem);
+	bfree(thread->queue);
+	bfree(thread);
+}
+
+static void audio_input_thread_release(struct audio_input_thread *thread)
+{
+	if (os_atomic_dec_long(&thread->refs) == 0)
+		audio_input_thread_destroy(thread);
+}
+
+static void audio_input_thread_stop(struct audio_input_thread *thread)
+{
+	os_atomic_set_bool(&thread->stop, true);
+
+	/* the audio thread may be waiting to queue a block */
+	os_event_signal(thread->space_event);
+
+	/* an input can disconnect itself from within its own callback, in
+	 * which case the thread cleans up after itself when it returns */
+	if (pthread_equal(pthread_self(), thread->thread)) {
+		thread->detached = true;
+		pthread_detach(thread->thread);
+		return;
+	}
+
+	os_sem_post(thread->queued_sem);
+	pthread_join(thread->thread, NULL);
+	audio_input_thread_release(thread);
+}
+
+static bool audio_input_thread_create(struct audio_input *input,
+		struct audio_output *audio, size_t mix_idx)
+{
+	struct audio_input_thread *thread;
+	enum audio_format format = input->conversion.format;
+	enum speaker_layout speakers = input->conversion.speakers;
+
+	thread = bzalloc(sizeof(struct audio_input_thread));
+	thread->callback   = input->callback;
+	thread->param      = input->param;
+	thread->mix_idx    = mix_idx;
+	thread->planes     = get_audio_planes(format, speakers);
+	thread->block_size = get_audio_size(format, speakers, 1);
+	thread->refs       = 1;
+	thread->queue_size = (AUDIO_INPUT_QUEUE_FRAMES +
+			audio->block_frames - 1) / audio->block_frames;
+	thread->queue      = bzalloc(sizeof(struct queued_audio) *
+			thread->queue_size);
+
+	thread->thread_name = profile_store_name(
+			obs_get_profiler_name_store(),
+			"audio_input_thread(%s, mix %d)",
+			audio->info.name, (int)mix_idx);
+	thread->latency_name = profile_store_name(
+			obs_get_profiler_name_store(),
+			"audio input latency (us) (%s, mix %d)",
+			audio->info.name, (int)mix_idx);
+
+	if (os_sem_init(&thread->queued_sem, 0) != 0)
+		goto fail0;
+	if (os_event_init(&thread->space_event, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail1;
+	if (pthread_create(&thread->thread, NULL, audio_input_thread,
+				thread) != 0)
+		goto fail2;
+
+	input->thread = thread;
+	return true;
+
+fail2:
+	os_event_destroy(thread->space_event);
+fail1:
+	os_sem_destroy(thread->queued_sem);
+fail0:
+	bfree(thread->queue);
+	bfree(thread);
+	blog(LOG_ERROR, "audio_input_thread_create: Failed to create "
+	                "input thread");
+	return false;
+}
+
+static bool audio_output_connect_internal(audio_t *audio, size_t mi,
+		const struct audio_convert_info *conversion, bool threaded,
 		audio_output_callback_t callback, void *param)
 {
 	bool success = false;
@@ -341,7 +644,7 @@ bool audio_output_connect(audio_t *audio, size_t mi,
 
 	if (audio_get_input_idx(audio, mi, callback, param) == DARRAY_INVALID) {
 		struct audio_mix *mix = &audio->mixes[mi];
-		struct audio_input input;
+		struct audio_input input = {0};
 		input.callback = callback;
 		input.param    = param;
 
@@ -363,6 +666,11 @@ bool audio_output_connect(audio_t *audio, size_t mi,
 				audio->info.samples_per_sec;
 
 		success = audio_input_init(&input, audio);
+		if (success && threaded) {
+			success = audio_input_thread_create(&input, audio, mi);
+			if (!success)
+				audio_resampler_destroy(input.resampler);
+		}
 		if (success)
 			da_push_back(mix->inputs, &input);
 	}
@@ -372,6 +680,22 @@ bool audio_output_connect(audio_t *audio, size_t mi,
 	return success;
 }
 
+bool audio_output_connect(audio_t *audio, size_t mi,
+		const struct audio_convert_info *conversion,
+		audio_output_callback_t callback, void *param)
+{
+	return audio_output_connect_internal(audio, mi, conversion, false,
+			callback, param);
+}
+
+bool audio_output_connect_threaded(audio_t *audio, size_t mi,
+		const struct audio_convert_info *conversion,
+		audio_output_callback_t callback, void *param)
+{
+	return audio_output_connect_internal(audio, mi, conversion, true,
+			callback, param);
+}
+
 void audio_output_disconnect(audio_t *audio, size_t mix_idx,
 		audio_output_callback_t callback, void *param)
 {
@@ -392,7 +716,7 @@ void audio_output_disconnect(audio_t *audio, size_t mix_idx,
 static inline bool valid_audio_params(const struct audio_output_info *info)
 {
 	return info->format && info->name && info->samples_per_sec > 0 &&
-	       info->speakers > 0;
+	       info->speakers > 0 && info->block_frames <= AUDIO_OUTPUT_FRAMES;
 }
 
 int audio_output_open(audio_t **audio, struct audio_output_info *info)
@@ -415,6 +739,8 @@ int audio_output_open(audio_t **audio, struct audio_output_info *info)
 	out->input_param= info->input_param;
 	out->block_size = (planar ? 1 : out->channels) *
 	                  get_audio_bytes_per_channel(info->format);
+	out->block_frames = info->block_frames ?
+		info->block_frames : AUDIO_OUTPUT_FRAMES;
 
 	if (pthread_mutexattr_init(&attr) != 0)
 		goto fail;
@@ -457,6 +783,7 @@ void audio_output_close(audio_t *audio)
 		da_free(mix->inputs);
 	}
 
+	da_free(audio->pending_threads);
 	os_event_destroy(audio->stop_event);
 	bfree(audio);
 }
@@ -499,3 +826,8 @@ uint32_t audio_output_get_sample_rate(const audio_t *audio)
 {
 	return audio ? audio->info.samples_per_sec : 0;
 }
+
+uint32_t audio_output_get_block_frames(const audio_t *audio)
+{
+	return audio ? audio->block_frames : 0;
+}
@@ -27,6 +27,8 @@ extern "C" {
 
 #define MAX_AUDIO_MIXES     6
 #define MAX_AUDIO_CHANNELS  2
+/* maximum (and default) number of frames per audio tick, audio buffers are
+ * always allocated for this many frames */
 #define AUDIO_OUTPUT_FRAMES 1024
 
 /*
@@ -88,6 +90,9 @@ struct audio_output_info {
 
 	audio_input_callback_t input_callback;
 	void                   *input_param;
+
+	/* frames per tick (up to AUDIO_OUTPUT_FRAMES, 0 for the default) */
+	uint32_t            block_frames;
 };
 
 struct audio_convert_info {
@@ -211,12 +216,23 @@ EXPORT bool audio_output_connect(audio_t *video, size_t mix_idx,
 EXPORT void audio_output_disconnect(audio_t *video, size_t mix_idx,
 		audio_output_callback_t callback, void *param);
 
+/**
+ * Connects an input that is called back on its own thread rather than inline
+ * on the audio thread.  Mixed blocks are copied into a queue for the thread;
+ * if the input falls too far behind, the audio thread waits for it to catch
+ * up, the same as it would for an inline input.
+ */
+EXPORT bool audio_output_connect_threaded(audio_t *audio, size_t mix_idx,
+		const struct audio_convert_info *conversion,
+		audio_output_callback_t callback, void *param);
+
 EXPORT bool audio_output_active(const audio_t *audio);
 
 EXPORT size_t audio_output_get_block_size(const audio_t *audio);
 EXPORT size_t audio_output_get_planes(const audio_t *audio);
 EXPORT size_t audio_output_get_channels(const audio_t *audio);
 EXPORT uint32_t audio_output_get_sample_rate(const audio_t *audio);
+EXPORT uint32_t audio_output_get_block_frames(const audio_t *audio);
 EXPORT const struct audio_output_info *audio_output_get_info(
 		const audio_t *audio);
 
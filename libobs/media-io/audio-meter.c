@@ -0,0 +1,682 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <math.h>
+#include <string.h>
+
+#include "../util/bmem.h"
+#include "audio-meter.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || \
+    defined(__x86_64__)
+#define METER_X86
+#include <emmintrin.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.1415926535897932384626433832795
+#endif
+
+/* loudness is measured in 100 ms sub-blocks: momentary loudness and the
+ * gating blocks of integrated loudness are 4 sub-blocks (400 ms, 75%
+ * overlap), and short-term loudness is 30 sub-blocks (3 s) */
+#define SUBBLOCKS_MOMENTARY  4
+#define SUBBLOCKS_SHORT_TERM 30
+
+/* gating blocks are kept in a histogram of 0.1 LU bins from the absolute
+ * gate (-70 LUFS) up to +30 LUFS, so integrated loudness uses constant
+ * memory no matter how long it has been measured */
+#define ABSOLUTE_GATE        -70.0
+#define RELATIVE_GATE        -10.0
+#define HIST_BINS_PER_LU     10
+#define HIST_BINS            (100 * HIST_BINS_PER_LU)
+
+/* 4x oversampling polyphase filter for true peak (48 taps) */
+#define TP_PHASES            4
+#define TP_TAPS              12
+#define TP_HISTORY           (TP_TAPS - 1)
+
+struct biquad {
+	double b0, b1, b2;
+	double a1, a2;
+};
+
+struct meter_channel {
+	float  weight;
+	double shelf_z[2];
+	double highpass_z[2];
+	float  tp_history[TP_HISTORY];
+};
+
+struct audio_meter {
+	size_t               channels;
+	struct meter_channel ch[MAX_AV_PLANES];
+
+	struct biquad        shelf;
+	struct biquad        highpass;
+
+	bool                 oversample;
+	float                tp_coefs[TP_TAPS][TP_PHASES];
+	float                *scratch;
+	size_t               scratch_size;
+
+	size_t               subblock_frames;
+	size_t               subblock_pos;
+	double               subblock_energy;
+	double               subblocks[SUBBLOCKS_SHORT_TERM];
+	size_t               subblock_idx;
+	size_t               subblock_count;
+
+	uint64_t             hist_count[HIST_BINS];
+	double               hist_energy[HIST_BINS];
+
+	float                momentary;
+	float                short_term;
+	float                integrated;
+};
+
+/* ------------------------------------------------------------------------- */
+/* kernels */
+
+static inline void peak_sum_c(const float *data, size_t frames,
+		float *peak, float *sum)
+{
+	float p = *peak;
+	float s = *sum;
+
+	for (size_t i = 0; i < frames; i++) {
+		const float val = fabsf(data[i]);
+		s += data[i] * data[i];
+		p  = (p > val) ? p : val;
+	}
+
+	*peak = p;
+	*sum  = s;
+}
+
+static inline float true_peak_c(const float *x, size_t start, size_t end,
+		const float coefs[TP_TAPS][TP_PHASES])
+{
+	float peak = 0.0f;
+
+	for (size_t n = start; n < end; n++) {
+		for (size_t p = 0; p < TP_PHASES; p++) {
+			float val = 0.0f;
+
+			for (size_t k = 0; k < TP_TAPS; k++)
+				val += coefs[k][p] * x[n - k];
+
+			val  = fabsf(val);
+			peak = (peak > val) ? peak : val;
+		}
+	}
+
+	return peak;
+}
+
+#ifdef METER_X86
+
+static inline float hmax_sse(__m128 val)
+{
+	val = _mm_max_ps(val, _mm_movehl_ps(val, val));
+	val = _mm_max_ss(val, _mm_shuffle_ps(val, val, 1));
+	return _mm_cvtss_f32(val);
+}
+
+static inline float hsum_sse(__m128 val)
+{
+	val = _mm_add_ps(val, _mm_movehl_ps(val, val));
+	val = _mm_add_ss(val, _mm_shuffle_ps(val, val, 1));
+	return _mm_cvtss_f32(val);
+}
+
+static void peak_sum(const float *data, size_t frames, float *peak,
+		float *sum)
+{
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	__m128 max0 = _mm_setzero_ps();
+	__m128 max1 = _mm_setzero_ps();
+	__m128 sum0 = _mm_setzero_ps();
+	__m128 sum1 = _mm_setzero_ps();
+	size_t i = 0;
+
+	for (; i + 8 <= frames; i += 8) {
+		__m128 a0 = _mm_loadu_ps(data + i);
+		__m128 a1 = _mm_loadu_ps(data + i + 4);
+		max0 = _mm_max_ps(max0, _mm_andnot_ps(sign, a0));
+		max1 = _mm_max_ps(max1, _mm_andnot_ps(sign, a1));
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(a0, a0));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(a1, a1));
+	}
+
+	*peak = hmax_sse(_mm_max_ps(max0, max1));
+	*sum  = hsum_sse(_mm_add_ps(sum0, sum1));
+
+	peak_sum_c(data + i, frames - i, peak, sum);
+}
+
+/* each phase is computed for four output samples at once, so the
+ * accumulators of the four phases are independent */
+static float true_peak(const float *x, size_t frames,
+		const float coefs[TP_TAPS][TP_PHASES])
+{
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	const size_t end = TP_HISTORY + frames;
+	__m128 c[TP_TAPS][TP_PHASES];
+	__m128 vmax = _mm_setzero_ps();
+	size_t n = TP_HISTORY;
+	float peak;
+
+	for (size_t k = 0; k < TP_TAPS; k++)
+		for (size_t p = 0; p < TP_PHASES; p++)
+			c[k][p] = _mm_set1_ps(coefs[k][p]);
+
+	for (; n + 4 <= end; n += 4) {
+		__m128 acc0 = _mm_setzero_ps();
+		__m128 acc1 = _mm_setzero_ps();
+		__m128 acc2 = _mm_setzero_ps();
+		__m128 acc3 = _mm_setzero_ps();
+
+		for (size_t k = 0; k < TP_TAPS; k++) {
+			__m128 in = _mm_loadu_ps(x + n - k);
+			acc0 = _mm_add_ps(acc0, _mm_mul_ps(in, c[k][0]));
+			acc1 = _mm_add_ps(acc1, _mm_mul_ps(in, c[k][1]));
+			acc2 = _mm_add_ps(acc2, _mm_mul_ps(in, c[k][2]));
+			acc3 = _mm_add_ps(acc3, _mm_mul_ps(in, c[k][3]));
+		}
+
+		vmax = _mm_max_ps(vmax, _mm_andnot_ps(sign, acc0));
+		vmax = _mm_max_ps(vmax, _mm_andnot_ps(sign, acc1));
+		vmax = _mm_max_ps(vmax, _mm_andnot_ps(sign, acc2));
+		vmax = _mm_max_ps(vmax, _mm_andnot_ps(sign, acc3));
+	}
+
+	peak = hmax_sse(vmax);
+
+	if (n < end) {
+		float tail = true_peak_c(x, n, end, coefs);
+		peak = (peak > tail) ? peak : tail;
+	}
+
+	return peak;
+}
+
+#else
+
+static void peak_sum(const float *data, size_t frames, float *peak,
+		float *sum)
+{
+	*peak = 0.0f;
+	*sum  = 0.0f;
+	peak_sum_c(data, frames, peak, sum);
+}
+
+static float true_peak(const float *x, size_t frames,
+		const float coefs[TP_TAPS][TP_PHASES])
+{
+	return true_peak_c(x, TP_HISTORY, TP_HISTORY + frames, coefs);
+}
+
+#endif
+
+void audio_meter_peak_sum(const float *data, size_t frames, float *peak,
+		float *sum)
+{
+	peak_sum(data, frames, peak, sum);
+}
+
+/* ------------------------------------------------------------------------- */
+/* filter setup */
+
+/* K-weighting filter coefficients for any sample rate (ITU-R BS.1770) */
+static void init_k_weighting(struct audio_meter *meter, uint32_t sample_rate)
+{
+	double f0 = 1681.974450955533;
+	double g  = 3.999843853973347;
+	double q  = 0.7071752369554196;
+	double k  = tan(M_PI * f0 / (double)sample_rate);
+	double vh = pow(10.0, g / 20.0);
+	double vb = pow(vh, 0.4996667741545416);
+	double a0 = 1.0 + k / q + k * k;
+
+	meter->shelf.b0 = (vh + vb * k / q + k * k) / a0;
+	meter->shelf.b1 = 2.0 * (k * k - vh) / a0;
+	meter->shelf.b2 = (vh - vb * k / q + k * k) / a0;
+	meter->shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+	meter->shelf.a2 = (1.0 - k / q + k * k) / a0;
+
+	f0 = 38.13547087602444;
+	q  = 0.5003270373238773;
+	k  = tan(M_PI * f0 / (double)sample_rate);
+	a0 = 1.0 + k / q + k * k;
+
+	meter->highpass.b0 = 1.0;
+	meter->highpass.b1 = -2.0;
+	meter->highpass.b2 = 1.0;
+	meter->highpass.a1 = 2.0 * (k * k - 1.0) / a0;
+	meter->highpass.a2 = (1.0 - k / q + k * k) / a0;
+}
+
+/* windowed sinc interpolator, with each phase normalized to unity gain */
+static void init_true_peak(struct audio_meter *meter)
+{
+	const size_t taps = TP_TAPS * TP_PHASES;
+	const double center = (double)(taps - 1) / 2.0;
+
+	for (size_t p = 0; p < TP_PHASES; p++) {
+		double phase_sum = 0.0;
+		double h[TP_TAPS];
+
+		for (size_t k = 0; k < TP_TAPS; k++) {
+			size_t j = p + k * TP_PHASES;
+			double x = ((double)j - center) / (double)TP_PHASES;
+			double w = 2.0 * M_PI * (double)j / (double)(taps - 1);
+			double sinc = (x == 0.0) ? 1.0 : sin(M_PI * x) / (M_PI * x);
+			double window = 0.42 - 0.5 * cos(w) + 0.08 * cos(2.0 * w);
+
+			h[k] = sinc * window;
+			phase_sum += h[k];
+		}
+
+		for (size_t k = 0; k < TP_TAPS; k++)
+			meter->tp_coefs[k][p] = (float)(h[k] / phase_sum);
+	}
+}
+
+/* channel weights: LFE is not measured and surround channels are +1.5 dB */
+static void init_weights(struct audio_meter *meter,
+		enum speaker_layout speakers)
+{
+	size_t lfe = MAX_AV_PLANES;
+	size_t surround = MAX_AV_PLANES;
+
+	switch (speakers) {
+	case SPEAKERS_2POINT1:          lfe = 2; break;
+	case SPEAKERS_QUAD:             surround = 2; break;
+	case SPEAKERS_SURROUND:         surround = 3; break;
+	case SPEAKERS_4POINT1:
+	case SPEAKERS_5POINT1:
+	case SPEAKERS_5POINT1_SURROUND:
+	case SPEAKERS_7POINT1:
+	case SPEAKERS_7POINT1_SURROUND: lfe = 3; surround = 4; break;
+	default:;
+	}
+
+	for (size_t i = 0; i < meter->channels; i++) {
+		if (i == lfe)
+			meter->ch[i].weight = 0.0f;
+		else if (i >= surround)
+			meter->ch[i].weight = 1.41f;
+		else
+			meter->ch[i].weight = 1.0f;
+	}
+}
+
+audio_meter_t *audio_meter_create(uint32_t sample_rate,
+		enum speaker_layout speakers)
+{
+	struct audio_meter *meter;
+
+	if (!sample_rate || speakers == SPEAKERS_UNKNOWN)
+		return NULL;
+
+	meter = bzalloc(sizeof(struct audio_meter));
+	meter->channels        = get_audio_channels(speakers);
+	meter->subblock_frames = sample_rate / 10;
+
+	/* at 96khz and above, samples are close enough together that the
+	 * sample peak is used as the true peak */
+	meter->oversample      = sample_rate < 96000;
+
+	init_k_weighting(meter, sample_rate);
+	init_true_peak(meter);
+	init_weights(meter, speakers);
+	audio_meter_reset(meter);
+	return meter;
+}
+
+void audio_meter_destroy(audio_meter_t *meter)
+{
+	if (meter) {
+		bfree(meter->scratch);
+		bfree(meter);
+	}
+}
+
+void audio_meter_reset(audio_meter_t *meter)
+{
+	if (!meter)
+		return;
+
+	for (size_t i = 0; i < meter->channels; i++) {
+		struct meter_channel *ch = &meter->ch[i];
+		memset(ch->shelf_z, 0, sizeof(ch->shelf_z));
+		memset(ch->highpass_z, 0, sizeof(ch->highpass_z));
+		memset(ch->tp_history, 0, sizeof(ch->tp_history));
+	}
+
+	meter->subblock_pos    = 0;
+	meter->subblock_energy = 0.0;
+	meter->subblock_idx    = 0;
+	meter->subblock_count  = 0;
+
+	memset(meter->hist_count, 0, sizeof(meter->hist_count));
+	memset(meter->hist_energy, 0, sizeof(meter->hist_energy));
+
+	meter->momentary  = -INFINITY;
+	meter->short_term = -INFINITY;
+	meter->integrated = -INFINITY;
+}
+
+/* ------------------------------------------------------------------------- */
+/* loudness */
+
+static inline double energy_to_lufs(double energy)
+{
+	return energy > 0.0 ? -0.691 + 10.0 * log10(energy) : -INFINITY;
+}
+
+static inline size_t lufs_to_bin(double lufs)
+{
+	size_t bin = (size_t)((lufs - ABSOLUTE_GATE) * HIST_BINS_PER_LU);
+	return bin < HIST_BINS ? bin : HIST_BINS - 1;
+}
+
+static inline void flush_denormal(double *val)
+{
+	if (fabs(*val) < 1.0e-30)
+		*val = 0.0;
+}
+
+/* returns the sum of squares of the K-weighted audio */
+static double k_weight(struct audio_meter *meter, struct meter_channel *ch,
+		const float *data, size_t frames)
+{
+	const struct biquad *s = &meter->shelf;
+	const struct biquad *h = &meter->highpass;
+	double s0 = ch->shelf_z[0],    s1 = ch->shelf_z[1];
+	double h0 = ch->highpass_z[0], h1 = ch->highpass_z[1];
+	double sum = 0.0;
+
+	for (size_t i = 0; i < frames; i++) {
+		double x = (double)data[i];
+		double y = s->b0 * x + s0;
+		double z;
+
+		s0 = s->b1 * x - s->a1 * y + s1;
+		s1 = s->b2 * x - s->a2 * y;
+
+		z  = h->b0 * y + h0;
+		h0 = h->b1 * y - h->a1 * z + h1;
+		h1 = h->b2 * y - h->a2 * z;
+
+		sum += z * z;
+	}
+
+	flush_denormal(&s0);
+	flush_denormal(&s1);
+	flush_denormal(&h0);
+	flush_denormal(&h1);
+
+	ch->shelf_z[0]    = s0;
+	ch->shelf_z[1]    = s1;
+	ch->highpass_z[0] = h0;
+	ch->highpass_z[1] = h1;
+	return sum;
+}
+
+#ifdef METER_X86
+
+static inline void store_pair(__m128d val, double *val0, double *val1)
+{
+	double vals[2];
+	_mm_storeu_pd(vals, val);
+
+	flush_denormal(&vals[0]);
+	flush_denormal(&vals[1]);
+	*val0 = vals[0];
+	*val1 = vals[1];
+}
+
+/* the filters are recursive, so instead of vectorizing over samples two
+ * channels are filtered at once, one per lane */
+static void k_weight_pair(struct audio_meter *meter,
+		struct meter_channel *ch0, struct meter_channel *ch1,
+		const float *data0, const float *data1, size_t frames,
+		double sums[2])
+{
+	const struct biquad *s = &meter->shelf;
+	const struct biquad *h = &meter->highpass;
+	const __m128d sb0 = _mm_set1_pd(s->b0), sb1 = _mm_set1_pd(s->b1);
+	const __m128d sb2 = _mm_set1_pd(s->b2), sa1 = _mm_set1_pd(s->a1);
+	const __m128d sa2 = _mm_set1_pd(s->a2);
+	const __m128d hb0 = _mm_set1_pd(h->b0), hb1 = _mm_set1_pd(h->b1);
+	const __m128d hb2 = _mm_set1_pd(h->b2), ha1 = _mm_set1_pd(h->a1);
+	const __m128d ha2 = _mm_set1_pd(h->a2);
+	__m128d s0 = _mm_set_pd(ch1->shelf_z[0], ch0->shelf_z[0]);
+	__m128d s1 = _mm_set_pd(ch1->shelf_z[1], ch0->shelf_z[1]);
+	__m128d h0 = _mm_set_pd(ch1->highpass_z[0], ch0->highpass_z[0]);
+	__m128d h1 = _mm_set_pd(ch1->highpass_z[1], ch0->highpass_z[1]);
+	__m128d sum = _mm_setzero_pd();
+
+	for (size_t i = 0; i < frames; i++) {
+		__m128d x = _mm_set_pd((double)data1[i], (double)data0[i]);
+		__m128d y = _mm_add_pd(_mm_mul_pd(sb0, x), s0);
+		__m128d z;
+
+		s0 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(sb1, x),
+					_mm_mul_pd(sa1, y)), s1);
+		s1 = _mm_sub_pd(_mm_mul_pd(sb2, x), _mm_mul_pd(sa2, y));
+
+		z  = _mm_add_pd(_mm_mul_pd(hb0, y), h0);
+		h0 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(hb1, y),
+					_mm_mul_pd(ha1, z)), h1);
+		h1 = _mm_sub_pd(_mm_mul_pd(hb2, y), _mm_mul_pd(ha2, z));
+
+		sum = _mm_add_pd(sum, _mm_mul_pd(z, z));
+	}
+
+	store_pair(s0, &ch0->shelf_z[0],    &ch1->shelf_z[0]);
+	store_pair(s1, &ch0->shelf_z[1],    &ch1->shelf_z[1]);
+	store_pair(h0, &ch0->highpass_z[0], &ch1->highpass_z[0]);
+	store_pair(h1, &ch0->highpass_z[1], &ch1->highpass_z[1]);
+	_mm_storeu_pd(sums, sum);
+}
+
+#endif
+
+static double subblocks_mean(const struct audio_meter *meter, size_t count)
+{
+	double sum = 0.0;
+
+	for (size_t i = 0; i < count; i++) {
+		size_t idx = (meter->subblock_idx + SUBBLOCKS_SHORT_TERM - 1 - i) %
+			SUBBLOCKS_SHORT_TERM;
+		sum += meter->subblocks[idx];
+	}
+
+	return sum / (double)count;
+}
+
+static double calc_integrated(const struct audio_meter *meter)
+{
+	uint64_t count = 0;
+	double energy = 0.0;
+	double threshold;
+	size_t start;
+
+	for (size_t i = 0; i < HIST_BINS; i++) {
+		count  += meter->hist_count[i];
+		energy += meter->hist_energy[i];
+	}
+
+	if (!count)
+		return -INFINITY;
+
+	threshold = energy_to_lufs(energy / (double)count) + RELATIVE_GATE;
+	start = threshold > ABSOLUTE_GATE ? lufs_to_bin(threshold) : 0;
+
+	count  = 0;
+	energy = 0.0;
+
+	for (size_t i = start; i < HIST_BINS; i++) {
+		count  += meter->hist_count[i];
+		energy += meter->hist_energy[i];
+	}
+
+	return count ? energy_to_lufs(energy / (double)count) : -INFINITY;
+}
+
+static void end_subblock(struct audio_meter *meter)
+{
+	meter->subblocks[meter->subblock_idx] = meter->subblock_energy /
+		(double)meter->subblock_frames;
+	meter->subblock_idx = (meter->subblock_idx + 1) % SUBBLOCKS_SHORT_TERM;
+	if (meter->subblock_count < SUBBLOCKS_SHORT_TERM)
+		meter->subblock_count++;
+
+	meter->subblock_pos    = 0;
+	meter->subblock_energy = 0.0;
+
+	if (meter->subblock_count >= SUBBLOCKS_MOMENTARY) {
+		double energy = subblocks_mean(meter, SUBBLOCKS_MOMENTARY);
+		double lufs = energy_to_lufs(energy);
+
+		meter->momentary = (float)lufs;
+
+		if (lufs > ABSOLUTE_GATE) {
+			size_t bin = lufs_to_bin(lufs);
+			meter->hist_count[bin]++;
+			meter->hist_energy[bin] += energy;
+			meter->integrated = (float)calc_integrated(meter);
+		}
+	}
+
+	if (meter->subblock_count == SUBBLOCKS_SHORT_TERM)
+		meter->short_term = (float)energy_to_lufs(
+				subblocks_mean(meter, SUBBLOCKS_SHORT_TERM));
+}
+
+static void measure_loudness(struct audio_meter *meter,
+		float *const data[MAX_AV_PLANES], size_t frames, float gain)
+{
+	const double gain_sq = (double)gain * (double)gain;
+	size_t active[MAX_AV_PLANES];
+	size_t num_active = 0;
+	size_t offset = 0;
+
+	for (size_t i = 0; i < meter->channels; i++)
+		if (data[i] && meter->ch[i].weight != 0.0f)
+			active[num_active++] = i;
+
+	while (offset < frames) {
+		size_t count = meter->subblock_frames - meter->subblock_pos;
+		double energy = 0.0;
+		size_t i = 0;
+
+		if (count > frames - offset)
+			count = frames - offset;
+
+#ifdef METER_X86
+		for (; i + 2 <= num_active; i += 2) {
+			struct meter_channel *ch0 = &meter->ch[active[i]];
+			struct meter_channel *ch1 = &meter->ch[active[i + 1]];
+			double sums[2];
+
+			k_weight_pair(meter, ch0, ch1,
+					data[active[i]] + offset,
+					data[active[i + 1]] + offset,
+					count, sums);
+
+			energy += (double)ch0->weight * sums[0] +
+			          (double)ch1->weight * sums[1];
+		}
+#endif
+
+		for (; i < num_active; i++) {
+			struct meter_channel *ch = &meter->ch[active[i]];
+
+			energy += (double)ch->weight * k_weight(meter, ch,
+					data[active[i]] + offset, count);
+		}
+
+		meter->subblock_energy += energy * gain_sq;
+		meter->subblock_pos    += count;
+		offset                 += count;
+
+		if (meter->subblock_pos == meter->subblock_frames)
+			end_subblock(meter);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+static float measure_true_peak(struct audio_meter *meter,
+		struct meter_channel *ch, const float *data, size_t frames)
+{
+	size_t size = TP_HISTORY + frames;
+	float peak;
+
+	if (meter->scratch_size < size) {
+		meter->scratch = brealloc(meter->scratch, size * sizeof(float));
+		meter->scratch_size = size;
+	}
+
+	memcpy(meter->scratch, ch->tp_history, sizeof(ch->tp_history));
+	memcpy(meter->scratch + TP_HISTORY, data, frames * sizeof(float));
+
+	peak = true_peak(meter->scratch, frames, meter->tp_coefs);
+
+	memcpy(ch->tp_history, meter->scratch + frames,
+			sizeof(ch->tp_history));
+	return peak;
+}
+
+void audio_meter_process(audio_meter_t *meter,
+		float *const data[MAX_AV_PLANES], size_t frames, float gain,
+		struct audio_meter_levels *levels)
+{
+	memset(levels, 0, sizeof(*levels));
+
+	if (!meter)
+		return;
+
+	levels->frames   = frames;
+	levels->channels = meter->channels;
+
+	for (size_t i = 0; i < meter->channels; i++) {
+		if (!data[i] || !frames)
+			continue;
+
+		peak_sum(data[i], frames, &levels->peak[i],
+				&levels->sum_squares[i]);
+
+		levels->true_peak[i] = meter->oversample ?
+			measure_true_peak(meter, &meter->ch[i], data[i], frames) :
+			levels->peak[i];
+
+		/* the interpolated peak can fall between samples */
+		if (levels->true_peak[i] < levels->peak[i])
+			levels->true_peak[i] = levels->peak[i];
+	}
+
+	measure_loudness(meter, data, frames, gain);
+
+	levels->momentary  = meter->momentary;
+	levels->short_term = meter->short_term;
+	levels->integrated = meter->integrated;
+}
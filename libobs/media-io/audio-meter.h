@@ -0,0 +1,82 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "media-io-defs.h"
+#include "audio-io.h"
+
+/*
+ * Audio metering engine
+ *
+ *   Measures float planar audio for level meters and loudness compliance:
+ * per-channel sample peak and sum of squares, 4x oversampled true peak, and
+ * ITU-R BS.1770 / EBU R128 momentary (400 ms), short-term (3 s) and gated
+ * integrated loudness.
+ *
+ *   Peak, sum of squares and the true peak interpolation filter are
+ * vectorized (SSE on x86).  The K-weighting filter is recursive, so it is
+ * run per channel in double precision.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct audio_meter;
+typedef struct audio_meter audio_meter_t;
+
+struct audio_meter_levels {
+	size_t frames;
+	size_t channels;
+
+	/* linear magnitudes and sums of this block of audio */
+	float  peak[MAX_AV_PLANES];
+	float  true_peak[MAX_AV_PLANES];
+	float  sum_squares[MAX_AV_PLANES];
+
+	/* LUFS, or -INFINITY until enough audio has been measured */
+	float  momentary;
+	float  short_term;
+	float  integrated;
+};
+
+EXPORT audio_meter_t *audio_meter_create(uint32_t sample_rate,
+		enum speaker_layout speakers);
+EXPORT void audio_meter_destroy(audio_meter_t *meter);
+
+/** Restarts the loudness measurement (integrated loudness included) */
+EXPORT void audio_meter_reset(audio_meter_t *meter);
+
+/**
+ * Measures a block of audio.  Missing planes are treated as silence.
+ *
+ * @param  gain    Gain applied to the audio for the loudness measurement only,
+ *                 peaks and sums are always of the input data.
+ * @param  levels  Receives the levels of this block and the current loudness.
+ */
+EXPORT void audio_meter_process(audio_meter_t *meter,
+		float *const data[MAX_AV_PLANES], size_t frames, float gain,
+		struct audio_meter_levels *levels);
+
+/** Sample peak (linear) and sum of squares of a single plane */
+EXPORT void audio_meter_peak_sum(const float *data, size_t frames,
+		float *peak, float *sum);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,282 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "../util/platform.h"
+#include "audio-mix.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || \
+    defined(__x86_64__)
+#define MIX_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX __attribute__((target("avx")))
+#else
+#define TARGET_AVX
+#endif
+
+struct audio_mix_funcs {
+	void (*add)(float *dst, const float *src, size_t count);
+	void (*add_ramp)(float *dst, const float *src, const float *gains,
+			size_t count);
+	void (*gain)(float *data, float gain, size_t count);
+	void (*gain_ramp)(float *data, const float *gains, size_t count);
+};
+
+/* ------------------------------------------------------------------------- */
+/* generic (used for the remainders of the vectorized versions) */
+
+static inline void add_c(float *dst, const float *src, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		dst[i] += src[i];
+}
+
+static inline void add_ramp_c(float *dst, const float *src,
+		const float *gains, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		dst[i] += src[i] * gains[i];
+}
+
+static inline void gain_c(float *data, float gain, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		data[i] *= gain;
+}
+
+static inline void gain_ramp_c(float *data, const float *gains, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		data[i] *= gains[i];
+}
+
+#ifdef MIX_X86
+
+/* ------------------------------------------------------------------------- */
+/* SSE */
+
+static void add_sse(float *dst, const float *src, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128 a0 = _mm_loadu_ps(dst + i);
+		__m128 a1 = _mm_loadu_ps(dst + i + 4);
+		a0 = _mm_add_ps(a0, _mm_loadu_ps(src + i));
+		a1 = _mm_add_ps(a1, _mm_loadu_ps(src + i + 4));
+		_mm_storeu_ps(dst + i, a0);
+		_mm_storeu_ps(dst + i + 4, a1);
+	}
+
+	add_c(dst + i, src + i, count - i);
+}
+
+static void add_ramp_sse(float *dst, const float *src, const float *gains,
+		size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 in = _mm_mul_ps(_mm_loadu_ps(src + i),
+				_mm_loadu_ps(gains + i));
+		_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), in));
+	}
+
+	add_ramp_c(dst + i, src + i, gains + i, count - i);
+}
+
+static void gain_sse(float *data, float gain, size_t count)
+{
+	__m128 vgain = _mm_set1_ps(gain);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128 a0 = _mm_loadu_ps(data + i);
+		__m128 a1 = _mm_loadu_ps(data + i + 4);
+		_mm_storeu_ps(data + i, _mm_mul_ps(a0, vgain));
+		_mm_storeu_ps(data + i + 4, _mm_mul_ps(a1, vgain));
+	}
+
+	gain_c(data + i, gain, count - i);
+}
+
+static void gain_ramp_sse(float *data, const float *gains, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 a = _mm_loadu_ps(data + i);
+		_mm_storeu_ps(data + i, _mm_mul_ps(a, _mm_loadu_ps(gains + i)));
+	}
+
+	gain_ramp_c(data + i, gains + i, count - i);
+}
+
+static const struct audio_mix_funcs sse_funcs = {
+	add_sse,
+	add_ramp_sse,
+	gain_sse,
+	gain_ramp_sse
+};
+
+/* ------------------------------------------------------------------------- */
+/* AVX */
+
+TARGET_AVX static void add_avx(float *dst, const float *src, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16) {
+		__m256 a0 = _mm256_loadu_ps(dst + i);
+		__m256 a1 = _mm256_loadu_ps(dst + i + 8);
+		a0 = _mm256_add_ps(a0, _mm256_loadu_ps(src + i));
+		a1 = _mm256_add_ps(a1, _mm256_loadu_ps(src + i + 8));
+		_mm256_storeu_ps(dst + i, a0);
+		_mm256_storeu_ps(dst + i + 8, a1);
+	}
+
+	add_c(dst + i, src + i, count - i);
+}
+
+TARGET_AVX static void add_ramp_avx(float *dst, const float *src,
+		const float *gains, size_t count)
+{
+	size_t i = 0;
+
+	/* multiply and add separately rather than fused, so results match
+	 * the other implementations exactly */
+	for (; i + 8 <= count; i += 8) {
+		__m256 in = _mm256_mul_ps(_mm256_loadu_ps(src + i),
+				_mm256_loadu_ps(gains + i));
+		_mm256_storeu_ps(dst + i,
+				_mm256_add_ps(_mm256_loadu_ps(dst + i), in));
+	}
+
+	add_ramp_c(dst + i, src + i, gains + i, count - i);
+}
+
+TARGET_AVX static void gain_avx(float *data, float gain, size_t count)
+{
+	__m256 vgain = _mm256_set1_ps(gain);
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16) {
+		__m256 a0 = _mm256_loadu_ps(data + i);
+		__m256 a1 = _mm256_loadu_ps(data + i + 8);
+		_mm256_storeu_ps(data + i, _mm256_mul_ps(a0, vgain));
+		_mm256_storeu_ps(data + i + 8, _mm256_mul_ps(a1, vgain));
+	}
+
+	gain_c(data + i, gain, count - i);
+}
+
+TARGET_AVX static void gain_ramp_avx(float *data, const float *gains,
+		size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m256 a = _mm256_loadu_ps(data + i);
+		_mm256_storeu_ps(data + i,
+				_mm256_mul_ps(a, _mm256_loadu_ps(gains + i)));
+	}
+
+	gain_ramp_c(data + i, gains + i, count - i);
+}
+
+static const struct audio_mix_funcs avx_funcs = {
+	add_avx,
+	add_ramp_avx,
+	gain_avx,
+	gain_ramp_avx
+};
+
+#else
+
+/* ------------------------------------------------------------------------- */
+/* no SIMD */
+
+static void add_generic(float *dst, const float *src, size_t count)
+{
+	add_c(dst, src, count);
+}
+
+static void add_ramp_generic(float *dst, const float *src,
+		const float *gains, size_t count)
+{
+	add_ramp_c(dst, src, gains, count);
+}
+
+static void gain_generic(float *data, float gain, size_t count)
+{
+	gain_c(data, gain, count);
+}
+
+static void gain_ramp_generic(float *data, const float *gains, size_t count)
+{
+	gain_ramp_c(data, gains, count);
+}
+
+static const struct audio_mix_funcs generic_funcs = {
+	add_generic,
+	add_ramp_generic,
+	gain_generic,
+	gain_ramp_generic
+};
+
+#endif
+
+/* ------------------------------------------------------------------------- */
+
+static const struct audio_mix_funcs *get_funcs(void)
+{
+	static const struct audio_mix_funcs *volatile funcs = NULL;
+
+	if (!funcs) {
+#ifdef MIX_X86
+		uint32_t features = os_get_cpu_features();
+		funcs = (features & OS_CPU_AVX) ? &avx_funcs : &sse_funcs;
+#else
+		funcs = &generic_funcs;
+#endif
+	}
+
+	return funcs;
+}
+
+void audio_mix_add(float *dst, const float *src, size_t count)
+{
+	get_funcs()->add(dst, src, count);
+}
+
+void audio_mix_add_ramp(float *dst, const float *src, const float *gains,
+		size_t count)
+{
+	get_funcs()->add_ramp(dst, src, gains, count);
+}
+
+void audio_mix_gain(float *data, float gain, size_t count)
+{
+	get_funcs()->gain(data, gain, count);
+}
+
+void audio_mix_gain_ramp(float *data, const float *gains, size_t count)
+{
+	get_funcs()->gain_ramp(data, gains, count);
+}
@@ -0,0 +1,51 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/c99defs.h"
+
+/*
+ * Audio mixing kernels
+ *
+ *   Vectorized routines for the float planar audio that sources and mixes
+ * use.  The best implementation for the CPU (SSE or AVX) is picked at
+ * runtime.  Buffers do not need to be aligned, and the results are the same
+ * regardless of which implementation is used.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** dst[i] += src[i] */
+EXPORT void audio_mix_add(float *dst, const float *src, size_t count);
+
+/** dst[i] += src[i] * gains[i] */
+EXPORT void audio_mix_add_ramp(float *dst, const float *src,
+		const float *gains, size_t count);
+
+/** data[i] *= gain */
+EXPORT void audio_mix_gain(float *data, float gain, size_t count);
+
+/** data[i] *= gains[i] */
+EXPORT void audio_mix_gain_ramp(float *data, const float *gains,
+		size_t count);
+
+#ifdef __cplusplus
+}
+#endif
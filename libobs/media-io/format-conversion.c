@@ -15,9 +15,290 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
+#include <string.h>
+#include "../util/platform.h"
 #include "format-conversion.h"
-#include <xmmintrin.h>
-#include <emmintrin.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || \
+    defined(__x86_64__)
+#define CONVERSION_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+struct conversion_funcs {
+	const char *name;
+
+	void (*compress_uyvx_to_i420)(
+			const uint8_t *input, uint32_t in_linesize,
+			uint32_t start_y, uint32_t end_y,
+			uint8_t *output[], const uint32_t out_linesize[]);
+	void (*compress_uyvx_to_nv12)(
+			const uint8_t *input, uint32_t in_linesize,
+			uint32_t start_y, uint32_t end_y,
+			uint8_t *output[], const uint32_t out_linesize[]);
+	void (*convert_uyvx_to_i444)(
+			const uint8_t *input, uint32_t in_linesize,
+			uint32_t start_y, uint32_t end_y,
+			uint8_t *output[], const uint32_t out_linesize[]);
+	void (*decompress_nv12)(
+			const uint8_t *const input[], const uint32_t in_linesize[],
+			uint32_t start_y, uint32_t end_y,
+			uint8_t *output, uint32_t out_linesize);
+	void (*decompress_420)(
+			const uint8_t *const input[], const uint32_t in_linesize[],
+			uint32_t start_y, uint32_t end_y,
+			uint8_t *output, uint32_t out_linesize);
+	void (*decompress_422)(
+			const uint8_t *input, uint32_t in_linesize,
+			uint32_t start_y, uint32_t end_y,
+			uint8_t *output, uint32_t out_linesize,
+			bool leading_lum);
+};
+
+static FORCE_INLINE uint32_t min_uint32(uint32_t a, uint32_t b)
+{
+	return a < b ? a : b;
+}
+
+/* ------------------------------------------------------------------------- */
+/* generic
+ *
+ *   Plain C versions.  These are used on CPUs without any of the vector
+ * extensions below, and the decompression functions double as the reference
+ * that the vectorized decompression functions must match exactly. */
+
+static void compress_uyvx_to_i420_c(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint32_t width = min_uint32(in_linesize, out_linesize[0]);
+
+	for (uint32_t y = start_y; y < end_y; y += 2) {
+		const uint8_t *line1 = input + y * in_linesize;
+		const uint8_t *line2 = line1 + in_linesize;
+		uint8_t *lum0 = output[0] + y * out_linesize[0];
+		uint8_t *lum1 = lum0 + out_linesize[0];
+		uint8_t *u = output[1] + (y >> 1) * out_linesize[1];
+		uint8_t *v = output[2] + (y >> 1) * out_linesize[2];
+
+		for (uint32_t x = 0; x < width; x += 2) {
+			const uint8_t *p1 = line1 + x * 4;
+			const uint8_t *p2 = line2 + x * 4;
+
+			lum0[x]     = p1[1];
+			lum0[x + 1] = p1[5];
+			lum1[x]     = p2[1];
+			lum1[x + 1] = p2[5];
+
+			u[x >> 1] = (uint8_t)((p1[0] + p1[4] + p2[0] + p2[4]) >> 2);
+			v[x >> 1] = (uint8_t)((p1[2] + p1[6] + p2[2] + p2[6]) >> 2);
+		}
+	}
+}
+
+static void compress_uyvx_to_nv12_c(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint32_t width = min_uint32(in_linesize, out_linesize[0]);
+
+	for (uint32_t y = start_y; y < end_y; y += 2) {
+		const uint8_t *line1 = input + y * in_linesize;
+		const uint8_t *line2 = line1 + in_linesize;
+		uint8_t *lum0 = output[0] + y * out_linesize[0];
+		uint8_t *lum1 = lum0 + out_linesize[0];
+		uint8_t *uv = output[1] + (y >> 1) * out_linesize[1];
+
+		for (uint32_t x = 0; x < width; x += 2) {
+			const uint8_t *p1 = line1 + x * 4;
+			const uint8_t *p2 = line2 + x * 4;
+
+			lum0[x]     = p1[1];
+			lum0[x + 1] = p1[5];
+			lum1[x]     = p2[1];
+			lum1[x + 1] = p2[5];
+
+			uv[x]     = (uint8_t)((p1[0] + p1[4] + p2[0] + p2[4]) >> 2);
+			uv[x + 1] = (uint8_t)((p1[2] + p1[6] + p2[2] + p2[6]) >> 2);
+		}
+	}
+}
+
+static void convert_uyvx_to_i444_c(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint32_t width = min_uint32(in_linesize, out_linesize[0]);
+
+	for (uint32_t y = start_y; y < end_y; y++) {
+		const uint8_t *line = input + y * in_linesize;
+		uint8_t *lum = output[0] + y * out_linesize[0];
+		uint8_t *u = output[1] + y * out_linesize[0];
+		uint8_t *v = output[2] + y * out_linesize[0];
+
+		for (uint32_t x = 0; x < width; x++) {
+			u[x]   = line[x * 4];
+			lum[x] = line[x * 4 + 1];
+			v[x]   = line[x * 4 + 2];
+		}
+	}
+}
+
+static void decompress_420_c(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize)
+{
+	uint32_t start_y_d2 = start_y/2;
+	uint32_t width_d2   = min_uint32(in_linesize[0], out_linesize/4)/2;
+	uint32_t height_d2  = end_y/2;
+	uint32_t y;
+
+	for (y = start_y_d2; y < height_d2; y++) {
+		const uint8_t *chroma0 = input[1] + y * in_linesize[1];
+		const uint8_t *chroma1 = input[2] + y * in_linesize[2];
+		register const uint8_t *lum0, *lum1;
+		register uint32_t *output0, *output1;
+		uint32_t x;
+
+		lum0 = input[0] + y * 2 * in_linesize[0];
+		lum1 = lum0 + in_linesize[0];
+		output0 = (uint32_t*)(output + y * 2 * out_linesize);
+		output1 = (uint32_t*)((uint8_t*)output0 + out_linesize);
+
+		for (x = 0; x < width_d2; x++) {
+			uint32_t out;
+			out = (*(chroma0++) << 8) | (*(chroma1++) << 16);
+
+			*(output0++) = *(lum0++) | out;
+			*(output0++) = *(lum0++) | out;
+
+			*(output1++) = *(lum1++) | out;
+			*(output1++) = *(lum1++) | out;
+		}
+	}
+}
+
+static void decompress_nv12_c(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize)
+{
+	uint32_t start_y_d2 = start_y/2;
+	uint32_t width_d2   = min_uint32(in_linesize[0], out_linesize/4)/2;
+	uint32_t height_d2  = end_y/2;
+	uint32_t y;
+
+	for (y = start_y_d2; y < height_d2; y++) {
+		const uint16_t *chroma;
+		register const uint8_t *lum0, *lum1;
+		register uint32_t *output0, *output1;
+		uint32_t x;
+
+		chroma = (const uint16_t*)(input[1] + y * in_linesize[1]);
+		lum0 = input[0] + y * 2 * in_linesize[0];
+		lum1 = lum0 + in_linesize[0];
+		output0 = (uint32_t*)(output + y * 2 * out_linesize);
+		output1 = (uint32_t*)((uint8_t*)output0 + out_linesize);
+
+		for (x = 0; x < width_d2; x++) {
+			uint32_t out = *(chroma++) << 8;
+
+			*(output0++) = *(lum0++) | out;
+			*(output0++) = *(lum0++) | out;
+
+			*(output1++) = *(lum1++) | out;
+			*(output1++) = *(lum1++) | out;
+		}
+	}
+}
+
+/* each input dword holds two pixels, which become two output dwords */
+static inline uint32_t packed422_width_d2(uint32_t in_linesize,
+		uint32_t out_linesize)
+{
+	return min_uint32(in_linesize / 4, out_linesize / 8);
+}
+
+static void decompress_422_c(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize,
+		bool leading_lum)
+{
+	uint32_t width_d2 = packed422_width_d2(in_linesize, out_linesize);
+	uint32_t y;
+
+	register const uint32_t *input32;
+	register const uint32_t *input32_end;
+	register uint32_t       *output32;
+
+	if (leading_lum) {
+		for (y = start_y; y < end_y; y++) {
+			input32     = (const uint32_t*)(input + y*in_linesize);
+			input32_end = input32 + width_d2;
+			output32    = (uint32_t*)(output + y*out_linesize);
+
+			while(input32 < input32_end) {
+				register uint32_t dw = *input32;
+
+				output32[0] = dw;
+				dw &= 0xFFFFFF00;
+				dw |= (uint8_t)(dw>>16);
+				output32[1] = dw;
+
+				output32 += 2;
+				input32++;
+			}
+		}
+	} else {
+		for (y = start_y; y < end_y; y++) {
+			input32     = (const uint32_t*)(input + y*in_linesize);
+			input32_end = input32 + width_d2;
+			output32    = (uint32_t*)(output + y*out_linesize);
+
+			while (input32 < input32_end) {
+				register uint32_t dw = *input32;
+
+				output32[0] = dw;
+				dw &= 0xFFFF00FF;
+				dw |= (dw>>16) & 0xFF00;
+				output32[1] = dw;
+
+				output32 += 2;
+				input32++;
+			}
+		}
+	}
+}
+
+static const struct conversion_funcs generic_funcs = {
+	"generic",
+	compress_uyvx_to_i420_c,
+	compress_uyvx_to_nv12_c,
+	convert_uyvx_to_i444_c,
+	decompress_nv12_c,
+	decompress_420_c,
+	decompress_422_c
+};
+
+#ifdef CONVERSION_X86
+
+/* ------------------------------------------------------------------------- */
+/* SSE2
+ *
+ *   The original conversion code.  Every other implementation of the
+ * compression functions must produce exactly the same output as these. */
+
 
 /* ...surprisingly, if I don't use a macro to force inlining, it causes the
  * CPU usage to boost by a tremendous amount in debug builds. */
@@ -84,12 +365,7 @@ do {                                                                          \
 } while (false)
 
 
-static FORCE_INLINE uint32_t min_uint32(uint32_t a, uint32_t b)
-{
-	return a < b ? a : b;
-}
-
-void compress_uyvx_to_i420(
+static void compress_uyvx_to_i420_sse2(
 		const uint8_t *input, uint32_t in_linesize,
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output[], const uint32_t out_linesize[])
@@ -127,7 +403,7 @@ void compress_uyvx_to_i420(
 	}
 }
 
-void compress_uyvx_to_nv12(
+static void compress_uyvx_to_nv12_sse2(
 		const uint8_t *input, uint32_t in_linesize,
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output[], const uint32_t out_linesize[])
@@ -163,7 +439,7 @@ void compress_uyvx_to_nv12(
 	}
 }
 
-void convert_uyvx_to_i444(
+static void convert_uyvx_to_i444_sse2(
 		const uint8_t *input, uint32_t in_linesize,
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output[], const uint32_t out_linesize[])
@@ -202,123 +478,529 @@ void convert_uyvx_to_i444(
 	}
 }
 
-void decompress_420(
+
+static const struct conversion_funcs sse2_funcs = {
+	"sse2",
+	compress_uyvx_to_i420_sse2,
+	compress_uyvx_to_nv12_sse2,
+	convert_uyvx_to_i444_sse2,
+	decompress_nv12_c,
+	decompress_420_c,
+	decompress_422_c
+};
+
+/* ------------------------------------------------------------------------- */
+/* AVX2
+ *
+ *   Handles 8 pixels of two lines at a time.  Instead of masking and packing,
+ * the individual channels are picked out with byte shuffles, with each
+ * 128-bit lane writing to a different part of the result so the two lanes
+ * can simply be OR'd together afterward.  Anything left over at the end of
+ * a line goes through the SSE2 path. */
+
+#define X -1
+
+static inline TARGET_AVX2 __m128i fold_lanes(__m256i val)
+{
+	return _mm_or_si128(_mm256_castsi256_si128(val),
+			_mm256_extracti128_si256(val, 1));
+}
+
+static inline TARGET_AVX2 void store_lo64(uint8_t *dst, __m128i val)
+{
+	_mm_storel_epi64((__m128i*)dst, val);
+}
+
+static inline TARGET_AVX2 void store_hi64(uint8_t *dst, __m128i val)
+{
+	_mm_storel_epi64((__m128i*)dst, _mm_unpackhi_epi64(val, val));
+}
+
+static inline TARGET_AVX2 void store_32(uint8_t *dst, __m128i val)
+{
+	int val32 = _mm_cvtsi128_si32(val);
+	memcpy(dst, &val32, sizeof(val32));
+}
+
+/* luma of the first line in bytes 0-7, luma of the second line in 8-15 */
+static inline TARGET_AVX2 __m128i get_lum_avx2(__m256i line1, __m256i line2)
+{
+	const __m256i shuf1 = _mm256_setr_epi8(
+			1, 5, 9, 13, X, X, X, X, X, X, X, X, X, X, X, X,
+			X, X, X, X, 1, 5, 9, 13, X, X, X, X, X, X, X, X);
+	const __m256i shuf2 = _mm256_setr_epi8(
+			X, X, X, X, X, X, X, X, 1, 5, 9, 13, X, X, X, X,
+			X, X, X, X, X, X, X, X, X, X, X, X, 1, 5, 9, 13);
+
+	return fold_lanes(_mm256_or_si256(
+			_mm256_shuffle_epi8(line1, shuf1),
+			_mm256_shuffle_epi8(line2, shuf2)));
+}
+
+/* averages each 2x2 block, leaving the U/V sums of each pixel pair in the
+ * low bytes of the first two words of each 64-bit element */
+static inline TARGET_AVX2 __m256i get_chroma_avg_avx2(__m256i line1,
+		__m256i line2)
+{
+	const __m256i uv_mask = _mm256_set1_epi16(0x00FF);
+	__m256i sum = _mm256_add_epi16(
+			_mm256_and_si256(line1, uv_mask),
+			_mm256_and_si256(line2, uv_mask));
+
+	sum = _mm256_add_epi16(sum, _mm256_srli_epi64(sum, 32));
+	return _mm256_srli_epi16(sum, 2);
+}
+
+static TARGET_AVX2 void compress_uyvx_to_i420_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t  *lum_plane   = output[0];
+	uint8_t  *u_plane     = output[1];
+	uint8_t  *v_plane     = output[2];
+	uint32_t width        = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t y;
+
+	/* U of all four pairs in bytes 0-3, V in bytes 4-7 */
+	const __m256i uv_shuf = _mm256_setr_epi8(
+			0, 8, X, X, 2, 10, X, X, X, X, X, X, X, X, X, X,
+			X, X, 0, 8, X, X, 2, 10, X, X, X, X, X, X, X, X);
+	__m128i lum_mask = _mm_set1_epi32(0x0000FF00);
+	__m128i uv_mask  = _mm_set1_epi16(0x00FF);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos        = y      * in_linesize;
+		uint32_t chroma_y_pos = (y>>1) * out_linesize[1];
+		uint32_t lum_y_pos    = y      * out_linesize[0];
+		uint32_t x = 0;
+
+		for (; x + 8 <= width; x += 8) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint8_t *lum0 = lum_plane + lum_y_pos + x;
+			uint8_t *lum1 = lum0 + out_linesize[0];
+
+			__m256i line1 = _mm256_loadu_si256((const __m256i*)img);
+			__m256i line2 = _mm256_loadu_si256(
+					(const __m256i*)(img + in_linesize));
+
+			__m128i lum = get_lum_avx2(line1, line2);
+			__m128i uv = fold_lanes(_mm256_shuffle_epi8(
+					get_chroma_avg_avx2(line1, line2),
+					uv_shuf));
+
+			store_lo64(lum0, lum);
+			store_hi64(lum1, lum);
+			store_32(u_plane + chroma_y_pos + (x>>1), uv);
+			store_32(v_plane + chroma_y_pos + (x>>1),
+					_mm_srli_si128(uv, 4));
+		}
+
+		for (; x < width; x += 4) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+
+			__m128i line1 = _mm_load_si128((const __m128i*)img);
+			__m128i line2 = _mm_load_si128(
+					(const __m128i*)(img + in_linesize));
+
+			pack_shift(lum_plane, lum_pos0, lum_pos1,
+					line1, line2, lum_mask, 1);
+			pack_ch_2plane(u_plane, v_plane,
+					chroma_y_pos + (x>>1),
+					line1, line2, uv_mask);
+		}
+	}
+}
+
+static TARGET_AVX2 void compress_uyvx_to_nv12_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t *lum_plane    = output[0];
+	uint8_t *chroma_plane = output[1];
+	uint32_t width        = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t y;
+
+	/* interleaved U/V of all four pairs in bytes 0-7 */
+	const __m256i uv_shuf = _mm256_setr_epi8(
+			0, 2, 8, 10, X, X, X, X, X, X, X, X, X, X, X, X,
+			X, X, X, X, 0, 2, 8, 10, X, X, X, X, X, X, X, X);
+	__m128i lum_mask = _mm_set1_epi32(0x0000FF00);
+	__m128i uv_mask  = _mm_set1_epi16(0x00FF);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos        = y      * in_linesize;
+		uint32_t chroma_y_pos = (y>>1) * out_linesize[1];
+		uint32_t lum_y_pos    = y      * out_linesize[0];
+		uint32_t x = 0;
+
+		for (; x + 8 <= width; x += 8) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint8_t *lum0 = lum_plane + lum_y_pos + x;
+			uint8_t *lum1 = lum0 + out_linesize[0];
+
+			__m256i line1 = _mm256_loadu_si256((const __m256i*)img);
+			__m256i line2 = _mm256_loadu_si256(
+					(const __m256i*)(img + in_linesize));
+
+			__m128i lum = get_lum_avx2(line1, line2);
+			__m128i uv = fold_lanes(_mm256_shuffle_epi8(
+					get_chroma_avg_avx2(line1, line2),
+					uv_shuf));
+
+			store_lo64(lum0, lum);
+			store_hi64(lum1, lum);
+			store_lo64(chroma_plane + chroma_y_pos + x, uv);
+		}
+
+		for (; x < width; x += 4) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+
+			__m128i line1 = _mm_load_si128((const __m128i*)img);
+			__m128i line2 = _mm_load_si128(
+					(const __m128i*)(img + in_linesize));
+
+			pack_shift(lum_plane, lum_pos0, lum_pos1,
+					line1, line2, lum_mask, 1);
+			pack_ch_1plane(chroma_plane, chroma_y_pos + x,
+					line1, line2, uv_mask);
+		}
+	}
+}
+
+static TARGET_AVX2 void convert_uyvx_to_i444_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t  *lum_plane   = output[0];
+	uint8_t  *u_plane     = output[1];
+	uint8_t  *v_plane     = output[2];
+	uint32_t width        = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t y;
+
+	/* luma in bytes 0-7 and U in bytes 8-15, or V in bytes 0-7 */
+	const __m256i lum_u_shuf = _mm256_setr_epi8(
+			1, 5, 9, 13, X, X, X, X, 0, 4, 8, 12, X, X, X, X,
+			X, X, X, X, 1, 5, 9, 13, X, X, X, X, 0, 4, 8, 12);
+	const __m256i v_shuf = _mm256_setr_epi8(
+			2, 6, 10, 14, X, X, X, X, X, X, X, X, X, X, X, X,
+			X, X, X, X, 2, 6, 10, 14, X, X, X, X, X, X, X, X);
+	__m128i lum_mask = _mm_set1_epi32(0x0000FF00);
+	__m128i u_mask   = _mm_set1_epi32(0x000000FF);
+	__m128i v_mask   = _mm_set1_epi32(0x00FF0000);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos        = y      * in_linesize;
+		uint32_t lum_y_pos    = y      * out_linesize[0];
+		uint32_t x = 0;
+
+		for (; x + 8 <= width; x += 8) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+
+			__m256i line1 = _mm256_loadu_si256((const __m256i*)img);
+			__m256i line2 = _mm256_loadu_si256(
+					(const __m256i*)(img + in_linesize));
+
+			__m128i lum_u1 = fold_lanes(
+					_mm256_shuffle_epi8(line1, lum_u_shuf));
+			__m128i lum_u2 = fold_lanes(
+					_mm256_shuffle_epi8(line2, lum_u_shuf));
+			__m128i v1 = fold_lanes(
+					_mm256_shuffle_epi8(line1, v_shuf));
+			__m128i v2 = fold_lanes(
+					_mm256_shuffle_epi8(line2, v_shuf));
+
+			store_lo64(lum_plane + lum_pos0, lum_u1);
+			store_lo64(lum_plane + lum_pos1, lum_u2);
+			store_hi64(u_plane + lum_pos0, lum_u1);
+			store_hi64(u_plane + lum_pos1, lum_u2);
+			store_lo64(v_plane + lum_pos0, v1);
+			store_lo64(v_plane + lum_pos1, v2);
+		}
+
+		for (; x < width; x += 4) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+
+			__m128i line1 = _mm_load_si128((const __m128i*)img);
+			__m128i line2 = _mm_load_si128(
+					(const __m128i*)(img + in_linesize));
+
+			pack_shift(lum_plane, lum_pos0, lum_pos1,
+					line1, line2, lum_mask, 1);
+			pack_val(u_plane, lum_pos0, lum_pos1,
+					line1, line2, u_mask);
+			pack_shift(v_plane, lum_pos0, lum_pos1,
+					line1, line2, v_mask, 2);
+		}
+	}
+}
+
+/* duplicates each of the first four dwords into two adjacent dwords */
+static inline TARGET_AVX2 __m256i dup_dwords(__m128i val)
+{
+	const __m256i idx = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+	return _mm256_permutevar8x32_epi32(_mm256_castsi128_si256(val), idx);
+}
+
+static inline TARGET_AVX2 __m256i load_lum8(const uint8_t *lum)
+{
+	return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)lum));
+}
+
+static inline TARGET_AVX2 __m128i load_u8x4(const uint8_t *data)
+{
+	int val;
+	memcpy(&val, data, sizeof(val));
+	return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(val));
+}
+
+static TARGET_AVX2 void decompress_420_avx2(
 		const uint8_t *const input[], const uint32_t in_linesize[],
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output, uint32_t out_linesize)
 {
 	uint32_t start_y_d2 = start_y/2;
-	uint32_t width_d2   = min_uint32(in_linesize[0], out_linesize)/2;
+	uint32_t width      = min_uint32(in_linesize[0], out_linesize/4) & ~1;
 	uint32_t height_d2  = end_y/2;
 	uint32_t y;
 
 	for (y = start_y_d2; y < height_d2; y++) {
 		const uint8_t *chroma0 = input[1] + y * in_linesize[1];
 		const uint8_t *chroma1 = input[2] + y * in_linesize[2];
-		register const uint8_t *lum0, *lum1;
-		register uint32_t *output0, *output1;
-		uint32_t x;
+		const uint8_t *lum0, *lum1;
+		uint32_t *output0, *output1;
+		uint32_t x = 0;
 
 		lum0 = input[0] + y * 2 * in_linesize[0];
 		lum1 = lum0 + in_linesize[0];
-		output0 = (uint32_t*)(output + y * 2 * in_linesize[0]);
-		output1 = (uint32_t*)((uint8_t*)output0 + in_linesize[0]);
+		output0 = (uint32_t*)(output + y * 2 * out_linesize);
+		output1 = (uint32_t*)((uint8_t*)output0 + out_linesize);
 
-		for (x = 0; x < width_d2; x++) {
-			uint32_t out;
-			out = (*(chroma0++) << 8) | (*(chroma1++) << 16);
+		for (; x + 8 <= width; x += 8) {
+			__m128i u = _mm_slli_epi32(load_u8x4(chroma0 + x/2), 8);
+			__m128i v = _mm_slli_epi32(load_u8x4(chroma1 + x/2), 16);
+			__m256i uv = dup_dwords(_mm_or_si128(u, v));
 
-			*(output0++) = *(lum0++) | out;
-			*(output0++) = *(lum0++) | out;
+			_mm256_storeu_si256((__m256i*)(output0 + x),
+					_mm256_or_si256(load_lum8(lum0 + x), uv));
+			_mm256_storeu_si256((__m256i*)(output1 + x),
+					_mm256_or_si256(load_lum8(lum1 + x), uv));
+		}
 
-			*(output1++) = *(lum1++) | out;
-			*(output1++) = *(lum1++) | out;
+		for (; x < width; x += 2) {
+			uint32_t out = (chroma0[x/2] << 8) | (chroma1[x/2] << 16);
+
+			output0[x]     = lum0[x]     | out;
+			output0[x + 1] = lum0[x + 1] | out;
+			output1[x]     = lum1[x]     | out;
+			output1[x + 1] = lum1[x + 1] | out;
 		}
 	}
 }
 
-void decompress_nv12(
+static TARGET_AVX2 void decompress_nv12_avx2(
 		const uint8_t *const input[], const uint32_t in_linesize[],
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output, uint32_t out_linesize)
 {
 	uint32_t start_y_d2 = start_y/2;
-	uint32_t width_d2   = min_uint32(in_linesize[0], out_linesize)/2;
+	uint32_t width      = min_uint32(in_linesize[0], out_linesize/4) & ~1;
 	uint32_t height_d2  = end_y/2;
 	uint32_t y;
 
 	for (y = start_y_d2; y < height_d2; y++) {
-		const uint16_t *chroma;
-		register const uint8_t *lum0, *lum1;
-		register uint32_t *output0, *output1;
-		uint32_t x;
+		const uint8_t *chroma = input[1] + y * in_linesize[1];
+		const uint8_t *lum0, *lum1;
+		uint32_t *output0, *output1;
+		uint32_t x = 0;
 
-		chroma = (const uint16_t*)(input[1] + y * in_linesize[1]);
 		lum0 = input[0] + y * 2 * in_linesize[0];
 		lum1 = lum0 + in_linesize[0];
 		output0 = (uint32_t*)(output + y * 2 * out_linesize);
 		output1 = (uint32_t*)((uint8_t*)output0 + out_linesize);
 
-		for (x = 0; x < width_d2; x++) {
-			uint32_t out = *(chroma++) << 8;
+		for (; x + 8 <= width; x += 8) {
+			__m128i uv = _mm_cvtepu16_epi32(_mm_loadl_epi64(
+					(const __m128i*)(chroma + x)));
+			__m256i uv8 = dup_dwords(_mm_slli_epi32(uv, 8));
 
-			*(output0++) = *(lum0++) | out;
-			*(output0++) = *(lum0++) | out;
+			_mm256_storeu_si256((__m256i*)(output0 + x),
+					_mm256_or_si256(load_lum8(lum0 + x), uv8));
+			_mm256_storeu_si256((__m256i*)(output1 + x),
+					_mm256_or_si256(load_lum8(lum1 + x), uv8));
+		}
 
-			*(output1++) = *(lum1++) | out;
-			*(output1++) = *(lum1++) | out;
+		for (; x < width; x += 2) {
+			uint32_t out = (chroma[x] << 8) | (chroma[x + 1] << 16);
+
+			output0[x]     = lum0[x]     | out;
+			output0[x + 1] = lum0[x + 1] | out;
+			output1[x]     = lum1[x]     | out;
+			output1[x + 1] = lum1[x + 1] | out;
 		}
 	}
 }
 
-void decompress_422(
+static TARGET_AVX2 void decompress_422_avx2(
 		const uint8_t *input, uint32_t in_linesize,
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output, uint32_t out_linesize,
 		bool leading_lum)
 {
-	uint32_t width_d2 = min_uint32(in_linesize, out_linesize)/2;
+	uint32_t width_d2 = packed422_width_d2(in_linesize, out_linesize);
 	uint32_t y;
 
-	register const uint32_t *input32;
-	register const uint32_t *input32_end;
-	register uint32_t       *output32;
+	/* the second pixel of each pair: the second luma value replaces the
+	 * first one */
+	const __m256i yuyv_shuf = _mm256_setr_epi8(
+			2, 1, 2, 3, 6, 5, 6, 7, 10, 9, 10, 11, 14, 13, 14, 15,
+			2, 1, 2, 3, 6, 5, 6, 7, 10, 9, 10, 11, 14, 13, 14, 15);
+	const __m256i uyvy_shuf = _mm256_setr_epi8(
+			0, 3, 2, 3, 4, 7, 6, 7, 8, 11, 10, 11, 12, 15, 14, 15,
+			0, 3, 2, 3, 4, 7, 6, 7, 8, 11, 10, 11, 12, 15, 14, 15);
+	const __m256i shuf = leading_lum ? yuyv_shuf : uyvy_shuf;
+	const uint32_t mask = leading_lum ? 0xFFFFFF00 : 0xFFFF00FF;
+
+	for (y = start_y; y < end_y; y++) {
+		const uint32_t *input32 = (const uint32_t*)(input + y*in_linesize);
+		uint32_t *output32 = (uint32_t*)(output + y*out_linesize);
+		uint32_t x = 0;
+
+		for (; x + 8 <= width_d2; x += 8) {
+			__m256i in = _mm256_loadu_si256(
+					(const __m256i*)(input32 + x));
+			__m256i second = _mm256_shuffle_epi8(in, shuf);
+			__m256i lo = _mm256_unpacklo_epi32(in, second);
+			__m256i hi = _mm256_unpackhi_epi32(in, second);
+
+			_mm256_storeu_si256((__m256i*)(output32 + x*2),
+					_mm256_permute2x128_si256(lo, hi, 0x20));
+			_mm256_storeu_si256((__m256i*)(output32 + x*2 + 8),
+					_mm256_permute2x128_si256(lo, hi, 0x31));
+		}
 
-	if (leading_lum) {
-		for (y = start_y; y < end_y; y++) {
-			input32     = (const uint32_t*)(input + y*in_linesize);
-			input32_end = input32 + width_d2;
-			output32    = (uint32_t*)(output + y*out_linesize);
+		for (; x < width_d2; x++) {
+			uint32_t dw = input32[x];
 
-			while(input32 < input32_end) {
-				register uint32_t dw = *input32;
+			output32[x*2] = dw;
+			if (leading_lum)
+				dw = (dw & mask) | (uint8_t)(dw>>16);
+			else
+				dw = (dw & mask) | ((dw>>16) & 0xFF00);
+			output32[x*2 + 1] = dw;
+		}
+	}
+}
 
-				output32[0] = dw;
-				dw &= 0xFFFFFF00;
-				dw |= (uint8_t)(dw>>16);
-				output32[1] = dw;
+#undef X
 
-				output32 += 2;
-				input32++;
-			}
-		}
-	} else {
-		for (y = start_y; y < end_y; y++) {
-			input32     = (const uint32_t*)(input + y*in_linesize);
-			input32_end = input32 + width_d2;
-			output32    = (uint32_t*)(output + y*out_linesize);
+static const struct conversion_funcs avx2_funcs = {
+	"avx2",
+	compress_uyvx_to_i420_avx2,
+	compress_uyvx_to_nv12_avx2,
+	convert_uyvx_to_i444_avx2,
+	decompress_nv12_avx2,
+	decompress_420_avx2,
+	decompress_422_avx2
+};
 
-			while (input32 < input32_end) {
-				register uint32_t dw = *input32;
+#endif
 
-				output32[0] = dw;
-				dw &= 0xFFFF00FF;
-				dw |= (dw>>16) & 0xFF00;
-				output32[1] = dw;
+/* ------------------------------------------------------------------------- */
 
-				output32 += 2;
-				input32++;
-			}
-		}
-	}
+static const struct conversion_funcs *volatile conversion_funcs = NULL;
+
+static const struct conversion_funcs *select_funcs(uint32_t features)
+{
+#ifdef CONVERSION_X86
+	if (features & OS_CPU_AVX2)
+		return &avx2_funcs;
+	if (features & OS_CPU_SSE2)
+		return &sse2_funcs;
+#endif
+	UNUSED_PARAMETER(features);
+	return &generic_funcs;
+}
+
+static inline const struct conversion_funcs *get_funcs(void)
+{
+	if (!conversion_funcs)
+		conversion_funcs = select_funcs(os_get_cpu_features());
+	return conversion_funcs;
+}
+
+const char *format_conversion_set_cpu_features(uint32_t features)
+{
+	conversion_funcs = select_funcs(features);
+	return conversion_funcs->name;
+}
+
+const char *format_conversion_get_impl(void)
+{
+	return get_funcs()->name;
+}
+
+void compress_uyvx_to_i420(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	get_funcs()->compress_uyvx_to_i420(input, in_linesize,
+			start_y, end_y, output, out_linesize);
+}
+
+void compress_uyvx_to_nv12(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	get_funcs()->compress_uyvx_to_nv12(input, in_linesize,
+			start_y, end_y, output, out_linesize);
+}
+
+void convert_uyvx_to_i444(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	get_funcs()->convert_uyvx_to_i444(input, in_linesize,
+			start_y, end_y, output, out_linesize);
+}
+
+void decompress_nv12(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize)
+{
+	get_funcs()->decompress_nv12(input, in_linesize,
+			start_y, end_y, output, out_linesize);
+}
+
+void decompress_420(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize)
+{
+	get_funcs()->decompress_420(input, in_linesize,
+			start_y, end_y, output, out_linesize);
+}
+
+void decompress_422(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize,
+		bool leading_lum)
+{
+	get_funcs()->decompress_422(input, in_linesize,
+			start_y, end_y, output, out_linesize, leading_lum);
 }
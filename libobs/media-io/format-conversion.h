@@ -25,6 +25,11 @@ extern "C" {
 
 /*
  * Functions for converting to and from packed 444 YUV
+ *
+ *   The fastest implementation for the CPU is picked at runtime.  All of them
+ * produce exactly the same output.  Every function only touches the rows
+ * from start_y to end_y, so a frame can be split into slices (see
+ * format_conversion_get_slice) and converted on multiple threads.
  */
 
 EXPORT void compress_uyvx_to_i420(
@@ -58,6 +63,34 @@ EXPORT void decompress_422(
 		uint8_t *output, uint32_t out_linesize,
 		bool leading_lum);
 
+/**
+ * Gets the rows that a slice covers when splitting the conversion of a frame
+ * into a number of slices.  Slices always start on an even row, so chroma
+ * rows of 4:2:0 formats are never split between two slices.
+ */
+static inline void format_conversion_get_slice(uint32_t height,
+		size_t slice, size_t slices, uint32_t *start_y, uint32_t *end_y)
+{
+	uint32_t pairs = (height + 1) / 2;
+
+	*start_y = (uint32_t)(pairs * slice / slices) * 2;
+	*end_y   = (uint32_t)(pairs * (slice + 1) / slices) * 2;
+
+	if (*end_y > height)
+		*end_y = height;
+}
+
+/**
+ * Restricts the conversion functions to implementations that only use the
+ * given OS_CPU_* features, and returns the name of the implementation that
+ * will be used.  This is only meant for testing the implementations against
+ * each other; normally the best one for the CPU is picked automatically.
+ */
+EXPORT const char *format_conversion_set_cpu_features(uint32_t features);
+
+/** Returns the name of the implementation in use ("avx2", "sse2", etc) */
+EXPORT const char *format_conversion_get_impl(void);
+
 #ifdef __cplusplus
 }
 #endif
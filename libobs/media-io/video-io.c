@@ -22,6 +22,8 @@
 #include "../util/profiler.h"
 #include "../util/threading.h"
 #include "../util/darray.h"
+#include "../util/circlebuf.h"
+#include "../util/threadpool.h"
 
 #include "format-conversion.h"
 #include "video-io.h"
@@ -30,31 +32,95 @@
 
 extern profiler_name_store_t *obs_get_profiler_name_store(void);
 
-#define MAX_CONVERT_BUFFERS 3
 #define MAX_CACHE_SIZE 16
+#define MAX_SCALE_THREADS 7
+#define DEFAULT_INPUT_QUEUE_SIZE 2
 
 struct cached_frame_info {
 	struct video_data frame;
 	int skipped;
 	int count;
+
+	/* incremented every time the slot is filled with a new frame */
+	uint64_t generation;
+
+	/* number of queued/processing references held by input threads.  a
+	 * cache slot only becomes available again once count and refs are
+	 * both zero */
+	int refs;
 };
 
-struct video_input {
+/* a scaled version of the output shared by every input that requests the
+ * same conversion.  scaled frames are kept per cache slot so they stay valid
+ * for as long as the cache slot itself is referenced */
+struct video_scale_target {
 	struct video_scale_info   conversion;
 	video_scaler_t            *scaler;
-	struct video_frame        frame[MAX_CONVERT_BUFFERS];
-	int                       cur_frame;
+	size_t                    slices;
+	long                      refs;
+
+	struct video_frame        frame[MAX_CACHE_SIZE];
+	uint64_t                  generation[MAX_CACHE_SIZE];
+	bool                      scaled;
+	volatile bool             failed;
+};
+
+struct video_input_thread;
+
+struct video_input {
+	struct video_scale_info   conversion;
+	struct video_scale_target *target;
 
 	void (*callback)(void *param, struct video_data *frame);
 	void *param;
+
+	/* if set, the input is called back on its own thread instead of
+	 * inline on the video thread */
+	struct video_input_thread *thread;
 };
 
-static inline void video_input_free(struct video_input *input)
-{
-	for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
-		video_frame_free(&input->frame[i]);
-	video_scaler_destroy(input->scaler);
-}
+struct scale_job {
+	struct video_scale_target *target;
+	size_t                    slice;
+	struct video_frame        *dst;
+	const struct video_data   *src;
+};
+
+struct queued_frame {
+	struct video_data         frame;
+	struct cached_frame_info  *info;
+};
+
+/* a frame for an input thread whose queue was full, pushed once the input
+ * mutex has been released */
+struct pending_frame {
+	struct video_input_thread *thread;
+	struct video_data         frame;
+};
+
+struct video_input_thread {
+	struct video_output       *video;
+
+	void (*callback)(void *param, struct video_data *frame);
+	void *param;
+
+	pthread_t                 thread;
+	pthread_mutex_t           mutex;
+	os_sem_t                  *queued_sem;
+	os_event_t                *space_event;
+	struct circlebuf          queue;
+	size_t                    queue_size;
+
+	uint64_t                  cur_timestamp;
+	uint64_t                  last_timestamp;
+
+	/* held by the input, and by the video thread while it waits for
+	 * space in the queue */
+	volatile long             refs;
+
+	volatile bool             stop;
+	bool                      detached;
+};
 
 struct video_output {
 	struct video_output_info   info;
@@ -73,6 +139,13 @@ struct video_output {
 	pthread_mutex_t            input_mutex;
 	DARRAY(struct video_input) inputs;
 
+	DARRAY(struct video_scale_target*) scale_targets;
+	DARRAY(struct scale_job)   scale_jobs;
+	os_threadpool_t            *scale_pool;
+
+	DARRAY(struct pending_frame) pending_frames;
+
+	uint64_t                   generation;
 	size_t                     available_frames;
 	size_t                     first_added;
 	size_t                     last_added;
@@ -81,35 +154,217 @@ struct video_output {
 
 /* ------------------------------------------------------------------------- */
 
-static inline bool scale_video_output(struct video_input *input,
-		struct video_data *data)
+static void video_input_thread_release(struct video_input_thread *thread);
+
+static inline void free_cached_frame(struct video_output *video)
 {
-	bool success = true;
+	if (++video->available_frames == video->info.cache_size)
+		video->last_added = video->first_added;
+}
 
-	if (input->scaler) {
-		struct video_frame *frame;
+static inline void release_cached_frame(struct video_output *video,
+		struct cached_frame_info *frame_info)
+{
+	pthread_mutex_lock(&video->data_mutex);
 
-		if (++input->cur_frame == MAX_CONVERT_BUFFERS)
-			input->cur_frame = 0;
+	if (--frame_info->refs == 0 && frame_info->count == 0)
+		free_cached_frame(video);
 
-		frame = &input->frame[input->cur_frame];
+	pthread_mutex_unlock(&video->data_mutex);
+}
 
-		success = video_scaler_scale(input->scaler,
-				frame->data, frame->linesize,
-				(const uint8_t * const*)data->data,
-				data->linesize);
+/* ------------------------------------------------------------------------- */
 
-		if (success) {
-			for (size_t i = 0; i < MAX_AV_PLANES; i++) {
-				data->data[i]     = frame->data[i];
-				data->linesize[i] = frame->linesize[i];
-			}
-		} else {
+static void scale_job_run(void *param, size_t idx)
+{
+	struct scale_job *job = (struct scale_job*)param + idx;
+	struct video_scale_target *target = job->target;
+
+	if (!video_scaler_scale_slice(target->scaler, job->slice,
+				job->dst->data, job->dst->linesize,
+				(const uint8_t * const*)job->src->data,
+				job->src->linesize))
+		target->failed = true;
+}
+
+/* scales the current frame once for every distinct conversion that any input
+ * has requested, spreading the slices of every target across the pool */
+static void scale_video_output(struct video_output *video,
+		struct cached_frame_info *frame_info)
+{
+	size_t slot = frame_info - video->cache;
+
+	da_resize(video->scale_jobs, 0);
+
+	for (size_t i = 0; i < video->scale_targets.num; i++) {
+		struct video_scale_target *target =
+			video->scale_targets.array[i];
+
+		/* frame duplicates do not need to be rescaled */
+		target->scaled = target->generation[slot] ==
+			frame_info->generation;
+		if (target->scaled)
+			continue;
+
+		target->failed = false;
+
+		for (size_t j = 0; j < target->slices; j++) {
+			struct scale_job *job = da_push_back_new(
+					video->scale_jobs);
+			job->target = target;
+			job->slice  = j;
+			job->dst    = &target->frame[slot];
+			job->src    = &frame_info->frame;
+		}
+	}
+
+	os_threadpool_run(video->scale_pool, scale_job_run,
+			video->scale_jobs.array, video->scale_jobs.num);
+
+	for (size_t i = 0; i < video->scale_targets.num; i++) {
+		struct video_scale_target *target =
+			video->scale_targets.array[i];
+
+		if (target->scaled)
+			continue;
+
+		if (target->failed) {
 			blog(LOG_WARNING, "video-io: Could not scale frame!");
+			target->generation[slot] = 0;
+		} else {
+			target->generation[slot] = frame_info->generation;
+			target->scaled = true;
 		}
 	}
+}
 
-	return success;
+static inline bool get_input_frame(struct video_output *video,
+		struct video_input *input,
+		struct cached_frame_info *frame_info,
+		struct video_data *data)
+{
+	struct video_scale_target *target = input->target;
+	size_t slot = frame_info - video->cache;
+
+	*data = frame_info->frame;
+
+	if (target) {
+		if (!target->scaled)
+			return false;
+
+		for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+			data->data[i]     = target->frame[slot].data[i];
+			data->linesize[i] = target->frame[slot].linesize[i];
+		}
+	}
+
+	return true;
+}
+
+static void *video_input_thread(void *param)
+{
+	struct video_input_thread *thread = param;
+	struct video_output *video = thread->video;
+
+	os_set_thread_name("video-io: input thread");
+
+	const char *input_thread_name =
+		profile_store_name(obs_get_profiler_name_store(),
+				"video_input_thread(%s)", video->info.name);
+
+	while (os_sem_wait(thread->queued_sem) == 0) {
+		struct queued_frame queued;
+
+		if (thread->stop)
+			break;
+
+		pthread_mutex_lock(&thread->mutex);
+		circlebuf_pop_front(&thread->queue, &queued, sizeof(queued));
+		thread->cur_timestamp = queued.frame.timestamp;
+		pthread_mutex_unlock(&thread->mutex);
+
+		os_event_signal(thread->space_event);
+
+		profile_start(input_thread_name);
+		thread->callback(thread->param, &queued.frame);
+		profile_end(input_thread_name);
+
+		release_cached_frame(video, queued.info);
+
+		profile_reenable_thread();
+
+		/* the input disconnected itself from within its callback */
+		if (thread->stop)
+			break;
+	}
+
+	if (thread->detached)
+		video_input_thread_release(thread);
+
+	return NULL;
+}
+
+/* must be called with the thread mutex held */
+static inline bool video_input_thread_full(struct video_input_thread *thread)
+{
+	return thread->queue.size >=
+		thread->queue_size * sizeof(struct queued_frame);
+}
+
+/* must be called with the thread mutex held */
+static inline void video_input_thread_queue(struct video_input_thread *thread,
+		struct video_data *frame, struct cached_frame_info *frame_info)
+{
+	struct queued_frame queued = {*frame, frame_info};
+
+	circlebuf_push_back(&thread->queue, &queued, sizeof(queued));
+	thread->last_timestamp = frame->timestamp;
+}
+
+static inline bool video_input_thread_try_push(
+		struct video_input_thread *thread,
+		struct video_data *frame, struct cached_frame_info *frame_info)
+{
+	pthread_mutex_lock(&thread->mutex);
+
+	if (video_input_thread_full(thread)) {
+		pthread_mutex_unlock(&thread->mutex);
+		return false;
+	}
+
+	video_input_thread_queue(thread, frame, frame_info);
+	pthread_mutex_unlock(&thread->mutex);
+
+	os_sem_post(thread->queued_sem);
+	return true;
+}
+
+/* waits for the input to fall less far behind, which in turn makes the video
+ * thread skip frames like it does for inline inputs.  this is only done
+ * after the input mutex has been released: the input's callback may need it,
+ * and connecting or disconnecting other inputs must not have to wait. */
+static void video_input_thread_wait_push(struct video_output *video,
+		struct video_input_thread *thread,
+		struct video_data *frame, struct cached_frame_info *frame_info)
+{
+	pthread_mutex_lock(&thread->mutex);
+
+	while (!thread->stop && video_input_thread_full(thread)) {
+		pthread_mutex_unlock(&thread->mutex);
+		os_event_wait(thread->space_event);
+		pthread_mutex_lock(&thread->mutex);
+	}
+
+	if (thread->stop) {
+		pthread_mutex_unlock(&thread->mutex);
+		release_cached_frame(video, frame_info);
+		return;
+	}
+
+	video_input_thread_queue(thread, frame, frame_info);
+	pthread_mutex_unlock(&thread->mutex);
+
+	os_sem_post(thread->queued_sem);
 }
 
 static inline bool video_output_cur_frame(struct video_output *video)
@@ -130,16 +385,48 @@ static inline bool video_output_cur_frame(struct video_output *video)
 
 	pthread_mutex_lock(&video->input_mutex);
 
+	scale_video_output(video, frame_info);
+
+	da_resize(video->pending_frames, 0);
+
 	for (size_t i = 0; i < video->inputs.num; i++) {
 		struct video_input *input = video->inputs.array+i;
-		struct video_data frame = frame_info->frame;
+		struct video_data frame;
 
-		if (scale_video_output(input, &frame))
+		if (!get_input_frame(video, input, frame_info, &frame))
+			continue;
+
+		if (input->thread) {
+			pthread_mutex_lock(&video->data_mutex);
+			frame_info->refs++;
+			pthread_mutex_unlock(&video->data_mutex);
+
+			if (!video_input_thread_try_push(input->thread,
+						&frame, frame_info)) {
+				struct pending_frame *pending;
+
+				pending = da_push_back_new(
+						video->pending_frames);
+				pending->thread = input->thread;
+				pending->frame  = frame;
+				os_atomic_inc_long(&input->thread->refs);
+			}
+
+		} else {
 			input->callback(input->param, &frame);
+		}
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
 
+	for (size_t i = 0; i < video->pending_frames.num; i++) {
+		struct pending_frame *pending = video->pending_frames.array + i;
+
+		video_input_thread_wait_push(video, pending->thread,
+				&pending->frame, frame_info);
+		video_input_thread_release(pending->thread);
+	}
+
 	/* -------------------------------- */
 
 	pthread_mutex_lock(&video->data_mutex);
@@ -152,8 +439,8 @@ static inline bool video_output_cur_frame(struct video_output *video)
 		if (++video->first_added == video->info.cache_size)
 			video->first_added = 0;
 
-		if (++video->available_frames == video->info.cache_size)
-			video->last_added = video->first_added;
+		if (frame_info->refs == 0)
+			free_cached_frame(video);
 	} else if (skipped) {
 		--frame_info->skipped;
 		++video->skipped_frames;
@@ -196,6 +483,122 @@ static void *video_thread(void *param)
 
 /* ------------------------------------------------------------------------- */
 
+static void video_input_thread_destroy(struct video_input_thread *thread)
+{
+	struct queued_frame queued;
+
+	while (thread->queue.size) {
+		circlebuf_pop_front(&thread->queue, &queued, sizeof(queued));
+		release_cached_frame(thread->video, queued.info);
+	}
+
+	circlebuf_free(&thread->queue);
+	os_sem_destroy(thread->queued_sem);
+	os_event_destroy(thread->space_event);
+	pthread_mutex_destroy(&thread->mutex);
+	bfree(thread);
+}
+
+static void video_input_thread_release(struct video_input_thread *thread)
+{
+	if (os_atomic_dec_long(&thread->refs) == 0)
+		video_input_thread_destroy(thread);
+}
+
+static void video_input_thread_stop(struct video_input_thread *thread)
+{
+	pthread_mutex_lock(&thread->mutex);
+	thread->stop = true;
+	pthread_mutex_unlock(&thread->mutex);
+
+	/* the video thread may be waiting to queue a frame */
+	os_event_signal(thread->space_event);
+
+	/* an input can disconnect itself from within its own callback, in
+	 * which case the thread cleans up after itself when it returns */
+	if (pthread_equal(pthread_self(), thread->thread)) {
+		thread->detached = true;
+		pthread_detach(thread->thread);
+		return;
+	}
+
+	os_sem_post(thread->queued_sem);
+	pthread_join(thread->thread, NULL);
+	video_input_thread_release(thread);
+}
+
+static void video_scale_target_release(struct video_output *video,
+		struct video_scale_target *target)
+{
+	if (!target || --target->refs > 0)
+		return;
+
+	da_erase_item(video->scale_targets, &target);
+
+	for (size_t i = 0; i < MAX_CACHE_SIZE; i++)
+		video_frame_free(&target->frame[i]);
+	video_scaler_destroy(target->scaler);
+	bfree(target);
+}
+
+/* must be called with the input mutex held */
+static inline void video_input_free(struct video_output *video,
+		struct video_input *input)
+{
+	if (input->thread) {
+		video_input_thread_stop(input->thread);
+		input->thread = NULL;
+	}
+
+	video_scale_target_release(video, input->target);
+	input->target = NULL;
+}
+
+static bool video_input_thread_create(struct video_input *input,
+		struct video_output *video, size_t queue_size)
+{
+	struct video_input_thread *thread;
+	size_t max_queue_size = video->info.cache_size > 1 ?
+		video->info.cache_size - 1 : 1;
+
+	if (!queue_size)
+		queue_size = DEFAULT_INPUT_QUEUE_SIZE;
+	if (queue_size > max_queue_size)
+		queue_size = max_queue_size;
+
+	thread = bzalloc(sizeof(struct video_input_thread));
+	thread->video      = video;
+	thread->callback   = input->callback;
+	thread->param      = input->param;
+	thread->queue_size = queue_size;
+	thread->refs       = 1;
+
+	if (pthread_mutex_init(&thread->mutex, NULL) != 0)
+		goto fail0;
+	if (os_sem_init(&thread->queued_sem, 0) != 0)
+		goto fail1;
+	if (os_event_init(&thread->space_event, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail2;
+	if (pthread_create(&thread->thread, NULL, video_input_thread,
+				thread) != 0)
+		goto fail3;
+
+	input->thread = thread;
+	return true;
+
+fail3:
+	os_event_destroy(thread->space_event);
+fail2:
+	os_sem_destroy(thread->queued_sem);
+fail1:
+	pthread_mutex_destroy(&thread->mutex);
+fail0:
+	bfree(thread);
+	blog(LOG_ERROR, "video_input_thread_create: Failed to create "
+	                "input thread");
+	return false;
+}
+
 static inline bool valid_video_params(const struct video_output_info *info)
 {
 	return info->height != 0 && info->width != 0 && info->fps_den != 0 &&
@@ -248,6 +651,14 @@ int video_output_open(video_t **video, struct video_output_info *info)
 	if (pthread_create(&out->thread, NULL, video_thread, out) != 0)
 		goto fail;
 
+	int cores = os_get_logical_cores();
+	size_t scale_threads = cores > 1 ? (size_t)cores - 1 : 0;
+	if (scale_threads > MAX_SCALE_THREADS)
+		scale_threads = MAX_SCALE_THREADS;
+	if (scale_threads)
+		out->scale_pool = os_threadpool_create(
+				"video-io: scale thread", scale_threads);
+
 	init_cache(out);
 
 	out->initialized = true;
@@ -267,8 +678,13 @@ void video_output_close(video_t *video)
 	video_output_stop(video);
 
 	for (size_t i = 0; i < video->inputs.num; i++)
-		video_input_free(&video->inputs.array[i]);
+		video_input_free(video, &video->inputs.array[i]);
 	da_free(video->inputs);
+	da_free(video->scale_targets);
+	da_free(video->scale_jobs);
+	da_free(video->pending_frames);
+
+	os_threadpool_destroy(video->scale_pool);
 
 	for (size_t i = 0; i < video->info.cache_size; i++)
 		video_frame_free((struct video_frame*)&video->cache[i]);
@@ -292,44 +708,86 @@ static size_t video_get_input_idx(const video_t *video,
 	return DARRAY_INVALID;
 }
 
+static inline bool scale_info_equal(const struct video_scale_info *a,
+		const struct video_scale_info *b)
+{
+	return a->format     == b->format &&
+	       a->width      == b->width &&
+	       a->height     == b->height &&
+	       a->range      == b->range &&
+	       a->colorspace == b->colorspace;
+}
+
+static struct video_scale_target *video_scale_target_get(
+		struct video_output *video,
+		const struct video_scale_info *conversion)
+{
+	struct video_scale_target *target;
+
+	for (size_t i = 0; i < video->scale_targets.num; i++) {
+		target = video->scale_targets.array[i];
+
+		if (scale_info_equal(&target->conversion, conversion)) {
+			target->refs++;
+			return target;
+		}
+	}
+
+	struct video_scale_info from = {
+		.format = video->info.format,
+		.width  = video->info.width,
+		.height = video->info.height,
+	};
+
+	target = bzalloc(sizeof(struct video_scale_target));
+	target->conversion = *conversion;
+	target->refs = 1;
+
+	int ret = video_scaler_create_sliced(&target->scaler,
+			conversion, &from, VIDEO_SCALE_FAST_BILINEAR,
+			os_threadpool_concurrency(video->scale_pool));
+	if (ret != VIDEO_SCALER_SUCCESS) {
+		if (ret == VIDEO_SCALER_BAD_CONVERSION)
+			blog(LOG_ERROR, "video_input_init: Bad "
+			                "scale conversion type");
+		else
+			blog(LOG_ERROR, "video_input_init: Failed to "
+			                "create scaler");
+
+		bfree(target);
+		return NULL;
+	}
+
+	target->slices = video_scaler_get_slices(target->scaler);
+
+	for (size_t i = 0; i < video->info.cache_size; i++)
+		video_frame_init(&target->frame[i],
+				conversion->format,
+				conversion->width,
+				conversion->height);
+
+	da_push_back(video->scale_targets, &target);
+	return target;
+}
+
 static inline bool video_input_init(struct video_input *input,
 		struct video_output *video)
 {
 	if (input->conversion.width  != video->info.width ||
 	    input->conversion.height != video->info.height ||
 	    input->conversion.format != video->info.format) {
-		struct video_scale_info from = {
-			.format = video->info.format,
-			.width  = video->info.width,
-			.height = video->info.height,
-		};
-
-		int ret = video_scaler_create(&input->scaler,
-				&input->conversion, &from,
-				VIDEO_SCALE_FAST_BILINEAR);
-		if (ret != VIDEO_SCALER_SUCCESS) {
-			if (ret == VIDEO_SCALER_BAD_CONVERSION)
-				blog(LOG_ERROR, "video_input_init: Bad "
-				                "scale conversion type");
-			else
-				blog(LOG_ERROR, "video_input_init: Failed to "
-				                "create scaler");
-
+		input->target = video_scale_target_get(video,
+				&input->conversion);
+		if (!input->target)
 			return false;
-		}
-
-		for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
-			video_frame_init(&input->frame[i],
-					input->conversion.format,
-					input->conversion.width,
-					input->conversion.height);
 	}
 
 	return true;
 }
 
-bool video_output_connect(video_t *video,
+static bool video_output_connect_internal(video_t *video,
 		const struct video_scale_info *conversion,
+		bool threaded, size_t queue_size,
 		void (*callback)(void *param, struct video_data *frame),
 		void *param)
 {
@@ -366,6 +824,12 @@ bool video_output_connect(video_t *video,
 			input.conversion.height = video->info.height;
 
 		success = video_input_init(&input, video);
+		if (success && threaded) {
+			success = video_input_thread_create(&input, video,
+					queue_size);
+			if (!success)
+				video_input_free(video, &input);
+		}
 		if (success)
 			da_push_back(video->inputs, &input);
 	}
@@ -375,10 +839,30 @@ bool video_output_connect(video_t *video,
 	return success;
 }
 
+bool video_output_connect(video_t *video,
+		const struct video_scale_info *conversion,
+		void (*callback)(void *param, struct video_data *frame),
+		void *param)
+{
+	return video_output_connect_internal(video, conversion, false, 0,
+			callback, param);
+}
+
+bool video_output_connect_threaded(video_t *video,
+		const struct video_scale_info *conversion, size_t queue_size,
+		void (*callback)(void *param, struct video_data *frame),
+		void *param)
+{
+	return video_output_connect_internal(video, conversion, true,
+			queue_size, callback, param);
+}
+
 void video_output_disconnect(video_t *video,
 		void (*callback)(void *param, struct video_data *frame),
 		void *param)
 {
+	struct video_input input = {0};
+
 	if (!video || !callback)
 		return;
 
@@ -386,8 +870,11 @@ void video_output_disconnect(video_t *video,
 
 	size_t idx = video_get_input_idx(video, callback, param);
 	if (idx != DARRAY_INVALID) {
-		video_input_free(video->inputs.array+idx);
+		input = video->inputs.array[idx];
 		da_erase(video->inputs, idx);
+
+		if (!input.thread)
+			video_input_free(video, &input);
 	}
 
 	if (video->inputs.num == 0) {
@@ -405,6 +892,70 @@ void video_output_disconnect(video_t *video,
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
+
+	/* input threads are stopped outside of the input mutex, as they may
+	 * be waiting on it from their own callback */
+	if (input.thread) {
+		video_input_thread_stop(input.thread);
+		input.thread = NULL;
+
+		pthread_mutex_lock(&video->input_mutex);
+		video_input_free(video, &input);
+		pthread_mutex_unlock(&video->input_mutex);
+	}
+}
+
+size_t video_output_get_input_queued_frames(video_t *video,
+		void (*callback)(void *param, struct video_data *frame),
+		void *param)
+{
+	size_t queued = 0;
+
+	if (!video || !callback)
+		return 0;
+
+	pthread_mutex_lock(&video->input_mutex);
+
+	size_t idx = video_get_input_idx(video, callback, param);
+	if (idx != DARRAY_INVALID && video->inputs.array[idx].thread) {
+		struct video_input_thread *thread =
+			video->inputs.array[idx].thread;
+
+		pthread_mutex_lock(&thread->mutex);
+		queued = thread->queue.size / sizeof(struct queued_frame);
+		pthread_mutex_unlock(&thread->mutex);
+	}
+
+	pthread_mutex_unlock(&video->input_mutex);
+
+	return queued;
+}
+
+uint64_t video_output_get_input_lag(video_t *video,
+		void (*callback)(void *param, struct video_data *frame),
+		void *param)
+{
+	uint64_t lag = 0;
+
+	if (!video || !callback)
+		return 0;
+
+	pthread_mutex_lock(&video->input_mutex);
+
+	size_t idx = video_get_input_idx(video, callback, param);
+	if (idx != DARRAY_INVALID && video->inputs.array[idx].thread) {
+		struct video_input_thread *thread =
+			video->inputs.array[idx].thread;
+
+		pthread_mutex_lock(&thread->mutex);
+		if (thread->last_timestamp > thread->cur_timestamp)
+			lag = thread->last_timestamp - thread->cur_timestamp;
+		pthread_mutex_unlock(&thread->mutex);
+	}
+
+	pthread_mutex_unlock(&video->input_mutex);
+
+	return lag;
 }
 
 bool video_output_active(const video_t *video)
@@ -429,8 +980,16 @@ bool video_output_lock_frame(video_t *video, struct video_frame *frame,
 	pthread_mutex_lock(&video->data_mutex);
 
 	if (video->available_frames == 0) {
-		video->cache[video->last_added].count += count;
-		video->cache[video->last_added].skipped += count;
+		cfi = &video->cache[video->last_added];
+
+		/* if the last frame has already been handed off to input
+		 * threads in its entirety, there is nothing to duplicate */
+		if (cfi->count == 0) {
+			video->skipped_frames += count;
+		} else {
+			cfi->count += count;
+			cfi->skipped += count;
+		}
 		locked = false;
 
 	} else {
@@ -443,6 +1002,7 @@ bool video_output_lock_frame(video_t *video, struct video_frame *frame,
 		cfi->frame.timestamp = timestamp;
 		cfi->count = count;
 		cfi->skipped = 0;
+		cfi->generation = ++video->generation;
 
 		memcpy(frame, &cfi->frame, sizeof(*frame));
 
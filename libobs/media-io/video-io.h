@@ -178,6 +178,30 @@ EXPORT void video_output_disconnect(video_t *video,
 		void (*callback)(void *param, struct video_data *frame),
 		void *param);
 
+/**
+ * Connects an input that is called back on its own thread rather
+ * than inline on the video thread.  Frames are queued by reference out of the
+ * frame cache; queue_size is the maximum number of queued frames (0 for the
+ * default), and is capped to the cache size minus one.
+ */
+EXPORT bool video_output_connect_threaded(video_t *video,
+		const struct video_scale_info *conversion, size_t queue_size,
+		void (*callback)(void *param, struct video_data *frame),
+		void *param);
+
+/** Returns the number of frames queued for a threaded input */
+EXPORT size_t video_output_get_input_queued_frames(video_t *video,
+		void (*callback)(void *param, struct video_data *frame),
+		void *param);
+
+/**
+ * Returns how far behind (in nanoseconds) a threaded input is from the most
+ * recently queued frame
+ */
+EXPORT uint64_t video_output_get_input_lag(video_t *video,
+		void (*callback)(void *param, struct video_data *frame),
+		void *param);
+
 EXPORT bool video_output_active(const video_t *video);
 
 EXPORT const struct video_output_info *video_output_get_info(
@@ -17,12 +17,38 @@
 
 #include "../util/bmem.h"
 #include "video-scaler.h"
+#include "video-frame.h"
 
 #include <libswscale/swscale.h>
 
-struct video_scaler {
+#define MAX_SCALE_SLICES 8
+#define MIN_SLICE_HEIGHT 64
+
+struct video_scaler_slice {
 	struct SwsContext *swscale;
+
+	/* rows actually scaled, including the overlap with neighboring
+	 * slices */
+	int src_y;
 	int src_height;
+	int scaled_dst_y;
+
+	/* rows of the output this slice is responsible for */
+	int dst_y;
+	int dst_height;
+
+	/* the scaled rows go here first when there's any overlap, so that
+	 * only this slice's own rows are copied to the output */
+	struct video_frame overlap_frame;
+	bool has_overlap;
+};
+
+struct video_scaler {
+	struct video_scaler_slice slices[MAX_SCALE_SLICES];
+	size_t num_slices;
+
+	enum video_format src_format;
+	enum video_format dst_format;
 };
 
 static inline enum AVPixelFormat get_ffmpeg_video_format(
@@ -80,12 +106,141 @@ static inline int get_ffmpeg_range_type(enum video_range_type type)
 	return 0;
 }
 
+static inline bool format_is_420(enum video_format format)
+{
+	return format == VIDEO_FORMAT_I420 || format == VIDEO_FORMAT_NV12;
+}
+
+static inline int get_plane_vshift(enum video_format format, size_t plane)
+{
+	return (plane != 0 && format_is_420(format)) ? 1 : 0;
+}
+
+static int gcd(int a, int b)
+{
+	while (b) {
+		int t = a % b;
+		a = b;
+		b = t;
+	}
+
+	return a;
+}
+
+/*
+ * Splits the destination into horizontal bands that each map to a whole
+ * number of source rows, so every slice samples from exactly the same
+ * positions as a single full-frame scale would.  step is the number of
+ * destination rows in each of those units.
+ */
+static size_t calc_slices(const struct video_scale_info *dst,
+		const struct video_scale_info *src, size_t max_slices,
+		int dst_ys[MAX_SCALE_SLICES + 1], int *unit_step)
+{
+	int src_h = (int)src->height;
+	int dst_h = (int)dst->height;
+	int g = gcd(src_h, dst_h);
+	int step = dst_h / g;
+	int src_step = src_h / g;
+	size_t units;
+	size_t count;
+
+	/* chroma rows must line up with the slice boundaries as well */
+	if ((format_is_420(src->format) || format_is_420(dst->format)) &&
+	    ((step & 1) || (src_step & 1)))
+		step *= 2;
+
+	units = (size_t)(dst_h / step);
+	count = max_slices;
+	if (count > MAX_SCALE_SLICES)
+		count = MAX_SCALE_SLICES;
+	if (count > units)
+		count = units;
+	if (count > (size_t)(dst_h / MIN_SLICE_HEIGHT))
+		count = (size_t)(dst_h / MIN_SLICE_HEIGHT);
+	if (count < 2)
+		count = 1;
+
+	for (size_t i = 0; i < count; i++)
+		dst_ys[i] = (int)(units * i / count) * step;
+	dst_ys[count] = dst_h;
+
+	*unit_step = step;
+	return count;
+}
+
+/*
+ * Number of source rows on either side of a slice that the vertical filter
+ * can reach.  Bicubic, the widest filter used, spans 4 source rows when
+ * upscaling and 4 output rows worth of source when downscaling, and 4:2:0
+ * chroma rows cover two luma rows each.
+ */
+static int calc_filter_rows(const struct video_scale_info *dst,
+		const struct video_scale_info *src)
+{
+	int ratio = (int)((src->height + dst->height - 1) / dst->height);
+	int rows = 2 * ratio + 2;
+
+	if (format_is_420(src->format) || format_is_420(dst->format))
+		rows *= 2;
+
+	return rows;
+}
+
+/*
+ * Each slice scales its own rows plus enough whole units of its neighbors'
+ * rows to cover the filter, and then only keeps its own rows.  Clamping the
+ * filter at the slice edge instead would leave visible seams.  Returns the
+ * number of destination rows the slice scales.
+ */
+static int init_slice(struct video_scaler_slice *slice,
+		const struct video_scale_info *dst,
+		const struct video_scale_info *src,
+		int dst_y, int dst_end, int step)
+{
+	int dst_h = (int)dst->height;
+	int src_step = (int)((int64_t)step * src->height / dst->height);
+	int pad_units = (calc_filter_rows(dst, src) + src_step - 1) / src_step;
+	int pad = pad_units * step;
+	int scaled_end = dst_end + pad;
+	int src_end;
+
+	slice->dst_y = dst_y;
+	slice->dst_height = dst_end - dst_y;
+	slice->scaled_dst_y = dst_y > pad ? dst_y - pad : 0;
+	if (scaled_end > dst_h)
+		scaled_end = dst_h;
+
+	slice->src_y = (int)((int64_t)slice->scaled_dst_y * src->height /
+			dst->height);
+	src_end = (int)((int64_t)scaled_end * src->height / dst->height);
+	slice->src_height = src_end - slice->src_y;
+
+	slice->has_overlap = slice->scaled_dst_y != dst_y ||
+		scaled_end != dst_end;
+	if (slice->has_overlap) {
+		int height = scaled_end - slice->scaled_dst_y;
+		video_frame_init(&slice->overlap_frame, dst->format,
+				dst->width, (uint32_t)(height + 1) & ~1);
+	}
+
+	return scaled_end - slice->scaled_dst_y;
+}
+
 #define FIXED_1_0 (1<<16)
 
 int video_scaler_create(video_scaler_t **scaler_out,
 		const struct video_scale_info *dst,
 		const struct video_scale_info *src,
 		enum video_scale_type type)
+{
+	return video_scaler_create_sliced(scaler_out, dst, src, type, 1);
+}
+
+int video_scaler_create_sliced(video_scaler_t **scaler_out,
+		const struct video_scale_info *dst,
+		const struct video_scale_info *src,
+		enum video_scale_type type, size_t max_slices)
 {
 	enum AVPixelFormat format_src = get_ffmpeg_video_format(src->format);
 	enum AVPixelFormat format_dst = get_ffmpeg_video_format(dst->format);
@@ -95,6 +250,8 @@ int video_scaler_create(video_scaler_t **scaler_out,
 	int                range_src  = get_ffmpeg_range_type(src->range);
 	int                range_dst  = get_ffmpeg_range_type(dst->range);
 	struct video_scaler *scaler;
+	int dst_ys[MAX_SCALE_SLICES + 1];
+	int step;
 	int ret;
 
 	if (!scaler_out)
@@ -105,25 +262,34 @@ int video_scaler_create(video_scaler_t **scaler_out,
 		return VIDEO_SCALER_BAD_CONVERSION;
 
 	scaler = bzalloc(sizeof(struct video_scaler));
-	scaler->src_height = src->height;
-
-	scaler->swscale = sws_getCachedContext(NULL,
-			src->width, src->height, format_src,
-			dst->width, dst->height, format_dst,
-			scale_type, NULL, NULL, NULL);
-	if (!scaler->swscale) {
-		blog(LOG_ERROR, "video_scaler_create: Could not create "
-		                "swscale");
-		goto fail;
-	}
+	scaler->src_format = src->format;
+	scaler->dst_format = dst->format;
+	scaler->num_slices = calc_slices(dst, src, max_slices, dst_ys, &step);
+
+	for (size_t i = 0; i < scaler->num_slices; i++) {
+		struct video_scaler_slice *slice = &scaler->slices[i];
+		int dst_height = init_slice(slice, dst, src,
+				dst_ys[i], dst_ys[i + 1], step);
 
-	ret = sws_setColorspaceDetails(scaler->swscale,
-			coeff_src, range_src,
-			coeff_dst, range_dst,
-			0, FIXED_1_0, FIXED_1_0);
-	if (ret < 0) {
-		blog(LOG_DEBUG, "video_scaler_create: "
-		                "sws_setColorspaceDetails failed, ignoring");
+		slice->swscale = sws_getCachedContext(NULL,
+				src->width, slice->src_height, format_src,
+				dst->width, dst_height, format_dst,
+				scale_type, NULL, NULL, NULL);
+		if (!slice->swscale) {
+			blog(LOG_ERROR, "video_scaler_create: Could not create "
+			                "swscale");
+			goto fail;
+		}
+
+		ret = sws_setColorspaceDetails(slice->swscale,
+				coeff_src, range_src,
+				coeff_dst, range_dst,
+				0, FIXED_1_0, FIXED_1_0);
+		if (ret < 0) {
+			blog(LOG_DEBUG, "video_scaler_create: "
+			                "sws_setColorspaceDetails failed, "
+			                "ignoring");
+		}
 	}
 
 	*scaler_out = scaler;
@@ -137,27 +303,104 @@ fail:
 void video_scaler_destroy(video_scaler_t *scaler)
 {
 	if (scaler) {
-		sws_freeContext(scaler->swscale);
+		for (size_t i = 0; i < MAX_SCALE_SLICES; i++) {
+			sws_freeContext(scaler->slices[i].swscale);
+			video_frame_free(&scaler->slices[i].overlap_frame);
+		}
 		bfree(scaler);
 	}
 }
 
-bool video_scaler_scale(video_scaler_t *scaler,
+/* copies the rows that belong to the slice out of its overlap frame */
+static void copy_slice_rows(const video_scaler_t *scaler,
+		const struct video_scaler_slice *slice,
+		uint8_t *out[], const uint32_t out_linesize[])
+{
+	const struct video_frame *frame = &slice->overlap_frame;
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		int shift = get_plane_vshift(scaler->dst_format, i);
+		int round = (1 << shift) - 1;
+		int start = (slice->dst_y - slice->scaled_dst_y) >> shift;
+		int rows = (slice->dst_height + round) >> shift;
+		uint32_t row_size = frame->linesize[i];
+		const uint8_t *in;
+
+		if (!out[i] || !frame->data[i])
+			continue;
+
+		if (row_size > out_linesize[i])
+			row_size = out_linesize[i];
+
+		in = frame->data[i] + (size_t)start * frame->linesize[i];
+		for (int y = 0; y < rows; y++)
+			memcpy(out[i] + (size_t)y * out_linesize[i],
+					in + (size_t)y * frame->linesize[i],
+					row_size);
+	}
+}
+
+size_t video_scaler_get_slices(const video_scaler_t *scaler)
+{
+	return scaler ? scaler->num_slices : 0;
+}
+
+bool video_scaler_scale_slice(video_scaler_t *scaler, size_t idx,
 		uint8_t *output[], const uint32_t out_linesize[],
 		const uint8_t *const input[], const uint32_t in_linesize[])
 {
-	if (!scaler)
+	struct video_scaler_slice *slice;
+	const uint8_t *in[MAX_AV_PLANES];
+	uint8_t *out[MAX_AV_PLANES];
+
+	if (!scaler || idx >= scaler->num_slices)
 		return false;
 
-	int ret = sws_scale(scaler->swscale,
-			input, (const int *)in_linesize,
-			0, scaler->src_height,
-			output, (const int *)out_linesize);
+	slice = &scaler->slices[idx];
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		int src_y = slice->src_y >>
+			get_plane_vshift(scaler->src_format, i);
+		int dst_y = slice->dst_y >>
+			get_plane_vshift(scaler->dst_format, i);
+
+		in[i]  = input[i] ?
+			input[i] + (size_t)src_y * in_linesize[i] : NULL;
+		out[i] = output[i] ?
+			output[i] + (size_t)dst_y * out_linesize[i] : NULL;
+	}
+
+	int ret = sws_scale(slice->swscale,
+			in, (const int *)in_linesize,
+			0, slice->src_height,
+			slice->has_overlap ? slice->overlap_frame.data : out,
+			slice->has_overlap ?
+				(const int *)slice->overlap_frame.linesize :
+				(const int *)out_linesize);
 	if (ret <= 0) {
 		blog(LOG_ERROR, "video_scaler_scale: sws_scale failed: %d",
 				ret);
 		return false;
 	}
 
+	if (slice->has_overlap)
+		copy_slice_rows(scaler, slice, out, out_linesize);
+
+	return true;
+}
+
+bool video_scaler_scale(video_scaler_t *scaler,
+		uint8_t *output[], const uint32_t out_linesize[],
+		const uint8_t *const input[], const uint32_t in_linesize[])
+{
+	if (!scaler)
+		return false;
+
+	for (size_t i = 0; i < scaler->num_slices; i++) {
+		if (!video_scaler_scale_slice(scaler, i, output, out_linesize,
+					input, in_linesize))
+			return false;
+	}
+
 	return true;
 }
@@ -35,11 +35,26 @@ EXPORT int video_scaler_create(video_scaler_t **scaler,
 		const struct video_scale_info *dst,
 		const struct video_scale_info *src,
 		enum video_scale_type type);
+
+/**
+ * Creates a scaler that can be run as up to max_slices independent
+ * horizontal slices, which may be scaled in parallel on different threads
+ * with video_scaler_scale_slice.
+ */
+EXPORT int video_scaler_create_sliced(video_scaler_t **scaler,
+		const struct video_scale_info *dst,
+		const struct video_scale_info *src,
+		enum video_scale_type type, size_t max_slices);
 EXPORT void video_scaler_destroy(video_scaler_t *scaler);
 
+EXPORT size_t video_scaler_get_slices(const video_scaler_t *scaler);
+
 EXPORT bool video_scaler_scale(video_scaler_t *scaler,
 		uint8_t *output[], const uint32_t out_linesize[],
 		const uint8_t *const input[], const uint32_t in_linesize[]);
+EXPORT bool video_scaler_scale_slice(video_scaler_t *scaler, size_t slice,
+		uint8_t *output[], const uint32_t out_linesize[],
+		const uint8_t *const input[], const uint32_t in_linesize[]);
 
 #ifdef __cplusplus
 }
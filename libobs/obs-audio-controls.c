@@ -20,6 +20,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "util/threading.h"
 #include "util/bmem.h"
 #include "media-io/audio-math.h"
+#include "media-io/audio-meter.h"
 #include "obs.h"
 #include "obs-internal.h"
 
@@ -59,16 +60,38 @@ struct meter_cb {
 	void                   *param;
 };
 
+struct loudness_cb {
+	obs_volmeter_loudness_t callback;
+	void                    *param;
+};
+
+/*
+ * A meter feed measures the audio of one source or mix once for all the
+ * volume meters attached to it.  Feeds are kept in obs->audio.meter_feeds
+ * and are reference counted by the attached volume meters.
+ */
+struct obs_meter_feed {
+	long                   refs;
+	obs_source_t           *source;
+	size_t                 mix_idx;
+
+	pthread_mutex_t        mutex;
+	audio_meter_t          *meter;
+	DARRAY(struct obs_volmeter*) volmeters;
+};
+
 struct obs_volmeter {
 	pthread_mutex_t        mutex;
 	obs_fader_conversion_t pos_to_db;
 	obs_fader_conversion_t db_to_pos;
 	obs_source_t           *source;
+	struct obs_meter_feed  *feed;
 	enum obs_fader_type    type;
 	float                  cur_db;
 
 	pthread_mutex_t        callback_mutex;
 	DARRAY(struct meter_cb)callbacks;
+	DARRAY(struct loudness_cb)loudness_callbacks;
 
 	unsigned int           channels;
 	unsigned int           update_ms;
@@ -80,10 +103,12 @@ struct obs_volmeter {
 	unsigned int           ival_frames;
 	float                  ival_sum;
 	float                  ival_max;
+	float                  ival_true_peak;
 
 	float                  vol_peak;
 	float                  vol_mag;
 	float                  vol_max;
+	float                  true_peak_max;
 };
 
 static float cubic_def_to_db(const float def)
@@ -216,6 +241,20 @@ static void signal_levels_updated(struct obs_volmeter *volmeter,
 	pthread_mutex_unlock(&volmeter->callback_mutex);
 }
 
+static void signal_loudness_updated(struct obs_volmeter *volmeter,
+		const struct obs_volmeter_loudness *loudness)
+{
+	pthread_mutex_lock(&volmeter->callback_mutex);
+	for (size_t i = volmeter->loudness_callbacks.num; i > 0; i--) {
+		struct loudness_cb cb =
+			volmeter->loudness_callbacks.array[i - 1];
+		cb.callback(cb.param, loudness);
+	}
+	pthread_mutex_unlock(&volmeter->callback_mutex);
+}
+
+static calldata_key_t volume_key = CALLDATA_KEY("volume");
+
 static void fader_source_volume_changed(void *vptr, calldata_t *calldata)
 {
 	struct obs_fader *fader = (struct obs_fader *) vptr;
@@ -228,7 +267,7 @@ static void fader_source_volume_changed(void *vptr, calldata_t *calldata)
 		return;
 	}
 
-	const float mul      = (float)calldata_float(calldata, "volume");
+	const float mul      = (float)calldata_float_key(calldata, &volume_key);
 	const float db       = mul_to_db(mul);
 	fader->cur_db        = db;
 
@@ -243,7 +282,7 @@ static void volmeter_source_volume_changed(void *vptr, calldata_t *calldata)
 
 	pthread_mutex_lock(&volmeter->mutex);
 
-	float mul = (float) calldata_float(calldata, "volume");
+	float mul = (float) calldata_float_key(calldata, &volume_key);
 	volmeter->cur_db = mul_to_db(mul);
 
 	pthread_mutex_unlock(&volmeter->mutex);
@@ -265,28 +304,6 @@ static void volmeter_source_destroyed(void *vptr, calldata_t *calldata)
 	obs_volmeter_detach_source(volmeter);
 }
 
-/* TODO: Separate for individual channels */
-static void volmeter_sum_and_max(float *data[MAX_AV_PLANES], size_t frames,
-		float *sum, float *max)
-{
-	float s  = *sum;
-	float m  = *max;
-
-	for (size_t plane = 0; plane < MAX_AV_PLANES; plane++) {
-		if (!data[plane])
-			break;
-
-		for (float *c = data[plane]; c < data[plane] + frames; ++c) {
-			const float pow = *c * *c;
-			s += pow;
-			m  = (m > pow) ? m : pow;
-		}
-	}
-
-	*sum = s;
-	*max = m;
-}
-
 /**
  * @todo The IIR low pass filter has a different behavior depending on the
  *       update interval and sample rate, it should be replaced with something
@@ -318,77 +335,230 @@ static void volmeter_calc_ival_levels(obs_volmeter_t *volmeter)
 			volmeter->vol_mag * (1.0f - alpha);
 
 	/* reset interval data */
-	volmeter->ival_frames = 0;
-	volmeter->ival_sum    = 0.0f;
-	volmeter->ival_max    = 0.0f;
+	volmeter->ival_frames    = 0;
+	volmeter->ival_sum       = 0.0f;
+	volmeter->ival_max       = 0.0f;
+	volmeter->ival_true_peak = 0.0f;
+}
+
+/* levels are measured per block of audio by the feed, so an interval ends
+ * with the first block that completes it */
+static bool volmeter_process_levels(obs_volmeter_t *volmeter,
+		const struct audio_meter_levels *levels)
+{
+	for (size_t i = 0; i < levels->channels; i++) {
+		const float pow = levels->peak[i] * levels->peak[i];
+
+		volmeter->ival_sum += levels->sum_squares[i];
+		if (pow > volmeter->ival_max)
+			volmeter->ival_max = pow;
+		if (levels->true_peak[i] > volmeter->ival_true_peak)
+			volmeter->ival_true_peak = levels->true_peak[i];
+	}
+
+	volmeter->ival_frames += (unsigned int)levels->frames;
+	return volmeter->ival_frames >= volmeter->update_frames;
+}
+
+static void volmeter_update(obs_volmeter_t *volmeter,
+		const struct audio_meter_levels *levels, bool muted)
+{
+	struct obs_volmeter_loudness loudness;
+	bool updated = false;
+	float mul, level, mag, peak, true_peak;
+
+	pthread_mutex_lock(&volmeter->mutex);
+
+	updated = volmeter_process_levels(volmeter, levels);
+
+	if (updated) {
+		mul       = db_to_mul(volmeter->cur_db);
+		true_peak = volmeter->ival_true_peak * mul;
+
+		if (true_peak > volmeter->true_peak_max)
+			volmeter->true_peak_max = true_peak;
+
+		volmeter_calc_ival_levels(volmeter);
+
+		level = volmeter->db_to_pos(mul_to_db(volmeter->vol_max * mul));
+		mag   = volmeter->db_to_pos(mul_to_db(volmeter->vol_mag * mul));
+		peak  = volmeter->db_to_pos(
+				mul_to_db(volmeter->vol_peak * mul));
+
+		loudness.momentary     = levels->momentary;
+		loudness.short_term    = levels->short_term;
+		loudness.integrated    = levels->integrated;
+		loudness.true_peak     = mul_to_db(true_peak);
+		loudness.true_peak_max = mul_to_db(volmeter->true_peak_max);
+	}
+
+	pthread_mutex_unlock(&volmeter->mutex);
+
+	if (updated) {
+		signal_levels_updated(volmeter, level, mag, peak, muted);
+		signal_loudness_updated(volmeter, &loudness);
+	}
 }
 
-static bool volmeter_process_audio_data(obs_volmeter_t *volmeter,
-		const struct audio_data *data)
+/* ------------------------------------------------------------------------- */
+
+static void meter_feed_process(struct obs_meter_feed *feed,
+		const struct audio_data *data, float gain, bool muted)
 {
-	bool updated   = false;
-	size_t frames  = 0;
-	size_t left    = data->frames;
-	float *adata[MAX_AV_PLANES];
+	struct audio_meter_levels levels;
+	float *planes[MAX_AV_PLANES];
 
 	for (size_t i = 0; i < MAX_AV_PLANES; i++)
-		adata[i] = (float*)data->data[i];
+		planes[i] = (float*)data->data[i];
 
-	while (left) {
-		frames  = (volmeter->ival_frames + left >
-				volmeter->update_frames)
-			? volmeter->update_frames - volmeter->ival_frames
-			: left;
+	pthread_mutex_lock(&feed->mutex);
 
-		volmeter_sum_and_max(adata, frames, &volmeter->ival_sum,
-				&volmeter->ival_max);
+	audio_meter_process(feed->meter, planes, data->frames, gain, &levels);
 
-		volmeter->ival_frames += (unsigned int)frames;
-		left                  -= frames;
+	for (size_t i = 0; i < feed->volmeters.num; i++)
+		volmeter_update(feed->volmeters.array[i], &levels, muted);
 
-		for (size_t i = 0; i < MAX_AV_PLANES; i++) {
-			if (!adata[i])
-				break;
-			adata[i] += frames;
+	pthread_mutex_unlock(&feed->mutex);
+}
+
+/* source loudness is measured as the source is mixed, after its volume and
+ * muting are applied */
+static void meter_feed_source_data(void *vptr, obs_source_t *source,
+		const struct audio_data *data, bool muted)
+{
+	struct obs_meter_feed *feed = vptr;
+	float gain = muted ? 0.0f : obs_source_get_volume(source);
+
+	meter_feed_process(feed, data, gain, muted);
+}
+
+static void meter_feed_mix_data(void *vptr, size_t mix_idx,
+		struct audio_data *data)
+{
+	struct obs_meter_feed *feed = vptr;
+
+	meter_feed_process(feed, data, 1.0f, false);
+
+	UNUSED_PARAMETER(mix_idx);
+}
+
+static struct obs_meter_feed *meter_feed_create(obs_source_t *source,
+		size_t mix_idx)
+{
+	audio_t *audio = obs->audio.audio;
+	const struct audio_output_info *aoi = audio_output_get_info(audio);
+	struct obs_meter_feed *feed = bzalloc(sizeof(struct obs_meter_feed));
+
+	feed->refs    = 1;
+	feed->source  = source;
+	feed->mix_idx = mix_idx;
+	feed->meter   = audio_meter_create(aoi->samples_per_sec,
+			aoi->speakers);
+
+	pthread_mutex_init_value(&feed->mutex);
+	if (pthread_mutex_init(&feed->mutex, NULL) != 0)
+		goto fail;
+
+	if (source) {
+		obs_source_add_audio_capture_callback(source,
+				meter_feed_source_data, feed);
+	} else {
+		struct audio_convert_info conv = {
+			aoi->samples_per_sec,
+			AUDIO_FORMAT_FLOAT_PLANAR,
+			aoi->speakers
+		};
+
+		if (!audio_output_connect(audio, mix_idx, &conv,
+					meter_feed_mix_data, feed)) {
+			pthread_mutex_destroy(&feed->mutex);
+			goto fail;
 		}
+	}
+
+	return feed;
+
+fail:
+	audio_meter_destroy(feed->meter);
+	bfree(feed);
+	return NULL;
+}
 
-		/* break if we did not reach the end of the interval */
-		if (volmeter->ival_frames != volmeter->update_frames)
+static struct obs_meter_feed *meter_feed_get(obs_source_t *source,
+		size_t mix_idx)
+{
+	struct obs_core_audio *audio = &obs->audio;
+	struct obs_meter_feed *feed = NULL;
+
+	pthread_mutex_lock(&audio->meter_mutex);
+
+	for (size_t i = 0; i < audio->meter_feeds.num; i++) {
+		struct obs_meter_feed *cur = audio->meter_feeds.array[i];
+
+		if (cur->source == source &&
+		    (source || cur->mix_idx == mix_idx)) {
+			feed = cur;
+			feed->refs++;
 			break;
+		}
+	}
 
-		volmeter_calc_ival_levels(volmeter);
-		updated = true;
+	if (!feed) {
+		feed = meter_feed_create(source, mix_idx);
+		if (feed)
+			da_push_back(audio->meter_feeds, &feed);
 	}
 
-	return updated;
+	pthread_mutex_unlock(&audio->meter_mutex);
+	return feed;
 }
 
-static void volmeter_source_data_received(void *vptr, obs_source_t *source,
-		const struct audio_data *data, bool muted)
+static void meter_feed_release(struct obs_meter_feed *feed)
 {
-	struct obs_volmeter *volmeter = (struct obs_volmeter *) vptr;
-	bool updated = false;
-	float mul, level, mag, peak;
+	struct obs_core_audio *audio = &obs->audio;
+	bool destroy = false;
 
-	pthread_mutex_lock(&volmeter->mutex);
+	pthread_mutex_lock(&audio->meter_mutex);
 
-	updated = volmeter_process_audio_data(volmeter, data);
+	if (--feed->refs == 0) {
+		da_erase_item(audio->meter_feeds, &feed);
 
-	if (updated) {
-		mul   = db_to_mul(volmeter->cur_db);
+		if (feed->source)
+			obs_source_remove_audio_capture_callback(feed->source,
+					meter_feed_source_data, feed);
+		else
+			audio_output_disconnect(audio->audio, feed->mix_idx,
+					meter_feed_mix_data, feed);
 
-		level = volmeter->db_to_pos(mul_to_db(volmeter->vol_max * mul));
-		mag   = volmeter->db_to_pos(mul_to_db(volmeter->vol_mag * mul));
-		peak  = volmeter->db_to_pos(
-				mul_to_db(volmeter->vol_peak * mul));
+		destroy = true;
 	}
 
-	pthread_mutex_unlock(&volmeter->mutex);
+	pthread_mutex_unlock(&audio->meter_mutex);
 
-	if (updated)
-		signal_levels_updated(volmeter, level, mag, peak, muted);
+	if (destroy) {
+		audio_meter_destroy(feed->meter);
+		da_free(feed->volmeters);
+		pthread_mutex_destroy(&feed->mutex);
+		bfree(feed);
+	}
+}
 
-	UNUSED_PARAMETER(source);
+static void meter_feed_add_volmeter(struct obs_meter_feed *feed,
+		obs_volmeter_t *volmeter)
+{
+	pthread_mutex_lock(&feed->mutex);
+	da_push_back(feed->volmeters, &volmeter);
+	pthread_mutex_unlock(&feed->mutex);
+}
+
+static void meter_feed_remove_volmeter(struct obs_meter_feed *feed,
+		obs_volmeter_t *volmeter)
+{
+	pthread_mutex_lock(&feed->mutex);
+	da_erase_item(feed->volmeters, &volmeter);
+	pthread_mutex_unlock(&feed->mutex);
+
+	meter_feed_release(feed);
 }
 
 static void volmeter_update_audio_settings(obs_volmeter_t *volmeter)
@@ -670,43 +840,77 @@ void obs_volmeter_destroy(obs_volmeter_t *volmeter)
 
 	obs_volmeter_detach_source(volmeter);
 	da_free(volmeter->callbacks);
+	da_free(volmeter->loudness_callbacks);
 	pthread_mutex_destroy(&volmeter->callback_mutex);
 	pthread_mutex_destroy(&volmeter->mutex);
 
 	bfree(volmeter);
 }
 
+static void volmeter_set_feed(obs_volmeter_t *volmeter,
+		obs_source_t *source, struct obs_meter_feed *feed, float vol)
+{
+	pthread_mutex_lock(&volmeter->mutex);
+
+	volmeter->source         = source;
+	volmeter->feed           = feed;
+	volmeter->cur_db         = mul_to_db(vol);
+	volmeter->ival_frames    = 0;
+	volmeter->ival_sum       = 0.0f;
+	volmeter->ival_max       = 0.0f;
+	volmeter->ival_true_peak = 0.0f;
+	volmeter->true_peak_max  = 0.0f;
+
+	pthread_mutex_unlock(&volmeter->mutex);
+
+	meter_feed_add_volmeter(feed, volmeter);
+}
+
 bool obs_volmeter_attach_source(obs_volmeter_t *volmeter, obs_source_t *source)
 {
+	struct obs_meter_feed *feed;
 	signal_handler_t *sh;
-	float vol;
 
 	if (!volmeter || !source)
 		return false;
 
 	obs_volmeter_detach_source(volmeter);
 
+	feed = meter_feed_get(source, 0);
+	if (!feed)
+		return false;
+
 	sh = obs_source_get_signal_handler(source);
 	signal_handler_connect(sh, "volume",
 			volmeter_source_volume_changed, volmeter);
 	signal_handler_connect(sh, "destroy",
 			volmeter_source_destroyed, volmeter);
-	obs_source_add_audio_capture_callback(source,
-			volmeter_source_data_received, volmeter);
-	vol = obs_source_get_volume(source);
 
-	pthread_mutex_lock(&volmeter->mutex);
+	volmeter_set_feed(volmeter, source, feed,
+			obs_source_get_volume(source));
+	return true;
+}
 
-	volmeter->source = source;
-	volmeter->cur_db = mul_to_db(vol);
+bool obs_volmeter_attach_mix(obs_volmeter_t *volmeter, size_t mix_idx)
+{
+	struct obs_meter_feed *feed;
 
-	pthread_mutex_unlock(&volmeter->mutex);
+	if (!volmeter || mix_idx >= MAX_AUDIO_MIXES)
+		return false;
+
+	obs_volmeter_detach_source(volmeter);
+
+	feed = meter_feed_get(NULL, mix_idx);
+	if (!feed)
+		return false;
 
+	volmeter_set_feed(volmeter, NULL, feed, 1.0f);
 	return true;
 }
 
 void obs_volmeter_detach_source(obs_volmeter_t *volmeter)
 {
+	struct obs_meter_feed *feed;
 	signal_handler_t *sh;
 	obs_source_t *source;
 
@@ -715,9 +919,14 @@ void obs_volmeter_detach_source(obs_volmeter_t *volmeter)
 
 	pthread_mutex_lock(&volmeter->mutex);
 	source = volmeter->source;
+	feed   = volmeter->feed;
 	volmeter->source = NULL;
+	volmeter->feed   = NULL;
 	pthread_mutex_unlock(&volmeter->mutex);
 
+	if (feed)
+		meter_feed_remove_volmeter(feed, volmeter);
+
 	if (!source)
 		return;
 
@@ -726,8 +935,31 @@ void obs_volmeter_detach_source(obs_volmeter_t *volmeter)
 			volmeter_source_volume_changed, volmeter);
 	signal_handler_disconnect(sh, "destroy",
 			volmeter_source_destroyed, volmeter);
-	obs_source_remove_audio_capture_callback(source,
-			volmeter_source_data_received, volmeter);
+}
+
+void obs_volmeter_reset_loudness(obs_volmeter_t *volmeter)
+{
+	struct obs_meter_feed *feed;
+
+	if (!volmeter)
+		return;
+
+	/* the meter mutex keeps the feed from being destroyed by a detach
+	 * on another thread */
+	pthread_mutex_lock(&obs->audio.meter_mutex);
+
+	pthread_mutex_lock(&volmeter->mutex);
+	feed = volmeter->feed;
+	volmeter->true_peak_max = 0.0f;
+	pthread_mutex_unlock(&volmeter->mutex);
+
+	if (feed) {
+		pthread_mutex_lock(&feed->mutex);
+		audio_meter_reset(feed->meter);
+		pthread_mutex_unlock(&feed->mutex);
+	}
+
+	pthread_mutex_unlock(&obs->audio.meter_mutex);
 }
 
 void obs_volmeter_set_update_interval(obs_volmeter_t *volmeter,
@@ -805,6 +1037,32 @@ void obs_volmeter_remove_callback(obs_volmeter_t *volmeter,
 	pthread_mutex_unlock(&volmeter->callback_mutex);
 }
 
+void obs_volmeter_add_loudness_callback(obs_volmeter_t *volmeter,
+		obs_volmeter_loudness_t callback, void *param)
+{
+	struct loudness_cb cb = {callback, param};
+
+	if (!obs_ptr_valid(volmeter, "obs_volmeter_add_loudness_callback"))
+		return;
+
+	pthread_mutex_lock(&volmeter->callback_mutex);
+	da_push_back(volmeter->loudness_callbacks, &cb);
+	pthread_mutex_unlock(&volmeter->callback_mutex);
+}
+
+void obs_volmeter_remove_loudness_callback(obs_volmeter_t *volmeter,
+		obs_volmeter_loudness_t callback, void *param)
+{
+	struct loudness_cb cb = {callback, param};
+
+	if (!obs_ptr_valid(volmeter, "obs_volmeter_remove_loudness_callback"))
+		return;
+
+	pthread_mutex_lock(&volmeter->callback_mutex);
+	da_erase_item(volmeter->loudness_callbacks, &cb);
+	pthread_mutex_unlock(&volmeter->callback_mutex);
+}
+
 float obs_volmeter_get_cur_db(enum obs_fader_type type, const float def)
 {
 	float db;
@@ -195,7 +195,18 @@ EXPORT bool obs_volmeter_attach_source(obs_volmeter_t *volmeter,
 		obs_source_t *source);
 
 /**
- * @brief Detach the volume meter from the currently attached source
+ * @brief Attach the volume meter to an audio mix
+ * @param volmeter pointer to the volume meter object
+ * @param mix_idx index of the mix (track)
+ * @return true on success
+ *
+ * Meters the final output of a mix, such as the program mix, instead of a
+ * single source.
+ */
+EXPORT bool obs_volmeter_attach_mix(obs_volmeter_t *volmeter, size_t mix_idx);
+
+/**
+ * @brief Detach the volume meter from the currently attached source or mix
  * @param volmeter pointer to the volume meter object
  */
 EXPORT void obs_volmeter_detach_source(obs_volmeter_t *volmeter);
@@ -251,6 +262,45 @@ EXPORT void obs_volmeter_add_callback(obs_volmeter_t *volmeter,
 EXPORT void obs_volmeter_remove_callback(obs_volmeter_t *volmeter,
 		obs_volmeter_updated_t callback, void *param);
 
+/**
+ * Loudness measured by a volume meter (ITU-R BS.1770 / EBU R128).  Loudness
+ * is in LUFS and true peak in dBTP, and values are -INFINITY until enough
+ * audio has been measured.
+ *
+ * The audio of a source or mix is only measured once no matter how many
+ * volume meters are attached to it, so all meters attached to the same
+ * source or mix share the same loudness measurement.
+ */
+struct obs_volmeter_loudness {
+	float momentary;     /**< 400 ms window */
+	float short_term;    /**< 3 s window */
+	float integrated;    /**< gated, since attaching or the last reset */
+	float true_peak;     /**< 4x oversampled peak of the update interval */
+	float true_peak_max; /**< highest true peak since the last reset */
+};
+
+typedef void (*obs_volmeter_loudness_t)(void *param,
+		const struct obs_volmeter_loudness *loudness);
+
+/**
+ * Loudness callbacks are called at the same update interval as the level
+ * callbacks.  Source loudness is measured after the source's volume and
+ * muting are applied.
+ */
+EXPORT void obs_volmeter_add_loudness_callback(obs_volmeter_t *volmeter,
+		obs_volmeter_loudness_t callback, void *param);
+EXPORT void obs_volmeter_remove_loudness_callback(obs_volmeter_t *volmeter,
+		obs_volmeter_loudness_t callback, void *param);
+
+/**
+ * @brief Restart the loudness measurement of the attached source or mix
+ * @param volmeter pointer to the volume meter object
+ *
+ * This also resets integrated loudness for other volume meters attached to
+ * the same source or mix.
+ */
+EXPORT void obs_volmeter_reset_loudness(obs_volmeter_t *volmeter);
+
 EXPORT float obs_volmeter_get_cur_db(enum obs_fader_type type, const float def);
 
 #ifdef __cplusplus
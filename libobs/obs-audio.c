@@ -24,7 +24,6 @@ struct ts_info {
 };
 
 #define DEBUG_AUDIO 0
-#define MAX_BUFFERING_TICKS 45
 
 static void push_audio_tree(obs_source_t *parent, obs_source_t *source, void *p)
 {
@@ -44,10 +43,10 @@ static inline size_t convert_time_to_frames(size_t sample_rate, uint64_t t)
 }
 
 static inline void mix_audio(struct audio_output_data *mixes,
-		obs_source_t *source, size_t channels, size_t sample_rate,
-		struct ts_info *ts)
+		obs_source_t *source, uint32_t mixers, size_t channels,
+		size_t sample_rate, struct ts_info *ts)
 {
-	size_t total_floats = AUDIO_OUTPUT_FRAMES;
+	size_t total_floats = obs->audio.block_frames;
 	size_t start_point = 0;
 
 	if (source->audio_ts < ts->start || ts->end <= source->audio_ts)
@@ -56,24 +55,25 @@ static inline void mix_audio(struct audio_output_data *mixes,
 	if (source->audio_ts != ts->start) {
 		start_point = convert_time_to_frames(sample_rate,
 				source->audio_ts - ts->start);
-		if (start_point == AUDIO_OUTPUT_FRAMES)
+		if (start_point == obs->audio.block_frames)
 			return;
 
 		total_floats -= start_point;
 	}
 
+	/* the source's output is silent for mixes it isn't routed to, and
+	 * mixes that aren't active aren't output at all */
+	mixers &= source->audio_mixers;
+
 	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
-		for (size_t ch = 0; ch < channels; ch++) {
-			register float *mix = mixes[mix_idx].data[ch];
-			register float *aud =
-				source->audio_output_buf[mix_idx][ch];
-			register float *end;
+		if ((mixers & (1 << mix_idx)) == 0)
+			continue;
 
-			mix += start_point;
-			end = aud + total_floats;
+		for (size_t ch = 0; ch < channels; ch++) {
+			float *mix = mixes[mix_idx].data[ch];
+			float *aud = source->audio_output_buf[mix_idx][ch];
 
-			while (aud < end)
-				*(mix++) += *(aud++);
+			audio_mix_add(mix + start_point, aud, total_floats);
 		}
 	}
 }
@@ -135,13 +135,13 @@ static bool discard_if_stopped(obs_source_t *source, size_t channels)
 	}
 }
 
-#define MAX_AUDIO_SIZE (AUDIO_OUTPUT_FRAMES * sizeof(float))
+#define MAX_AUDIO_SIZE (obs->audio.block_frames * sizeof(float))
 
 static inline void discard_audio(struct obs_core_audio *audio,
 		obs_source_t *source, size_t channels, size_t sample_rate,
 		struct ts_info *ts)
 {
-	size_t total_floats = AUDIO_OUTPUT_FRAMES;
+	size_t total_floats = audio->block_frames;
 	size_t size;
 
 #if DEBUG_AUDIO == 1
@@ -177,7 +177,7 @@ static inline void discard_audio(struct obs_core_audio *audio,
 					source->audio_ts, ts->start);
 		}
 #endif
-		if (audio->total_buffering_ticks == MAX_BUFFERING_TICKS)
+		if (audio->total_buffering_ticks == audio->max_buffering_ticks)
 			ignore_audio(source, channels, sample_rate);
 		return;
 	}
@@ -186,7 +186,7 @@ static inline void discard_audio(struct obs_core_audio *audio,
 	    source->audio_ts != (ts->start - 1)) {
 		size_t start_point = convert_time_to_frames(sample_rate,
 				source->audio_ts - ts->start);
-		if (start_point == AUDIO_OUTPUT_FRAMES) {
+		if (start_point == audio->block_frames) {
 #if DEBUG_AUDIO == 1
 			if (is_audio_source)
 				blog(LOG_DEBUG, "can't discard, start point is "
@@ -236,7 +236,7 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 	size_t ms;
 	int ticks;
 
-	if (audio->total_buffering_ticks == MAX_BUFFERING_TICKS)
+	if (audio->total_buffering_ticks == audio->max_buffering_ticks)
 		return;
 
 	if (!audio->buffering_wait_ticks)
@@ -244,19 +244,21 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 
 	offset = ts->start - min_ts;
 	frames = ns_to_audio_frames(sample_rate, offset);
-	ticks = (int)((frames + AUDIO_OUTPUT_FRAMES - 1) / AUDIO_OUTPUT_FRAMES);
+	ticks = (int)((frames + audio->block_frames - 1) /
+			audio->block_frames);
 
 	audio->total_buffering_ticks += ticks;
 
-	if (audio->total_buffering_ticks >= MAX_BUFFERING_TICKS) {
-		ticks -= audio->total_buffering_ticks - MAX_BUFFERING_TICKS;
-		audio->total_buffering_ticks = MAX_BUFFERING_TICKS;
+	if (audio->total_buffering_ticks >= audio->max_buffering_ticks) {
+		ticks -= audio->total_buffering_ticks -
+			audio->max_buffering_ticks;
+		audio->total_buffering_ticks = audio->max_buffering_ticks;
 		blog(LOG_WARNING, "Max audio buffering reached!");
 	}
 
-	ms = ticks * AUDIO_OUTPUT_FRAMES * 1000 / sample_rate;
-	total_ms = audio->total_buffering_ticks * AUDIO_OUTPUT_FRAMES * 1000 /
-		sample_rate;
+	ms = ticks * audio->block_frames * 1000 / sample_rate;
+	total_ms = audio->total_buffering_ticks * audio->block_frames *
+		1000 / sample_rate;
 
 	blog(LOG_INFO, "adding %d milliseconds of audio buffering, total "
 			"audio buffering is now %d milliseconds",
@@ -269,7 +271,7 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 #endif
 
 	new_ts.start = audio->buffered_ts - audio_frames_to_ns(sample_rate,
-			audio->buffering_wait_ticks * AUDIO_OUTPUT_FRAMES);
+			audio->buffering_wait_ticks * audio->block_frames);
 
 	while (ticks--) {
 		int cur_ticks = ++audio->buffering_wait_ticks;
@@ -277,7 +279,7 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 		new_ts.end = new_ts.start;
 		new_ts.start = audio->buffered_ts - audio_frames_to_ns(
 				sample_rate,
-				cur_ticks * AUDIO_OUTPUT_FRAMES);
+				cur_ticks * audio->block_frames);
 
 #if DEBUG_AUDIO == 1
 		blog(LOG_DEBUG, "add buffered ts: %"PRIu64"-%"PRIu64,
@@ -294,7 +296,7 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 static bool audio_buffer_insuffient(struct obs_source *source,
 		size_t sample_rate, uint64_t min_ts)
 {
-	size_t total_floats = AUDIO_OUTPUT_FRAMES;
+	size_t total_floats = obs->audio.block_frames;
 	size_t size;
 
 	if (source->info.audio_render || source->audio_pending ||
@@ -306,7 +308,7 @@ static bool audio_buffer_insuffient(struct obs_source *source,
 	    source->audio_ts != (min_ts - 1)) {
 		size_t start_point = convert_time_to_frames(sample_rate,
 				source->audio_ts - min_ts);
-		if (start_point >= AUDIO_OUTPUT_FRAMES)
+		if (start_point >= obs->audio.block_frames)
 			return false;
 
 		total_floats -= start_point;
@@ -364,6 +366,8 @@ static inline void release_audio_sources(struct obs_core_audio *audio)
 		obs_source_release(audio->render_order.array[i]);
 }
 
+static const char *audio_buffering_name = "audio buffering (ms)";
+
 bool audio_callback(void *param,
 		uint64_t start_ts_in, uint64_t end_ts_in, uint64_t *out_ts,
 		uint32_t mixers, struct audio_output_data *mixes)
@@ -384,7 +388,7 @@ bool audio_callback(void *param,
 	circlebuf_peek_front(&audio->buffered_timestamps, &ts, sizeof(ts));
 	min_ts = ts.start;
 
-	audio_size = AUDIO_OUTPUT_FRAMES * sizeof(float);
+	audio_size = audio->block_frames * sizeof(float);
 
 #if DEBUG_AUDIO == 1
 	blog(LOG_DEBUG, "ts %llu-%llu", ts.start, ts.end);
@@ -445,8 +449,8 @@ bool audio_callback(void *param,
 			pthread_mutex_lock(&source->audio_buf_mutex);
 
 			if (source->audio_output_buf[0][0] && source->audio_ts)
-				mix_audio(mixes, source, channels, sample_rate,
-						&ts);
+				mix_audio(mixes, source, mixers, channels,
+						sample_rate, &ts);
 
 			pthread_mutex_unlock(&source->audio_buf_mutex);
 		}
@@ -473,6 +477,9 @@ bool audio_callback(void *param,
 
 	circlebuf_pop_front(&audio->buffered_timestamps, NULL, sizeof(ts));
 
+	profile_counter_record(audio_buffering_name,
+			obs_get_audio_buffering_ms());
+
 	*out_ts = ts.start;
 
 	if (audio->buffering_wait_ticks) {
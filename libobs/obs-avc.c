@@ -15,7 +15,7 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
-#include "obs.h"
+#include "obs-internal.h"
 #include "obs-avc.h"
 #include "util/array-serializer.h"
 
@@ -127,22 +127,76 @@ static void serialize_avc_data(struct serializer *s, const uint8_t *data,
 	}
 }
 
+struct fixed_output_data {
+	uint8_t *data;
+	size_t  size;
+	size_t  pos;
+};
+
+static size_t fixed_output_write(void *param, const void *data, size_t size)
+{
+	struct fixed_output_data *output = param;
+
+	if (size > output->size - output->pos)
+		size = output->size - output->pos;
+
+	memcpy(output->data + output->pos, data, size);
+	output->pos += size;
+	return size;
+}
+
+static void fixed_output_serializer_init(struct serializer *s,
+		struct fixed_output_data *output, uint8_t *data, size_t size)
+{
+	memset(s, 0, sizeof(struct serializer));
+	output->data = data;
+	output->size = size;
+	output->pos  = 0;
+	s->data      = output;
+	s->write     = fixed_output_write;
+}
+
+static size_t get_avc_data_size(const uint8_t *data, size_t size)
+{
+	const uint8_t *nal_start, *nal_end;
+	const uint8_t *end = data+size;
+	size_t avc_size = 0;
+
+	nal_start = obs_avc_find_startcode(data, end);
+	while (true) {
+		while (nal_start < end && !*(nal_start++));
+
+		if (nal_start == end)
+			break;
+
+		nal_end = obs_avc_find_startcode(nal_start, end);
+		avc_size += 4 + (size_t)(nal_end - nal_start);
+		nal_start = nal_end;
+	}
+
+	return avc_size;
+}
+
 void obs_parse_avc_packet(struct encoder_packet *avc_packet,
 		const struct encoder_packet *src)
 {
-	struct array_output_data output;
 	struct serializer s;
-	long ref = 1;
+	struct fixed_output_data output;
 
-	array_output_serializer_init(&s, &output);
 	*avc_packet = *src;
 
-	serialize(&s, &ref, sizeof(ref));
+	/* size it up front so it can be written straight into a pooled
+	 * packet buffer */
+	avc_packet->size = get_avc_data_size(src->data, src->size);
+	avc_packet->data = obs_encoder_packet_alloc(avc_packet->size);
+
+	fixed_output_serializer_init(&s, &output, avc_packet->data,
+			avc_packet->size);
 	serialize_avc_data(&s, src->data, src->size, &avc_packet->keyframe,
 			&avc_packet->priority);
 
-	avc_packet->data          = output.bytes.array + sizeof(ref);
-	avc_packet->size          = output.bytes.num - sizeof(ref);
+	obs_encoder_packet_add_copied(avc_packet->size);
+
 	avc_packet->drop_priority = get_drop_priority(avc_packet->priority);
 }
 
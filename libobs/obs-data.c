@@ -27,11 +27,17 @@
 #include "obs-data.h"
 
 #include <jansson.h>
+#include <errno.h>
+#include <locale.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
 
 struct obs_data_item {
 	volatile long        ref;
 	struct obs_data      *parent;
 	struct obs_data_item *next;
+	uint32_t             name_hash;
 	enum obs_data_type   type;
 	size_t               name_len;
 	size_t               data_len;
@@ -46,6 +52,13 @@ struct obs_data {
 	volatile long        ref;
 	char                 *json;
 	struct obs_data_item *first_item;
+	struct obs_data_item *last_item;
+	size_t               num_items;
+
+	/* open addressing table of items by name, only created once the
+	 * object has more than a few items */
+	struct obs_data_item **index;
+	size_t               index_size;
 };
 
 struct obs_data_array {
@@ -88,6 +101,19 @@ static inline char *get_item_name(struct obs_data_item *item)
 	return (char*)item + sizeof(struct obs_data_item);
 }
 
+/* FNV-1a */
+static inline uint32_t get_name_hash(const char *name)
+{
+	uint32_t hash = 2166136261U;
+
+	while (*name) {
+		hash ^= (uint8_t)*(name++);
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
 static inline void *get_data_ptr(obs_data_item_t *item)
 {
 	return (uint8_t*)get_item_name(item) + item->name_len;
@@ -276,10 +302,11 @@ static struct obs_data_item *obs_data_item_create(const char *name,
 
 	item = bzalloc(total_size);
 
-	item->capacity = total_size;
-	item->type     = type;
-	item->name_len = name_size;
-	item->ref      = 1;
+	item->capacity  = total_size;
+	item->type      = type;
+	item->name_len  = name_size;
+	item->name_hash = get_name_hash(name);
+	item->ref       = 1;
 
 	if (default_data) {
 		item->default_len = size;
@@ -300,6 +327,129 @@ static struct obs_data_item *obs_data_item_create(const char *name,
 	return item;
 }
 
+/* ------------------------------------------------------------------------- */
+/* Item index */
+
+#define INDEX_MIN_ITEMS 8
+#define INDEX_MIN_SIZE  32
+
+static inline void index_add(struct obs_data_item **index, size_t mask,
+		struct obs_data_item *item)
+{
+	size_t idx = item->name_hash & mask;
+
+	while (index[idx])
+		idx = (idx + 1) & mask;
+
+	index[idx] = item;
+}
+
+static void index_rebuild(struct obs_data *data, size_t size)
+{
+	struct obs_data_item *item = data->first_item;
+
+	bfree(data->index);
+	data->index      = bzalloc(sizeof(struct obs_data_item*) * size);
+	data->index_size = size;
+
+	while (item) {
+		index_add(data->index, size - 1, item);
+		item = item->next;
+	}
+}
+
+/* called after the item has been linked in to the item list */
+static void index_insert(struct obs_data *data, struct obs_data_item *item)
+{
+	if (!data->index) {
+		if (data->num_items >= INDEX_MIN_ITEMS)
+			index_rebuild(data, INDEX_MIN_SIZE);
+		return;
+	}
+
+	/* keep the load factor at or below 1/2 so probes stay short */
+	if (data->num_items * 2 > data->index_size)
+		index_rebuild(data, data->index_size * 2);
+	else
+		index_add(data->index, data->index_size - 1, item);
+}
+
+static struct obs_data_item **index_find(struct obs_data *data,
+		uint32_t hash, const struct obs_data_item *item)
+{
+	size_t mask = data->index_size - 1;
+	size_t idx  = hash & mask;
+
+	while (data->index[idx]) {
+		if (data->index[idx] == item)
+			return &data->index[idx];
+		idx = (idx + 1) & mask;
+	}
+
+	return NULL;
+}
+
+static void index_remove(struct obs_data *data, struct obs_data_item *item)
+{
+	struct obs_data_item **slot;
+	size_t mask, i, j;
+
+	if (!data->index)
+		return;
+
+	slot = index_find(data, item->name_hash, item);
+	if (!slot)
+		return;
+
+	/* backward shift deletion, so no tombstones are needed */
+	mask = data->index_size - 1;
+	i = j = (size_t)(slot - data->index);
+
+	for (;;) {
+		j = (j + 1) & mask;
+
+		struct obs_data_item *cur = data->index[j];
+		if (!cur)
+			break;
+
+		size_t home = cur->name_hash & mask;
+		bool stays = (i <= j) ? (i < home && home <= j)
+		                      : (i < home || home <= j);
+		if (!stays) {
+			data->index[i] = cur;
+			i = j;
+		}
+	}
+
+	data->index[i] = NULL;
+}
+
+/* old_ptr may already be freed at this point, only its address is used */
+static inline void index_replace(struct obs_data *data,
+		struct obs_data_item *old_ptr, struct obs_data_item *new_ptr)
+{
+	struct obs_data_item **slot;
+
+	if (!data->index)
+		return;
+
+	slot = index_find(data, new_ptr->name_hash, old_ptr);
+	if (slot)
+		*slot = new_ptr;
+}
+
+static inline struct obs_data_item *get_prev_item(struct obs_data *data,
+		struct obs_data_item **prev_next)
+{
+	if (prev_next == &data->first_item)
+		return NULL;
+
+	return (struct obs_data_item*)((uint8_t*)prev_next -
+			offsetof(struct obs_data_item, next));
+}
+
+/* ------------------------------------------------------------------------- */
+
 static struct obs_data_item **get_item_prev_next(struct obs_data *data,
 		struct obs_data_item *current)
 {
@@ -322,23 +472,60 @@ static struct obs_data_item **get_item_prev_next(struct obs_data *data,
 
 static inline void obs_data_item_detach(struct obs_data_item *item)
 {
-	struct obs_data_item **prev_next = get_item_prev_next(item->parent,
-			item);
+	struct obs_data *data = item->parent;
+	struct obs_data_item **prev_next = get_item_prev_next(data, item);
 
 	if (prev_next) {
+		if (data->last_item == item)
+			data->last_item = get_prev_item(data, prev_next);
+
 		*prev_next = item->next;
 		item->next = NULL;
+
+		data->num_items--;
+		index_remove(data, item);
 	}
 }
 
 static inline void obs_data_item_reattach(struct obs_data_item *old_ptr,
 		struct obs_data_item *new_ptr)
 {
-	struct obs_data_item **prev_next = get_item_prev_next(new_ptr->parent,
-			old_ptr);
+	struct obs_data *data = new_ptr->parent;
+	struct obs_data_item **prev_next = get_item_prev_next(data, old_ptr);
 
-	if (prev_next)
+	if (prev_next) {
 		*prev_next = new_ptr;
+
+		if (data->last_item == old_ptr)
+			data->last_item = new_ptr;
+
+		index_replace(data, old_ptr, new_ptr);
+	}
+}
+
+/* items are kept sorted by name */
+static void obs_data_item_attach(struct obs_data *data,
+		struct obs_data_item *item)
+{
+	const char *name = get_item_name(item);
+	struct obs_data_item **prev_next = &data->first_item;
+
+	/* saved settings are already in order, so try the end first */
+	if (data->last_item && strcmp(get_item_name(data->last_item), name) < 0)
+		prev_next = &data->last_item->next;
+
+	while (*prev_next && strcmp(get_item_name(*prev_next), name) < 0)
+		prev_next = &(*prev_next)->next;
+
+	item->parent = data;
+	item->next   = *prev_next;
+	*prev_next   = item;
+
+	if (!item->next)
+		data->last_item = item;
+
+	data->num_items++;
+	index_insert(data, item);
 }
 
 static struct obs_data_item *obs_data_item_ensure_capacity(
@@ -469,69 +656,615 @@ static inline void obs_data_item_set_autoselect_data(
 
 /* ------------------------------------------------------------------------- */
 
-static void obs_data_add_json_item(obs_data_t *data, const char *key,
-		json_t *json);
+/* Settings are parsed straight in to obs_data objects rather than going
+ * through a jansson tree first.  This accepts the same input jansson does
+ * with JSON_REJECT_DUPLICATES, and like before, null values and array
+ * elements that aren't objects are ignored. */
+
+#define JSON_MAX_DEPTH 2048
+
+static struct obs_data_item *get_item(struct obs_data *data, const char *name);
+
+/* keys of the objects currently being parsed, used to detect duplicates
+ * whether or not the values end up being stored in an obs_data object */
+struct json_key {
+	uint32_t    hash;
+	size_t      offset;
+};
+
+struct json_parser {
+	const char  *pos;
+	const char  *line_start;
+	int         line;
+	int         depth;
+	struct dstr key;
+	struct dstr str;
+	char        error[160];
+
+	DARRAY(struct json_key) keys;
+	DARRAY(char)            key_names;
+};
+
+static void json_error(struct json_parser *p, const char *format, ...)
+{
+	va_list args;
 
-static inline void obs_data_add_json_object_data(obs_data_t *data, json_t *jobj)
+	if (*p->error)
+		return;
+
+	va_start(args, format);
+	vsnprintf(p->error, sizeof(p->error), format, args);
+	va_end(args);
+}
+
+static inline void json_skip_whitespace(struct json_parser *p)
 {
-	const char *item_key;
-	json_t *jitem;
+	for (;;) {
+		char ch = *p->pos;
+
+		if (ch == '\n') {
+			p->line++;
+			p->line_start = p->pos + 1;
+		} else if (ch != ' ' && ch != '\t' && ch != '\r') {
+			break;
+		}
 
-	json_object_foreach (jobj, item_key, jitem) {
-		obs_data_add_json_item(data, item_key, jitem);
+		p->pos++;
 	}
 }
 
-static inline void obs_data_add_json_object(obs_data_t *data, const char *key,
-		json_t *jobj)
+static inline int json_hex_digit(char ch)
+{
+	if (ch >= '0' && ch <= '9') return ch - '0';
+	if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+	if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+	return -1;
+}
+
+static bool json_read_hex4(struct json_parser *p, uint32_t *val)
 {
-	obs_data_t *sub_obj = obs_data_create();
+	*val = 0;
 
-	obs_data_add_json_object_data(sub_obj, jobj);
-	obs_data_set_obj(data, key, sub_obj);
-	obs_data_release(sub_obj);
+	for (int i = 0; i < 4; i++) {
+		int digit = json_hex_digit(p->pos[i]);
+		if (digit < 0) {
+			json_error(p, "invalid escape");
+			return false;
+		}
+
+		*val = (*val << 4) | (uint32_t)digit;
+	}
+
+	p->pos += 4;
+	return true;
 }
 
-static void obs_data_add_json_array(obs_data_t *data, const char *key,
-		json_t *jarray)
+static void json_cat_utf8(struct dstr *str, uint32_t cp)
 {
-	obs_data_array_t *array = obs_data_array_create();
-	size_t idx;
-	json_t *jitem;
+	char buf[4];
+	size_t len;
 
-	json_array_foreach (jarray, idx, jitem) {
-		obs_data_t *item;
+	if (cp < 0x80) {
+		buf[0] = (char)cp;
+		len = 1;
+	} else if (cp < 0x800) {
+		buf[0] = (char)(0xC0 | (cp >> 6));
+		buf[1] = (char)(0x80 | (cp & 0x3F));
+		len = 2;
+	} else if (cp < 0x10000) {
+		buf[0] = (char)(0xE0 | (cp >> 12));
+		buf[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+		buf[2] = (char)(0x80 | (cp & 0x3F));
+		len = 3;
+	} else {
+		buf[0] = (char)(0xF0 | (cp >> 18));
+		buf[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+		buf[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+		buf[3] = (char)(0x80 | (cp & 0x3F));
+		len = 4;
+	}
 
-		if (!json_is_object(jitem))
-			continue;
+	dstr_ncat(str, buf, len);
+}
 
-		item = obs_data_create();
-		obs_data_add_json_object_data(item, jitem);
-		obs_data_array_push_back(array, item);
-		obs_data_release(item);
+/* returns the length of the UTF-8 sequence at str, or 0 if it's invalid */
+static size_t json_utf8_length(const unsigned char *str)
+{
+	unsigned char ch = str[0];
+	uint32_t cp;
+	size_t len;
+
+	if (ch < 0xC2 || ch > 0xF4)
+		return 0;
+
+	if (ch < 0xE0) {
+		len = 2;
+		cp  = ch & 0x1F;
+	} else if (ch < 0xF0) {
+		len = 3;
+		cp  = ch & 0x0F;
+	} else {
+		len = 4;
+		cp  = ch & 0x07;
 	}
 
-	obs_data_set_array(data, key, array);
-	obs_data_array_release(array);
+	for (size_t i = 1; i < len; i++) {
+		if ((str[i] & 0xC0) != 0x80)
+			return 0;
+		cp = (cp << 6) | (str[i] & 0x3F);
+	}
+
+	if ((len == 3 && cp < 0x800) || (len == 4 && cp < 0x10000) ||
+	    (cp >= 0xD800 && cp <= 0xDFFF) || cp > 0x10FFFF)
+		return 0;
+
+	return len;
+}
+
+static bool json_parse_escape(struct json_parser *p, struct dstr *out)
+{
+	uint32_t cp, low;
+	char ch = *(p->pos++);
+
+	switch (ch) {
+	case '"':  dstr_cat_ch(out, '"');  return true;
+	case '\\': dstr_cat_ch(out, '\\'); return true;
+	case '/':  dstr_cat_ch(out, '/');  return true;
+	case 'b':  dstr_cat_ch(out, '\b'); return true;
+	case 'f':  dstr_cat_ch(out, '\f'); return true;
+	case 'n':  dstr_cat_ch(out, '\n'); return true;
+	case 'r':  dstr_cat_ch(out, '\r'); return true;
+	case 't':  dstr_cat_ch(out, '\t'); return true;
+	case 'u':  break;
+	default:
+		json_error(p, "invalid escape");
+		return false;
+	}
+
+	if (!json_read_hex4(p, &cp))
+		return false;
+
+	if (cp >= 0xD800 && cp <= 0xDBFF) {
+		if (p->pos[0] != '\\' || p->pos[1] != 'u') {
+			json_error(p, "invalid Unicode '\\u%04X'", cp);
+			return false;
+		}
+
+		p->pos += 2;
+		if (!json_read_hex4(p, &low))
+			return false;
+
+		if (low < 0xDC00 || low > 0xDFFF) {
+			json_error(p, "invalid Unicode '\\u%04X\\u%04X'",
+					cp, low);
+			return false;
+		}
+
+		cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+
+	} else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+		json_error(p, "invalid Unicode '\\u%04X'", cp);
+		return false;
+
+	} else if (cp == 0) {
+		json_error(p, "\\u0000 is not allowed");
+		return false;
+	}
+
+	json_cat_utf8(out, cp);
+	return true;
+}
+
+/* expects p->pos to be on the opening quote */
+static bool json_parse_string(struct json_parser *p, struct dstr *out)
+{
+	const char *run;
+
+	dstr_ensure_capacity(out, 64);
+	out->array[0] = 0;
+	out->len = 0;
+
+	run = ++p->pos;
+
+	for (;;) {
+		unsigned char ch = (unsigned char)*p->pos;
+
+		if (ch == '"' || ch == '\\' || ch < 0x20 || ch >= 0x80) {
+			if (p->pos != run)
+				dstr_ncat(out, run, p->pos - run);
+
+			if (ch == '"') {
+				p->pos++;
+				return true;
+
+			} else if (ch == '\\') {
+				p->pos++;
+				if (!json_parse_escape(p, out))
+					return false;
+
+			} else if (ch >= 0x80) {
+				size_t len = json_utf8_length(
+						(const unsigned char*)p->pos);
+				if (!len) {
+					json_error(p, "invalid UTF-8");
+					return false;
+				}
+
+				dstr_ncat(out, p->pos, len);
+				p->pos += len;
+
+			} else if (!ch) {
+				json_error(p, "premature end of input");
+				return false;
+
+			} else {
+				json_error(p, "control character 0x%x", ch);
+				return false;
+			}
+
+			run = p->pos;
+		} else {
+			p->pos++;
+		}
+	}
+}
+
+static inline bool json_is_digit(char ch)
+{
+	return ch >= '0' && ch <= '9';
+}
+
+/* strtod uses the locale's decimal point, same workaround jansson uses */
+static double json_strtod(const char *start, size_t len)
+{
+	const char *point = localeconv()->decimal_point;
+	char buf[128];
+	char *num = len < sizeof(buf) ? buf : bmalloc(len + 1);
+	double val;
+
+	memcpy(num, start, len);
+	num[len] = 0;
+
+	if (point && *point && *point != '.') {
+		char *dot = strchr(num, '.');
+		if (dot)
+			*dot = *point;
+	}
+
+	val = strtod(num, NULL);
+
+	if (num != buf)
+		bfree(num);
+	return val;
+}
+
+static bool json_parse_number(struct json_parser *p, obs_data_t *data,
+		const char *key)
+{
+	const char *start = p->pos;
+	bool real = false;
+
+	if (*p->pos == '-')
+		p->pos++;
+
+	if (*p->pos == '0') {
+		p->pos++;
+	} else if (json_is_digit(*p->pos)) {
+		while (json_is_digit(*p->pos))
+			p->pos++;
+	} else {
+		json_error(p, "invalid token");
+		return false;
+	}
+
+	if (*p->pos == '.') {
+		real = true;
+		p->pos++;
+
+		if (!json_is_digit(*p->pos)) {
+			json_error(p, "invalid real number");
+			return false;
+		}
+		while (json_is_digit(*p->pos))
+			p->pos++;
+	}
+
+	if (*p->pos == 'e' || *p->pos == 'E') {
+		real = true;
+		p->pos++;
+
+		if (*p->pos == '+' || *p->pos == '-')
+			p->pos++;
+		if (!json_is_digit(*p->pos)) {
+			json_error(p, "invalid real number");
+			return false;
+		}
+		while (json_is_digit(*p->pos))
+			p->pos++;
+	}
+
+	if (json_is_digit(*p->pos)) {
+		json_error(p, "invalid token");
+		return false;
+	}
+
+	if (!real) {
+		long long val;
+
+		errno = 0;
+		val = strtoll(start, NULL, 10);
+		if (errno == ERANGE) {
+			json_error(p, val < 0 ? "too big negative integer" :
+					"too big integer");
+			return false;
+		}
+
+		if (data)
+			obs_data_set_int(data, key, val);
+
+	} else {
+		double val = json_strtod(start, p->pos - start);
+
+		if (isinf(val)) {
+			json_error(p, "real number overflow");
+			return false;
+		}
+
+		if (data)
+			obs_data_set_double(data, key, val);
+	}
+
+	return true;
+}
+
+static bool json_parse_value(struct json_parser *p, obs_data_t *data,
+		const char *key);
+
+/* adds the current key to the keys of the object that starts at first_key,
+ * returns false if the object already has it */
+static bool json_add_key(struct json_parser *p, size_t first_key)
+{
+	const char *name = p->key.array;
+	uint32_t hash = get_name_hash(name);
+	struct json_key *key;
+
+	for (size_t i = first_key; i < p->keys.num; i++) {
+		key = p->keys.array + i;
+		if (key->hash == hash &&
+		    strcmp(p->key_names.array + key->offset, name) == 0)
+			return false;
+	}
+
+	key = da_push_back_new(p->keys);
+	key->hash   = hash;
+	key->offset = p->key_names.num;
+	da_push_back_array(p->key_names, name, p->key.len + 1);
+	return true;
+}
+
+static bool json_parse_object_items(struct json_parser *p, obs_data_t *data)
+{
+	size_t first_key = p->keys.num;
+
+	for (;;) {
+		if (*p->pos != '"') {
+			json_error(p, "string or '}' expected");
+			return false;
+		}
+
+		if (!json_parse_string(p, &p->key))
+			return false;
+
+		if (!json_add_key(p, first_key)) {
+			json_error(p, "duplicate object key");
+			return false;
+		}
+
+		json_skip_whitespace(p);
+		if (*p->pos != ':') {
+			json_error(p, "':' expected");
+			return false;
+		}
+
+		p->pos++;
+		json_skip_whitespace(p);
+
+		if (!json_parse_value(p, data, p->key.array))
+			return false;
+
+		json_skip_whitespace(p);
+
+		if (*p->pos == '}') {
+			p->pos++;
+			return true;
+		} else if (*p->pos != ',') {
+			json_error(p, "'}' expected");
+			return false;
+		}
+
+		p->pos++;
+		json_skip_whitespace(p);
+	}
+}
+
+static bool json_parse_object_data(struct json_parser *p, obs_data_t *data)
+{
+	size_t num_keys = p->keys.num;
+	size_t names_size = p->key_names.num;
+	bool success;
+
+	p->pos++;
+	json_skip_whitespace(p);
+
+	if (*p->pos == '}') {
+		p->pos++;
+		return true;
+	}
+
+	success = json_parse_object_items(p, data);
+
+	da_resize(p->keys, num_keys);
+	da_resize(p->key_names, names_size);
+	return success;
+}
+
+static bool json_parse_array(struct json_parser *p, obs_data_array_t *array)
+{
+	p->pos++;
+	json_skip_whitespace(p);
+
+	if (*p->pos == ']') {
+		p->pos++;
+		return true;
+	}
+
+	for (;;) {
+		if (*p->pos == '{' && array) {
+			obs_data_t *item = obs_data_create();
+			obs_data_array_push_back(array, item);
+			obs_data_release(item);
+
+			p->depth++;
+			if (p->depth > JSON_MAX_DEPTH) {
+				json_error(p, "maximum parsing depth reached");
+				return false;
+			}
+			if (!json_parse_object_data(p, item))
+				return false;
+			p->depth--;
+
+		} else if (!json_parse_value(p, NULL, NULL)) {
+			return false;
+		}
+
+		json_skip_whitespace(p);
+
+		if (*p->pos == ']') {
+			p->pos++;
+			return true;
+		} else if (*p->pos != ',') {
+			json_error(p, "']' expected");
+			return false;
+		}
+
+		p->pos++;
+		json_skip_whitespace(p);
+	}
 }
 
-static void obs_data_add_json_item(obs_data_t *data, const char *key,
-		json_t *json)
+static inline bool json_parse_literal(struct json_parser *p, const char *lit)
 {
-	if (json_is_object(json))
-		obs_data_add_json_object(data, key, json);
-	else if (json_is_array(json))
-		obs_data_add_json_array(data, key, json);
-	else if (json_is_string(json))
-		obs_data_set_string(data, key, json_string_value(json));
-	else if (json_is_integer(json))
-		obs_data_set_int(data, key, json_integer_value(json));
-	else if (json_is_real(json))
-		obs_data_set_double(data, key, json_real_value(json));
-	else if (json_is_true(json))
-		obs_data_set_bool(data, key, true);
-	else if (json_is_false(json))
-		obs_data_set_bool(data, key, false);
+	size_t len = strlen(lit);
+
+	if (strncmp(p->pos, lit, len) != 0) {
+		json_error(p, "invalid token");
+		return false;
+	}
+
+	p->pos += len;
+	return true;
+}
+
+/* sets the value on data if data is not NULL, otherwise only validates it */
+static bool json_parse_value(struct json_parser *p, obs_data_t *data,
+		const char *key)
+{
+	bool success;
+
+	switch (*p->pos) {
+	case '{':
+	case '[':
+		if (++p->depth > JSON_MAX_DEPTH) {
+			json_error(p, "maximum parsing depth reached");
+			return false;
+		}
+
+		/* set the new object before filling it; key is reused by
+		 * the nested parse */
+		if (*p->pos == '{') {
+			obs_data_t *obj = data ? obs_data_create() : NULL;
+			if (obj) {
+				obs_data_set_obj(data, key, obj);
+				obs_data_release(obj);
+			}
+			success = json_parse_object_data(p, obj);
+		} else {
+			obs_data_array_t *array = data ?
+				obs_data_array_create() : NULL;
+			if (array) {
+				obs_data_set_array(data, key, array);
+				obs_data_array_release(array);
+			}
+			success = json_parse_array(p, array);
+		}
+
+		p->depth--;
+		return success;
+
+	case '"':
+		if (!json_parse_string(p, &p->str))
+			return false;
+		if (data)
+			obs_data_set_string(data, key, p->str.array);
+		return true;
+
+	case 't':
+		if (!json_parse_literal(p, "true"))
+			return false;
+		if (data)
+			obs_data_set_bool(data, key, true);
+		return true;
+
+	case 'f':
+		if (!json_parse_literal(p, "false"))
+			return false;
+		if (data)
+			obs_data_set_bool(data, key, false);
+		return true;
+
+	case 'n':
+		return json_parse_literal(p, "null");
+
+	case 0:
+		json_error(p, "premature end of input");
+		return false;
+
+	default:
+		if (*p->pos == '-' || json_is_digit(*p->pos))
+			return json_parse_number(p, data, key);
+
+		json_error(p, "invalid token");
+		return false;
+	}
+}
+
+/* top level values have to be objects or arrays, an array just results in
+ * an empty object as it has no keys */
+static bool json_parse_root(struct json_parser *p, obs_data_t *data)
+{
+	bool success;
+
+	json_skip_whitespace(p);
+
+	if (*p->pos == '{') {
+		success = json_parse_object_data(p, data);
+	} else if (*p->pos == '[') {
+		success = json_parse_array(p, NULL);
+	} else {
+		json_error(p, "'[' or '{' expected");
+		return false;
+	}
+
+	if (!success)
+		return false;
+
+	json_skip_whitespace(p);
+	if (*p->pos) {
+		json_error(p, "end of file expected");
+		return false;
+	}
+
+	return true;
 }
 
 /* ------------------------------------------------------------------------- */
@@ -632,21 +1365,28 @@ obs_data_t *obs_data_create()
 obs_data_t *obs_data_create_from_json(const char *json_string)
 {
 	obs_data_t *data = obs_data_create();
+	struct json_parser p = {0};
 
-	json_error_t error;
-	json_t *root = json_loads(json_string, JSON_REJECT_DUPLICATES, &error);
+	if (!json_string)
+		json_string = "";
 
-	if (root) {
-		obs_data_add_json_object_data(data, root);
-		json_decref(root);
-	} else {
+	p.pos        = json_string;
+	p.line_start = json_string;
+	p.line       = 1;
+
+	if (!json_parse_root(&p, data)) {
 		blog(LOG_ERROR, "obs-data.c: [obs_data_create_from_json] "
-		                "Failed reading json string (%d): %s",
-		                error.line, error.text);
+		                "Failed reading json string (%d:%d): %s",
+		                p.line, (int)(p.pos - p.line_start) + 1,
+		                p.error);
 		obs_data_release(data);
 		data = NULL;
 	}
 
+	dstr_free(&p.key);
+	dstr_free(&p.str);
+	da_free(p.keys);
+	da_free(p.key_names);
 	return data;
 }
 
@@ -705,12 +1445,18 @@ static inline void obs_data_destroy(struct obs_data *data)
 
 	while (item) {
 		struct obs_data_item *next = item->next;
+
+		/* items can outlive their parent if they're still referenced
+		 * elsewhere, so don't let them touch it again */
+		item->parent = NULL;
+		item->next = NULL;
 		obs_data_item_release(&item);
 		item = next;
 	}
 
 	/* NOTE: don't use bfree for json text, allocated by json */
 	free(data->json);
+	bfree(data->index);
 	bfree(data);
 }
 
@@ -766,6 +1512,23 @@ static struct obs_data_item *get_item(struct obs_data *data, const char *name)
 {
 	if (!data) return NULL;
 
+	if (data->index) {
+		uint32_t hash = get_name_hash(name);
+		size_t mask = data->index_size - 1;
+		size_t idx = hash & mask;
+		struct obs_data_item *item;
+
+		while ((item = data->index[idx]) != NULL) {
+			if (item->name_hash == hash &&
+			    strcmp(get_item_name(item), name) == 0)
+				return item;
+
+			idx = (idx + 1) & mask;
+		}
+
+		return NULL;
+	}
+
 	struct obs_data_item *item = data->first_item;
 
 	while (item) {
@@ -789,30 +1552,8 @@ static void set_item_data(struct obs_data *data, struct obs_data_item **item,
 		new_item = obs_data_item_create(name, ptr, size, type,
 				default_data, autoselect_data);
 
-		obs_data_item_t *prev = obs_data_first(data);
-		obs_data_item_t *next = obs_data_first(data);
-		obs_data_item_next(&next);
-		for (; prev && next; obs_data_item_next(&prev),
-				obs_data_item_next(&next)) {
-			if (strcmp(get_item_name(next), name) > 0)
-				break;
-		}
-
-		new_item->parent = data;
-		if (prev && strcmp(get_item_name(prev), name) < 0) {
-			prev->next     = new_item;
-			new_item->next = next;
-
-		} else {
-			data->first_item = new_item;
-			new_item->next   = prev;
-		}
-
-		if (!prev)
-			data->first_item = new_item;
-
-		obs_data_item_release(&prev);
-		obs_data_item_release(&next);
+		if (new_item)
+			obs_data_item_attach(data, new_item);
 
 	} else if (default_data) {
 		obs_data_item_set_default_data(item, ptr, size, type);
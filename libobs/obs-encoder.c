@@ -84,6 +84,10 @@ static struct obs_encoder *create_encoder(const char *id,
 	encoder = bzalloc(sizeof(struct obs_encoder));
 	encoder->mixer_idx = mixer_idx;
 
+	/* audio encoders encode off of the audio thread by default so that
+	 * encoding every track does not delay mixing */
+	encoder->threaded = type == OBS_ENCODER_AUDIO;
+
 	if (!ei) {
 		blog(LOG_ERROR, "Encoder ID '%s' not found", id);
 
@@ -183,14 +187,24 @@ static void add_connection(struct obs_encoder *encoder)
 		struct audio_convert_info audio_info = {0};
 		get_audio_info(encoder, &audio_info);
 
-		audio_output_connect(encoder->media, encoder->mixer_idx,
-				&audio_info, receive_audio, encoder);
+		if (encoder->threaded)
+			audio_output_connect_threaded(encoder->media,
+					encoder->mixer_idx, &audio_info,
+					receive_audio, encoder);
+		else
+			audio_output_connect(encoder->media,
+					encoder->mixer_idx, &audio_info,
+					receive_audio, encoder);
 	} else {
 		struct video_scale_info info = {0};
 		get_video_info(encoder, &info);
 
-		video_output_connect(encoder->media, &info, receive_video,
-			encoder);
+		if (encoder->threaded)
+			video_output_connect_threaded(encoder->media, &info, 0,
+					receive_video, encoder);
+		else
+			video_output_connect(encoder->media, &info,
+					receive_video, encoder);
 	}
 
 	set_encoder_active(encoder, true);
@@ -580,6 +594,48 @@ void obs_encoder_set_scaled_size(obs_encoder_t *encoder, uint32_t width,
 	encoder->scaled_height = height;
 }
 
+void obs_encoder_set_threaded(obs_encoder_t *encoder, bool threaded)
+{
+	if (!obs_encoder_valid(encoder, "obs_encoder_set_threaded"))
+		return;
+	if (encoder_active(encoder)) {
+		blog(LOG_WARNING, "encoder '%s': Cannot change threading "
+		                  "while the encoder is active",
+		                  obs_encoder_get_name(encoder));
+		return;
+	}
+
+	encoder->threaded = threaded;
+}
+
+bool obs_encoder_threaded(const obs_encoder_t *encoder)
+{
+	return obs_encoder_valid(encoder, "obs_encoder_threaded") ?
+		encoder->threaded : false;
+}
+
+size_t obs_encoder_get_queued_frames(const obs_encoder_t *encoder)
+{
+	if (!obs_encoder_valid(encoder, "obs_encoder_get_queued_frames"))
+		return 0;
+	if (encoder->info.type != OBS_ENCODER_VIDEO || !encoder->threaded)
+		return 0;
+
+	return video_output_get_input_queued_frames(encoder->media,
+			receive_video, (void*)encoder);
+}
+
+uint64_t obs_encoder_get_lag(const obs_encoder_t *encoder)
+{
+	if (!obs_encoder_valid(encoder, "obs_encoder_get_lag"))
+		return 0;
+	if (encoder->info.type != OBS_ENCODER_VIDEO || !encoder->threaded)
+		return 0;
+
+	return video_output_get_input_lag(encoder->media, receive_video,
+			(void*)encoder);
+}
+
 uint32_t obs_encoder_get_width(const obs_encoder_t *encoder)
 {
 	if (!obs_encoder_valid(encoder, "obs_encoder_get_width"))
@@ -721,7 +777,6 @@ static void send_first_video_packet(struct obs_encoder *encoder,
 		struct encoder_callback *cb, struct encoder_packet *packet)
 {
 	struct encoder_packet first_packet;
-	DARRAY(uint8_t)       data;
 	uint8_t               *sei;
 	size_t                size;
 
@@ -729,25 +784,24 @@ static void send_first_video_packet(struct obs_encoder *encoder,
 	if (!packet->keyframe)
 		return;
 
-	da_init(data);
-
 	if (!get_sei(encoder, &sei, &size) || !sei || !size) {
 		cb->new_packet(cb->param, packet);
 		cb->sent_first_packet = true;
 		return;
 	}
 
-	da_push_back_array(data, sei, size);
-	da_push_back_array(data, packet->data, packet->size);
-
 	first_packet      = *packet;
-	first_packet.data = data.array;
-	first_packet.size = data.num;
+	first_packet.size = size + packet->size;
+	first_packet.data = obs_encoder_packet_alloc(first_packet.size);
+	memcpy(first_packet.data, sei, size);
+	memcpy(first_packet.data + size, packet->data, packet->size);
+
+	obs_encoder_packet_add_copied(first_packet.size);
 
 	cb->new_packet(cb->param, &first_packet);
 	cb->sent_first_packet = true;
 
-	da_free(data);
+	obs_encoder_packet_release(&first_packet);
 }
 
 static inline void send_packet(struct obs_encoder *encoder,
@@ -811,15 +865,23 @@ static inline void do_encode(struct obs_encoder *encoder,
 			packet_dts_usec(&pkt) - encoder->offset_usec;
 		pkt.sys_dts_usec = pkt.dts_usec;
 
+		/* the encoder's packet data is only valid until the next
+		 * encode call, so copy it once into a refcounted packet that
+		 * every output then shares by reference */
+		struct encoder_packet out;
+		obs_encoder_packet_create_instance(&out, &pkt);
+
 		pthread_mutex_lock(&encoder->callbacks_mutex);
 
 		for (size_t i = encoder->callbacks.num; i > 0; i--) {
 			struct encoder_callback *cb;
 			cb = encoder->callbacks.array+(i-1);
-			send_packet(encoder, cb, &pkt);
+			send_packet(encoder, cb, &out);
 		}
 
 		pthread_mutex_unlock(&encoder->callbacks_mutex);
+
+		obs_encoder_packet_release(&out);
 	}
 
 error:
@@ -1035,16 +1097,164 @@ void obs_encoder_remove_output(struct obs_encoder *encoder,
 	pthread_mutex_unlock(&encoder->outputs_mutex);
 }
 
+/* ------------------------------------------------------------------------- */
+/* packet data pool */
+
+/* size classes go up in quarter powers of two (256, 320, 384, 448, 512, ...)
+ * so a packet never wastes more than a quarter of its size, which matters
+ * for outputs that keep many packets alive such as the replay buffer.
+ * larger packets are allocated at their exact size and never pooled. */
+#define PACKET_POOL_MIN_SHIFT  8  /* 256 bytes */
+#define PACKET_POOL_MAX_SHIFT  22 /* 4 megabytes */
+#define PACKET_POOL_STEPS      4
+#define PACKET_POOL_BUCKETS    ((PACKET_POOL_MAX_SHIFT - \
+                                PACKET_POOL_MIN_SHIFT) * \
+                                PACKET_POOL_STEPS + 1)
+#define PACKET_POOL_MAX_BYTES  (16 * 1024 * 1024)
+#define PACKET_NO_BUCKET       ((size_t)-1)
+
+/* stored directly in front of the packet data */
+struct packet_header {
+	size_t        bucket;
+	volatile long refs;
+};
+
+static pthread_mutex_t packet_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static void *packet_pool[PACKET_POOL_BUCKETS];
+static struct obs_encoder_packet_stats packet_stats = {0};
+
+static inline size_t get_bucket_size(size_t bucket)
+{
+	size_t shift = bucket / PACKET_POOL_STEPS + PACKET_POOL_MIN_SHIFT;
+	size_t step  = bucket % PACKET_POOL_STEPS;
+
+	return ((size_t)1 << shift) +
+		step * ((size_t)1 << shift) / PACKET_POOL_STEPS;
+}
+
+static inline size_t get_bucket(size_t size)
+{
+	size_t shift = PACKET_POOL_MIN_SHIFT;
+	size_t base;
+	size_t step_size;
+
+	if (size <= ((size_t)1 << PACKET_POOL_MIN_SHIFT))
+		return 0;
+	if (size > ((size_t)1 << PACKET_POOL_MAX_SHIFT))
+		return PACKET_NO_BUCKET;
+
+	while (((size_t)1 << (shift + 1)) < size)
+		shift++;
+
+	base      = (size_t)1 << shift;
+	step_size = base / PACKET_POOL_STEPS;
+
+	return (shift - PACKET_POOL_MIN_SHIFT) * PACKET_POOL_STEPS +
+		(size - base + step_size - 1) / step_size;
+}
+
+static inline struct packet_header *get_packet_header(uint8_t *data)
+{
+	return ((struct packet_header*)data) - 1;
+}
+
+uint8_t *obs_encoder_packet_alloc(size_t size)
+{
+	struct packet_header *header = NULL;
+	size_t bucket = get_bucket(size);
+
+	pthread_mutex_lock(&packet_pool_mutex);
+
+	packet_stats.allocations++;
+
+	if (bucket != PACKET_NO_BUCKET && packet_pool[bucket]) {
+		header = packet_pool[bucket];
+		packet_pool[bucket] = *(void**)(header + 1);
+
+		packet_stats.pool_hits++;
+		packet_stats.bytes_pooled -= get_bucket_size(bucket);
+	}
+
+	pthread_mutex_unlock(&packet_pool_mutex);
+
+	if (!header) {
+		size_t alloc_size = bucket != PACKET_NO_BUCKET ?
+			get_bucket_size(bucket) : size;
+		header = bmalloc(sizeof(struct packet_header) + alloc_size);
+	}
+
+	header->bucket = bucket;
+	header->refs   = 1;
+	return (uint8_t*)(header + 1);
+}
+
+static void packet_free(struct packet_header *header)
+{
+	size_t bucket = header->bucket;
+
+	if (bucket != PACKET_NO_BUCKET) {
+		size_t size = get_bucket_size(bucket);
+
+		pthread_mutex_lock(&packet_pool_mutex);
+
+		/* the total is capped rather than each size class, so that
+		 * idle buffers never add up to more than this */
+		if (packet_stats.bytes_pooled + size <= PACKET_POOL_MAX_BYTES) {
+			*(void**)(header + 1) = packet_pool[bucket];
+			packet_pool[bucket] = header;
+
+			packet_stats.bytes_pooled += size;
+			header = NULL;
+		}
+
+		pthread_mutex_unlock(&packet_pool_mutex);
+	}
+
+	bfree(header);
+}
+
+void obs_encoder_packet_pool_free(void)
+{
+	pthread_mutex_lock(&packet_pool_mutex);
+
+	for (size_t i = 0; i < PACKET_POOL_BUCKETS; i++) {
+		while (packet_pool[i]) {
+			void *block = packet_pool[i];
+			packet_pool[i] = *(void**)((struct packet_header*)block + 1);
+			bfree(block);
+		}
+	}
+
+	packet_stats.bytes_pooled = 0;
+
+	pthread_mutex_unlock(&packet_pool_mutex);
+}
+
+void obs_encoder_packet_add_copied(size_t size)
+{
+	pthread_mutex_lock(&packet_pool_mutex);
+	packet_stats.bytes_copied += size;
+	pthread_mutex_unlock(&packet_pool_mutex);
+}
+
+void obs_encoder_packet_get_stats(struct obs_encoder_packet_stats *stats)
+{
+	if (!stats)
+		return;
+
+	pthread_mutex_lock(&packet_pool_mutex);
+	*stats = packet_stats;
+	pthread_mutex_unlock(&packet_pool_mutex);
+}
+
 void obs_encoder_packet_create_instance(struct encoder_packet *dst,
 		const struct encoder_packet *src)
 {
-	long *p_refs;
-
 	*dst = *src;
-	p_refs = bmalloc(src->size + sizeof(long));
-	dst->data = (void*)(p_refs + 1);
-	*p_refs = 1;
+	dst->data = obs_encoder_packet_alloc(src->size);
 	memcpy(dst->data, src->data, src->size);
+
+	obs_encoder_packet_add_copied(src->size);
 }
 
 void obs_duplicate_encoder_packet(struct encoder_packet *dst,
@@ -1065,8 +1275,8 @@ void obs_encoder_packet_ref(struct encoder_packet *dst,
 		return;
 
 	if (src->data) {
-		long *p_refs = ((long*)src->data) - 1;
-		os_atomic_inc_long(p_refs);
+		struct packet_header *header = get_packet_header(src->data);
+		os_atomic_inc_long(&header->refs);
 	}
 
 	*dst = *src;
@@ -1078,9 +1288,9 @@ void obs_encoder_packet_release(struct encoder_packet *pkt)
 		return;
 
 	if (pkt->data) {
-		long *p_refs = ((long*)pkt->data) - 1;
-		if (os_atomic_dec_long(p_refs) == 0)
-			bfree(p_refs);
+		struct packet_header *header = get_packet_header(pkt->data);
+		if (os_atomic_dec_long(&header->refs) == 0)
+			packet_free(header);
 	}
 
 	memset(pkt, 0, sizeof(struct encoder_packet));
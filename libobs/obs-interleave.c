@@ -0,0 +1,294 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "obs.h"
+#include "obs-interleave.h"
+
+/* packet must be the first member so that packet pointers handed out by the
+ * interleaver can be converted back */
+struct interleaved_packet {
+	struct encoder_packet packet;
+	uint64_t              seq;
+};
+
+#define ITEM_SIZE sizeof(struct interleaved_packet)
+
+static inline size_t get_track(enum obs_encoder_type type, size_t audio_idx)
+{
+	return type == OBS_ENCODER_VIDEO ? 0 : audio_idx + 1;
+}
+
+static inline size_t track_count(const struct circlebuf *track)
+{
+	return track->size / ITEM_SIZE;
+}
+
+static inline struct interleaved_packet *track_get(struct circlebuf *track,
+		size_t idx)
+{
+	return circlebuf_data(track, idx * ITEM_SIZE);
+}
+
+static inline bool packet_less(const struct interleaved_packet *a,
+		const struct interleaved_packet *b)
+{
+	if (a->packet.dts_usec != b->packet.dts_usec)
+		return a->packet.dts_usec < b->packet.dts_usec;
+	return a->seq < b->seq;
+}
+
+/* ------------------------------------------------------------------------- */
+/* min-heap of track indices, keyed on the packet at the front of each track */
+
+static inline bool heap_less(struct packet_interleaver *pi, size_t a,
+		size_t b)
+{
+	return packet_less(track_get(&pi->tracks[pi->heap[a]], 0),
+			track_get(&pi->tracks[pi->heap[b]], 0));
+}
+
+static inline void heap_swap(struct packet_interleaver *pi, size_t a,
+		size_t b)
+{
+	size_t tmp  = pi->heap[a];
+	pi->heap[a] = pi->heap[b];
+	pi->heap[b] = tmp;
+}
+
+static void heap_sift_up(struct packet_interleaver *pi, size_t idx)
+{
+	while (idx > 0) {
+		size_t parent = (idx - 1) / 2;
+		if (!heap_less(pi, idx, parent))
+			break;
+
+		heap_swap(pi, idx, parent);
+		idx = parent;
+	}
+}
+
+static void heap_sift_down(struct packet_interleaver *pi, size_t idx)
+{
+	while (true) {
+		size_t left  = idx * 2 + 1;
+		size_t right = left + 1;
+		size_t min   = idx;
+
+		if (left < pi->heap_size && heap_less(pi, left, min))
+			min = left;
+		if (right < pi->heap_size && heap_less(pi, right, min))
+			min = right;
+		if (min == idx)
+			break;
+
+		heap_swap(pi, idx, min);
+		idx = min;
+	}
+}
+
+static void heap_rebuild(struct packet_interleaver *pi)
+{
+	pi->heap_size = 0;
+
+	for (size_t i = 0; i < INTERLEAVE_TRACKS; i++) {
+		if (pi->tracks[i].size)
+			pi->heap[pi->heap_size++] = i;
+	}
+
+	for (size_t i = pi->heap_size / 2; i > 0; i--)
+		heap_sift_down(pi, i - 1);
+}
+
+/* ------------------------------------------------------------------------- */
+
+void interleaver_init(struct packet_interleaver *pi)
+{
+	memset(pi, 0, sizeof(*pi));
+}
+
+void interleaver_free(struct packet_interleaver *pi)
+{
+	struct encoder_packet packet;
+
+	while (interleaver_pop(pi, &packet))
+		obs_encoder_packet_release(&packet);
+
+	for (size_t i = 0; i < INTERLEAVE_TRACKS; i++)
+		circlebuf_free(&pi->tracks[i]);
+
+	interleaver_init(pi);
+}
+
+void interleaver_push(struct packet_interleaver *pi,
+		const struct encoder_packet *packet)
+{
+	struct interleaved_packet item = {*packet, pi->next_seq++};
+	size_t track_idx = get_track(packet->type, packet->track_idx);
+	struct circlebuf *track = &pi->tracks[track_idx];
+	size_t count = track_count(track);
+
+	pi->num_packets++;
+
+	if (!count) {
+		circlebuf_push_back(track, &item, ITEM_SIZE);
+		pi->heap[pi->heap_size] = track_idx;
+		heap_sift_up(pi, pi->heap_size++);
+		return;
+	}
+
+	if (!packet_less(&item, track_get(track, count - 1))) {
+		circlebuf_push_back(track, &item, ITEM_SIZE);
+		return;
+	}
+
+	/* encoders output packets in DTS order, so this should rarely if
+	 * ever happen; move the newer packets aside to insert it in order */
+	DARRAY(struct interleaved_packet) newer;
+	da_init(newer);
+
+	while (count && packet_less(&item, track_get(track, count - 1))) {
+		struct interleaved_packet *back = da_push_back_new(newer);
+		circlebuf_pop_back(track, back, ITEM_SIZE);
+		count--;
+	}
+
+	circlebuf_push_back(track, &item, ITEM_SIZE);
+
+	for (size_t i = newer.num; i > 0; i--)
+		circlebuf_push_back(track, newer.array + (i - 1), ITEM_SIZE);
+
+	da_free(newer);
+	heap_rebuild(pi);
+}
+
+struct encoder_packet *interleaver_peek(struct packet_interleaver *pi)
+{
+	if (!pi->heap_size)
+		return NULL;
+
+	return &track_get(&pi->tracks[pi->heap[0]], 0)->packet;
+}
+
+bool interleaver_pop(struct packet_interleaver *pi,
+		struct encoder_packet *packet)
+{
+	struct interleaved_packet item;
+	struct circlebuf *track;
+
+	if (!pi->heap_size)
+		return false;
+
+	track = &pi->tracks[pi->heap[0]];
+	circlebuf_pop_front(track, &item, ITEM_SIZE);
+	*packet = item.packet;
+	pi->num_packets--;
+
+	if (!track->size)
+		pi->heap[0] = pi->heap[--pi->heap_size];
+	if (pi->heap_size)
+		heap_sift_down(pi, 0);
+
+	return true;
+}
+
+bool interleaver_less(const struct encoder_packet *a,
+		const struct encoder_packet *b)
+{
+	return packet_less((const struct interleaved_packet*)a,
+			(const struct interleaved_packet*)b);
+}
+
+size_t interleaver_track_size(struct packet_interleaver *pi,
+		enum obs_encoder_type type, size_t audio_idx)
+{
+	return track_count(&pi->tracks[get_track(type, audio_idx)]);
+}
+
+struct encoder_packet *interleaver_get(struct packet_interleaver *pi,
+		enum obs_encoder_type type, size_t audio_idx, size_t idx)
+{
+	struct circlebuf *track = &pi->tracks[get_track(type, audio_idx)];
+
+	if (idx >= track_count(track))
+		return NULL;
+
+	return &track_get(track, idx)->packet;
+}
+
+struct encoder_packet *interleaver_first(struct packet_interleaver *pi,
+		enum obs_encoder_type type, size_t audio_idx)
+{
+	return interleaver_get(pi, type, audio_idx, 0);
+}
+
+struct encoder_packet *interleaver_last(struct packet_interleaver *pi,
+		enum obs_encoder_type type, size_t audio_idx)
+{
+	size_t count = interleaver_track_size(pi, type, audio_idx);
+	return count ? interleaver_get(pi, type, audio_idx, count - 1) : NULL;
+}
+
+void interleaver_discard_to(struct packet_interleaver *pi,
+		const struct encoder_packet *packet, bool inclusive)
+{
+	struct interleaved_packet key =
+		*(const struct interleaved_packet*)packet;
+	struct encoder_packet *front;
+	struct encoder_packet out;
+
+	while ((front = interleaver_peek(pi)) != NULL) {
+		const struct interleaved_packet *item =
+			(const struct interleaved_packet*)front;
+
+		if (inclusive ? packet_less(&key, item) :
+				!packet_less(item, &key))
+			break;
+
+		interleaver_pop(pi, &out);
+		obs_encoder_packet_release(&out);
+	}
+}
+
+void interleaver_discard_to_dts(struct packet_interleaver *pi,
+		int64_t dts_usec)
+{
+	struct encoder_packet *front;
+	struct encoder_packet out;
+
+	while ((front = interleaver_peek(pi)) != NULL) {
+		if (front->dts_usec >= dts_usec)
+			break;
+
+		interleaver_pop(pi, &out);
+		obs_encoder_packet_release(&out);
+	}
+}
+
+void interleaver_update(struct packet_interleaver *pi,
+		void (*update)(void *param, struct encoder_packet *packet),
+		void *param)
+{
+	for (size_t i = 0; i < INTERLEAVE_TRACKS; i++) {
+		struct circlebuf *track = &pi->tracks[i];
+		size_t count = track_count(track);
+
+		for (size_t j = 0; j < count; j++)
+			update(param, &track_get(track, j)->packet);
+	}
+
+	heap_rebuild(pi);
+}
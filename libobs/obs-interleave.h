@@ -0,0 +1,111 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "util/c99defs.h"
+#include "util/circlebuf.h"
+#include "obs-encoder.h"
+
+/*
+ * Output packet interleaver
+ *
+ *   Keeps a FIFO of packets for each track (video, plus one for each audio
+ * mix), and merges them in DTS order with a min-heap keyed on the DTS of the
+ * packet at the front of each track.  Packets with identical DTS values are
+ * merged in the order they were pushed.  Pushing and popping are
+ * O(log tracks) regardless of how many packets are buffered.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define INTERLEAVE_TRACKS (MAX_AUDIO_MIXES + 1)
+
+struct packet_interleaver {
+	struct circlebuf tracks[INTERLEAVE_TRACKS];
+	size_t           heap[INTERLEAVE_TRACKS];
+	size_t           heap_size;
+	uint64_t         next_seq;
+	size_t           num_packets;
+};
+
+EXPORT void interleaver_init(struct packet_interleaver *pi);
+
+/** Releases all buffered packets and frees the interleaver's memory */
+EXPORT void interleaver_free(struct packet_interleaver *pi);
+
+/** Takes ownership of the packet's reference */
+EXPORT void interleaver_push(struct packet_interleaver *pi,
+		const struct encoder_packet *packet);
+
+/** Returns the packet with the lowest DTS, or NULL if empty */
+EXPORT struct encoder_packet *interleaver_peek(struct packet_interleaver *pi);
+
+/** Removes the packet with the lowest DTS, transferring its reference */
+EXPORT bool interleaver_pop(struct packet_interleaver *pi,
+		struct encoder_packet *packet);
+
+/**
+ * Returns true if buffered packet a comes before buffered packet b in merge
+ * order.  Both packets must have been returned by this interleaver.
+ */
+EXPORT bool interleaver_less(const struct encoder_packet *a,
+		const struct encoder_packet *b);
+
+/** Returns the number of packets buffered for a given type/track */
+EXPORT size_t interleaver_track_size(struct packet_interleaver *pi,
+		enum obs_encoder_type type, size_t audio_idx);
+
+/** Returns a buffered packet of a given type/track in DTS order */
+EXPORT struct encoder_packet *interleaver_get(struct packet_interleaver *pi,
+		enum obs_encoder_type type, size_t audio_idx, size_t idx);
+
+EXPORT struct encoder_packet *interleaver_first(struct packet_interleaver *pi,
+		enum obs_encoder_type type, size_t audio_idx);
+EXPORT struct encoder_packet *interleaver_last(struct packet_interleaver *pi,
+		enum obs_encoder_type type, size_t audio_idx);
+
+/**
+ * Releases every packet that comes before the given buffered packet in merge
+ * order (or up to and including it if inclusive is true)
+ */
+EXPORT void interleaver_discard_to(struct packet_interleaver *pi,
+		const struct encoder_packet *packet, bool inclusive);
+
+/** Releases packets from the front until one has a DTS of at least dts_usec */
+EXPORT void interleaver_discard_to_dts(struct packet_interleaver *pi,
+		int64_t dts_usec);
+
+/**
+ * Calls a function on every buffered packet and then restores the merge
+ * order.  The function must keep each track's packets in order relative to
+ * one another (such as by applying a per-track offset).
+ */
+EXPORT void interleaver_update(struct packet_interleaver *pi,
+		void (*update)(void *param, struct encoder_packet *packet),
+		void *param);
+
+static inline size_t interleaver_size(const struct packet_interleaver *pi)
+{
+	return pi->num_packets;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -24,6 +24,7 @@
 #include "util/threading.h"
 #include "util/platform.h"
 #include "util/profiler.h"
+#include "util/threadpool.h"
 #include "callback/signal.h"
 #include "callback/proc.h"
 
@@ -33,12 +34,20 @@
 #include "media-io/audio-resampler.h"
 #include "media-io/video-io.h"
 #include "media-io/audio-io.h"
+#include "media-io/audio-mix.h"
 
 #include "obs.h"
+#include "obs-interleave.h"
 
-#define NUM_TEXTURES 2
+#define MIN_TEXTURES 2
+#define MAX_TEXTURES 8
+#define MAX_CONVERT_THREADS 7
+#define MAX_CONVERT_BANDS (MAX_CONVERT_THREADS + 1)
 #define MICROSECOND_DEN 1000000
 
+/* maximum amount of audio buffering in frames, regardless of block size */
+#define MAX_BUFFERING_FRAMES (45 * AUDIO_OUTPUT_FRAMES)
+
 static inline int64_t packet_dts_usec(struct encoder_packet *packet)
 {
 	return packet->dts * MICROSECOND_DEN / packet->timebase_den;
@@ -222,14 +231,15 @@ struct obs_vframe_info {
 
 struct obs_core_video {
 	graphics_t                      *graphics;
-	gs_stagesurf_t                  *copy_surfaces[NUM_TEXTURES];
-	gs_texture_t                    *render_textures[NUM_TEXTURES];
-	gs_texture_t                    *output_textures[NUM_TEXTURES];
-	gs_texture_t                    *convert_textures[NUM_TEXTURES];
-	bool                            textures_rendered[NUM_TEXTURES];
-	bool                            textures_output[NUM_TEXTURES];
-	bool                            textures_copied[NUM_TEXTURES];
-	bool                            textures_converted[NUM_TEXTURES];
+	gs_stagesurf_t                  *copy_surfaces[MAX_TEXTURES];
+	gs_texture_t                    *render_textures[MAX_TEXTURES];
+	gs_texture_t                    *output_textures[MAX_TEXTURES];
+	gs_texture_t                    *convert_textures[MAX_TEXTURES];
+	bool                            textures_rendered[MAX_TEXTURES];
+	bool                            textures_output[MAX_TEXTURES];
+	bool                            textures_copied[MAX_TEXTURES];
+	bool                            textures_converted[MAX_TEXTURES];
+	int                             num_textures;
 	struct circlebuf                vframe_info_buffer;
 	gs_effect_t                     *default_effect;
 	gs_effect_t                     *default_rect_effect;
@@ -244,6 +254,10 @@ struct obs_core_video {
 	gs_stagesurf_t                  *mapped_surface;
 	int                             cur_texture;
 
+	uint64_t                        map_wait_total_ns;
+	uint64_t                        map_wait_max_ns;
+	uint32_t                        map_count;
+
 	uint64_t                        video_time;
 	uint64_t                        video_avg_frame_time_ns;
 	double                          video_fps;
@@ -251,6 +265,16 @@ struct obs_core_video {
 	pthread_t                       video_thread;
 	uint32_t                        total_frames;
 	uint32_t                        lagged_frames;
+	uint32_t                        culled_items;
+	uint32_t                        last_culled_items;
+	/* number of scene items currently being drawn straight into their
+	 * scene, anything drawn inside of them isn't clipped to the canvas */
+	uint32_t                        unclipped_item_depth;
+	bool                            render_cache_disabled;
+	gs_texture_t                    *render_cache_target;
+	uint64_t                        last_texrender_hits;
+	uint64_t                        last_texrender_misses;
+	struct gs_draw_stats            last_draw_stats;
 	bool                            thread_initialized;
 
 	bool                            gpu_conversion;
@@ -259,6 +283,8 @@ struct obs_core_video {
 	uint32_t                        plane_offsets[3];
 	uint32_t                        plane_sizes[3];
 	uint32_t                        plane_linewidth[3];
+	os_threadpool_t                 *convert_pool;
+	const char                      *convert_band_names[MAX_CONVERT_BANDS];
 
 	uint32_t                        output_width;
 	uint32_t                        output_height;
@@ -282,6 +308,7 @@ struct obs_core_video {
 };
 
 struct audio_monitor;
+struct obs_meter_feed;
 
 struct obs_core_audio {
 	audio_t                         *audio;
@@ -293,6 +320,11 @@ struct obs_core_audio {
 	struct circlebuf                buffered_timestamps;
 	int                             buffering_wait_ticks;
 	int                             total_buffering_ticks;
+	int                             max_buffering_ticks;
+
+	/* frames per audio tick.  audio buffers are always allocated for
+	 * AUDIO_OUTPUT_FRAMES, the largest block size */
+	size_t                          block_frames;
 
 	float                           user_volume;
 
@@ -300,6 +332,9 @@ struct obs_core_audio {
 	DARRAY(struct audio_monitor*)   monitors;
 	char                            *monitoring_device_name;
 	char                            *monitoring_device_id;
+
+	pthread_mutex_t                 meter_mutex;
+	DARRAY(struct obs_meter_feed*)  meter_feeds;
 };
 
 /* user sources, output channels, and displays */
@@ -378,6 +413,7 @@ struct obs_core {
 
 	signal_handler_t                *signals;
 	proc_handler_t                  *procs;
+	signal_handle_t                 *source_volume_signal;
 
 	char                            *locale;
 	char                            *module_config_path;
@@ -577,6 +613,7 @@ struct obs_source {
 	struct circlebuf                audio_input_buf[MAX_AUDIO_CHANNELS];
 	size_t                          last_audio_input_buf_size;
 	DARRAY(struct audio_action)     audio_actions;
+	signal_handle_t                 *volume_signal;
 	float                           *audio_output_buf[MAX_AUDIO_MIXES][MAX_AUDIO_CHANNELS];
 	struct resample_info            sample_info;
 	audio_resampler_t               *resampler;
@@ -642,6 +679,11 @@ struct obs_source {
 	enum obs_allow_direct_render    allow_direct;
 	bool                            rendering_filter;
 
+	/* render cache, used for sources drawn more than once per frame */
+	gs_texrender_t                  *render_cache;
+	uint32_t                        render_count;
+	uint32_t                        last_render_count;
+
 	/* sources specific hotkeys */
 	obs_hotkey_pair_id              mute_unmute_key;
 	obs_hotkey_id                   push_to_mute_key;
@@ -822,7 +864,7 @@ struct obs_output {
 	pthread_t                       end_data_capture_thread;
 	os_event_t                      *stopping_event;
 	pthread_mutex_t                 interleaved_mutex;
-	DARRAY(struct encoder_packet)   interleaved_packets;
+	struct packet_interleaver       interleaved_packets;
 	int                             stop_code;
 
 	int                             reconnect_retry_sec;
@@ -901,6 +943,9 @@ extern void obs_output_remove_encoder(struct obs_output *output,
 
 extern void obs_encoder_packet_create_instance(struct encoder_packet *dst,
 		const struct encoder_packet *src);
+extern uint8_t *obs_encoder_packet_alloc(size_t size);
+extern void obs_encoder_packet_add_copied(size_t size);
+extern void obs_encoder_packet_pool_free(void);
 void obs_output_destroy(obs_output_t *output);
 
 
@@ -940,6 +985,10 @@ struct obs_encoder {
 	volatile bool                   active;
 	bool                            initialized;
 
+	/* encode on a dedicated thread rather than inline on the video/audio
+	 * output thread (the default for audio encoders) */
+	bool                            threaded;
+
 	/* indicates ownership of the info.id buffer */
 	bool                            owns_info_id;
 
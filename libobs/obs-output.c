@@ -164,9 +164,7 @@ fail:
 
 static inline void free_packets(struct obs_output *output)
 {
-	for (size_t i = 0; i < output->interleaved_packets.num; i++)
-		obs_encoder_packet_release(output->interleaved_packets.array+i);
-	da_free(output->interleaved_packets);
+	interleaver_free(&output->interleaved_packets);
 }
 
 void obs_output_destroy(obs_output_t *output)
@@ -951,6 +949,12 @@ static inline void apply_interleaved_packet_offset(struct obs_output *output,
 	out->dts_usec = packet_dts_usec(out);
 }
 
+static void update_interleaved_packet_offset(void *param,
+		struct encoder_packet *packet)
+{
+	apply_interleaved_packet_offset(param, packet);
+}
+
 static inline bool has_higher_opposing_ts(struct obs_output *output,
 		struct encoder_packet *packet)
 {
@@ -970,7 +974,6 @@ static bool add_caption(struct obs_output *output, struct encoder_packet *out)
 	sei_t sei;
 	uint8_t *data;
 	size_t size;
-	long ref = 1;
 
 	DARRAY(uint8_t) out_data;
 
@@ -980,7 +983,6 @@ static bool add_caption(struct obs_output *output, struct encoder_packet *out)
 	sei_init(&sei);
 
 	da_init(out_data);
-	da_push_back_array(out_data, &ref, sizeof(ref));
 	da_push_back_array(out_data, out->data, out->size);
 
 	caption_frame_init(&cf);
@@ -998,8 +1000,11 @@ static bool add_caption(struct obs_output *output, struct encoder_packet *out)
 	obs_encoder_packet_release(out);
 
 	*out = backup;
-	out->data = (uint8_t*)out_data.array + sizeof(ref);
-	out->size = out_data.num - sizeof(ref);
+	out->size = out_data.num;
+	out->data = obs_encoder_packet_alloc(out->size);
+	memcpy(out->data, out_data.array, out->size);
+	obs_encoder_packet_add_copied(out->size);
+	da_free(out_data);
 
 	sei_free(&sei);
 
@@ -1012,15 +1017,17 @@ static bool add_caption(struct obs_output *output, struct encoder_packet *out)
 
 static inline void send_interleaved(struct obs_output *output)
 {
-	struct encoder_packet out = output->interleaved_packets.array[0];
+	struct encoder_packet *next = interleaver_peek(
+			&output->interleaved_packets);
+	struct encoder_packet out;
 
 	/* do not send an interleaved packet if there's no packet of the
 	 * opposing type of a higher timestamp in the interleave buffer.
 	 * this ensures that the timestamps are monotonic */
-	if (!has_higher_opposing_ts(output, &out))
+	if (!next || !has_higher_opposing_ts(output, next))
 		return;
 
-	da_erase(output->interleaved_packets, 0);
+	interleaver_pop(&output->interleaved_packets, &out);
 
 	if (out.type == OBS_ENCODER_VIDEO) {
 		output->total_frames++;
@@ -1067,182 +1074,140 @@ static inline void set_higher_ts(struct obs_output *output,
 
 static inline struct encoder_packet *find_first_packet_type(
 		struct obs_output *output, enum obs_encoder_type type,
-		size_t audio_idx);
-static int find_first_packet_type_idx(struct obs_output *output,
-		enum obs_encoder_type type, size_t audio_idx);
+		size_t audio_idx)
+{
+	return interleaver_first(&output->interleaved_packets, type,
+			audio_idx);
+}
+
+static inline struct encoder_packet *find_last_packet_type(
+		struct obs_output *output, enum obs_encoder_type type,
+		size_t audio_idx)
+{
+	return interleaver_last(&output->interleaved_packets, type,
+			audio_idx);
+}
 
 /* gets the point where audio and video are closest together */
-static size_t get_interleaved_start_idx(struct obs_output *output)
+static struct encoder_packet *get_interleaved_start_packet(
+		struct obs_output *output)
 {
+	struct packet_interleaver *pi = &output->interleaved_packets;
 	int64_t closest_diff = 0x7FFFFFFFFFFFFFFFLL;
 	struct encoder_packet *first_video = find_first_packet_type(output,
 			OBS_ENCODER_VIDEO, 0);
-	size_t video_idx = DARRAY_INVALID;
-	size_t idx = 0;
-
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		int64_t diff;
-
-		if (packet->type != OBS_ENCODER_AUDIO) {
-			if (packet == first_video)
-				video_idx = i;
-			continue;
-		}
+	struct encoder_packet *closest = NULL;
+
+	if (!first_video)
+		return NULL;
 
-		diff = llabs(packet->dts_usec - first_video->dts_usec);
-		if (diff < closest_diff) {
-			closest_diff = diff;
-			idx = i;
+	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		size_t count = interleaver_track_size(pi, OBS_ENCODER_AUDIO, i);
+
+		for (size_t j = 0; j < count; j++) {
+			struct encoder_packet *packet = interleaver_get(pi,
+					OBS_ENCODER_AUDIO, i, j);
+			int64_t diff;
+
+			diff = llabs(packet->dts_usec - first_video->dts_usec);
+			if (diff < closest_diff || (diff == closest_diff && closest &&
+			    interleaver_less(packet, closest))) {
+				closest_diff = diff;
+				closest = packet;
+			}
 		}
 	}
 
-	return video_idx < idx ? video_idx : idx;
+	if (!closest)
+		return NULL;
+
+	return interleaver_less(first_video, closest) ? first_video : closest;
 }
 
-static int prune_premature_packets(struct obs_output *output)
+static int prune_premature_packets(struct obs_output *output,
+		struct encoder_packet **last_premature)
 {
 	size_t audio_mixes = num_audio_mixes(output);
 	struct encoder_packet *video;
-	int video_idx;
-	int max_idx;
 	int64_t duration_usec;
 	int64_t max_diff = 0;
 	int64_t diff = 0;
 
-	video_idx = find_first_packet_type_idx(output, OBS_ENCODER_VIDEO, 0);
-	if (video_idx == -1) {
+	video = find_first_packet_type(output, OBS_ENCODER_VIDEO, 0);
+	if (!video) {
 		output->received_video = false;
 		return -1;
 	}
 
-	max_idx = video_idx;
-	video = &output->interleaved_packets.array[video_idx];
+	*last_premature = video;
 	duration_usec = video->timebase_num * 1000000LL / video->timebase_den;
 
 	for (size_t i = 0; i < audio_mixes; i++) {
 		struct encoder_packet *audio;
-		int audio_idx;
 
-		audio_idx = find_first_packet_type_idx(output,
-				OBS_ENCODER_AUDIO, i);
-		if (audio_idx == -1) {
+		audio = find_first_packet_type(output, OBS_ENCODER_AUDIO, i);
+		if (!audio) {
 			output->received_audio = false;
 			return -1;
 		}
 
-		audio = &output->interleaved_packets.array[audio_idx];
-		if (audio_idx > max_idx)
-			max_idx = audio_idx;
+		if (interleaver_less(*last_premature, audio))
+			*last_premature = audio;
 
 		diff = audio->dts_usec - video->dts_usec;
 		if (diff > max_diff)
 			max_diff = diff;
 	}
 
-	return diff > duration_usec ? max_idx + 1 : 0;
+	return diff > duration_usec ? 1 : 0;
 }
 
-static void discard_to_idx(struct obs_output *output, size_t idx)
+#define DEBUG_STARTING_PACKETS 0
+
+#if DEBUG_STARTING_PACKETS == 1
+static void log_interleaved_track(struct obs_output *output,
+		enum obs_encoder_type type, size_t audio_idx)
 {
-	for (size_t i = 0; i < idx; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		obs_encoder_packet_release(packet);
-	}
+	struct packet_interleaver *pi = &output->interleaved_packets;
+	size_t count = interleaver_track_size(pi, type, audio_idx);
 
-	da_erase_range(output->interleaved_packets, 0, idx);
+	for (size_t i = 0; i < count; i++) {
+		struct encoder_packet *packet = interleaver_get(pi, type,
+				audio_idx, i);
+		blog(LOG_DEBUG, "packet: %s %d, ts: %lld",
+				type == OBS_ENCODER_AUDIO ? "audio" : "video",
+				(int)audio_idx, packet->dts_usec);
+	}
 }
-
-#define DEBUG_STARTING_PACKETS 0
+#endif
 
 static bool prune_interleaved_packets(struct obs_output *output)
 {
-	size_t start_idx = 0;
-	int prune_start = prune_premature_packets(output);
+	struct encoder_packet *start = NULL;
+	int prune = prune_premature_packets(output, &start);
 
 #if DEBUG_STARTING_PACKETS == 1
-	blog(LOG_DEBUG, "--------- Pruning! %d ---------", prune_start);
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		blog(LOG_DEBUG, "packet: %s %d, ts: %lld, pruned = %s",
-				packet->type == OBS_ENCODER_AUDIO ?
-				"audio" : "video", (int)packet->track_idx,
-				packet->dts_usec,
-				(int)i < prune_start ? "true" : "false");
-	}
+	blog(LOG_DEBUG, "--------- Pruning! %d ---------", prune);
+	log_interleaved_track(output, OBS_ENCODER_VIDEO, 0);
+	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++)
+		log_interleaved_track(output, OBS_ENCODER_AUDIO, i);
 #endif
 
 	/* prunes the first video packet if it's too far away from audio */
-	if (prune_start == -1)
+	if (prune == -1) {
 		return false;
-	else if (prune_start != 0)
-		start_idx = (size_t)prune_start;
-	else
-		start_idx = get_interleaved_start_idx(output);
-
-	if (start_idx)
-		discard_to_idx(output, start_idx);
-
-	return true;
-}
-
-static int find_first_packet_type_idx(struct obs_output *output,
-		enum obs_encoder_type type, size_t audio_idx)
-{
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-
-		if (packet->type == type) {
-			if (type == OBS_ENCODER_AUDIO &&
-			    packet->track_idx != audio_idx) {
-				continue;
-			}
-
-			return (int)i;
-		}
-	}
-
-	return -1;
-}
-
-static int find_last_packet_type_idx(struct obs_output *output,
-		enum obs_encoder_type type, size_t audio_idx)
-{
-	for (size_t i = output->interleaved_packets.num; i > 0; i--) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i - 1];
-
-		if (packet->type == type) {
-			if (type == OBS_ENCODER_AUDIO &&
-			    packet->track_idx != audio_idx) {
-				continue;
-			}
 
-			return (int)(i - 1);
-		}
+	} else if (prune != 0) {
+		interleaver_discard_to(&output->interleaved_packets, start,
+				true);
+	} else {
+		start = get_interleaved_start_packet(output);
+		if (start)
+			interleaver_discard_to(&output->interleaved_packets,
+					start, false);
 	}
 
-	return -1;
-}
-
-static inline struct encoder_packet *find_first_packet_type(
-		struct obs_output *output, enum obs_encoder_type type,
-		size_t audio_idx)
-{
-	int idx = find_first_packet_type_idx(output, type, audio_idx);
-	return (idx != -1) ? &output->interleaved_packets.array[idx] : NULL;
-}
-
-static inline struct encoder_packet *find_last_packet_type(
-		struct obs_output *output, enum obs_encoder_type type,
-		size_t audio_idx)
-{
-	int idx = find_last_packet_type_idx(output, type, audio_idx);
-	return (idx != -1) ? &output->interleaved_packets.array[idx] : NULL;
+	return true;
 }
 
 static bool get_audio_and_video_packets(struct obs_output *output,
@@ -1274,7 +1239,7 @@ static bool initialize_interleaved_packets(struct obs_output *output)
 	struct encoder_packet *audio[MAX_AUDIO_MIXES];
 	struct encoder_packet *last_audio[MAX_AUDIO_MIXES];
 	size_t audio_mixes = num_audio_mixes(output);
-	size_t start_idx;
+	struct encoder_packet *start;
 
 	if (!get_audio_and_video_packets(output, &video, audio, audio_mixes))
 		return false;
@@ -1292,9 +1257,10 @@ static bool initialize_interleaved_packets(struct obs_output *output)
 	}
 
 	/* clear out excess starting audio if it hasn't been already */
-	start_idx = get_interleaved_start_idx(output);
-	if (start_idx) {
-		discard_to_idx(output, start_idx);
+	start = get_interleaved_start_packet(output);
+	if (start && start != interleaver_peek(&output->interleaved_packets)) {
+		interleaver_discard_to(&output->interleaved_packets, start,
+				false);
 		if (!get_audio_and_video_packets(output, &video, audio,
 					audio_mixes))
 			return false;
@@ -1320,61 +1286,12 @@ static bool initialize_interleaved_packets(struct obs_output *output)
 	output->highest_video_ts -= video->dts_usec;
 
 	/* apply new offsets to all existing packet DTS/PTS values */
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		apply_interleaved_packet_offset(output, packet);
-	}
+	interleaver_update(&output->interleaved_packets,
+			update_interleaved_packet_offset, output);
 
 	return true;
 }
 
-static inline void insert_interleaved_packet(struct obs_output *output,
-		struct encoder_packet *out)
-{
-	size_t idx;
-	for (idx = 0; idx < output->interleaved_packets.num; idx++) {
-		struct encoder_packet *cur_packet;
-		cur_packet = output->interleaved_packets.array + idx;
-
-		if (out->dts_usec < cur_packet->dts_usec)
-			break;
-	}
-
-	da_insert(output->interleaved_packets, idx, out);
-}
-
-static void resort_interleaved_packets(struct obs_output *output)
-{
-	DARRAY(struct encoder_packet) old_array;
-
-	old_array.da = output->interleaved_packets.da;
-	memset(&output->interleaved_packets, 0,
-			sizeof(output->interleaved_packets));
-
-	for (size_t i = 0; i < old_array.num; i++)
-		insert_interleaved_packet(output, &old_array.array[i]);
-
-	da_free(old_array);
-}
-
-static void discard_unused_audio_packets(struct obs_output *output,
-		int64_t dts_usec)
-{
-	size_t idx = 0;
-
-	for (; idx < output->interleaved_packets.num; idx++) {
-		struct encoder_packet *p =
-			&output->interleaved_packets.array[idx];
-
-		if (p->dts_usec >= dts_usec)
-			break;
-	}
-
-	if (idx)
-		discard_to_idx(output, idx);
-}
-
 static void interleave_packets(void *data, struct encoder_packet *packet)
 {
 	struct obs_output     *output = data;
@@ -1393,7 +1310,8 @@ static void interleave_packets(void *data, struct encoder_packet *packet)
 	if (!output->received_video &&
 	    packet->type == OBS_ENCODER_VIDEO &&
 	    !packet->keyframe) {
-		discard_unused_audio_packets(output, packet->dts_usec);
+		interleaver_discard_to_dts(&output->interleaved_packets,
+				packet->dts_usec);
 		pthread_mutex_unlock(&output->interleaved_mutex);
 
 		if (output->active_delay_ns)
@@ -1406,14 +1324,14 @@ static void interleave_packets(void *data, struct encoder_packet *packet)
 	if (output->active_delay_ns)
 		out = *packet;
 	else
-		obs_encoder_packet_create_instance(&out, packet);
+		obs_encoder_packet_ref(&out, packet);
 
 	if (was_started)
 		apply_interleaved_packet_offset(output, &out);
 	else
 		check_received(output, packet);
 
-	insert_interleaved_packet(output, &out);
+	interleaver_push(&output->interleaved_packets, &out);
 	set_higher_ts(output, &out);
 
 	/* when both video and audio have been received, we're ready
@@ -1421,10 +1339,8 @@ static void interleave_packets(void *data, struct encoder_packet *packet)
 	if (output->received_audio && output->received_video) {
 		if (!was_started) {
 			if (prune_interleaved_packets(output)) {
-				if (initialize_interleaved_packets(output)) {
-					resort_interleaved_packets(output);
+				if (initialize_interleaved_packets(output))
 					send_interleaved(output);
-				}
 			}
 		} else {
 			send_interleaved(output);
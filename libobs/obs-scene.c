@@ -67,6 +67,7 @@ static void *scene_create(obs_data_t *settings, struct obs_source *source)
 	struct obs_scene *scene = bmalloc(sizeof(struct obs_scene));
 	scene->source     = source;
 	scene->first_item = NULL;
+	da_init(scene->occluders);
 
 	signal_handler_add_array(obs_source_get_signal_handler(source),
 			obs_scene_signals);
@@ -159,6 +160,7 @@ static void scene_destroy(void *data)
 
 	pthread_mutex_destroy(&scene->video_mutex);
 	pthread_mutex_destroy(&scene->audio_mutex);
+	da_free(scene->occluders);
 	bfree(scene);
 }
 
@@ -311,6 +313,36 @@ static inline uint32_t calc_cy(const struct obs_scene_item *item,
 	return (crop_cy > height) ? 2 : (height - crop_cy);
 }
 
+static void update_draw_rect(struct obs_scene_item *item, uint32_t width,
+		uint32_t height)
+{
+	struct vec3 corners[4];
+	struct cull_rect *rect = &item->draw_rect;
+
+	item->draw_rect_valid = width && height;
+	if (!item->draw_rect_valid)
+		return;
+
+	vec3_set(&corners[0], 0.0f,          0.0f,           0.0f);
+	vec3_set(&corners[1], (float)width,  0.0f,           0.0f);
+	vec3_set(&corners[2], 0.0f,          (float)height,  0.0f);
+	vec3_set(&corners[3], (float)width,  (float)height,  0.0f);
+
+	vec2_set(&rect->min, M_INFINITE, M_INFINITE);
+	vec2_set(&rect->max, -M_INFINITE, -M_INFINITE);
+
+	for (size_t i = 0; i < 4; i++) {
+		vec3_transform(&corners[i], &corners[i], &item->draw_transform);
+
+		rect->min.x = fminf(rect->min.x, corners[i].x);
+		rect->min.y = fminf(rect->min.y, corners[i].y);
+		rect->max.x = fmaxf(rect->max.x, corners[i].x);
+		rect->max.y = fmaxf(rect->max.y, corners[i].y);
+	}
+
+	item->draw_rect_filled = fmodf(item->rot, 90.0f) == 0.0f;
+}
+
 static void update_item_transform(struct obs_scene_item *item)
 {
 	uint32_t        width         = obs_source_get_width(item->source);
@@ -355,6 +387,8 @@ static void update_item_transform(struct obs_scene_item *item)
 
 	item->output_scale = scale;
 
+	update_draw_rect(item, width, height);
+
 	/* ----------------------- */
 
 	if (item->bounds_type != OBS_BOUNDS_NONE) {
@@ -422,8 +456,13 @@ static void render_item_texture(struct obs_scene_item *item)
 	gs_texture_t *tex = gs_texrender_get_texture(item->item_render);
 	gs_effect_t *effect = obs->video.default_effect;
 	enum obs_scale_type type = item->scale_filter;
-	uint32_t cx = gs_texture_get_width(tex);
-	uint32_t cy = gs_texture_get_height(tex);
+	uint32_t cx, cy;
+
+	if (!tex)
+		return;
+
+	cx = gs_texture_get_width(tex);
+	cy = gs_texture_get_height(tex);
 
 	if (type != OBS_SCALE_DISABLE) {
 		if (type == OBS_SCALE_POINT) {
@@ -486,11 +525,17 @@ static inline void render_item(struct obs_scene_item *item)
 					-(float)item->crop.top,
 					0.0f);
 
+			/* the texture clips the source to its own size */
+			uint32_t depth = obs->video.unclipped_item_depth;
+			obs->video.unclipped_item_depth = 0;
+
 			gs_blend_state_push();
 			gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
 			obs_source_video_render(item->source);
 			gs_blend_state_pop();
 			gs_texrender_end(item->item_render);
+
+			obs->video.unclipped_item_depth = depth;
 		}
 	}
 
@@ -499,7 +544,9 @@ static inline void render_item(struct obs_scene_item *item)
 	if (item->item_render) {
 		render_item_texture(item);
 	} else {
+		obs->video.unclipped_item_depth++;
 		obs_source_video_render(item->source);
+		obs->video.unclipped_item_depth--;
 	}
 	gs_matrix_pop();
 }
@@ -521,20 +568,136 @@ static void scene_video_tick(void *data, float seconds)
 	UNUSED_PARAMETER(seconds);
 }
 
+/* only the largest opaque areas are kept, scenes made of many small opaque
+ * items would otherwise test every item against every item above it */
+#define MAX_OCCLUDERS 8
+
+static inline float rect_area(const struct cull_rect *rect)
+{
+	return (rect->max.x - rect->min.x) * (rect->max.y - rect->min.y);
+}
+
+static void add_occluder(struct obs_scene *scene, const struct cull_rect *rect)
+{
+	size_t smallest = 0;
+
+	if (scene->occluders.num < MAX_OCCLUDERS) {
+		da_push_back(scene->occluders, rect);
+		return;
+	}
+
+	for (size_t i = 1; i < scene->occluders.num; i++) {
+		if (rect_area(&scene->occluders.array[i]) <
+		    rect_area(&scene->occluders.array[smallest]))
+			smallest = i;
+	}
+
+	if (rect_area(rect) > rect_area(&scene->occluders.array[smallest]))
+		scene->occluders.array[smallest] = *rect;
+}
+
+static inline bool rect_covers(const struct cull_rect *outer,
+		const struct cull_rect *inner)
+{
+	return outer->min.x <= inner->min.x && outer->min.y <= inner->min.y &&
+	       outer->max.x >= inner->max.x && outer->max.y >= inner->max.y;
+}
+
+static bool item_occluded(const struct obs_scene *scene,
+		const struct cull_rect *rect)
+{
+	for (size_t i = 0; i < scene->occluders.num; i++) {
+		if (rect_covers(&scene->occluders.array[i], rect))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Walks the items from the top down and marks the ones that can't contribute
+ * any pixels: items entirely outside of the canvas, and items entirely under
+ * the opaque area of items above them.  Items with an unknown size are always
+ * rendered.
+ *
+ * Item coordinates are in the scene's own space, so items are only tested
+ * against the canvas when the scene is clipped to it: when it's the scene
+ * being rendered to an output or view, or is drawn to an item texture.  A
+ * scene nested directly in another scene can be scaled or offset by its
+ * parent, so only occlusion is tested for it.
+ */
+static void cull_items(struct obs_scene *scene, struct obs_scene_item *last)
+{
+	const bool clipped = obs->video.unclipped_item_depth == 0;
+	const float canvas_cx = (float)obs->video.base_width;
+	const float canvas_cy = (float)obs->video.base_height;
+	struct obs_scene_item *item = last;
+	uint32_t culled = 0;
+
+	da_resize(scene->occluders, 0);
+
+	while (item) {
+		struct cull_rect rect;
+
+		item->culled = false;
+
+		if (!item->user_visible || !item->draw_rect_valid) {
+			item = item->prev;
+			continue;
+		}
+
+		rect = item->draw_rect;
+		if (clipped) {
+			rect.min.x = fmaxf(rect.min.x, 0.0f);
+			rect.min.y = fmaxf(rect.min.y, 0.0f);
+			rect.max.x = fminf(rect.max.x, canvas_cx);
+			rect.max.y = fminf(rect.max.y, canvas_cy);
+		}
+
+		if (rect.min.x >= rect.max.x || rect.min.y >= rect.max.y ||
+		    item_occluded(scene, &rect)) {
+			item->culled = true;
+			culled++;
+
+		} else if (item->draw_rect_filled &&
+		           obs_source_opaque(item->source)) {
+			add_occluder(scene, &rect);
+		}
+
+		item = item->prev;
+	}
+
+	obs->video.culled_items += culled;
+}
+
+/* the render cache holds premultiplied color, so a scene rendered straight
+ * into it has to blend its alpha channel the same way as its color */
+static inline bool rendering_render_cache(void)
+{
+	gs_texture_t *target = obs->video.render_cache_target;
+	return target && gs_get_render_target() == target;
+}
+
+static inline void set_premultiplied_blend_state(void)
+{
+	gs_enable_blending(true);
+	gs_blend_function_separate(
+			GS_BLEND_SRCALPHA, GS_BLEND_INVSRCALPHA,
+			GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
+}
+
 static void scene_video_render(void *data, gs_effect_t *effect)
 {
 	DARRAY(struct obs_scene_item*) remove_items;
 	struct obs_scene *scene = data;
 	struct obs_scene_item *item;
+	struct obs_scene_item *last = NULL;
 
 	da_init(remove_items);
 
 	video_lock(scene);
 	item = scene->first_item;
 
-	gs_blend_state_push();
-	gs_reset_blend_state();
-
 	while (item) {
 		if (obs_source_removed(item->source)) {
 			struct obs_scene_item *del_item = item;
@@ -548,7 +711,21 @@ static void scene_video_render(void *data, gs_effect_t *effect)
 		if (source_size_changed(item))
 			update_item_transform(item);
 
-		if (item->user_visible)
+		last = item;
+		item = item->next;
+	}
+
+	cull_items(scene, last);
+
+	gs_blend_state_push();
+	if (rendering_render_cache())
+		set_premultiplied_blend_state();
+	else
+		gs_reset_blend_state();
+
+	item = scene->first_item;
+	while (item) {
+		if (item->user_visible && !item->culled)
 			render_item(item);
 
 		item = item->next;
@@ -661,7 +838,8 @@ static void scene_load_item(struct obs_scene *scene, obs_data_t *item_data)
 
 	} else if (!item->item_render && item_texture_enabled(item)) {
 		obs_enter_graphics();
-		item->item_render = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+		item->item_render = gs_texrender_create_transient(GS_RGBA,
+				GS_ZS_NONE);
 		obs_leave_graphics();
 	}
 
@@ -795,7 +973,7 @@ static void apply_scene_item_audio_actions(struct obs_scene_item *item,
 		new_frame_num = (timestamp - ts) * (uint64_t)sample_rate /
 			1000000000ULL;
 
-		if (ts && new_frame_num >= AUDIO_OUTPUT_FRAMES)
+		if (ts && new_frame_num >= obs->audio.block_frames)
 			break;
 
 		da_erase(item->audio_actions, i--);
@@ -813,7 +991,7 @@ static void apply_scene_item_audio_actions(struct obs_scene_item *item,
 	}
 
 	if (buf) {
-		for (; frame_num < AUDIO_OUTPUT_FRAMES; frame_num++)
+		for (; frame_num < obs->audio.block_frames; frame_num++)
 			buf[frame_num] = cur_visible ? 1.0f : 0.0f;
 	}
 
@@ -842,7 +1020,7 @@ static bool apply_scene_item_volume(struct obs_scene_item *item,
 	pthread_mutex_unlock(&item->actions_mutex);
 
 	if (actions_pending) {
-		uint64_t duration = (uint64_t)AUDIO_OUTPUT_FRAMES *
+		uint64_t duration = (uint64_t)obs->audio.block_frames *
 			1000000000ULL / (uint64_t)sample_rate;
 
 		if (!ts || action.timestamp < (ts + duration)) {
@@ -861,27 +1039,16 @@ static void process_all_audio_actions(struct obs_scene_item *item,
 	while (apply_scene_item_volume(item, NULL, 0, sample_rate));
 }
 
-static void mix_audio_with_buf(float *p_out, float *p_in, float *buf_in,
-		size_t pos, size_t count)
+static inline void mix_audio_with_buf(float *p_out, float *p_in,
+		float *buf_in, size_t pos, size_t count)
 {
-	register float *out = p_out;
-	register float *buf = buf_in + pos;
-	register float *in = p_in + pos;
-	register float *end = in + count;
-
-	while (in < end)
-		*(out++) += *(in++) * *(buf++);
+	audio_mix_add_ramp(p_out, p_in + pos, buf_in + pos, count);
 }
 
 static inline void mix_audio(float *p_out, float *p_in,
 		size_t pos, size_t count)
 {
-	register float *out = p_out;
-	register float *in = p_in + pos;
-	register float *end = in + count;
-
-	while (in < end)
-		*(out++) += *(in++);
+	audio_mix_add(p_out, p_in + pos, count);
 }
 
 static bool scene_audio_render(void *data, uint64_t *ts_out,
@@ -925,6 +1092,7 @@ static bool scene_audio_render(void *data, uint64_t *ts_out,
 	item = scene->first_item;
 	while (item) {
 		uint64_t source_ts;
+		uint32_t child_mixers;
 		size_t pos, count;
 		bool apply_buf;
 
@@ -944,16 +1112,19 @@ static bool scene_audio_render(void *data, uint64_t *ts_out,
 
 		pos = (size_t)ns_to_audio_frames(sample_rate,
 				source_ts - timestamp);
-		count = AUDIO_OUTPUT_FRAMES - pos;
+		count = obs->audio.block_frames - pos;
 
 		if (!apply_buf && !item->visible) {
 			item = item->next;
 			continue;
 		}
 
+		/* the child's output is silent for mixes it isn't routed to */
+		child_mixers = mixers & item->source->audio_mixers;
+
 		obs_source_get_audio_mix(item->source, &child_audio);
 		for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++) {
-			if ((mixers & (1 << mix)) == 0)
+			if ((child_mixers & (1 << mix)) == 0)
 				continue;
 
 			for (size_t ch = 0; ch < channels; ch++) {
@@ -1115,6 +1286,9 @@ obs_scene_t *obs_scene_duplicate(obs_scene_t *scene, const char *name,
 			new_item->scale_filter = item->scale_filter;
 			new_item->box_transform = item->box_transform;
 			new_item->draw_transform = item->draw_transform;
+			new_item->draw_rect = item->draw_rect;
+			new_item->draw_rect_valid = item->draw_rect_valid;
+			new_item->draw_rect_filled = item->draw_rect_filled;
 			new_item->bounds_type = item->bounds_type;
 			new_item->bounds_align = item->bounds_align;
 			new_item->bounds = item->bounds;
@@ -1124,7 +1298,8 @@ obs_scene_t *obs_scene_duplicate(obs_scene_t *scene, const char *name,
 			if (!new_item->item_render &&
 			    item_texture_enabled(new_item)) {
 				obs_enter_graphics();
-				new_item->item_render = gs_texrender_create(
+				new_item->item_render =
+					gs_texrender_create_transient(
 						GS_RGBA, GS_ZS_NONE);
 				obs_leave_graphics();
 			}
@@ -1379,7 +1554,8 @@ obs_sceneitem_t *obs_scene_add(obs_scene_t *scene, obs_source_t *source)
 
 	if (item_texture_enabled(item)) {
 		obs_enter_graphics();
-		item->item_render = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+		item->item_render = gs_texrender_create_transient(GS_RGBA,
+				GS_ZS_NONE);
 		obs_leave_graphics();
 	}
 
@@ -1920,7 +2096,8 @@ void obs_sceneitem_set_crop(obs_sceneitem_t *item,
 		item->item_render = NULL;
 
 	} else if (!item->item_render) {
-		item->item_render = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+		item->item_render = gs_texrender_create_transient(GS_RGBA,
+				GS_ZS_NONE);
 	}
 
 	memcpy(&item->crop, crop, sizeof(*crop));
@@ -1960,7 +2137,8 @@ void obs_sceneitem_set_scale_filter(obs_sceneitem_t *item,
 		item->item_render = NULL;
 
 	} else if (!item->item_render) {
-		item->item_render = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+		item->item_render = gs_texrender_create_transient(GS_RGBA,
+				GS_ZS_NONE);
 	}
 
 	obs_leave_graphics();
@@ -28,6 +28,11 @@ struct item_action {
 	uint64_t timestamp;
 };
 
+struct cull_rect {
+	struct vec2 min;
+	struct vec2 max;
+};
+
 struct obs_scene_item {
 	volatile long         ref;
 	volatile bool         removed;
@@ -62,6 +67,15 @@ struct obs_scene_item {
 	struct matrix4        box_transform;
 	struct matrix4        draw_transform;
 
+	/* scene space bounding box of the drawn area, and whether the drawn
+	 * area fills it (no rotation other than multiples of 90 degrees) */
+	struct cull_rect      draw_rect;
+	bool                  draw_rect_valid;
+	bool                  draw_rect_filled;
+
+	/* set each render when the item can't contribute any pixels */
+	bool                  culled;
+
 	enum obs_bounds_type  bounds_type;
 	uint32_t              bounds_align;
 	struct vec2           bounds;
@@ -84,4 +98,7 @@ struct obs_scene {
 	pthread_mutex_t       video_mutex;
 	pthread_mutex_t       audio_mutex;
 	struct obs_scene_item *first_item;
+
+	/* opaque areas of the items above the one being culled */
+	DARRAY(struct cull_rect) occluders;
 };
@@ -88,8 +88,12 @@ bool obs_source_init_context(struct obs_source *source,
 				settings, name, hotkey_data, private))
 		return false;
 
-	return signal_handler_add_array(source->context.signals,
-			source_signals);
+	if (!signal_handler_add_array(source->context.signals, source_signals))
+		return false;
+
+	source->volume_signal = signal_handler_get_handle(
+			source->context.signals, "volume");
+	return true;
 }
 
 const char *obs_source_get_display_name(const char *id)
@@ -490,10 +494,29 @@ void obs_source_frame_init(struct obs_source_frame *frame,
 	}
 }
 
+/* frame output with obs_source_output_video_external, the data belongs to the
+ * producer and is handed back through the release callback */
+struct external_frame {
+	struct obs_source_frame    frame;
+	obs_source_frame_release_t release;
+	void                       *param;
+};
+
+static void async_frame_destroy(struct obs_source_frame *frame)
+{
+	if (frame->external) {
+		struct external_frame *ef = (struct external_frame*)frame;
+		ef->release(ef->param);
+		bfree(ef);
+	} else {
+		obs_source_frame_destroy(frame);
+	}
+}
+
 static inline void obs_source_frame_decref(struct obs_source_frame *frame)
 {
 	if (os_atomic_dec_long(&frame->refs) == 0)
-		obs_source_frame_destroy(frame);
+		async_frame_destroy(frame);
 }
 
 static bool obs_source_filter_remove_refless(obs_source_t *source,
@@ -557,6 +580,8 @@ void obs_source_destroy(struct obs_source *source)
 		gs_texture_destroy(source->async_prev_texture);
 	if (source->filter_texrender)
 		gs_texrender_destroy(source->filter_texrender);
+	if (source->render_cache)
+		gs_texrender_destroy(source->render_cache);
 	gs_leave_context();
 
 	for (i = 0; i < MAX_AV_PLANES; i++)
@@ -1009,6 +1034,12 @@ void obs_source_video_tick(obs_source_t *source, float seconds)
 	if (source->filter_texrender)
 		gs_texrender_reset(source->filter_texrender);
 
+	/* same for the render cache */
+	if (source->render_cache)
+		gs_texrender_reset(source->render_cache);
+	source->last_render_count = source->render_count;
+	source->render_count = 0;
+
 	/* call show/hide if the reference changed */
 	now_showing = !!source->show_refs;
 	if (now_showing != source->showing) {
@@ -1544,6 +1575,70 @@ static bool update_async_texrender(struct obs_source *source,
 	return true;
 }
 
+/* smallest number of rows worth handing to another thread */
+#define MIN_DECOMPRESS_SLICE_ROWS 64
+
+struct decompress_job {
+	const struct obs_source_frame *frame;
+	enum convert_type             type;
+	uint8_t                       *ptr;
+	uint32_t                      linesize;
+	size_t                        slices;
+};
+
+static void decompress_slice(void *param, size_t idx)
+{
+	struct decompress_job *job = param;
+	const struct obs_source_frame *frame = job->frame;
+	uint32_t start_y, end_y;
+
+	format_conversion_get_slice(frame->height, idx, job->slices,
+			&start_y, &end_y);
+
+	if (job->type == CONVERT_420)
+		decompress_420((const uint8_t* const*)frame->data,
+				frame->linesize,
+				start_y, end_y, job->ptr, job->linesize);
+
+	else if (job->type == CONVERT_NV12)
+		decompress_nv12((const uint8_t* const*)frame->data,
+				frame->linesize,
+				start_y, end_y, job->ptr, job->linesize);
+
+	else if (job->type == CONVERT_422_Y)
+		decompress_422(frame->data[0], frame->linesize[0],
+				start_y, end_y, job->ptr, job->linesize, true);
+
+	else if (job->type == CONVERT_422_U)
+		decompress_422(frame->data[0], frame->linesize[0],
+				start_y, end_y, job->ptr, job->linesize, false);
+}
+
+/* splits the conversion of large frames over the conversion threads */
+static void decompress_frame(const struct obs_source_frame *frame,
+		enum convert_type type, uint8_t *ptr, uint32_t linesize)
+{
+	os_threadpool_t *pool = obs->video.convert_pool;
+	struct decompress_job job = {
+		.frame    = frame,
+		.type     = type,
+		.ptr      = ptr,
+		.linesize = linesize,
+		.slices   = 1
+	};
+
+	if (pool) {
+		size_t max_slices = frame->height / MIN_DECOMPRESS_SLICE_ROWS;
+
+		job.slices = os_threadpool_concurrency(pool);
+		if (job.slices > max_slices)
+			job.slices = max_slices ? max_slices : 1;
+	}
+
+	os_threadpool_run(job.slices > 1 ? pool : NULL, decompress_slice,
+			&job, job.slices);
+}
+
 bool update_async_texture(struct obs_source *source,
 		const struct obs_source_frame *frame,
 		gs_texture_t *tex, gs_texrender_t *texrender)
@@ -1573,23 +1668,7 @@ bool update_async_texture(struct obs_source *source,
 	if (!gs_texture_map(tex, &ptr, &linesize))
 		return false;
 
-	if (type == CONVERT_420)
-		decompress_420((const uint8_t* const*)frame->data,
-				frame->linesize,
-				0, frame->height, ptr, linesize);
-
-	else if (type == CONVERT_NV12)
-		decompress_nv12((const uint8_t* const*)frame->data,
-				frame->linesize,
-				0, frame->height, ptr, linesize);
-
-	else if (type == CONVERT_422_Y)
-		decompress_422(frame->data[0], frame->linesize[0],
-				0, frame->height, ptr, linesize, true);
-
-	else if (type == CONVERT_422_U)
-		decompress_422(frame->data[0], frame->linesize[0],
-				0, frame->height, ptr, linesize, false);
+	decompress_frame(frame, type, ptr, linesize);
 
 	gs_texture_unmap(tex);
 	return true;
@@ -1763,13 +1842,117 @@ static inline void render_video(obs_source_t *source)
 		obs_source_render_async_video(source);
 }
 
+/* the cache is sized to the source, so only inputs are cached.  scenes can
+ * draw items past their own bounds (nested scenes with overflowing items),
+ * which the cache would clip, and only while the scene is drawn more than
+ * once, so it would look different depending on where else it's shown. */
+static inline bool render_cache_allowed(const obs_source_t *source)
+{
+	uint32_t flags = source->info.output_flags;
+
+	if (source->info.type != OBS_SOURCE_TYPE_INPUT)
+		return false;
+
+	return (flags & OBS_SOURCE_VIDEO) != 0 &&
+		(flags & OBS_SOURCE_DO_NOT_CACHE) == 0 &&
+		!source->rendering_filter &&
+		!obs->video.render_cache_disabled;
+}
+
+/* renders the source to its cache texture the first time it's drawn in a
+ * frame, and draws that texture every time.  only used for sources that were
+ * drawn more than once in the previous frame.
+ *
+ * the cache is composited over transparent black with premultiplied alpha and
+ * drawn with ONE/INVSRCALPHA, which gives the same result as drawing the
+ * source directly with SRCALPHA/INVSRCALPHA.  any other blend state (such as
+ * the ONE/ZERO copies into item and filter textures) can't be reproduced from
+ * premultiplied color, so the source is rendered directly in that case. */
+static bool render_video_cached(obs_source_t *source)
+{
+	gs_effect_t *effect = obs->video.default_effect;
+	struct gs_blend_state blend;
+	gs_texture_t *prev_target;
+	gs_texture_t *tex;
+	uint32_t cx, cy;
+
+	if (!render_cache_allowed(source))
+		return false;
+
+	source->render_count++;
+
+	/* the cache is drawn with its own effect, so it can't be used in the
+	 * middle of another effect */
+	if (source->last_render_count <= 1 || gs_get_effect()) {
+		if (source->last_render_count <= 1 && source->render_cache) {
+			gs_texrender_destroy(source->render_cache);
+			source->render_cache = NULL;
+		}
+		return false;
+	}
+
+	gs_get_blend_state(&blend);
+	if (!blend.enabled ||
+	    blend.src_c  != GS_BLEND_SRCALPHA ||
+	    blend.dest_c != GS_BLEND_INVSRCALPHA)
+		return false;
+
+	cx = obs_source_get_width(source);
+	cy = obs_source_get_height(source);
+	if (!cx || !cy)
+		return false;
+
+	if (!source->render_cache)
+		source->render_cache = gs_texrender_create_transient(
+				GS_RGBA, GS_ZS_NONE);
+
+	gs_blend_state_push();
+	gs_blend_function_separate(
+			GS_BLEND_SRCALPHA, GS_BLEND_INVSRCALPHA,
+			GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
+
+	if (gs_texrender_begin(source->render_cache, cx, cy)) {
+		struct vec4 clear_color;
+
+		prev_target = obs->video.render_cache_target;
+		obs->video.render_cache_target =
+			gs_texrender_get_texture(source->render_cache);
+
+		vec4_zero(&clear_color);
+		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+		gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+
+		render_video(source);
+
+		obs->video.render_cache_target = prev_target;
+		gs_texrender_end(source->render_cache);
+	}
+
+	gs_blend_state_pop();
+
+	tex = gs_texrender_get_texture(source->render_cache);
+	if (!tex)
+		return false;
+
+	gs_blend_state_push();
+	gs_blend_function_separate(GS_BLEND_ONE, GS_BLEND_INVSRCALPHA,
+			blend.src_a, blend.dest_a);
+
+	while (gs_effect_loop(effect, "Draw"))
+		obs_source_draw(tex, 0, 0, cx, cy, false);
+
+	gs_blend_state_pop();
+	return true;
+}
+
 void obs_source_video_render(obs_source_t *source)
 {
 	if (!obs_source_valid(source, "obs_source_video_render"))
 		return;
 
 	obs_source_addref(source);
-	render_video(source);
+	if (!render_video_cached(source))
+		render_video(source);
 	obs_source_release(source);
 }
 
@@ -1857,6 +2040,40 @@ uint32_t obs_source_get_height(obs_source_t *source)
 		get_base_height(source);
 }
 
+static inline bool async_format_opaque(enum video_format format)
+{
+	return format_is_yuv(format) || format == VIDEO_FORMAT_BGRX ||
+		format == VIDEO_FORMAT_Y800;
+}
+
+bool obs_source_opaque(obs_source_t *source)
+{
+	bool opaque = false;
+
+	if (!data_valid(source, "obs_source_opaque"))
+		return false;
+	if (!source->enabled || source->info.type != OBS_SOURCE_TYPE_INPUT)
+		return false;
+
+	/* filters can change the alpha of any source */
+	pthread_mutex_lock(&source->filter_mutex);
+
+	if (!source->filters.num) {
+		if (source->info.is_opaque)
+			opaque = source->info.is_opaque(source->context.data);
+
+		else if ((source->info.output_flags & OBS_SOURCE_ASYNC) != 0 &&
+		         !source->info.video_render)
+			opaque = source->async_active &&
+				source->async_texture &&
+				async_format_opaque(source->async_format);
+	}
+
+	pthread_mutex_unlock(&source->filter_mutex);
+
+	return opaque;
+}
+
 uint32_t obs_source_get_base_width(obs_source_t *source)
 {
 	if (!data_valid(source, "obs_source_get_base_width"))
@@ -2269,7 +2486,7 @@ static void clean_cache(obs_source_t *source)
 		struct async_frame *af = &source->async_cache.array[i - 1];
 		if (!af->used) {
 			if (++af->unused_count == MAX_UNUSED_FRAME_DURATION) {
-				obs_source_frame_destroy(af->frame);
+				async_frame_destroy(af->frame);
 				da_erase(source->async_cache, i - 1);
 			}
 		}
@@ -2335,13 +2552,60 @@ static inline struct obs_source_frame *cache_video(struct obs_source *source,
 	copy_frame_data(new_frame, frame);
 
 	if (os_atomic_dec_long(&new_frame->refs) == 0) {
-		obs_source_frame_destroy(new_frame);
+		async_frame_destroy(new_frame);
 		new_frame = NULL;
 	}
 
 	return new_frame;
 }
 
+/* external frames stay in async_cache as used entries until libobs is done
+ * with them, at which point remove_async_frame drops them from the cache */
+static inline struct obs_source_frame *cache_external_video(
+		struct obs_source *source,
+		const struct obs_source_frame *frame,
+		obs_source_frame_release_t release, void *param)
+{
+	struct external_frame *ef;
+	struct async_frame new_af;
+
+	pthread_mutex_lock(&source->async_mutex);
+
+	if (source->async_frames.num >= MAX_ASYNC_FRAMES) {
+		free_async_cache(source);
+		source->last_frame_ts = 0;
+		pthread_mutex_unlock(&source->async_mutex);
+		release(param);
+		return NULL;
+	}
+
+	if (async_texture_changed(source, frame)) {
+		free_async_cache(source);
+		source->async_cache_width  = frame->width;
+		source->async_cache_height = frame->height;
+		source->async_cache_format = frame->format;
+	}
+
+	clean_cache(source);
+
+	ef = bzalloc(sizeof(struct external_frame));
+	ef->frame            = *frame;
+	ef->frame.refs       = 1;
+	ef->frame.prev_frame = false;
+	ef->frame.external   = true;
+	ef->release          = release;
+	ef->param            = param;
+
+	new_af.frame        = &ef->frame;
+	new_af.used         = true;
+	new_af.unused_count = 0;
+	da_push_back(source->async_cache, &new_af);
+
+	pthread_mutex_unlock(&source->async_mutex);
+
+	return &ef->frame;
+}
+
 void obs_source_output_video(obs_source_t *source,
 		const struct obs_source_frame *frame)
 {
@@ -2366,6 +2630,62 @@ void obs_source_output_video(obs_source_t *source,
 	}
 }
 
+/* async filters (such as the video delay filter) can hold on to frames for an
+ * arbitrary amount of time, which would starve a producer with a fixed number
+ * of buffers */
+static bool has_async_video_filters(obs_source_t *source)
+{
+	bool found = false;
+
+	pthread_mutex_lock(&source->filter_mutex);
+
+	for (size_t i = 0; i < source->filters.num; i++) {
+		struct obs_source *filter = source->filters.array[i];
+
+		if (filter->enabled && filter->info.filter_video) {
+			found = true;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&source->filter_mutex);
+	return found;
+}
+
+void obs_source_output_video_external(obs_source_t *source,
+		const struct obs_source_frame *frame,
+		obs_source_frame_release_t release, void *param)
+{
+	struct obs_source_frame *output;
+
+	if (!release)
+		return;
+
+	if (!obs_source_valid(source, "obs_source_output_video_external") ||
+	    !frame) {
+		release(param);
+		return;
+	}
+
+	/* Y800 has to be expanded to BGRX on the CPU anyway, and frames that
+	 * async filters may keep are copied so the buffer is returned now */
+	if (frame->format == VIDEO_FORMAT_Y800 ||
+	    has_async_video_filters(source)) {
+		obs_source_output_video(source, frame);
+		release(param);
+		return;
+	}
+
+	output = cache_external_video(source, frame, release, param);
+
+	if (output) {
+		pthread_mutex_lock(&source->async_mutex);
+		da_push_back(source->async_frames, &output);
+		pthread_mutex_unlock(&source->async_mutex);
+		source->async_active = true;
+	}
+}
+
 static inline bool preload_frame_changed(obs_source_t *source,
 		const struct obs_source_frame *in)
 {
@@ -2602,7 +2922,12 @@ void remove_async_frame(obs_source_t *source, struct obs_source_frame *frame)
 		struct async_frame *f = &source->async_cache.array[i];
 
 		if (f->frame == frame) {
-			f->used = false;
+			if (frame->external) {
+				da_erase(source->async_cache, i);
+				obs_source_frame_decref(frame);
+			} else {
+				f->used = false;
+			}
 			break;
 		}
 	}
@@ -2752,12 +3077,12 @@ void obs_source_release_frame(obs_source_t *source,
 		return;
 
 	if (!source) {
-		obs_source_frame_destroy(frame);
+		async_frame_destroy(frame);
 	} else {
 		pthread_mutex_lock(&source->async_mutex);
 
 		if (os_atomic_dec_long(&frame->refs) == 0)
-			obs_source_frame_destroy(frame);
+			async_frame_destroy(frame);
 		else
 			remove_async_frame(source, frame);
 
@@ -2895,8 +3220,8 @@ bool obs_source_process_filter_begin(obs_source_t *filter,
 	}
 
 	if (!filter->filter_texrender)
-		filter->filter_texrender = gs_texrender_create(format,
-				GS_ZS_NONE);
+		filter->filter_texrender = gs_texrender_create_transient(
+				format, GS_ZS_NONE);
 
 	gs_blend_state_push();
 	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
@@ -2945,7 +3270,9 @@ void obs_source_process_filter_tech_end(obs_source_t *filter, gs_effect_t *effec
 		render_filter_bypass(target, effect, tech);
 	} else {
 		texture = gs_texrender_get_texture(filter->filter_texrender);
-		render_filter_tex(texture, effect, width, height, tech);
+		if (texture)
+			render_filter_tex(texture, effect, width, height,
+					tech);
 	}
 }
 
@@ -3028,16 +3355,17 @@ void obs_source_set_volume(obs_source_t *source, float volume)
 		struct calldata data;
 		uint8_t stack[128];
 
+		static calldata_key_t volume_key = CALLDATA_KEY("volume");
+
 		calldata_init_fixed(&data, stack, sizeof(stack));
 		calldata_set_ptr(&data, "source", source);
 		calldata_set_float(&data, "volume", volume);
 
-		signal_handler_signal(source->context.signals, "volume", &data);
+		signal_handle_signal(source->volume_signal, &data);
 		if (!source->context.private)
-			signal_handler_signal(obs->signals, "source_volume",
-					&data);
+			signal_handle_signal(obs->source_volume_signal, &data);
 
-		volume = (float)calldata_float(&data, "volume");
+		volume = (float)calldata_float_key(&data, &volume_key);
 
 		pthread_mutex_lock(&source->audio_actions_mutex);
 		da_push_back(source->audio_actions, &action);
@@ -3721,24 +4049,17 @@ static float get_source_volume(obs_source_t *source, uint64_t os_time)
 static inline void multiply_output_audio(obs_source_t *source, size_t mix,
 		size_t channels, float vol)
 {
-	register float *out = source->audio_output_buf[mix][0];
-	register float *end = out + AUDIO_OUTPUT_FRAMES * channels;
-
-	while (out < end)
-		*(out++) *= vol;
+	for (size_t ch = 0; ch < channels; ch++)
+		audio_mix_gain(source->audio_output_buf[mix][ch], vol,
+				obs->audio.block_frames);
 }
 
 static inline void multiply_vol_data(obs_source_t *source, size_t mix,
 		size_t channels, float *vol_data)
 {
-	for (size_t ch = 0; ch < channels; ch++) {
-		register float *out = source->audio_output_buf[mix][ch];
-		register float *end = out + AUDIO_OUTPUT_FRAMES;
-		register float *vol = vol_data;
-
-		while (out < end)
-			*(out++) *= *(vol++);
-	}
+	for (size_t ch = 0; ch < channels; ch++)
+		audio_mix_gain_ramp(source->audio_output_buf[mix][ch],
+				vol_data, obs->audio.block_frames);
 }
 
 static inline void apply_audio_action(obs_source_t *source,
@@ -3761,6 +4082,7 @@ static void apply_audio_actions(obs_source_t *source, size_t channels,
 {
 	float *vol_data = malloc(sizeof(float) * AUDIO_OUTPUT_FRAMES);
 	float cur_vol = get_source_volume(source, source->audio_ts);
+	size_t frames = obs->audio.block_frames;
 	size_t frame_num = 0;
 
 	pthread_mutex_lock(&source->audio_actions_mutex);
@@ -3776,7 +4098,7 @@ static void apply_audio_actions(obs_source_t *source, size_t channels,
 		new_frame_num = conv_time_to_frames(sample_rate,
 				timestamp - source->audio_ts);
 
-		if (new_frame_num >= AUDIO_OUTPUT_FRAMES)
+		if (new_frame_num >= frames)
 			break;
 
 		da_erase(source->audio_actions, i--);
@@ -3791,7 +4113,7 @@ static void apply_audio_actions(obs_source_t *source, size_t channels,
 		cur_vol = get_source_volume(source, timestamp);
 	}
 
-	for (; frame_num < AUDIO_OUTPUT_FRAMES; frame_num++)
+	for (; frame_num < frames; frame_num++)
 		vol_data[frame_num] = cur_vol;
 
 	pthread_mutex_unlock(&source->audio_actions_mutex);
@@ -3821,7 +4143,7 @@ static void apply_audio_volume(obs_source_t *source, uint32_t mixers,
 
 	if (actions_pending) {
 		uint64_t duration = conv_frames_to_time(sample_rate,
-				AUDIO_OUTPUT_FRAMES);
+				obs->audio.block_frames);
 
 		if (action.timestamp < (source->audio_ts + duration)) {
 			apply_audio_actions(source, channels, sample_rate);
@@ -3908,8 +4230,9 @@ static inline void process_audio_source_tick(obs_source_t *source,
 
 		if ((source->audio_mixers & mix_and_val) == 0 ||
 		    (mixers & mix_and_val) == 0) {
-			memset(source->audio_output_buf[mix][0],
-					0, size * channels);
+			for (size_t ch = 0; ch < channels; ch++)
+				memset(source->audio_output_buf[mix][ch],
+						0, size);
 			continue;
 		}
 
@@ -3918,9 +4241,12 @@ static inline void process_audio_source_tick(obs_source_t *source,
 					source->audio_output_buf[0][ch], size);
 	}
 
-	if ((source->audio_mixers & 1) == 0 || (mixers & 1) == 0)
-		memset(source->audio_output_buf[0][0], 0,
-				size * channels);
+	/* channels are AUDIO_OUTPUT_FRAMES apart, so they can't be cleared
+	 * in one go when ticks are smaller than that */
+	if ((source->audio_mixers & 1) == 0 || (mixers & 1) == 0) {
+		for (size_t ch = 0; ch < channels; ch++)
+			memset(source->audio_output_buf[0][ch], 0, size);
+	}
 
 	apply_audio_volume(source, mixers, channels, sample_rate);
 	source->audio_pending = false;
@@ -130,6 +130,18 @@ enum obs_source_type {
  */
 #define OBS_SOURCE_DO_NOT_SELF_MONITOR (1<<9)
 
+/**
+ * Source must not have its video cached
+ *
+ * Sources drawn more than once per frame (in several scenes or views) are
+ * normally rendered to a texture once and drawn from it afterward.  When this
+ * is used, the source is rendered every time it is drawn instead, for sources
+ * whose output depends on where or when in the frame they are drawn (for
+ * example, sources that draw interaction state per view), or that draw
+ * outside of their own width and height, which the cache would clip.
+ */
+#define OBS_SOURCE_DO_NOT_CACHE (1<<10)
+
 /** @} */
 
 typedef void (*obs_source_enum_proc_t)(obs_source_t *parent,
@@ -428,6 +440,16 @@ struct obs_source_info {
 
 	void (*transition_start)(void *data);
 	void (*transition_stop)(void *data);
+
+	/**
+	 * Called to check whether the source currently covers its whole
+	 * width and height with fully opaque pixels.  Optional, sources are
+	 * treated as possibly transparent if not implemented.
+	 *
+	 * @param  data  Source data
+	 * @return       true if the source is opaque
+	 */
+	bool (*is_opaque)(void *data);
 };
 
 EXPORT void obs_register_source_s(const struct obs_source_info *info,
@@ -337,15 +337,32 @@ static inline void render_video(struct obs_core_video *video, int cur_texture,
 	gs_end_scene();
 }
 
+static const char *gs_stagesurface_map_name = "gs_stagesurface_map";
 static inline bool download_frame(struct obs_core_video *video,
-		int prev_texture, struct video_data *frame)
+		int download_texture, struct video_data *frame)
 {
-	gs_stagesurf_t *surface = video->copy_surfaces[prev_texture];
+	gs_stagesurf_t *surface = video->copy_surfaces[download_texture];
+	uint64_t start, wait;
+	bool success;
 
-	if (!video->textures_copied[prev_texture])
+	if (!video->textures_copied[download_texture])
 		return false;
 
-	if (!gs_stagesurface_map(surface, &frame->data[0], &frame->linesize[0]))
+	/* the map blocks until the GPU has finished with the surface, so
+	 * keep track of how long that takes */
+	profile_start(gs_stagesurface_map_name);
+	start = os_gettime_ns();
+	success = gs_stagesurface_map(surface, &frame->data[0],
+			&frame->linesize[0]);
+	wait = os_gettime_ns() - start;
+	profile_end(gs_stagesurface_map_name);
+
+	video->map_wait_total_ns += wait;
+	video->map_count++;
+	if (wait > video->map_wait_max_ns)
+		video->map_wait_max_ns = wait;
+
+	if (!success)
 		return false;
 
 	video->mapped_surface = surface;
@@ -432,31 +449,88 @@ static void set_gpu_converted_data(struct obs_core_video *video,
 	}
 }
 
-static void convert_frame(
+static void convert_rows(
 		struct video_frame *output, const struct video_data *input,
-		const struct video_output_info *info)
+		const struct video_output_info *info,
+		uint32_t start_y, uint32_t end_y)
 {
 	if (info->format == VIDEO_FORMAT_I420) {
 		compress_uyvx_to_i420(
 				input->data[0], input->linesize[0],
-				0, info->height,
+				start_y, end_y,
 				output->data, output->linesize);
 
 	} else if (info->format == VIDEO_FORMAT_NV12) {
 		compress_uyvx_to_nv12(
 				input->data[0], input->linesize[0],
-				0, info->height,
+				start_y, end_y,
 				output->data, output->linesize);
 
 	} else if (info->format == VIDEO_FORMAT_I444) {
 		convert_uyvx_to_i444(
 				input->data[0], input->linesize[0],
-				0, info->height,
+				start_y, end_y,
 				output->data, output->linesize);
+	}
+}
 
-	} else {
+/* smallest number of rows worth handing to another thread */
+#define MIN_CONVERT_BAND_ROWS 64
+
+struct convert_job {
+	struct video_frame              *output;
+	const struct video_data         *input;
+	const struct video_output_info  *info;
+	size_t                          bands;
+};
+
+static void convert_band(void *param, size_t idx)
+{
+	struct convert_job *job = param;
+	const char *name = obs->video.convert_band_names[idx];
+	uint32_t start_y, end_y;
+
+	format_conversion_get_slice(job->info->height, idx, job->bands,
+			&start_y, &end_y);
+
+	profile_start(name);
+	convert_rows(job->output, job->input, job->info, start_y, end_y);
+	profile_end(name);
+}
+
+/* splits the frame into bands of rows that are converted in parallel on the
+ * conversion threads, with this thread converting one of the bands */
+static void convert_frame(
+		struct video_frame *output, const struct video_data *input,
+		const struct video_output_info *info)
+{
+	os_threadpool_t *pool = obs->video.convert_pool;
+	struct convert_job job = {
+		.output = output,
+		.input  = input,
+		.info   = info,
+		.bands  = 1
+	};
+
+	if (info->format != VIDEO_FORMAT_I420 &&
+	    info->format != VIDEO_FORMAT_NV12 &&
+	    info->format != VIDEO_FORMAT_I444) {
 		blog(LOG_ERROR, "convert_frame: unsupported texture format");
+		return;
+	}
+
+	if (pool) {
+		size_t max_bands = info->height / MIN_CONVERT_BAND_ROWS;
+
+		job.bands = os_threadpool_concurrency(pool);
+		if (job.bands > MAX_CONVERT_BANDS)
+			job.bands = MAX_CONVERT_BANDS;
+		if (job.bands > max_bands)
+			job.bands = max_bands ? max_bands : 1;
 	}
+
+	os_threadpool_run(job.bands > 1 ? pool : NULL, convert_band, &job,
+			job.bands);
 }
 
 static inline void copy_rgbx_frame(
@@ -529,6 +603,76 @@ static inline void video_sleep(struct obs_core_video *video,
 			sizeof(vframe_info));
 }
 
+static const char *effect_param_lookups_name =
+	"effect parameter lookups per frame";
+static const char *effect_param_uploads_name =
+	"effect parameter uploads per frame";
+
+/* covers everything drawn with the video context this frame, including the
+ * displays */
+static inline void record_effect_stats(void)
+{
+	struct gs_effect_stats stats;
+
+	gs_effect_get_stats(&stats);
+	profile_counter_record(effect_param_lookups_name, stats.param_lookups);
+	profile_counter_record(effect_param_uploads_name, stats.param_uploads);
+}
+
+static const char *draw_calls_name = "draw calls per frame";
+static const char *sprites_name = "sprites per frame";
+static const char *batched_sprites_name = "batched sprites per frame";
+
+static inline void record_draw_stats(struct obs_core_video *video)
+{
+	struct gs_draw_stats *last = &video->last_draw_stats;
+	struct gs_draw_stats stats;
+
+	gs_get_draw_stats(&stats);
+	profile_counter_record(draw_calls_name,
+			stats.draw_calls - last->draw_calls);
+	profile_counter_record(sprites_name, stats.sprites - last->sprites);
+	profile_counter_record(batched_sprites_name,
+			stats.batched_sprites - last->batched_sprites);
+
+	*last = stats;
+}
+
+static const char *texrender_pool_hits_name =
+	"render target pool hits per frame";
+static const char *texrender_pool_misses_name =
+	"render target pool misses per frame";
+static const char *texrender_pool_held_name =
+	"render target pool bytes held";
+static const char *texrender_pool_in_use_name =
+	"render target pool bytes in use";
+
+/* idle pooled render targets are kept for about two seconds so that sources
+ * toggled or resized briefly don't reallocate */
+#define TEXRENDER_POOL_IDLE_SECONDS 2
+
+static inline void trim_texrender_pool(struct obs_core_video *video)
+{
+	struct gs_texrender_pool_stats stats;
+	const struct video_output_info *voi =
+		video_output_get_info(video->video);
+	uint32_t max_idle_frames = TEXRENDER_POOL_IDLE_SECONDS *
+		(voi ? voi->fps_num / voi->fps_den : 30);
+
+	gs_texrender_pool_trim(max_idle_frames);
+	gs_texrender_pool_get_stats(&stats);
+
+	profile_counter_record(texrender_pool_hits_name,
+			stats.hits - video->last_texrender_hits);
+	profile_counter_record(texrender_pool_misses_name,
+			stats.misses - video->last_texrender_misses);
+	profile_counter_record(texrender_pool_held_name, stats.bytes_held);
+	profile_counter_record(texrender_pool_in_use_name, stats.bytes_in_use);
+
+	video->last_texrender_hits   = stats.hits;
+	video->last_texrender_misses = stats.misses;
+}
+
 static const char *output_frame_gs_context_name = "gs_context(video->graphics)";
 static const char *output_frame_render_video_name = "render_video";
 static const char *output_frame_download_frame_name = "download_frame";
@@ -538,7 +682,13 @@ static inline void output_frame(void)
 {
 	struct obs_core_video *video = &obs->video;
 	int cur_texture  = video->cur_texture;
-	int prev_texture = cur_texture == 0 ? NUM_TEXTURES-1 : cur_texture-1;
+	int prev_texture = cur_texture == 0 ?
+		video->num_textures-1 : cur_texture-1;
+	/* each stage works on the previous frame's output of the stage before
+	 * it, but the staged surface that gets mapped is the oldest one in
+	 * the ring, giving the GPU (num_textures - 1) frames to finish
+	 * before the CPU has to wait on it */
+	int download_texture = (cur_texture + 1) % video->num_textures;
 	struct video_data frame;
 	bool frame_ready;
 
@@ -552,13 +702,17 @@ static inline void output_frame(void)
 	profile_end(output_frame_render_video_name);
 
 	profile_start(output_frame_download_frame_name);
-	frame_ready = download_frame(video, prev_texture, &frame);
+	frame_ready = download_frame(video, download_texture, &frame);
 	profile_end(output_frame_download_frame_name);
 
 	profile_start(output_frame_gs_flush_name);
 	gs_flush();
 	profile_end(output_frame_gs_flush_name);
 
+	record_effect_stats();
+	record_draw_stats(video);
+	trim_texrender_pool(video);
+
 	gs_leave_context();
 	profile_end(output_frame_gs_context_name);
 
@@ -573,7 +727,7 @@ static inline void output_frame(void)
 		profile_end(output_frame_output_video_data_name);
 	}
 
-	if (++video->cur_texture == NUM_TEXTURES)
+	if (++video->cur_texture == video->num_textures)
 		video->cur_texture = 0;
 }
 
@@ -617,6 +771,9 @@ void *obs_video_thread(void *param)
 		output_frame();
 		profile_end(output_frame_name);
 
+		obs->video.last_culled_items = obs->video.culled_items;
+		obs->video.culled_items = 0;
+
 		frame_time_ns = os_gettime_ns() - frame_start;
 
 		profile_end(video_thread_name);
@@ -171,7 +171,7 @@ static bool obs_init_gpu_conversion(struct obs_video_info *ovi)
 		return true;
 	}
 
-	for (size_t i = 0; i < NUM_TEXTURES; i++) {
+	for (int i = 0; i < video->num_textures; i++) {
 		video->convert_textures[i] = gs_texture_create(
 				ovi->output_width, video->conversion_height,
 				GS_RGBA, 1, NULL, GS_RENDER_TARGET);
@@ -188,9 +188,9 @@ static bool obs_init_textures(struct obs_video_info *ovi)
 	struct obs_core_video *video = &obs->video;
 	uint32_t output_height = video->gpu_conversion ?
 		video->conversion_height : ovi->output_height;
-	size_t i;
+	int i;
 
-	for (i = 0; i < NUM_TEXTURES; i++) {
+	for (i = 0; i < video->num_textures; i++) {
 		video->copy_surfaces[i] = gs_stagesurface_create(
 				ovi->output_width, output_height, GS_RGBA);
 
@@ -347,6 +347,25 @@ static inline void set_video_matrix(struct obs_core_video *video,
 	memcpy(video->color_matrix, &mat, sizeof(float) * 16);
 }
 
+static void obs_init_convert_pool(struct obs_core_video *video)
+{
+	int cores = os_get_logical_cores();
+	size_t threads = cores > 1 ? (size_t)cores - 1 : 0;
+
+	if (threads > MAX_CONVERT_THREADS)
+		threads = MAX_CONVERT_THREADS;
+	if (threads)
+		video->convert_pool = os_threadpool_create(
+				"libobs: conversion thread", threads);
+
+	/* each band of a frame converted in parallel gets its own profiler
+	 * entry */
+	for (size_t i = 0; i < MAX_CONVERT_BANDS; i++)
+		video->convert_band_names[i] = profile_store_name(
+				obs_get_profiler_name_store(),
+				"convert_frame(band %d)", (int)i);
+}
+
 static int obs_init_video(struct obs_video_info *ovi)
 {
 	struct obs_core_video *video = &obs->video;
@@ -360,6 +379,7 @@ static int obs_init_video(struct obs_video_info *ovi)
 	video->output_height  = ovi->output_height;
 	video->gpu_conversion = ovi->gpu_conversion;
 	video->scale_type     = ovi->scale_type;
+	video->num_textures   = (int)ovi->pipeline_depth;
 
 	set_video_matrix(video, ovi);
 
@@ -384,6 +404,8 @@ static int obs_init_video(struct obs_video_info *ovi)
 
 	gs_leave_context();
 
+	obs_init_convert_pool(video);
+
 	errorcode = pthread_create(&video->video_thread, NULL,
 			obs_video_thread, obs);
 	if (errorcode != 0)
@@ -417,6 +439,9 @@ static void obs_free_video(void)
 		video_output_close(video->video);
 		video->video = NULL;
 
+		os_threadpool_destroy(video->convert_pool);
+		video->convert_pool = NULL;
+
 		if (!video->graphics)
 			return;
 
@@ -427,7 +452,7 @@ static void obs_free_video(void)
 			video->mapped_surface = NULL;
 		}
 
-		for (size_t i = 0; i < NUM_TEXTURES; i++) {
+		for (size_t i = 0; i < MAX_TEXTURES; i++) {
 			gs_stagesurface_destroy(video->copy_surfaces[i]);
 			gs_texture_destroy(video->render_textures[i]);
 			gs_texture_destroy(video->convert_textures[i]);
@@ -456,6 +481,25 @@ static void obs_free_video(void)
 	}
 }
 
+static void log_map_wait(void)
+{
+	struct obs_core_video *video = &obs->video;
+
+	if (!video->map_count)
+		return;
+
+	blog(LOG_INFO, "Video output readback: %"PRIu32" frames mapped, "
+			"%.3f ms average wait, %.3f ms longest wait",
+			video->map_count,
+			(double)video->map_wait_total_ns /
+			(double)video->map_count / 1000000.0,
+			(double)video->map_wait_max_ns / 1000000.0);
+
+	video->map_wait_total_ns = 0;
+	video->map_wait_max_ns = 0;
+	video->map_count = 0;
+}
+
 static void obs_free_graphics(void)
 {
 	struct obs_core_video *video = &obs->video;
@@ -492,6 +536,7 @@ static bool obs_init_audio(struct audio_output_info *ai)
 	pthread_mutexattr_t attr;
 
 	pthread_mutex_init_value(&audio->monitoring_mutex);
+	pthread_mutex_init_value(&audio->meter_mutex);
 
 	if (pthread_mutexattr_init(&attr) != 0)
 		return false;
@@ -499,9 +544,17 @@ static bool obs_init_audio(struct audio_output_info *ai)
 		return false;
 	if (pthread_mutex_init(&audio->monitoring_mutex, &attr) != 0)
 		return false;
+	if (pthread_mutex_init(&audio->meter_mutex, NULL) != 0)
+		return false;
 
 	audio->user_volume    = 1.0f;
 
+	/* the maximum amount of buffering stays the same (~1 second at
+	 * 48khz) regardless of block size */
+	audio->block_frames = ai->block_frames;
+	audio->max_buffering_ticks = (int)(MAX_BUFFERING_FRAMES /
+			audio->block_frames);
+
 	audio->monitoring_device_name = bstrdup("Default");
 	audio->monitoring_device_id = bstrdup("default");
 
@@ -531,6 +584,9 @@ static void obs_free_audio(void)
 	bfree(audio->monitoring_device_id);
 	pthread_mutex_destroy(&audio->monitoring_mutex);
 
+	da_free(audio->meter_feeds);
+	pthread_mutex_destroy(&audio->meter_mutex);
+
 	memset(audio, 0, sizeof(struct obs_core_audio));
 }
 
@@ -660,7 +716,12 @@ static inline bool obs_init_handlers(void)
 	if (!obs->procs)
 		return false;
 
-	return signal_handler_add_array(obs->signals, obs_signals);
+	if (!signal_handler_add_array(obs->signals, obs_signals))
+		return false;
+
+	obs->source_volume_signal = signal_handler_get_handle(obs->signals,
+			"source_volume");
+	return true;
 }
 
 static pthread_once_t obs_pthread_once_init_token = PTHREAD_ONCE_INIT;
@@ -838,12 +899,14 @@ void obs_shutdown(void)
 
 	stop_video();
 	stop_hotkeys();
+	log_map_wait();
 
 	obs_free_audio();
 	obs_free_data();
 	obs_free_video();
 	obs_free_hotkeys();
 	obs_free_graphics();
+	obs_encoder_packet_pool_free();
 	proc_handler_destroy(obs->procs);
 	signal_handler_destroy(obs->signals);
 	obs->procs = NULL;
@@ -937,12 +1000,18 @@ int obs_reset_video(struct obs_video_info *ovi)
 	struct obs_core_video *video = &obs->video;
 
 	stop_video();
+	log_map_wait();
 	obs_free_video();
 
 	/* align to multiple-of-two and SSE alignment sizes */
 	ovi->output_width  &= 0xFFFFFFFC;
 	ovi->output_height &= 0xFFFFFFFE;
 
+	if (ovi->pipeline_depth < MIN_TEXTURES)
+		ovi->pipeline_depth = MIN_TEXTURES;
+	else if (ovi->pipeline_depth > MAX_TEXTURES)
+		ovi->pipeline_depth = MAX_TEXTURES;
+
 	if (!video->graphics) {
 		int errorcode = obs_init_graphics(ovi);
 		if (errorcode != OBS_VIDEO_SUCCESS) {
@@ -976,16 +1045,35 @@ int obs_reset_video(struct obs_video_info *ovi)
 	               "\toutput resolution: %dx%d\n"
 	               "\tdownscale filter:  %s\n"
 	               "\tfps:               %d/%d\n"
-	               "\tformat:            %s",
+	               "\tformat:            %s\n"
+	               "\tpipeline depth:    %u",
 	               ovi->base_width, ovi->base_height,
 	               ovi->output_width, ovi->output_height,
 	               scale_type_name,
 	               ovi->fps_num, ovi->fps_den,
-		       get_video_format_name(ovi->output_format));
+		       get_video_format_name(ovi->output_format),
+		       ovi->pipeline_depth);
 
 	return obs_init_video(ovi);
 }
 
+static inline uint32_t get_block_frames(uint32_t block_frames)
+{
+	switch (block_frames) {
+	case 128:
+	case 256:
+	case 512:
+	case AUDIO_OUTPUT_FRAMES:
+		return block_frames;
+	case 0:
+		return AUDIO_OUTPUT_FRAMES;
+	}
+
+	blog(LOG_WARNING, "Unsupported audio block size %u, using %d",
+			block_frames, AUDIO_OUTPUT_FRAMES);
+	return AUDIO_OUTPUT_FRAMES;
+}
+
 bool obs_reset_audio(const struct obs_audio_info *oai)
 {
 	struct audio_output_info ai;
@@ -1005,13 +1093,17 @@ bool obs_reset_audio(const struct obs_audio_info *oai)
 	ai.format = AUDIO_FORMAT_FLOAT_PLANAR;
 	ai.speakers = oai->speakers;
 	ai.input_callback = audio_callback;
+	ai.input_param = NULL;
+	ai.block_frames = get_block_frames(oai->block_frames);
 
 	blog(LOG_INFO, "---------------------------------");
 	blog(LOG_INFO, "audio settings reset:\n"
 	               "\tsamples per sec: %d\n"
-	               "\tspeakers:        %d",
+	               "\tspeakers:        %d\n"
+	               "\tblock frames:    %d",
 	               (int)ai.samples_per_sec,
-	               (int)ai.speakers);
+	               (int)ai.speakers,
+	               (int)ai.block_frames);
 
 	return obs_init_audio(&ai);
 }
@@ -1039,9 +1131,25 @@ bool obs_get_audio_info(struct obs_audio_info *oai)
 
 	oai->samples_per_sec = info->samples_per_sec;
 	oai->speakers = info->speakers;
+	oai->block_frames = info->block_frames;
 	return true;
 }
 
+uint32_t obs_get_audio_buffering_ms(void)
+{
+	struct obs_core_audio *audio;
+	uint32_t sample_rate;
+
+	if (!obs || !obs->audio.audio)
+		return 0;
+
+	audio = &obs->audio;
+	sample_rate = audio_output_get_sample_rate(audio->audio);
+
+	return (uint32_t)((uint64_t)audio->total_buffering_ticks *
+			audio->block_frames * 1000 / sample_rate);
+}
+
 bool obs_enum_source_types(size_t idx, const char **id)
 {
 	if (!obs) return false;
@@ -1979,3 +2087,19 @@ uint32_t obs_get_lagged_frames(void)
 {
 	return obs ? obs->video.lagged_frames : 0;
 }
+
+uint32_t obs_get_culled_items(void)
+{
+	return obs ? obs->video.last_culled_items : 0;
+}
+
+void obs_set_render_cache_enabled(bool enabled)
+{
+	if (obs)
+		obs->video.render_cache_disabled = !enabled;
+}
+
+bool obs_render_cache_enabled(void)
+{
+	return obs ? !obs->video.render_cache_disabled : false;
+}
@@ -150,7 +150,8 @@ struct obs_transform_info {
  */
 struct obs_video_info {
 	/**
-	 * Graphics module to use (usually "libobs-opengl" or "libobs-d3d11")
+	 * Graphics module to use (usually "libobs-opengl" or "libobs-d3d11", or
+	 * "libobs-null" for headless testing and benchmarking)
 	 */
 	const char          *graphics_module;
 
@@ -174,6 +175,14 @@ struct obs_video_info {
 	enum video_range_type range;       /**< YUV range (if YUV) */
 
 	enum obs_scale_type scale_type;    /**< How to scale if scaling */
+
+	/**
+	 * Number of frames that can be in flight between rendering and
+	 * reading back the output on the CPU (2-8, 0 for the default of 2).
+	 * More frames give the GPU more time to finish before the output is
+	 * mapped, at the cost of a frame of latency for each.
+	 */
+	uint32_t            pipeline_depth;
 };
 
 /**
@@ -182,6 +191,13 @@ struct obs_video_info {
 struct obs_audio_info {
 	uint32_t            samples_per_sec;
 	enum speaker_layout speakers;
+
+	/**
+	 * Frames mixed per audio tick (128, 256, 512 or 1024, 0 for the
+	 * default of 1024).  Smaller blocks lower the latency from sources to
+	 * outputs at the cost of waking the audio thread more often.
+	 */
+	uint32_t            block_frames;
 };
 
 /**
@@ -235,8 +251,15 @@ struct obs_source_frame {
 	/* used internally by libobs */
 	volatile long       refs;
 	bool                prev_frame;
+	bool                external;
 };
 
+/**
+ * Called by libobs when it no longer needs the data of a frame that was output
+ * with obs_source_output_video_external.  May be called from any thread.
+ */
+typedef void (*obs_source_frame_release_t)(void *param);
+
 /* ------------------------------------------------------------------------- */
 /* OBS context */
 
@@ -312,6 +335,12 @@ EXPORT bool obs_get_video_info(struct obs_video_info *ovi);
 /** Gets the current audio settings, returns false if no audio */
 EXPORT bool obs_get_audio_info(struct obs_audio_info *oai);
 
+/**
+ * Returns how much audio buffering (in milliseconds) is currently being
+ * applied to keep sources with late timestamps in sync
+ */
+EXPORT uint32_t obs_get_audio_buffering_ms(void);
+
 /**
  * Opens a plugin module directly from a specific path.
  *
@@ -639,6 +668,21 @@ EXPORT uint64_t obs_get_average_frame_time_ns(void);
 EXPORT uint32_t obs_get_total_frames(void);
 EXPORT uint32_t obs_get_lagged_frames(void);
 
+/**
+ * Gets the number of scene items that were not rendered in the last frame
+ * because they were outside of the canvas or covered by opaque items.
+ * Scenes rendered more than once in a frame count their items each time.
+ */
+EXPORT uint32_t obs_get_culled_items(void);
+
+/**
+ * Enables or disables the render cache (enabled by default).  Sources drawn
+ * more than once per frame are rendered to a texture the first time and drawn
+ * from it afterward, unless they have the OBS_SOURCE_DO_NOT_CACHE flag.
+ */
+EXPORT void obs_set_render_cache_enabled(bool enabled);
+EXPORT bool obs_render_cache_enabled(void);
+
 
 /* ------------------------------------------------------------------------- */
 /* Display context */
@@ -764,6 +808,12 @@ EXPORT uint32_t obs_source_get_width(obs_source_t *source);
 /** Gets the height of a source (if it has video) */
 EXPORT uint32_t obs_source_get_height(obs_source_t *source);
 
+/**
+ * Returns true if the source covers its whole width and height with opaque
+ * pixels.  Scenes use this to skip rendering items hidden under it.
+ */
+EXPORT bool obs_source_opaque(obs_source_t *source);
+
 /**
  * If the source is a filter, returns the parent source of the filter.  Only
  * guaranteed to be valid inside of the video_render, filter_audio,
@@ -997,6 +1047,22 @@ EXPORT void obs_source_draw(gs_texture_t *image, int x, int y,
 EXPORT void obs_source_output_video(obs_source_t *source,
 		const struct obs_source_frame *frame);
 
+/**
+ * Outputs asynchronous video data without copying it.  libobs uploads straight
+ * from the data pointers of the frame, so the memory they point to must stay
+ * valid and unmodified until the release callback is called with the given
+ * parameter.  The release callback is always called exactly once, and may be
+ * called before this function returns if the frame is dropped.
+ *
+ * If the source has async video filters the frame is copied instead and
+ * released right away, since filters may hold on to frames indefinitely.
+ * Producers with a fixed number of buffers should still copy with
+ * obs_source_output_video once most of their buffers are in use.
+ */
+EXPORT void obs_source_output_video_external(obs_source_t *source,
+		const struct obs_source_frame *frame,
+		obs_source_frame_release_t release, void *param);
+
 /** Preloads asynchronous video data to allow instantaneous playback */
 EXPORT void obs_source_preload_video(obs_source_t *source,
 		const struct obs_source_frame *frame);
@@ -1660,6 +1726,27 @@ EXPORT enum obs_encoder_type obs_encoder_get_type(const obs_encoder_t *encoder);
 EXPORT void obs_encoder_set_scaled_size(obs_encoder_t *encoder, uint32_t width,
 		uint32_t height);
 
+/**
+ * Sets whether an encoder runs on its own thread instead of inline on the
+ * video or audio output thread, which lets multiple encoders encode in
+ * parallel.  Audio encoders are threaded by default, video encoders are not.
+ * If the encoder is active, this function will trigger a warning, and do
+ * nothing.
+ */
+EXPORT void obs_encoder_set_threaded(obs_encoder_t *encoder, bool threaded);
+
+/** Returns true if the encoder runs on its own thread */
+EXPORT bool obs_encoder_threaded(const obs_encoder_t *encoder);
+
+/** For threaded video encoders, returns the number of frames queued */
+EXPORT size_t obs_encoder_get_queued_frames(const obs_encoder_t *encoder);
+
+/**
+ * For threaded video encoders, returns how far behind (in nanoseconds) the
+ * encoder is from the most recent raw frame
+ */
+EXPORT uint64_t obs_encoder_get_lag(const obs_encoder_t *encoder);
+
 /** For video encoders, returns the width of the encoded image */
 EXPORT uint32_t obs_encoder_get_width(const obs_encoder_t *encoder);
 
@@ -1746,6 +1833,24 @@ EXPORT void obs_encoder_packet_ref(struct encoder_packet *dst,
 		struct encoder_packet *src);
 EXPORT void obs_encoder_packet_release(struct encoder_packet *packet);
 
+struct obs_encoder_packet_stats {
+	/** Total bytes copied into packet buffers by libobs */
+	uint64_t bytes_copied;
+	/** Total packet buffers allocated */
+	uint64_t allocations;
+	/** Packet buffers that were reused from the pool */
+	uint64_t pool_hits;
+	/** Bytes currently held by the pool for reuse */
+	uint64_t bytes_pooled;
+};
+
+/**
+ * Returns cumulative packet buffer statistics.  Sample bytes_copied over
+ * time to get the number of bytes copied per second.
+ */
+EXPORT void obs_encoder_packet_get_stats(
+		struct obs_encoder_packet_stats *stats);
+
 
 /* ------------------------------------------------------------------------- */
 /* Stream Services */
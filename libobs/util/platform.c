@@ -26,6 +26,12 @@
 #include "utf8.h"
 #include "dstr.h"
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
 FILE *os_wfopen(const wchar_t *path, const char *mode)
 {
 	FILE *file = NULL;
@@ -773,3 +779,85 @@ char *os_generate_formatted_filename(const char *extension, bool space,
 
 	return sf.array;
 }
+
+#if defined(_MSC_VER) || defined(__i386__) || defined(__x86_64__)
+static inline void get_cpuid(int leaf, int subleaf, uint32_t regs[4])
+{
+#ifdef _MSC_VER
+	__cpuidex((int*)regs, leaf, subleaf);
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static inline uint64_t get_xcr0(void)
+{
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	uint32_t eax, edx;
+	__asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((uint64_t)edx << 32) | eax;
+#endif
+}
+
+static uint32_t detect_cpu_features(void)
+{
+	uint32_t features = 0;
+	uint32_t regs[4];
+	uint32_t max_leaf;
+	bool os_saves_ymm = false;
+
+	get_cpuid(0, 0, regs);
+	max_leaf = regs[0];
+	if (max_leaf < 1)
+		return 0;
+
+	get_cpuid(1, 0, regs);
+	if (regs[3] & (1 << 26))
+		features |= OS_CPU_SSE2;
+	if (regs[2] & (1 << 9))
+		features |= OS_CPU_SSSE3;
+	if (regs[2] & (1 << 19))
+		features |= OS_CPU_SSE41;
+
+	/* AVX registers are only usable if the OS saves them (OSXSAVE and
+	 * the XMM/YMM state bits of XCR0) */
+	if ((regs[2] & (1 << 27)) != 0)
+		os_saves_ymm = (get_xcr0() & 0x6) == 0x6;
+
+	if (os_saves_ymm) {
+		if (regs[2] & (1 << 28))
+			features |= OS_CPU_AVX;
+		if ((regs[2] & (1 << 12)) && (features & OS_CPU_AVX))
+			features |= OS_CPU_FMA3;
+
+		if (max_leaf >= 7) {
+			get_cpuid(7, 0, regs);
+			if ((regs[1] & (1 << 5)) && (features & OS_CPU_AVX))
+				features |= OS_CPU_AVX2;
+		}
+	}
+
+	return features;
+}
+#else
+static uint32_t detect_cpu_features(void)
+{
+	return 0;
+}
+#endif
+
+uint32_t os_get_cpu_features(void)
+{
+	static volatile bool detected = false;
+	static volatile uint32_t features = 0;
+
+	/* detection is idempotent, so racing on the first call is harmless */
+	if (!detected) {
+		features = detect_cpu_features();
+		detected = true;
+	}
+
+	return features;
+}
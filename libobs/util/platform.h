@@ -181,6 +181,20 @@ EXPORT void os_breakpoint(void);
 EXPORT int os_get_physical_cores(void);
 EXPORT int os_get_logical_cores(void);
 
+#define OS_CPU_SSE2   (1 << 0)
+#define OS_CPU_SSSE3  (1 << 1)
+#define OS_CPU_SSE41  (1 << 2)
+#define OS_CPU_AVX    (1 << 3)
+#define OS_CPU_AVX2   (1 << 4)
+#define OS_CPU_FMA3   (1 << 5)
+
+/**
+ * Returns the instruction set extensions (OS_CPU_*) that are supported by
+ * both the CPU and the operating system, for picking SIMD code paths at
+ * runtime.
+ */
+EXPORT uint32_t os_get_cpu_features(void);
+
 #ifdef _MSC_VER
 #define strtoll _strtoi64
 #if _MSC_VER < 1900
@@ -7,13 +7,24 @@
 #include "threading.h"
 
 #include <math.h>
+#include <errno.h>
 
 #include <zlib.h>
 
 //#define TRACK_OVERHEAD
 
+typedef struct profile_counter profile_counter;
+struct profile_counter {
+	const char *name;
+	uint64_t samples;
+	uint64_t sum;
+	uint64_t min;
+	uint64_t max;
+};
+
 struct profiler_snapshot {
 	DARRAY(profiler_snapshot_entry_t) roots;
+	DARRAY(profile_counter) counters;
 };
 
 struct profiler_snapshot_entry {
@@ -260,14 +271,25 @@ static bool enabled = false;
 static pthread_mutex_t root_mutex = PTHREAD_MUTEX_INITIALIZER;
 static DARRAY(profile_root_entry) root_entries;
 
+static pthread_mutex_t counter_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(profile_counter) counters;
+
 #ifdef _MSC_VER
-static __declspec(thread) profile_call *thread_context = NULL;
-static __declspec(thread) bool thread_enabled = true;
+#define THREAD_LOCAL __declspec(thread)
 #else
-static __thread profile_call *thread_context = NULL;
-static __thread bool thread_enabled = true;
+#define THREAD_LOCAL __thread
 #endif
 
+static THREAD_LOCAL profile_call *thread_context = NULL;
+static THREAD_LOCAL bool thread_enabled = true;
+
+/* trace mode state, see "Profiler tracing" below */
+static volatile bool tracing = false;
+static THREAD_LOCAL long thread_trace_depth = 0;
+
+static void trace_push(const char *name, bool end);
+static void profiler_trace_free(void);
+
 void profiler_start(void)
 {
 	pthread_mutex_lock(&root_mutex);
@@ -372,6 +394,15 @@ static void merge_context(profile_call *context)
 
 void profile_start(const char *name)
 {
+	/* a root started while tracing stays in trace mode until it ends, so
+	 * begin/end events always come in pairs */
+	if (thread_trace_depth ||
+	    (!thread_context && os_atomic_load_bool(&tracing))) {
+		thread_trace_depth++;
+		trace_push(name, false);
+		return;
+	}
+
 	if (!thread_enabled)
 		return;
 
@@ -399,6 +430,12 @@ void profile_start(const char *name)
 
 void profile_end(const char *name)
 {
+	if (thread_trace_depth) {
+		thread_trace_depth--;
+		trace_push(name, true);
+		return;
+	}
+
 	uint64_t end = os_gettime_ns();
 	if (!thread_enabled)
 		return;
@@ -443,6 +480,38 @@ void profile_end(const char *name)
 	merge_context(call);
 }
 
+void profile_counter_record(const char *name, uint64_t value)
+{
+	profile_counter *counter = NULL;
+
+	if (!thread_enabled)
+		return;
+
+	pthread_mutex_lock(&counter_mutex);
+
+	for (size_t i = 0; i < counters.num; i++) {
+		if (counters.array[i].name == name) {
+			counter = &counters.array[i];
+			break;
+		}
+	}
+
+	if (!counter) {
+		counter = da_push_back_new(counters);
+		counter->name = name;
+		counter->min = value;
+	}
+
+	counter->samples++;
+	counter->sum += value;
+	if (value < counter->min)
+		counter->min = value;
+	if (value > counter->max)
+		counter->max = value;
+
+	pthread_mutex_unlock(&counter_mutex);
+}
+
 static int profiler_time_entry_compare(const void *first, const void *second)
 {
 	int64_t diff = ((profiler_time_entry*)second)->time_delta -
@@ -750,10 +819,37 @@ void profile_print_func(const char *intro, profile_entry_print_func print,
 	dstr_free(&indent_buffer);
 }
 
+static void profile_print_counters(profiler_snapshot_t *snap)
+{
+	if (!snap->counters.num)
+		return;
+
+	blog(LOG_INFO, "== Profiler Counters ============================");
+	for (size_t i = 0; i < snap->counters.num; i++) {
+		profile_counter *counter = &snap->counters.array[i];
+		double avg = counter->samples ?
+			(double)counter->sum / (double)counter->samples : 0.0;
+
+		blog(LOG_INFO, "%s: min=%"PRIu64", avg=%g, max=%"PRIu64
+				" (%"PRIu64" samples)", counter->name,
+				counter->min, avg, counter->max,
+				counter->samples);
+	}
+	blog(LOG_INFO, "=================================================");
+}
+
 void profiler_print(profiler_snapshot_t *snap)
 {
+	bool free_snapshot = !snap;
+	if (!snap)
+		snap = profile_snapshot_create();
+
 	profile_print_func("== Profiler Results =============================",
 			profile_print_entry, snap);
+	profile_print_counters(snap);
+
+	if (free_snapshot)
+		profile_snapshot_free(snap);
 }
 
 void profiler_print_time_between_calls(profiler_snapshot_t *snap)
@@ -828,6 +924,349 @@ void profiler_free(void)
 	}
 
 	da_free(old_root_entries);
+
+	pthread_mutex_lock(&counter_mutex);
+	da_free(counters);
+	pthread_mutex_unlock(&counter_mutex);
+
+	profiler_trace_free();
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* Profiler tracing */
+
+/* Each thread appends begin/end events to its own single-producer ring
+ * buffer; only the drain thread reads them, so recording an event never
+ * takes a lock.  Buffers are registered once per thread and kept until
+ * profiler_free so threads never have to unregister.  Freeing them bumps
+ * trace_generation, so threads that still hold a pointer to their old buffer
+ * register a new one instead of writing to freed memory.
+ *
+ * A begin event is only recorded if there's also room left for its end
+ * event (and those of every begin still open), so events always come in
+ * pairs.  When a begin is dropped, everything up to its end is dropped
+ * too. */
+
+#define TRACE_BUFFER_EVENTS (1 << 14)
+#define TRACE_BUFFER_MASK   (TRACE_BUFFER_EVENTS - 1)
+#define TRACE_DRAIN_MS      10
+
+struct trace_event {
+	const char *name;
+	uint64_t time;
+	bool end;
+};
+
+struct trace_buffer {
+	struct trace_buffer *next;
+	long tid;
+	const char *thread_name;
+
+	/* head is only written by the owning thread, tail only by the
+	 * drain thread */
+	volatile long head;
+	volatile long tail;
+	volatile long dropped;
+
+	/* only used by the owning thread: number of recorded begins without
+	 * an end yet, and how deep into a dropped begin the thread is */
+	long open;
+	long skip;
+
+	bool named;
+	struct trace_event events[TRACE_BUFFER_EVENTS];
+};
+
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct trace_buffer *trace_buffers = NULL;
+static long trace_num_buffers = 0;
+static volatile long trace_generation = 1;
+static THREAD_LOCAL struct trace_buffer *thread_trace_buffer = NULL;
+static THREAD_LOCAL long thread_trace_generation = 0;
+
+static pthread_t trace_thread;
+static os_event_t *trace_stop_event = NULL;
+static FILE *trace_file = NULL;
+static uint64_t trace_start_time = 0;
+static bool trace_first_event = true;
+
+static struct trace_buffer *trace_register_thread(const char *name)
+{
+	struct trace_buffer *buf = bzalloc(sizeof(struct trace_buffer));
+	buf->thread_name = name;
+
+	pthread_mutex_lock(&trace_mutex);
+	buf->tid = ++trace_num_buffers;
+	buf->next = trace_buffers;
+	trace_buffers = buf;
+	thread_trace_generation = trace_generation;
+	pthread_mutex_unlock(&trace_mutex);
+
+	thread_trace_buffer = buf;
+	return buf;
+}
+
+static void trace_push(const char *name, bool end)
+{
+	uint64_t time = os_gettime_ns();
+	struct trace_buffer *buf = thread_trace_buffer;
+	if (!buf || thread_trace_generation !=
+			os_atomic_load_long(&trace_generation))
+		buf = trace_register_thread(name);
+
+	/* the begin went to a buffer that has since been freed */
+	if (end && !buf->open && !buf->skip)
+		return;
+
+	if (buf->skip) {
+		buf->skip += end ? -1 : 1;
+		os_atomic_inc_long(&buf->dropped);
+		return;
+	}
+
+	long head = buf->head;
+	long tail = os_atomic_load_long(&buf->tail);
+
+	/* ends always have a slot reserved by their begin */
+	if (!end && (unsigned long)(head - tail + buf->open + 2) >
+			TRACE_BUFFER_EVENTS) {
+		buf->skip = 1;
+		os_atomic_inc_long(&buf->dropped);
+		return;
+	}
+
+	struct trace_event *event = &buf->events[head & TRACE_BUFFER_MASK];
+	event->name = name;
+	event->time = time;
+	event->end  = end;
+	buf->open  += end ? -1 : 1;
+
+	/* full barrier: publishes the event before the new head */
+	os_atomic_inc_long(&buf->head);
+}
+
+static struct trace_buffer *trace_get_buffers(void)
+{
+	struct trace_buffer *buf;
+
+	/* buffers are only ever prepended, so the list is safe to walk
+	 * without the lock once its head has been read */
+	pthread_mutex_lock(&trace_mutex);
+	buf = trace_buffers;
+	pthread_mutex_unlock(&trace_mutex);
+	return buf;
+}
+
+static void trace_write_string(struct dstr *out, const char *str)
+{
+	dstr_cat_ch(out, '"');
+	for (; str && *str; str++) {
+		unsigned char ch = (unsigned char)*str;
+		if (ch == '"' || ch == '\\') {
+			dstr_cat_ch(out, '\\');
+			dstr_cat_ch(out, (char)ch);
+		} else if (ch < 0x20) {
+			dstr_catf(out, "\\u%04x", ch);
+		} else {
+			dstr_cat_ch(out, (char)ch);
+		}
+	}
+	dstr_cat_ch(out, '"');
+}
+
+static inline void trace_write_separator(struct dstr *out)
+{
+	if (!trace_first_event)
+		dstr_cat(out, ",\n");
+	trace_first_event = false;
+}
+
+static void trace_drain_buffer(struct trace_buffer *buf, struct dstr *out)
+{
+	long head = os_atomic_load_long(&buf->head);
+	long tail = buf->tail;
+
+	if (head == tail)
+		return;
+
+	if (!buf->named) {
+		trace_write_separator(out);
+		dstr_catf(out, "{\"name\":\"thread_name\",\"ph\":\"M\","
+				"\"pid\":1,\"tid\":%ld,\"args\":{\"name\":",
+				buf->tid);
+		trace_write_string(out, buf->thread_name);
+		dstr_cat(out, "}}");
+		buf->named = true;
+	}
+
+	for (long i = tail; i != head; i++) {
+		struct trace_event *event = &buf->events[i & TRACE_BUFFER_MASK];
+		uint64_t ns = event->time > trace_start_time ?
+			event->time - trace_start_time : 0;
+
+		trace_write_separator(out);
+		dstr_cat(out, "{\"name\":");
+		trace_write_string(out, event->name);
+		dstr_catf(out, ",\"ph\":\"%c\",\"ts\":%"PRIu64".%03u,"
+				"\"pid\":1,\"tid\":%ld}",
+				event->end ? 'E' : 'B',
+				ns / 1000, (unsigned)(ns % 1000), buf->tid);
+	}
+
+	/* full barrier: the events have been read before the slots are
+	 * handed back to the producer (tail has no other writer) */
+	os_atomic_compare_swap_long(&buf->tail, tail, head);
+}
+
+static void trace_drain(struct dstr *out)
+{
+	struct trace_buffer *buf = trace_get_buffers();
+
+	for (; buf; buf = buf->next)
+		trace_drain_buffer(buf, out);
+
+	if (out->len) {
+		fwrite(out->array, 1, out->len, trace_file);
+		out->len = 0;
+	}
+}
+
+static void *trace_thread_proc(void *data)
+{
+	struct dstr out = {0};
+
+	os_set_thread_name("profiler: trace");
+
+	while (os_event_timedwait(trace_stop_event, TRACE_DRAIN_MS) ==
+			ETIMEDOUT)
+		trace_drain(&out);
+
+	trace_drain(&out);
+	dstr_free(&out);
+
+	UNUSED_PARAMETER(data);
+	return NULL;
+}
+
+bool profiler_trace_start(const char *path)
+{
+	bool success = false;
+
+	pthread_mutex_lock(&trace_mutex);
+
+	if (trace_file) {
+		blog(LOG_WARNING, "profiler_trace_start: already tracing");
+		goto unlock;
+	}
+
+	trace_file = os_fopen(path, "wb");
+	if (!trace_file) {
+		blog(LOG_WARNING, "profiler_trace_start: failed to open '%s'",
+				path);
+		goto unlock;
+	}
+
+	if (os_event_init(&trace_stop_event, OS_EVENT_TYPE_MANUAL) != 0)
+		goto fail;
+
+	/* skip anything left over from a previous session; the drain
+	 * thread isn't running, so nothing else writes tail here */
+	for (struct trace_buffer *buf = trace_buffers; buf; buf = buf->next) {
+		os_atomic_set_long(&buf->tail,
+				os_atomic_load_long(&buf->head));
+		os_atomic_set_long(&buf->dropped, 0);
+		buf->named = false;
+	}
+
+	fputs("{\"traceEvents\":[\n", trace_file);
+	trace_first_event = true;
+	trace_start_time = os_gettime_ns();
+
+	if (pthread_create(&trace_thread, NULL, trace_thread_proc, NULL) != 0) {
+		os_event_destroy(trace_stop_event);
+		trace_stop_event = NULL;
+		goto fail;
+	}
+
+	os_atomic_set_bool(&tracing, true);
+	blog(LOG_INFO, "Profiler: tracing to '%s'", path);
+	success = true;
+	goto unlock;
+
+fail:
+	blog(LOG_WARNING, "profiler_trace_start: failed to start trace thread");
+	fclose(trace_file);
+	trace_file = NULL;
+
+unlock:
+	pthread_mutex_unlock(&trace_mutex);
+	return success;
+}
+
+void profiler_trace_stop(void)
+{
+	long dropped = 0;
+
+	pthread_mutex_lock(&trace_mutex);
+
+	if (!trace_file) {
+		pthread_mutex_unlock(&trace_mutex);
+		return;
+	}
+
+	os_atomic_set_bool(&tracing, false);
+	pthread_mutex_unlock(&trace_mutex);
+
+	/* the drain thread takes trace_mutex to read the buffer list */
+	os_event_signal(trace_stop_event);
+	pthread_join(trace_thread, NULL);
+
+	pthread_mutex_lock(&trace_mutex);
+
+	fputs("\n]}\n", trace_file);
+	fclose(trace_file);
+	trace_file = NULL;
+
+	os_event_destroy(trace_stop_event);
+	trace_stop_event = NULL;
+
+	for (struct trace_buffer *buf = trace_buffers; buf; buf = buf->next)
+		dropped += os_atomic_load_long(&buf->dropped);
+
+	pthread_mutex_unlock(&trace_mutex);
+
+	if (dropped)
+		blog(LOG_WARNING, "Profiler: trace dropped %ld events",
+				dropped);
+	blog(LOG_INFO, "Profiler: tracing stopped");
+}
+
+bool profiler_trace_active(void)
+{
+	return os_atomic_load_bool(&tracing);
+}
+
+static void profiler_trace_free(void)
+{
+	struct trace_buffer *buf;
+
+	profiler_trace_stop();
+
+	pthread_mutex_lock(&trace_mutex);
+	buf = trace_buffers;
+	trace_buffers = NULL;
+	trace_num_buffers = 0;
+	os_atomic_inc_long(&trace_generation);
+	pthread_mutex_unlock(&trace_mutex);
+
+	while (buf) {
+		struct trace_buffer *next = buf->next;
+		bfree(buf);
+		buf = next;
+	}
+
+	thread_trace_buffer = NULL;
 }
 
 
@@ -946,6 +1385,10 @@ profiler_snapshot_t *profile_snapshot_create(void)
 	for (size_t i = 0; i < snap->roots.num; i++)
 		sort_snapshot_entry(&snap->roots.array[i]);
 
+	pthread_mutex_lock(&counter_mutex);
+	da_copy(snap->counters, counters);
+	pthread_mutex_unlock(&counter_mutex);
+
 	return snap;
 }
 
@@ -968,6 +1411,7 @@ void profile_snapshot_free(profiler_snapshot_t *snap)
 		free_snapshot_entry(&snap->roots.array[i]);
 
 	da_free(snap->roots);
+	da_free(snap->counters);
 	bfree(snap);
 }
 
@@ -22,6 +22,12 @@ EXPORT void profile_end(const char *name);
 
 EXPORT void profile_reenable_thread(void);
 
+/* Records a sample for a counter, such as the number of times something
+ * happened during a frame.  profiler_print lists the minimum, average and
+ * maximum of each counter.  Names are compared by pointer, the same as
+ * with profile_start. */
+EXPORT void profile_counter_record(const char *name, uint64_t value);
+
 /* ------------------------------------------------------------------------- */
 /* Profiler control */
 
@@ -33,6 +39,24 @@ EXPORT void profiler_print_time_between_calls(profiler_snapshot_t *snap);
 
 EXPORT void profiler_free(void);
 
+/* ------------------------------------------------------------------------- */
+/* Profiler tracing */
+
+/**
+ * Writes every profile_start/profile_end pair to a Chrome trace event JSON
+ * file (viewable in chrome://tracing or Perfetto) until profiler_trace_stop
+ * is called.
+ *
+ *   While tracing, call trees that begin on any thread are recorded as
+ * timestamped events in a per-thread lock-free buffer instead of being
+ * merged into the regular profiler data, so they won't show up in
+ * snapshots.  A background thread drains the buffers to the file; events
+ * are dropped (and counted in the log) if a buffer fills up first.
+ */
+EXPORT bool profiler_trace_start(const char *path);
+EXPORT void profiler_trace_stop(void);
+EXPORT bool profiler_trace_active(void);
+
 /* ------------------------------------------------------------------------- */
 /* Profiler name storage */
 
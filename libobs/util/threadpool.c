@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2017 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "bmem.h"
+#include "dstr.h"
+#include "platform.h"
+#include "threading.h"
+#include "threadpool.h"
+
+struct task_batch {
+	os_task_t         task;
+	void              *param;
+	size_t            count;
+	size_t            next;
+	size_t            remaining;
+
+	struct task_batch *next_batch;
+};
+
+struct os_threadpool {
+	char              *name;
+	pthread_t         *threads;
+	size_t            num_threads;
+
+	pthread_mutex_t   mutex;
+	pthread_cond_t    work_cond;
+	pthread_cond_t    done_cond;
+	struct task_batch *first_batch;
+	struct task_batch *last_batch;
+	bool              stop;
+};
+
+/* must be called with the pool mutex held */
+static struct task_batch *claim_job(struct os_threadpool *pool, size_t *idx)
+{
+	struct task_batch *batch = pool->first_batch;
+	if (!batch)
+		return NULL;
+
+	*idx = batch->next++;
+
+	if (batch->next == batch->count) {
+		pool->first_batch = batch->next_batch;
+		if (!pool->first_batch)
+			pool->last_batch = NULL;
+	}
+
+	return batch;
+}
+
+/* must be called with the pool mutex held */
+static void finish_job(struct os_threadpool *pool, struct task_batch *batch)
+{
+	if (--batch->remaining == 0)
+		pthread_cond_broadcast(&pool->done_cond);
+}
+
+static void *pool_thread(void *data)
+{
+	struct os_threadpool *pool = data;
+	struct task_batch *batch;
+	size_t idx;
+
+	os_set_thread_name(pool->name);
+
+	pthread_mutex_lock(&pool->mutex);
+
+	while (!pool->stop) {
+		batch = claim_job(pool, &idx);
+		if (!batch) {
+			pthread_cond_wait(&pool->work_cond, &pool->mutex);
+			continue;
+		}
+
+		pthread_mutex_unlock(&pool->mutex);
+		batch->task(batch->param, idx);
+		pthread_mutex_lock(&pool->mutex);
+
+		finish_job(pool, batch);
+	}
+
+	pthread_mutex_unlock(&pool->mutex);
+	return NULL;
+}
+
+os_threadpool_t *os_threadpool_create(const char *name, size_t threads)
+{
+	struct os_threadpool *pool;
+
+	if (!threads) {
+		int cores = os_get_logical_cores();
+		threads = cores > 1 ? (size_t)cores - 1 : 0;
+	}
+
+	pool = bzalloc(sizeof(struct os_threadpool));
+	pool->name = bstrdup(name ? name : "threadpool");
+
+	if (pthread_mutex_init(&pool->mutex, NULL) != 0)
+		goto fail0;
+	if (pthread_cond_init(&pool->work_cond, NULL) != 0)
+		goto fail1;
+	if (pthread_cond_init(&pool->done_cond, NULL) != 0)
+		goto fail2;
+
+	pool->threads = bzalloc(sizeof(pthread_t) * (threads ? threads : 1));
+
+	for (size_t i = 0; i < threads; i++) {
+		if (pthread_create(&pool->threads[i], NULL, pool_thread,
+					pool) != 0)
+			break;
+		pool->num_threads++;
+	}
+
+	return pool;
+
+fail2:
+	pthread_cond_destroy(&pool->work_cond);
+fail1:
+	pthread_mutex_destroy(&pool->mutex);
+fail0:
+	bfree(pool->name);
+	bfree(pool);
+	return NULL;
+}
+
+void os_threadpool_destroy(os_threadpool_t *pool)
+{
+	if (!pool)
+		return;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->stop = true;
+	pthread_cond_broadcast(&pool->work_cond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for (size_t i = 0; i < pool->num_threads; i++)
+		pthread_join(pool->threads[i], NULL);
+
+	pthread_cond_destroy(&pool->done_cond);
+	pthread_cond_destroy(&pool->work_cond);
+	pthread_mutex_destroy(&pool->mutex);
+	bfree(pool->threads);
+	bfree(pool->name);
+	bfree(pool);
+}
+
+size_t os_threadpool_concurrency(const os_threadpool_t *pool)
+{
+	return pool ? pool->num_threads + 1 : 1;
+}
+
+void os_threadpool_run(os_threadpool_t *pool, os_task_t task,
+		void *param, size_t count)
+{
+	struct task_batch batch = {0};
+	struct task_batch *claimed;
+	size_t idx;
+
+	if (!count)
+		return;
+
+	if (!pool || !pool->num_threads || count == 1) {
+		for (size_t i = 0; i < count; i++)
+			task(param, i);
+		return;
+	}
+
+	batch.task      = task;
+	batch.param     = param;
+	batch.count     = count;
+	batch.remaining = count;
+
+	pthread_mutex_lock(&pool->mutex);
+
+	if (pool->last_batch)
+		pool->last_batch->next_batch = &batch;
+	else
+		pool->first_batch = &batch;
+	pool->last_batch = &batch;
+
+	if (count - 1 < pool->num_threads)
+		for (size_t i = 0; i < count - 1; i++)
+			pthread_cond_signal(&pool->work_cond);
+	else
+		pthread_cond_broadcast(&pool->work_cond);
+
+	/* help out with our own batch rather than sitting idle */
+	while (batch.next < batch.count) {
+		claimed = claim_job(pool, &idx);
+
+		pthread_mutex_unlock(&pool->mutex);
+		claimed->task(claimed->param, idx);
+		pthread_mutex_lock(&pool->mutex);
+
+		finish_job(pool, claimed);
+	}
+
+	while (batch.remaining)
+		pthread_cond_wait(&pool->done_cond, &pool->mutex);
+
+	pthread_mutex_unlock(&pool->mutex);
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2017 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include "c99defs.h"
+
+/*
+ * Persistent worker thread pool
+ *
+ *   Runs batches of independent jobs ("parallel for") across a fixed set of
+ * worker threads.  The calling thread takes part in its own batch, and
+ * os_threadpool_run returns once every job in the batch has completed, so
+ * jobs may safely reference data on the caller's stack.  Multiple threads
+ * can submit batches to the same pool at the same time.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct os_threadpool;
+typedef struct os_threadpool os_threadpool_t;
+
+typedef void (*os_task_t)(void *param, size_t idx);
+
+/**
+ * Creates a thread pool.  If threads is 0, one worker is created for each
+ * logical core other than the calling thread's.
+ */
+EXPORT os_threadpool_t *os_threadpool_create(const char *name, size_t threads);
+EXPORT void os_threadpool_destroy(os_threadpool_t *pool);
+
+/** Returns the number of threads that can run jobs, including the caller */
+EXPORT size_t os_threadpool_concurrency(const os_threadpool_t *pool);
+
+/**
+ * Calls task(param, idx) for every idx in [0, count) and waits for all of
+ * them to finish.  If pool is NULL, the jobs are run on the calling thread.
+ */
+EXPORT void os_threadpool_run(os_threadpool_t *pool, os_task_t task,
+		void *param, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
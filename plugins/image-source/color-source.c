@@ -97,6 +97,12 @@ static uint32_t color_source_getheight(void *data)
 	return context->height;
 }
 
+static bool color_source_is_opaque(void *data)
+{
+	struct color_source *context = data;
+	return (context->color >> 24) == 0xFF;
+}
+
 static void color_source_defaults(obs_data_t *settings)
 {
 	obs_data_set_default_int(settings, "color", 0xFFFFFFFF);
@@ -116,5 +122,6 @@ struct obs_source_info color_source_info = {
 	.get_width      = color_source_getwidth,
 	.get_height     = color_source_getheight,
 	.video_render   = color_source_render,
-	.get_properties = color_source_properties
+	.get_properties = color_source_properties,
+	.is_opaque      = color_source_is_opaque
 };
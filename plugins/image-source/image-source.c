@@ -24,6 +24,7 @@ struct image_source {
 	float        update_time_elapsed;
 	uint64_t     last_time;
 	bool         active;
+	uint64_t     gif_mem_budget;
 
 	gs_image_file_t image;
 };
@@ -54,7 +55,8 @@ static void image_source_load(struct image_source *context)
 	if (file && *file) {
 		debug("loading texture '%s'", file);
 		context->file_timestamp = get_modified_timestamp(file);
-		gs_image_file_init(&context->image, file);
+		gs_image_file_init_with_budget(&context->image, file,
+				context->gif_mem_budget);
 		context->update_time_elapsed = 0;
 
 		obs_enter_graphics();
@@ -63,6 +65,15 @@ static void image_source_load(struct image_source *context)
 
 		if (!context->image.loaded)
 			warn("failed to load texture '%s'", file);
+		else
+			info("loaded '%s' in %.2f ms, %llu KB resident%s",
+					file,
+					(double)context->image.load_time_ns /
+					1000000.0,
+					(unsigned long long)
+					(context->image.mem_usage / 1024),
+					context->image.stream ?
+					" (streaming)" : "");
 	}
 }
 
@@ -78,11 +89,14 @@ static void image_source_update(void *data, obs_data_t *settings)
 	struct image_source *context = data;
 	const char *file = obs_data_get_string(settings, "file");
 	const bool unload = obs_data_get_bool(settings, "unload");
+	const long long gif_budget_mb =
+		obs_data_get_int(settings, "gif_mem_budget");
 
 	if (context->file)
 		bfree(context->file);
 	context->file = bstrdup(file);
 	context->persistent = !unload;
+	context->gif_mem_budget = (uint64_t)gif_budget_mb * 1024 * 1024;
 
 	/* Load the image if the source is persistent or showing */
 	if (context->persistent || obs_source_showing(context->source))
@@ -94,6 +108,8 @@ static void image_source_update(void *data, obs_data_t *settings)
 static void image_source_defaults(obs_data_t *settings)
 {
 	obs_data_set_default_bool(settings, "unload", false);
+	obs_data_set_default_int(settings, "gif_mem_budget",
+			GS_IMAGE_FILE_DEFAULT_GIF_BUDGET / (1024 * 1024));
 }
 
 static void image_source_show(void *data)
@@ -112,11 +128,25 @@ static void image_source_hide(void *data)
 		image_source_unload(context);
 }
 
+static void image_source_get_stats(void *data, calldata_t *cd)
+{
+	struct image_source *context = data;
+
+	calldata_set_int(cd, "load_time_ns",
+			(long long)context->image.load_time_ns);
+	calldata_set_int(cd, "mem_usage",
+			(long long)context->image.mem_usage);
+}
+
 static void *image_source_create(obs_data_t *settings, obs_source_t *source)
 {
 	struct image_source *context = bzalloc(sizeof(struct image_source));
+	proc_handler_t *ph = obs_source_get_proc_handler(source);
 	context->source = source;
 
+	proc_handler_add(ph, "void get_stats(out int load_time_ns, "
+			"out int mem_usage)", image_source_get_stats, context);
+
 	image_source_update(context, settings);
 	return context;
 }
@@ -243,6 +273,9 @@ static obs_properties_t *image_source_properties(void *data)
 			OBS_PATH_FILE, image_filter, path.array);
 	obs_properties_add_bool(props,
 			"unload", obs_module_text("UnloadWhenNotShowing"));
+	obs_properties_add_int(props,
+			"gif_mem_budget", obs_module_text("GifMemoryBudget"),
+			16, 8192, 16);
 	dstr_free(&path);
 
 	return props;
@@ -66,8 +66,10 @@ int_fast32_t v4l2_create_mmap(int_fast32_t dev, struct v4l2_buffer_data *buf)
 	struct v4l2_requestbuffers req;
 	struct v4l2_buffer map;
 
+	/* frames are not copied, so libobs holds on to a few buffers until
+	 * they are rendered */
 	memset(&req, 0, sizeof(req));
-	req.count  = 4;
+	req.count  = 8;
 	req.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 	req.memory = V4L2_MEMORY_MMAP;
 
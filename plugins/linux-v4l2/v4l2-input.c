@@ -63,6 +63,34 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define blog(level, msg, ...) blog(level, "v4l2-input: " msg, ##__VA_ARGS__)
 
+/**
+ * Mapped buffers shared with libobs
+ *
+ * Frames are output without copying, so a buffer can only be queued back to
+ * the driver once libobs has released the frame that points to it.  That can
+ * happen after the capture was stopped or even after the source was destroyed,
+ * so the mapping is refcounted and only destroyed with the last frame.
+ */
+struct v4l2_frame_pool;
+
+struct v4l2_frame_ref {
+	struct v4l2_frame_pool *pool;
+	uint32_t index;
+};
+
+struct v4l2_frame_pool {
+	volatile long refs;
+	pthread_mutex_t mutex;
+
+	/* buffers held by libobs, not queued to the driver */
+	volatile long in_flight;
+
+	/* -1 once the capture was stopped */
+	int_fast32_t dev;
+	struct v4l2_buffer_data buffers;
+	struct v4l2_frame_ref *frames;
+};
+
 /**
  * Data structure for the v4l2 source
  */
@@ -85,13 +113,129 @@ struct v4l2_data {
 	int width;
 	int height;
 	int linesize;
-	struct v4l2_buffer_data buffers;
+	struct v4l2_frame_pool *pool;
 };
 
 /* forward declarations */
 static void v4l2_init(struct v4l2_data *data);
 static void v4l2_terminate(struct v4l2_data *data);
 
+static struct v4l2_frame_pool *v4l2_frame_pool_create(int_fast32_t dev)
+{
+	struct v4l2_frame_pool *pool = bzalloc(sizeof(struct v4l2_frame_pool));
+
+	if (pthread_mutex_init(&pool->mutex, NULL) != 0) {
+		bfree(pool);
+		return NULL;
+	}
+
+	pool->refs = 1;
+	pool->dev  = dev;
+	return pool;
+}
+
+static void v4l2_frame_pool_release(struct v4l2_frame_pool *pool)
+{
+	if (!pool || os_atomic_dec_long(&pool->refs) != 0)
+		return;
+
+	v4l2_destroy_mmap(&pool->buffers);
+	pthread_mutex_destroy(&pool->mutex);
+	bfree(pool->frames);
+	bfree(pool);
+}
+
+/**
+ * Stop queueing buffers and drop the reference of the source
+ *
+ * Must be called before the device is closed.
+ */
+static void v4l2_frame_pool_detach(struct v4l2_frame_pool *pool)
+{
+	if (!pool)
+		return;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->dev = -1;
+	pthread_mutex_unlock(&pool->mutex);
+
+	v4l2_frame_pool_release(pool);
+}
+
+/**
+ * Map the device buffers and set up a reference for each of them
+ */
+static int_fast32_t v4l2_frame_pool_map(struct v4l2_frame_pool *pool)
+{
+	if (v4l2_create_mmap(pool->dev, &pool->buffers) < 0)
+		return -1;
+
+	pool->frames = bzalloc(pool->buffers.count *
+			sizeof(struct v4l2_frame_ref));
+	for (uint_fast32_t i = 0; i < pool->buffers.count; ++i) {
+		pool->frames[i].pool  = pool;
+		pool->frames[i].index = i;
+	}
+
+	return 0;
+}
+
+/**
+ * Called by libobs once a frame is uploaded or dropped, queues the buffer back
+ * to the driver if the capture is still running
+ */
+static void v4l2_release_frame(void *param)
+{
+	struct v4l2_frame_ref *ref = param;
+	struct v4l2_frame_pool *pool = ref->pool;
+	struct v4l2_buffer buf;
+
+	pthread_mutex_lock(&pool->mutex);
+
+	if (pool->dev != -1) {
+		memset(&buf, 0, sizeof(buf));
+		buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		buf.memory = V4L2_MEMORY_MMAP;
+		buf.index  = ref->index;
+
+		if (v4l2_ioctl(pool->dev, VIDIOC_QBUF, &buf) < 0)
+			blog(LOG_DEBUG, "failed to enqueue buffer");
+	}
+
+	pthread_mutex_unlock(&pool->mutex);
+
+	os_atomic_dec_long(&pool->in_flight);
+	v4l2_frame_pool_release(pool);
+}
+
+/**
+ * Queue a buffer back to the driver right away after its data was copied
+ */
+static void v4l2_requeue_buffer(struct v4l2_data *data, uint32_t index)
+{
+	struct v4l2_buffer buf;
+
+	memset(&buf, 0, sizeof(buf));
+	buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	buf.memory = V4L2_MEMORY_MMAP;
+	buf.index  = index;
+
+	if (v4l2_ioctl(data->dev, VIDIOC_QBUF, &buf) < 0)
+		blog(LOG_DEBUG, "failed to enqueue buffer");
+}
+
+/**
+ * Whether the next frame can be output without copying
+ *
+ * At least two buffers are always left to the driver, otherwise a consumer
+ * that holds on to frames would stall the capture.
+ */
+static inline bool v4l2_can_output_external(struct v4l2_frame_pool *pool)
+{
+	return os_atomic_load_long(&pool->in_flight) + 2 <
+		(long)pool->buffers.count;
+}
+
 /**
  * Prepare the output frame structure for obs and compute plane offsets
  *
@@ -157,8 +301,9 @@ static void *v4l2_thread(void *vptr)
 	struct v4l2_buffer buf;
 	struct obs_source_frame out;
 	size_t plane_offsets[MAX_AV_PLANES];
+	struct v4l2_frame_pool *pool = data->pool;
 
-	if (v4l2_start_capture(data->dev, &data->buffers) < 0)
+	if (v4l2_start_capture(data->dev, &pool->buffers) < 0)
 		goto exit;
 
 	frames   = 0;
@@ -197,14 +342,20 @@ static void *v4l2_thread(void *vptr)
 			first_ts = out.timestamp;
 		out.timestamp -= first_ts;
 
-		start = (uint8_t *) data->buffers.info[buf.index].start;
+		start = (uint8_t *) pool->buffers.info[buf.index].start;
 		for (uint_fast32_t i = 0; i < MAX_AV_PLANES; ++i)
 			out.data[i] = start + plane_offsets[i];
-		obs_source_output_video(data->source, &out);
 
-		if (v4l2_ioctl(data->dev, VIDIOC_QBUF, &buf) < 0) {
-			blog(LOG_DEBUG, "failed to enqueue buffer");
-			break;
+		if (v4l2_can_output_external(pool)) {
+			/* the buffer is queued again by v4l2_release_frame */
+			os_atomic_inc_long(&pool->refs);
+			os_atomic_inc_long(&pool->in_flight);
+			obs_source_output_video_external(data->source, &out,
+					v4l2_release_frame,
+					&pool->frames[buf.index]);
+		} else {
+			obs_source_output_video(data->source, &out);
+			v4l2_requeue_buffer(data, buf.index);
 		}
 
 		frames++;
@@ -784,7 +935,8 @@ static void v4l2_terminate(struct v4l2_data *data)
 		data->thread = 0;
 	}
 
-	v4l2_destroy_mmap(&data->buffers);
+	v4l2_frame_pool_detach(data->pool);
+	data->pool = NULL;
 
 	if (data->dev != -1) {
 		v4l2_close(data->dev);
@@ -892,7 +1044,8 @@ static void v4l2_init(struct v4l2_data *data)
 	blog(LOG_INFO, "Framerate: %.2f fps", (float) fps_denom / fps_num);
 
 	/* map buffers */
-	if (v4l2_create_mmap(data->dev, &data->buffers) < 0) {
+	data->pool = v4l2_frame_pool_create(data->dev);
+	if (!data->pool || v4l2_frame_pool_map(data->pool) < 0) {
 		blog(LOG_ERROR, "Failed to map buffers");
 		goto fail;
 	}
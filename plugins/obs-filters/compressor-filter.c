@@ -4,6 +4,11 @@
 
 #include <obs-module.h>
 #include <media-io/audio-math.h>
+#include <media-io/audio-mix.h>
+#include <media-io/audio-dynamics.h>
+#include <util/circlebuf.h>
+#include <util/platform.h>
+#include <util/threading.h>
 
 /* -------------------------------------------------------- */
 
@@ -27,6 +32,8 @@
 #define S_ATTACK_TIME                   "attack_time"
 #define S_RELEASE_TIME                  "release_time"
 #define S_OUTPUT_GAIN                   "output_gain"
+#define S_LOOKAHEAD                     "lookahead"
+#define S_SIDECHAIN_SOURCE              "sidechain_source"
 
 #define MT_ obs_module_text
 #define TEXT_RATIO                      MT_("Compressor.Ratio")
@@ -34,6 +41,8 @@
 #define TEXT_ATTACK_TIME                MT_("Compressor.AttackTime")
 #define TEXT_RELEASE_TIME               MT_("Compressor.ReleaseTime")
 #define TEXT_OUTPUT_GAIN                MT_("Compressor.OutputGain")
+#define TEXT_LOOKAHEAD                  MT_("Compressor.Lookahead")
+#define TEXT_SIDECHAIN_SOURCE           MT_("Compressor.SidechainSource")
 
 #define MIN_RATIO                       1.0f
 #define MAX_RATIO                       32.0f
@@ -44,7 +53,9 @@
 #define MIN_ATK_RLS_MS                  1
 #define MAX_RLS_MS                      1000
 #define MAX_ATK_MS                      500
+#define MAX_LOOKAHEAD_MS                20
 #define DEFAULT_AUDIO_BUF_MS            10
+#define SIDECHAIN_CHECK_INTERVAL_NS     3000000000ULL
 
 #define MS_IN_S                         1000
 #define MS_IN_S_F                       ((float)MS_IN_S)
@@ -54,6 +65,7 @@
 struct compressor_data {
 	obs_source_t *context;
 	float *envelope_buf;
+	float *gain_buf;
 	size_t envelope_buf_len;
 
 	float ratio;
@@ -65,6 +77,26 @@ struct compressor_data {
 	size_t num_channels;
 	float envelope;
 	float slope;
+
+	/* the filtered audio is delayed by the lookahead, so gain reduction
+	 * starts before the peaks that caused it */
+	size_t lookahead_frames;
+	size_t new_lookahead_frames;
+	float *lookahead_buf[MAX_AV_PLANES];
+	float *lookahead_tmp;
+	size_t lookahead_tmp_len;
+
+	/* audio of another source can drive the envelope (ducking) */
+	pthread_mutex_t sidechain_update_mutex;
+	uint64_t sidechain_check_time;
+	obs_weak_source_t *weak_sidechain;
+	char *sidechain_name;
+
+	pthread_mutex_t sidechain_mutex;
+	struct circlebuf sidechain_data[MAX_AV_PLANES];
+	float *sidechain_buf[MAX_AV_PLANES];
+	size_t sidechain_buf_len;
+	size_t max_sidechain_frames;
 };
 
 /* -------------------------------------------------------- */
@@ -73,6 +105,7 @@ static inline void resize_env_buffer(struct compressor_data *cd, size_t len)
 {
 	cd->envelope_buf_len = len;
 	cd->envelope_buf = brealloc(cd->envelope_buf, len * sizeof(float));
+	cd->gain_buf = brealloc(cd->gain_buf, len * sizeof(float));
 }
 
 static inline float gain_coefficient(uint32_t sample_rate, float time)
@@ -80,6 +113,68 @@ static inline float gain_coefficient(uint32_t sample_rate, float time)
 	return (float)exp(-1.0f / (sample_rate * time));
 }
 
+static void sidechain_capture(void *param, obs_source_t *source,
+		const struct audio_data *audio_data, bool muted)
+{
+	struct compressor_data *cd = param;
+	size_t expected_size;
+
+	UNUSED_PARAMETER(source);
+
+	pthread_mutex_lock(&cd->sidechain_mutex);
+
+	if (cd->max_sidechain_frames < audio_data->frames)
+		cd->max_sidechain_frames = audio_data->frames;
+
+	/* drop old data if the filtered source stopped consuming it */
+	expected_size = cd->max_sidechain_frames * sizeof(float);
+	if (cd->sidechain_data[0].size > expected_size * 2) {
+		for (size_t i = 0; i < cd->num_channels; i++)
+			circlebuf_pop_front(&cd->sidechain_data[i], NULL,
+					expected_size);
+	}
+
+	for (size_t i = 0; i < cd->num_channels; i++) {
+		struct circlebuf *buf = &cd->sidechain_data[i];
+		const size_t size = audio_data->frames * sizeof(float);
+
+		if (muted || !audio_data->data[i])
+			circlebuf_upsize(buf, buf->size + size);
+		else
+			circlebuf_push_back(buf, audio_data->data[i], size);
+	}
+
+	pthread_mutex_unlock(&cd->sidechain_mutex);
+}
+
+static void sidechain_detach(struct compressor_data *cd)
+{
+	obs_weak_source_t *weak_sidechain;
+	obs_source_t *sidechain;
+
+	pthread_mutex_lock(&cd->sidechain_update_mutex);
+	weak_sidechain = cd->weak_sidechain;
+	cd->weak_sidechain = NULL;
+	pthread_mutex_unlock(&cd->sidechain_update_mutex);
+
+	if (!weak_sidechain)
+		return;
+
+	sidechain = obs_weak_source_get_source(weak_sidechain);
+	if (sidechain) {
+		obs_source_remove_audio_capture_callback(sidechain,
+				sidechain_capture, cd);
+		obs_source_release(sidechain);
+	}
+
+	obs_weak_source_release(weak_sidechain);
+
+	pthread_mutex_lock(&cd->sidechain_mutex);
+	for (size_t i = 0; i < MAX_AV_PLANES; i++)
+		circlebuf_free(&cd->sidechain_data[i]);
+	pthread_mutex_unlock(&cd->sidechain_mutex);
+}
+
 static const char *compressor_name(void *unused)
 {
 	UNUSED_PARAMETER(unused);
@@ -100,6 +195,11 @@ static void compressor_update(void *data, obs_data_t *s)
 		(float)obs_data_get_int(s, S_RELEASE_TIME);
 	const float output_gain_db =
 		(float)obs_data_get_double(s, S_OUTPUT_GAIN);
+	const size_t lookahead_ms =
+		(size_t)obs_data_get_int(s, S_LOOKAHEAD);
+	const char *sidechain_name =
+		obs_data_get_string(s, S_SIDECHAIN_SOURCE);
+	bool sidechain_changed;
 
 	if (cd->envelope_buf_len <= 0) {
 		resize_env_buffer(cd,
@@ -115,12 +215,47 @@ static void compressor_update(void *data, obs_data_t *s)
 	cd->output_gain = db_to_mul(output_gain_db);
 	cd->num_channels = num_channels;
 	cd->slope = 1.0f - (1.0f / cd->ratio);
+
+	/* the lookahead buffers are resized on the audio thread */
+	cd->new_lookahead_frames = sample_rate * lookahead_ms / MS_IN_S;
+
+	if (!*sidechain_name)
+		sidechain_name = "none";
+
+	pthread_mutex_lock(&cd->sidechain_update_mutex);
+	sidechain_changed = !cd->sidechain_name ||
+		strcmp(cd->sidechain_name, sidechain_name) != 0;
+	pthread_mutex_unlock(&cd->sidechain_update_mutex);
+
+	if (sidechain_changed) {
+		sidechain_detach(cd);
+
+		pthread_mutex_lock(&cd->sidechain_update_mutex);
+		bfree(cd->sidechain_name);
+		cd->sidechain_name = bstrdup(sidechain_name);
+		cd->sidechain_check_time = 0;
+		pthread_mutex_unlock(&cd->sidechain_update_mutex);
+	}
 }
 
 static void *compressor_create(obs_data_t *settings, obs_source_t *filter)
 {
 	struct compressor_data *cd = bzalloc(sizeof(struct compressor_data));
 	cd->context = filter;
+
+	if (pthread_mutex_init(&cd->sidechain_mutex, NULL) != 0) {
+		blog(LOG_ERROR, "Failed to create mutex");
+		bfree(cd);
+		return NULL;
+	}
+
+	if (pthread_mutex_init(&cd->sidechain_update_mutex, NULL) != 0) {
+		pthread_mutex_destroy(&cd->sidechain_mutex);
+		blog(LOG_ERROR, "Failed to create mutex");
+		bfree(cd);
+		return NULL;
+	}
+
 	compressor_update(cd, settings);
 	return cd;
 }
@@ -128,50 +263,162 @@ static void *compressor_create(obs_data_t *settings, obs_source_t *filter)
 static void compressor_destroy(void *data)
 {
 	struct compressor_data *cd = data;
+
+	sidechain_detach(cd);
+
+	pthread_mutex_destroy(&cd->sidechain_mutex);
+	pthread_mutex_destroy(&cd->sidechain_update_mutex);
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		bfree(cd->lookahead_buf[i]);
+		bfree(cd->sidechain_buf[i]);
+	}
+
+	bfree(cd->lookahead_tmp);
+	bfree(cd->sidechain_name);
 	bfree(cd->envelope_buf);
+	bfree(cd->gain_buf);
 	bfree(cd);
 }
 
-static inline void analyze_envelope(struct compressor_data *cd,
-	float **samples, const uint32_t num_samples)
+/* looks up the sidechain source by name until it has been created */
+static void compressor_tick(void *data, float seconds)
 {
-	if (cd->envelope_buf_len < num_samples) {
-		resize_env_buffer(cd, num_samples);
+	struct compressor_data *cd = data;
+	char *name = NULL;
+
+	pthread_mutex_lock(&cd->sidechain_update_mutex);
+
+	if (!cd->weak_sidechain && cd->sidechain_name &&
+	    strcmp(cd->sidechain_name, "none") != 0) {
+		uint64_t t = os_gettime_ns();
+
+		if (t - cd->sidechain_check_time > SIDECHAIN_CHECK_INTERVAL_NS) {
+			name = bstrdup(cd->sidechain_name);
+			cd->sidechain_check_time = t;
+		}
 	}
 
-	memset(cd->envelope_buf, 0, num_samples * sizeof(cd->envelope_buf[0]));
-	for (size_t chan = 0; chan < cd->num_channels; ++chan) {
-		if (samples[chan]) {
-			float env = cd->envelope;
-			for (uint32_t i = 0; i < num_samples; ++i) {
-				const float env_in = fabsf(samples[chan][i]);
-				if (env < env_in) {
-					env = env_in + cd->attack_gain *
-						(env - env_in);
-				} else {
-					env = env_in + cd->release_gain *
-						(env - env_in);
-				}
-				cd->envelope_buf[i] = fmaxf(
-						cd->envelope_buf[i], env);
+	pthread_mutex_unlock(&cd->sidechain_update_mutex);
+
+	if (name) {
+		obs_source_t *sidechain = obs_get_source_by_name(name);
+		obs_source_t *parent = obs_filter_get_parent(cd->context);
+
+		if (sidechain && sidechain != parent) {
+			obs_weak_source_t *weak =
+				obs_source_get_weak_source(sidechain);
+			bool attach = false;
+
+			pthread_mutex_lock(&cd->sidechain_update_mutex);
+			if (!cd->weak_sidechain &&
+			    strcmp(cd->sidechain_name, name) == 0) {
+				cd->weak_sidechain = weak;
+				attach = true;
 			}
+			pthread_mutex_unlock(&cd->sidechain_update_mutex);
+
+			if (attach)
+				obs_source_add_audio_capture_callback(sidechain,
+						sidechain_capture, cd);
+			else
+				obs_weak_source_release(weak);
 		}
+
+		obs_source_release(sidechain);
+		bfree(name);
 	}
-	cd->envelope = cd->envelope_buf[num_samples - 1];
+
+	UNUSED_PARAMETER(seconds);
 }
 
-static inline void process_compression(const struct compressor_data *cd,
-	float **samples, uint32_t num_samples)
+/* pops a block of sidechain audio.  returns false if there is no sidechain or
+ * not enough of its audio yet, the filtered audio is analyzed instead. */
+static bool get_sidechain_data(struct compressor_data *cd,
+	const uint32_t num_samples)
 {
-	for (size_t i = 0; i < num_samples; ++i) {
-		const float env_db = mul_to_db(cd->envelope_buf[i]);
-		float gain = cd->slope * (cd->threshold - env_db);
-		gain = db_to_mul(fminf(0, gain));
+	const size_t data_size = num_samples * sizeof(float);
+	bool has_data = false;
 
-		for (size_t c = 0; c < cd->num_channels; ++c) {
-			if (samples[c]) {
-				samples[c][i] *= gain * cd->output_gain;
-			}
+	pthread_mutex_lock(&cd->sidechain_update_mutex);
+	bool has_sidechain = cd->weak_sidechain != NULL;
+	pthread_mutex_unlock(&cd->sidechain_update_mutex);
+
+	if (!has_sidechain)
+		return false;
+
+	if (cd->sidechain_buf_len < num_samples) {
+		for (size_t i = 0; i < MAX_AV_PLANES; i++)
+			cd->sidechain_buf[i] = brealloc(cd->sidechain_buf[i],
+					data_size);
+		cd->sidechain_buf_len = num_samples;
+	}
+
+	pthread_mutex_lock(&cd->sidechain_mutex);
+
+	if (cd->sidechain_data[0].size >= data_size) {
+		for (size_t i = 0; i < cd->num_channels; i++)
+			circlebuf_pop_front(&cd->sidechain_data[i],
+					cd->sidechain_buf[i], data_size);
+		has_data = true;
+	}
+
+	pthread_mutex_unlock(&cd->sidechain_mutex);
+	return has_data;
+}
+
+static void update_lookahead(struct compressor_data *cd)
+{
+	const size_t frames = cd->new_lookahead_frames;
+
+	if (frames == cd->lookahead_frames)
+		return;
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		bfree(cd->lookahead_buf[i]);
+		cd->lookahead_buf[i] = frames ?
+			bzalloc(frames * sizeof(float)) : NULL;
+	}
+
+	cd->lookahead_frames = frames;
+}
+
+/* delays each channel by the lookahead, the last frames of the block are kept
+ * for the next one */
+static void apply_lookahead(struct compressor_data *cd, float **samples,
+	const uint32_t num_samples)
+{
+	const size_t delay = cd->lookahead_frames;
+	const size_t keep = num_samples < delay ? num_samples : delay;
+
+	if (cd->lookahead_tmp_len < keep) {
+		cd->lookahead_tmp = brealloc(cd->lookahead_tmp,
+				keep * sizeof(float));
+		cd->lookahead_tmp_len = keep;
+	}
+
+	for (size_t c = 0; c < cd->num_channels; c++) {
+		float *buf = cd->lookahead_buf[c];
+		float *data = samples[c];
+
+		if (!data)
+			continue;
+
+		if (num_samples >= delay) {
+			memcpy(cd->lookahead_tmp, data + num_samples - delay,
+					delay * sizeof(float));
+			memmove(data + delay, data,
+					(num_samples - delay) * sizeof(float));
+			memcpy(data, buf, delay * sizeof(float));
+			memcpy(buf, cd->lookahead_tmp, delay * sizeof(float));
+		} else {
+			memcpy(cd->lookahead_tmp, data,
+					num_samples * sizeof(float));
+			memcpy(data, buf, num_samples * sizeof(float));
+			memmove(buf, buf + num_samples,
+					(delay - num_samples) * sizeof(float));
+			memcpy(buf + delay - num_samples, cd->lookahead_tmp,
+					num_samples * sizeof(float));
 		}
 	}
 }
@@ -182,9 +429,32 @@ static struct obs_audio_data *compressor_filter_audio(void *data,
 	struct compressor_data *cd = data;
 	const uint32_t num_samples = audio->frames;
 	float **samples = (float**)audio->data;
+	float **env_samples = samples;
+
+	if (!num_samples)
+		return audio;
+
+	if (cd->envelope_buf_len < num_samples)
+		resize_env_buffer(cd, num_samples);
 
-	analyze_envelope(cd, samples, num_samples);
-	process_compression(cd, samples, num_samples);
+	if (get_sidechain_data(cd, num_samples))
+		env_samples = cd->sidechain_buf;
+
+	audio_dyn_envelope(cd->envelope_buf, env_samples, cd->num_channels,
+			num_samples, cd->attack_gain, cd->release_gain,
+			&cd->envelope);
+	audio_dyn_compress_gain(cd->gain_buf, cd->envelope_buf, num_samples,
+			cd->threshold, cd->slope, cd->output_gain);
+
+	update_lookahead(cd);
+	if (cd->lookahead_frames)
+		apply_lookahead(cd, samples, num_samples);
+
+	for (size_t c = 0; c < cd->num_channels; c++) {
+		if (samples[c])
+			audio_mix_gain_ramp(samples[c], cd->gain_buf,
+					num_samples);
+	}
 
 	return audio;
 }
@@ -196,11 +466,39 @@ static void compressor_defaults(obs_data_t *s)
 	obs_data_set_default_int(s, S_ATTACK_TIME, 6);
 	obs_data_set_default_int(s, S_RELEASE_TIME, 60);
 	obs_data_set_default_double(s, S_OUTPUT_GAIN, 0.0f);
+	obs_data_set_default_int(s, S_LOOKAHEAD, 0);
+	obs_data_set_default_string(s, S_SIDECHAIN_SOURCE, "none");
+}
+
+struct sidechain_prop_info {
+	obs_property_t *sources;
+	obs_source_t *parent;
+};
+
+static bool add_sources(void *data, obs_source_t *source)
+{
+	struct sidechain_prop_info *info = data;
+	uint32_t caps = obs_source_get_output_flags(source);
+
+	if (source == info->parent)
+		return true;
+	if ((caps & OBS_SOURCE_AUDIO) == 0)
+		return true;
+
+	const char *name = obs_source_get_name(source);
+	obs_property_list_add_string(info->sources, name, name);
+	return true;
 }
 
 static obs_properties_t *compressor_properties(void *data)
 {
+	struct compressor_data *cd = data;
 	obs_properties_t *props = obs_properties_create();
+	obs_source_t *parent = NULL;
+	obs_property_t *sources;
+
+	if (cd)
+		parent = obs_filter_get_parent(cd->context);
 
 	obs_properties_add_float_slider(props, S_RATIO,
 		TEXT_RATIO, MIN_RATIO, MAX_RATIO, 0.5f);
@@ -212,8 +510,17 @@ static obs_properties_t *compressor_properties(void *data)
 		TEXT_RELEASE_TIME, MIN_ATK_RLS_MS, MAX_RLS_MS, 1);
 	obs_properties_add_float_slider(props, S_OUTPUT_GAIN,
 		TEXT_OUTPUT_GAIN, MIN_OUTPUT_GAIN_DB, MAX_OUTPUT_GAIN_DB, 0.1f);
+	obs_properties_add_int_slider(props, S_LOOKAHEAD,
+		TEXT_LOOKAHEAD, 0, MAX_LOOKAHEAD_MS, 1);
+
+	sources = obs_properties_add_list(props, S_SIDECHAIN_SOURCE,
+			TEXT_SIDECHAIN_SOURCE, OBS_COMBO_TYPE_LIST,
+			OBS_COMBO_FORMAT_STRING);
+	obs_property_list_add_string(sources, obs_module_text("None"), "none");
+
+	struct sidechain_prop_info info = {sources, parent};
+	obs_enum_sources(add_sources, &info);
 
-	UNUSED_PARAMETER(data);
 	return props;
 }
 
@@ -225,6 +532,7 @@ struct obs_source_info compressor_filter = {
 	.create = compressor_create,
 	.destroy = compressor_destroy,
 	.update = compressor_update,
+	.video_tick = compressor_tick,
 	.filter_audio = compressor_filter_audio,
 	.get_defaults = compressor_defaults,
 	.get_properties = compressor_properties,
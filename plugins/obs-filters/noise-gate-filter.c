@@ -1,4 +1,6 @@
 #include <media-io/audio-math.h>
+#include <media-io/audio-mix.h>
+#include <media-io/audio-dynamics.h>
 #include <obs-module.h>
 #include <math.h>
 
@@ -39,6 +41,10 @@ struct noise_gate_data {
 	float attenuation;
 	float level;
 	float held_time;
+
+	float *level_buf;
+	float *gain_buf;
+	size_t buf_len;
 };
 
 #define VOL_MIN -96.0f
@@ -53,6 +59,8 @@ static const char *noise_gate_name(void *unused)
 static void noise_gate_destroy(void *data)
 {
 	struct noise_gate_data *ng = data;
+	bfree(ng->level_buf);
+	bfree(ng->gain_buf);
 	bfree(ng);
 }
 
@@ -109,7 +117,7 @@ static struct obs_audio_data *noise_gate_filter_audio(void *data,
 {
 	struct noise_gate_data *ng = data;
 
-	float *adata[2] = {(float*)audio->data[0], (float*)audio->data[1]};
+	float **adata = (float**)audio->data;
 	const float close_threshold = ng->close_threshold;
 	const float open_threshold = ng->open_threshold;
 	const float sample_rate_i = ng->sample_rate_i;
@@ -118,11 +126,20 @@ static struct obs_audio_data *noise_gate_filter_audio(void *data,
 	const float decay_rate = ng->decay_rate;
 	const float hold_time = ng->hold_time;
 	const size_t channels = ng->channels;
+	const size_t frames = audio->frames;
+
+	if (ng->buf_len < frames) {
+		ng->level_buf = brealloc(ng->level_buf, frames * sizeof(float));
+		ng->gain_buf = brealloc(ng->gain_buf, frames * sizeof(float));
+		ng->buf_len = frames;
+	}
 
-	for (size_t i = 0; i < audio->frames; i++) {
-		float cur_level = (channels == 2)
-			? fmaxf(fabsf(adata[0][i]), fabsf(adata[1][i]))
-			: fabsf(adata[0][i]);
+	audio_dyn_peak(ng->level_buf, adata, channels, frames);
+
+	/* the gate state carries from sample to sample, so only the level
+	 * detection and the gain multiply are vectorized */
+	for (size_t i = 0; i < frames; i++) {
+		float cur_level = ng->level_buf[i];
 
 		if (cur_level > open_threshold && !ng->is_open) {
 			ng->is_open = true;
@@ -145,8 +162,12 @@ static struct obs_audio_data *noise_gate_filter_audio(void *data,
 			}
 		}
 
-		for (size_t c = 0; c < channels; c++)
-			adata[c][i] *= ng->attenuation;
+		ng->gain_buf[i] = ng->attenuation;
+	}
+
+	for (size_t c = 0; c < channels; c++) {
+		if (adata[c])
+			audio_mix_gain_ramp(adata[c], ng->gain_buf, frames);
 	}
 
 	return audio;
@@ -177,19 +177,22 @@ bool flv_meta_data(obs_output_t *context, uint8_t **output, size_t *size,
 static int32_t last_time = 0;
 #endif
 
-static void flv_video(struct serializer *s, struct encoder_packet *packet,
-		bool is_header)
+static inline uint8_t *write_wb24(uint8_t *p, uint32_t u24)
 {
-	int64_t offset  = packet->pts - packet->dts;
-	int32_t time_ms = get_ms_time(packet, packet->dts);
-
-	if (!packet->data || !packet->size)
-		return;
+	*(p++) = (uint8_t)(u24 >> 16);
+	*(p++) = (uint8_t)(u24 >> 8);
+	*(p++) = (uint8_t)u24;
+	return p;
+}
 
-	s_w8(s, RTMP_PACKET_TYPE_VIDEO);
+static uint8_t *flv_tag_header(uint8_t *p, uint8_t type, size_t body_size,
+		int32_t time_ms)
+{
+	*(p++) = type;
 
 #ifdef DEBUG_TIMESTAMPS
-	blog(LOG_DEBUG, "Video: %lu", time_ms);
+	blog(LOG_DEBUG, "%s: %lu", type == RTMP_PACKET_TYPE_VIDEO ?
+			"Video" : "Audio", time_ms);
 
 	if (last_time > time_ms)
 		blog(LOG_DEBUG, "Non-monotonic");
@@ -197,52 +200,66 @@ static void flv_video(struct serializer *s, struct encoder_packet *packet,
 	last_time = time_ms;
 #endif
 
-	s_wb24(s, (uint32_t)packet->size + 5);
-	s_wb24(s, time_ms);
-	s_w8(s, (time_ms >> 24) & 0x7F);
-	s_wb24(s, 0);
+	p = write_wb24(p, (uint32_t)body_size);
+	p = write_wb24(p, time_ms);
+	*(p++) = (time_ms >> 24) & 0x7F;
+	return write_wb24(p, 0);
+}
+
+static size_t flv_video_header(uint8_t *header, struct encoder_packet *packet,
+		bool is_header)
+{
+	int64_t offset  = packet->pts - packet->dts;
+	int32_t time_ms = get_ms_time(packet, packet->dts);
+	uint8_t *p;
+
+	p = flv_tag_header(header, RTMP_PACKET_TYPE_VIDEO, packet->size + 5,
+			time_ms);
 
 	/* these are the 5 extra bytes mentioned above */
-	s_w8(s, packet->keyframe ? 0x17 : 0x27);
-	s_w8(s, is_header ? 0 : 1);
-	s_wb24(s, get_ms_time(packet, offset));
-	s_write(s, packet->data, packet->size);
+	*(p++) = packet->keyframe ? 0x17 : 0x27;
+	*(p++) = is_header ? 0 : 1;
+	p = write_wb24(p, get_ms_time(packet, offset));
 
-	/* write tag size (starting byte doesn't count) */
-	s_wb32(s, (uint32_t)serializer_get_pos(s) + 4 - 1);
+	return (size_t)(p - header);
 }
 
-static void flv_audio(struct serializer *s, struct encoder_packet *packet,
+static size_t flv_audio_header(uint8_t *header, struct encoder_packet *packet,
 		bool is_header)
 {
 	int32_t time_ms = get_ms_time(packet, packet->dts);
+	uint8_t *p;
 
-	if (!packet->data || !packet->size)
-		return;
-
-	s_w8(s, RTMP_PACKET_TYPE_AUDIO);
+	p = flv_tag_header(header, RTMP_PACKET_TYPE_AUDIO, packet->size + 2,
+			time_ms);
 
-#ifdef DEBUG_TIMESTAMPS
-	blog(LOG_DEBUG, "Audio: %lu", time_ms);
+	/* these are the two extra bytes mentioned above */
+	*(p++) = 0xaf;
+	*(p++) = is_header ? 0 : 1;
 
-	if (last_time > time_ms)
-		blog(LOG_DEBUG, "Non-monotonic");
+	return (size_t)(p - header);
+}
 
-	last_time = time_ms;
-#endif
+size_t flv_packet_header(struct encoder_packet *packet, uint8_t *header,
+		bool is_header)
+{
+	if (!packet->data || !packet->size)
+		return 0;
 
-	s_wb24(s, (uint32_t)packet->size + 2);
-	s_wb24(s, time_ms);
-	s_w8(s, (time_ms >> 24) & 0x7F);
-	s_wb24(s, 0);
+	if (packet->type == OBS_ENCODER_VIDEO)
+		return flv_video_header(header, packet, is_header);
+	else
+		return flv_audio_header(header, packet, is_header);
+}
 
-	/* these are the two extra bytes mentioned above */
-	s_w8(s, 0xaf);
-	s_w8(s, is_header ? 0 : 1);
-	s_write(s, packet->data, packet->size);
+void flv_packet_footer(struct encoder_packet *packet, size_t header_size,
+		uint8_t *footer)
+{
+	/* tag size (starting byte doesn't count) */
+	uint32_t tag_size = (uint32_t)(header_size + packet->size) + 4 - 1;
 
-	/* write tag size (starting byte doesn't count) */
-	s_wb32(s, (uint32_t)serializer_get_pos(s) + 4 - 1);
+	footer[0] = (uint8_t)(tag_size >> 24);
+	write_wb24(footer + 1, tag_size);
 }
 
 void flv_packet_mux(struct encoder_packet *packet,
@@ -250,13 +267,20 @@ void flv_packet_mux(struct encoder_packet *packet,
 {
 	struct array_output_data data;
 	struct serializer s;
+	uint8_t header[FLV_PACKET_HEADER_MAX_SIZE];
+	uint8_t footer[FLV_PACKET_FOOTER_SIZE];
+	size_t header_size;
 
 	array_output_serializer_init(&s, &data);
 
-	if (packet->type == OBS_ENCODER_VIDEO)
-		flv_video(&s, packet, is_header);
-	else
-		flv_audio(&s, packet, is_header);
+	header_size = flv_packet_header(packet, header, is_header);
+	if (header_size) {
+		flv_packet_footer(packet, header_size, footer);
+
+		s_write(&s, header, header_size);
+		s_write(&s, packet->data, packet->size);
+		s_write(&s, footer, sizeof(footer));
+	}
 
 	*output = data.bytes.array;
 	*size   = data.bytes.num;
@@ -21,6 +21,10 @@
 
 #define MILLISECOND_DEN   1000
 
+/* maximum size of the tag header that precedes packet data */
+#define FLV_PACKET_HEADER_MAX_SIZE 16
+#define FLV_PACKET_FOOTER_SIZE     4
+
 static uint32_t get_ms_time(struct encoder_packet *packet, int64_t val)
 {
 	return (uint32_t)(val * MILLISECOND_DEN / packet->timebase_den);
@@ -32,3 +36,16 @@ extern bool flv_meta_data(obs_output_t *context, uint8_t **output, size_t *size,
 		bool write_header, size_t audio_idx);
 extern void flv_packet_mux(struct encoder_packet *packet,
 		uint8_t **output, size_t *size, bool is_header);
+
+/**
+ * Writes the tag header that precedes a packet's data, and returns its size
+ * (0 if the packet is empty).  Together with the footer this allows a tag to
+ * be written out in pieces without copying the packet data into a single
+ * buffer first.
+ */
+extern size_t flv_packet_header(struct encoder_packet *packet,
+		uint8_t *header, bool is_header);
+
+/** Writes the tag size that follows a packet's data */
+extern void flv_packet_footer(struct encoder_packet *packet,
+		size_t header_size, uint8_t *footer);
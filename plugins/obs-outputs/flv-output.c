@@ -92,16 +92,26 @@ static void flv_output_stop(void *data, uint64_t ts)
 static int write_packet(struct flv_output *stream,
 		struct encoder_packet *packet, bool is_header)
 {
-	uint8_t *data;
-	size_t  size;
+	uint8_t header[FLV_PACKET_HEADER_MAX_SIZE];
+	uint8_t footer[FLV_PACKET_FOOTER_SIZE];
+	size_t  header_size;
 	int     ret = 0;
 
 	stream->last_packet_ts = get_ms_time(packet, packet->dts);
 
-	flv_packet_mux(packet, &data, &size, is_header);
-	fwrite(data, 1, size, stream->file);
-	bfree(data);
-	obs_encoder_packet_release(packet);
+	header_size = flv_packet_header(packet, header, is_header);
+	if (header_size) {
+		flv_packet_footer(packet, header_size, footer);
+
+		fwrite(header, 1, header_size, stream->file);
+		fwrite(packet->data, 1, packet->size, stream->file);
+		fwrite(footer, 1, sizeof(footer), stream->file);
+	}
+
+	if (is_header)
+		bfree(packet->data);
+	else
+		obs_encoder_packet_release(packet);
 
 	return ret;
 }
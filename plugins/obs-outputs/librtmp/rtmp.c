@@ -5276,10 +5276,15 @@ RTMP_Write(RTMP *r, const char *buf, int size, int streamIdx)
             pkt->m_nBytesRead = 0;
             if (!ret)
                 return -1;
+            /* the trailing tag size can be omitted when a tag is
+             * written in pieces */
+            if (s2 < 4)
+            {
+                s2 = 0;
+                break;
+            }
             buf += 4;
             s2 -= 4;
-            if (s2 < 0)
-                break;
         }
     }
     return size+s2;
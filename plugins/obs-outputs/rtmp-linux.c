@@ -0,0 +1,321 @@
+#ifdef __linux__
+#include "rtmp-stream.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+#ifndef TCP_NOTSENT_LOWAT
+#define TCP_NOTSENT_LOWAT 25
+#endif
+
+static void fatal_sock_shutdown(struct rtmp_stream *stream)
+{
+	close(stream->rtmp.m_sb.sb_socket);
+	stream->rtmp.m_sb.sb_socket = -1;
+
+	pthread_mutex_lock(&stream->write_buf_mutex);
+	stream->write_buf_len = 0;
+	pthread_mutex_unlock(&stream->write_buf_mutex);
+
+	os_event_signal(stream->buffer_space_available_event);
+}
+
+static bool socket_event(struct rtmp_stream *stream, uint32_t events,
+		uint64_t last_send_time)
+{
+	int sock = stream->rtmp.m_sb.sb_socket;
+
+	if (events & EPOLLERR) {
+		int err_code = 0;
+		socklen_t size = sizeof(err_code);
+
+		getsockopt(sock, SOL_SOCKET, SO_ERROR, &err_code, &size);
+
+		blog(LOG_ERROR, "socket_thread_linux: Aborting due to "
+				"socket error %d", err_code);
+		stream->rtmp.last_error_code = err_code;
+		fatal_sock_shutdown(stream);
+		return false;
+	}
+
+	if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) {
+		char discard[16384];
+
+		for (;;) {
+			ssize_t ret = recv(sock, discard, sizeof(discard),
+					MSG_DONTWAIT);
+			int err_code = 0;
+
+			if (ret > 0)
+				continue;
+
+			if (ret == -1) {
+				err_code = errno;
+				if (err_code == EAGAIN || err_code == EWOULDBLOCK)
+					break;
+				if (err_code == EINTR)
+					continue;
+
+				blog(LOG_ERROR, "socket_thread_linux: "
+						"Socket error, recv() returned "
+						"%d, errno %d",
+						(int)ret, err_code);
+
+			} else if (last_send_time) {
+				uint32_t diff = (uint32_t)(
+					(os_gettime_ns() / 1000000) -
+					last_send_time);
+
+				blog(LOG_ERROR, "socket_thread_linux: "
+						"Connection closed, %u ms "
+						"since last send (buffer: "
+						"%d / %d)",
+						diff,
+						(int)stream->write_buf_len,
+						(int)stream->write_buf_size);
+			}
+
+			if (os_event_try(stream->stop_event) != EAGAIN)
+				blog(LOG_ERROR, "socket_thread_linux: Aborting "
+						"due to connection closed "
+						"during shutdown, %d bytes lost",
+						(int)stream->write_buf_len);
+
+			stream->rtmp.last_error_code = err_code;
+			fatal_sock_shutdown(stream);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+enum data_ret {
+	RET_BREAK,
+	RET_FATAL,
+	RET_CONTINUE
+};
+
+static enum data_ret write_data(struct rtmp_stream *stream,
+		uint64_t *last_send_time, size_t send_size)
+{
+	size_t send_len;
+	ssize_t ret;
+
+	pthread_mutex_lock(&stream->write_buf_mutex);
+
+	if (!stream->write_buf_len) {
+		pthread_mutex_unlock(&stream->write_buf_mutex);
+		return RET_BREAK;
+	}
+
+	send_len = stream->write_buf_len;
+	if (send_len > send_size)
+		send_len = send_size;
+
+	/* librtmp connects with a blocking socket, so don't let send() block
+	 * here: the write buffer mutex is held, and socket_queue_data would
+	 * stall on it for as long as the peer isn't reading.  whatever isn't
+	 * sent stays at the front of the buffer until EPOLLOUT */
+	ret = send(stream->rtmp.m_sb.sb_socket, stream->write_buf, send_len,
+			MSG_NOSIGNAL | MSG_DONTWAIT);
+
+	if (ret > 0) {
+		size_t sent = (size_t)ret;
+
+		if (stream->write_buf_len - sent)
+			memmove(stream->write_buf,
+					stream->write_buf + sent,
+					stream->write_buf_len - sent);
+		stream->write_buf_len -= sent;
+
+		*last_send_time = os_gettime_ns() / 1000000;
+
+		os_event_signal(stream->buffer_space_available_event);
+
+	} else {
+		int err_code = ret == -1 ? errno : 0;
+
+		/* not sent past TCP_NOTSENT_LOWAT (or the socket buffer is
+		 * full), so wait until the socket is writable again */
+		if (err_code == EAGAIN || err_code == EWOULDBLOCK) {
+			pthread_mutex_unlock(&stream->write_buf_mutex);
+			return RET_BREAK;
+		}
+		if (err_code == EINTR) {
+			pthread_mutex_unlock(&stream->write_buf_mutex);
+			return RET_CONTINUE;
+		}
+
+		blog(LOG_ERROR, "socket_thread_linux: Socket error, "
+				"send() returned %d, errno %d",
+				(int)ret, err_code);
+
+		pthread_mutex_unlock(&stream->write_buf_mutex);
+		stream->rtmp.last_error_code = err_code;
+		fatal_sock_shutdown(stream);
+		return RET_FATAL;
+	}
+
+	pthread_mutex_unlock(&stream->write_buf_mutex);
+	return RET_CONTINUE;
+}
+
+static inline bool write_buf_empty(struct rtmp_stream *stream)
+{
+	bool empty;
+
+	pthread_mutex_lock(&stream->write_buf_mutex);
+	empty = stream->write_buf_len == 0;
+	pthread_mutex_unlock(&stream->write_buf_mutex);
+
+	return empty;
+}
+
+static void set_send_lowat(struct rtmp_stream *stream, size_t send_size)
+{
+	int lowat = (int)send_size;
+	int ret;
+
+	/* limits how much unsent data the kernel will queue, which keeps the
+	 * rest in our own buffer so that congestion causes frame drops
+	 * rather than an ever-growing socket buffer */
+	ret = setsockopt(stream->rtmp.m_sb.sb_socket, IPPROTO_TCP,
+			TCP_NOTSENT_LOWAT, &lowat, sizeof(lowat));
+	if (ret != 0)
+		blog(LOG_WARNING, "socket_thread_linux: Failed to set "
+				"TCP_NOTSENT_LOWAT, errno %d", errno);
+}
+
+#define LATENCY_FACTOR 20
+#define BASE_EVENTS    (EPOLLIN | EPOLLRDHUP)
+
+static inline void socket_thread_linux_internal(struct rtmp_stream *stream)
+{
+	int sock = stream->rtmp.m_sb.sb_socket;
+	int wake_fd = stream->socket_wake_fd;
+	uint64_t last_send_time = 0;
+	uint32_t sock_events = BASE_EVENTS;
+	struct epoll_event ev = {0};
+	size_t send_size;
+	int epoll_fd;
+
+	if (stream->low_latency_mode)
+		send_size = stream->write_buf_size / (LATENCY_FACTOR - 2);
+	else
+		send_size = stream->write_buf_size;
+
+	set_send_lowat(stream, send_size);
+
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd == -1) {
+		blog(LOG_ERROR, "socket_thread_linux: Aborting due to "
+				"epoll_create1 failure, errno %d", errno);
+		fatal_sock_shutdown(stream);
+		return;
+	}
+
+	ev.events = sock_events;
+	ev.data.fd = sock;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sock, &ev) != 0)
+		goto epoll_fail;
+
+	ev.events = EPOLLIN;
+	ev.data.fd = wake_fd;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev) != 0)
+		goto epoll_fail;
+
+	for (;;) {
+		struct epoll_event events[2];
+		uint32_t new_events = BASE_EVENTS;
+		int count;
+
+		bool empty = write_buf_empty(stream);
+
+		if (os_event_try(stream->send_thread_signaled_exit) != EAGAIN) {
+			if (empty) {
+				os_event_reset(stream->send_thread_signaled_exit);
+				break;
+			}
+		}
+
+		/* only wait for the socket to become writable while there's
+		 * something to write, otherwise it'd wake up constantly */
+		if (!empty)
+			new_events |= EPOLLOUT;
+
+		if (new_events != sock_events) {
+			ev.events = new_events;
+			ev.data.fd = sock;
+			if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, sock, &ev) != 0)
+				goto epoll_fail;
+			sock_events = new_events;
+		}
+
+		count = epoll_wait(epoll_fd, events, 2, -1);
+		if (count == -1) {
+			if (errno == EINTR)
+				continue;
+
+			blog(LOG_ERROR, "socket_thread_linux: Aborting due "
+					"to epoll_wait failure, errno %d",
+					errno);
+			fatal_sock_shutdown(stream);
+			goto exit;
+		}
+
+		for (int i = 0; i < count; i++) {
+			uint32_t cur = events[i].events;
+
+			if (events[i].data.fd == wake_fd) {
+				eventfd_t val;
+				eventfd_read(wake_fd, &val);
+				continue;
+			}
+
+			if (!socket_event(stream, cur & ~EPOLLOUT,
+						last_send_time))
+				goto exit;
+
+			if ((cur & EPOLLOUT) == 0)
+				continue;
+
+			for (;;) {
+				enum data_ret ret = write_data(stream,
+						&last_send_time, send_size);
+
+				if (ret == RET_FATAL)
+					goto exit;
+				if (ret == RET_BREAK)
+					break;
+			}
+		}
+	}
+
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, sock, NULL);
+	close(epoll_fd);
+
+	blog(LOG_INFO, "socket_thread_linux: Normal exit");
+	return;
+
+epoll_fail:
+	blog(LOG_ERROR, "socket_thread_linux: Aborting due to epoll_ctl "
+			"failure, errno %d", errno);
+	fatal_sock_shutdown(stream);
+
+exit:
+	close(epoll_fd);
+}
+
+void *socket_thread_linux(void *data)
+{
+	struct rtmp_stream *stream = data;
+
+	os_set_thread_name("rtmp-stream: socket_thread");
+	socket_thread_linux_internal(stream);
+	return NULL;
+}
+#endif
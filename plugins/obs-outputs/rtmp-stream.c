@@ -123,6 +123,9 @@ static void *rtmp_stream_create(obs_data_t *settings, obs_output_t *output)
 	struct rtmp_stream *stream = bzalloc(sizeof(struct rtmp_stream));
 	stream->output = output;
 	pthread_mutex_init_value(&stream->packets_mutex);
+#ifdef __linux__
+	stream->socket_wake_fd = -1;
+#endif
 
 	RTMP_Init(&stream->rtmp);
 	RTMP_LogSetCallback(log_rtmp);
@@ -291,6 +294,18 @@ static void droptest_cap_data_rate(struct rtmp_stream *stream, size_t size)
 }
 #endif
 
+static inline void signal_buffer_has_data(struct rtmp_stream *stream)
+{
+	os_event_signal(stream->buffer_has_data_event);
+
+#ifdef __linux__
+	/* os events can't be waited on with epoll, so also wake the socket
+	 * thread through an eventfd */
+	if (stream->socket_wake_fd != -1)
+		eventfd_write(stream->socket_wake_fd, 1);
+#endif
+}
+
 static int socket_queue_data(RTMPSockBuf *sb, const char *data, int len, void *arg)
 {
 	UNUSED_PARAMETER(sb);
@@ -320,7 +335,7 @@ retry_send:
 
 	pthread_mutex_unlock(&stream->write_buf_mutex);
 
-	os_event_signal (stream->buffer_has_data_event);
+	signal_buffer_has_data(stream);
 
 	return len;
 }
@@ -328,8 +343,9 @@ retry_send:
 static int send_packet(struct rtmp_stream *stream,
 		struct encoder_packet *packet, bool is_header, size_t idx)
 {
-	uint8_t *data;
-	size_t  size;
+	uint8_t header[FLV_PACKET_HEADER_MAX_SIZE];
+	size_t  header_size;
+	size_t  size = 0;
 	int     recv_size = 0;
 	int     ret = 0;
 
@@ -347,14 +363,24 @@ static int send_packet(struct rtmp_stream *stream,
 		}
 	}
 
-	flv_packet_mux(packet, &data, &size, is_header);
+	header_size = flv_packet_header(packet, header, is_header);
+	if (header_size)
+		size = header_size + packet->size + FLV_PACKET_FOOTER_SIZE;
 
 #ifdef TEST_FRAMEDROPS
 	droptest_cap_data_rate(stream, size);
 #endif
 
-	ret = RTMP_Write(&stream->rtmp, (char*)data, (int)size, (int)idx);
-	bfree(data);
+	/* the tag header and the packet data are written separately so that
+	 * librtmp gathers them straight into its own packet body instead of
+	 * them being muxed into an intermediate FLV buffer first */
+	if (header_size) {
+		ret = RTMP_Write(&stream->rtmp, (char*)header,
+				(int)header_size, (int)idx);
+		if (ret >= 0)
+			ret = RTMP_Write(&stream->rtmp, (char*)packet->data,
+					(int)packet->size, (int)idx);
+	}
 
 	if (is_header)
 		bfree(packet->data);
@@ -367,6 +393,16 @@ static int send_packet(struct rtmp_stream *stream,
 
 static inline bool send_headers(struct rtmp_stream *stream);
 
+#ifdef __linux__
+static inline void close_socket_wake_fd(struct rtmp_stream *stream)
+{
+	if (stream->socket_wake_fd != -1) {
+		close(stream->socket_wake_fd);
+		stream->socket_wake_fd = -1;
+	}
+}
+#endif
+
 static inline bool can_shutdown_stream(struct rtmp_stream *stream,
 		struct encoder_packet *packet)
 {
@@ -482,10 +518,13 @@ static void *send_thread(void *data)
 
 	if (stream->new_socket_loop) {
 		os_event_signal(stream->send_thread_signaled_exit);
-		os_event_signal(stream->buffer_has_data_event);
+		signal_buffer_has_data(stream);
 		pthread_join(stream->socket_thread, NULL);
 		stream->socket_thread_active = false;
 		stream->rtmp.m_bCustomSend = false;
+#ifdef __linux__
+		close_socket_wake_fd(stream);
+#endif
 	}
 
 	set_output_error(stream);
@@ -685,6 +724,18 @@ static int init_send(struct rtmp_stream *stream)
 #ifdef _WIN32
 		ret = pthread_create(&stream->socket_thread, NULL,
 				socket_thread_windows, stream);
+#elif defined(__linux__)
+		stream->socket_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (stream->socket_wake_fd == -1) {
+			stream->rtmp.last_error_code = errno;
+			warn("Failed to create socket thread eventfd");
+			return OBS_OUTPUT_ERROR;
+		}
+
+		ret = pthread_create(&stream->socket_thread, NULL,
+				socket_thread_linux, stream);
+		if (ret != 0)
+			close_socket_wake_fd(stream);
 #else
 		warn("New socket loop not supported on this platform");
 		return OBS_OUTPUT_ERROR;
@@ -16,6 +16,11 @@
 #include <sys/ioctl.h>
 #endif
 
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
 #define do_log(level, format, ...) \
 	blog(level, "[rtmp stream: '%s'] " format, \
 			obs_output_get_name(stream->output), ##__VA_ARGS__)
@@ -101,8 +106,13 @@ struct rtmp_stream {
 	os_event_t       *buffer_has_data_event;
 	os_event_t       *socket_available_event;
 	os_event_t       *send_thread_signaled_exit;
+#ifdef __linux__
+	int              socket_wake_fd;
+#endif
 };
 
 #ifdef _WIN32
 void *socket_thread_windows(void *data);
+#elif defined(__linux__)
+void *socket_thread_linux(void *data);
 #endif
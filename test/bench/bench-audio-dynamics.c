@@ -0,0 +1,410 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <math.h>
+#include <string.h>
+#include <util/bmem.h>
+#include <media-io/audio-io.h>
+#include <media-io/audio-math.h>
+#include <media-io/audio-mix.h>
+#include <media-io/audio-dynamics.h>
+#include "bench.h"
+
+/*
+ * Runs the compressor and noise gate filters over blocks of audio for a
+ * number of stereo sources.  "scalar" is the previous per-sample filter code
+ * (log10f/powf per sample for the compressor), "simd" is the filter code
+ * built on the dynamics kernels.  Both are fed the same 1000 blocks, and the
+ * outputs are compared before timing.
+ */
+
+#define NUM_SOURCES 20
+#define CHANNELS    2
+#define NUM_BLOCKS  1000
+#define NUM_INPUTS  8
+
+#define SAMPLE_RATE 48000
+#define RATIO       10.0f
+#define THRESHOLD   -18.0f
+#define ATTACK_MS   6.0f
+#define RELEASE_MS  60.0f
+
+struct compressor_state {
+	float envelope;
+	float attack_gain;
+	float release_gain;
+	float threshold;
+	float slope;
+	float output_gain;
+};
+
+struct gate_state {
+	float open_threshold;
+	float close_threshold;
+	float decay_rate;
+	float attack_rate;
+	float release_rate;
+	float hold_time;
+	float sample_rate_i;
+
+	bool  is_open;
+	float attenuation;
+	float level;
+	float held_time;
+};
+
+struct dynamics_data {
+	/* input blocks of different loudness, cycled through */
+	float                   *inputs[NUM_INPUTS][CHANNELS];
+	float                   *work[NUM_SOURCES][MAX_AV_PLANES];
+	float                   env_buf[AUDIO_OUTPUT_FRAMES];
+	float                   gain_buf[AUDIO_OUTPUT_FRAMES];
+
+	struct compressor_state comp[NUM_SOURCES];
+	struct gate_state       gate[NUM_SOURCES];
+	float                   result;
+};
+
+static float *alloc_buffer(uint32_t seed, float amplitude)
+{
+	float *buf = bmalloc(AUDIO_OUTPUT_FRAMES * sizeof(float));
+
+	for (size_t i = 0; i < AUDIO_OUTPUT_FRAMES; i++) {
+		seed = seed * 1103515245 + 12345;
+		buf[i] = ((float)(seed >> 16) / 65536.0f - 0.5f) * 2.0f *
+			amplitude;
+	}
+
+	return buf;
+}
+
+static void init_states(struct dynamics_data *data)
+{
+	for (size_t i = 0; i < NUM_SOURCES; i++) {
+		struct compressor_state *comp = &data->comp[i];
+		struct gate_state *gate = &data->gate[i];
+		const float rate = (float)SAMPLE_RATE;
+
+		memset(comp, 0, sizeof(*comp));
+		comp->attack_gain = expf(-1.0f / (rate * ATTACK_MS / 1000.0f));
+		comp->release_gain = expf(-1.0f / (rate * RELEASE_MS / 1000.0f));
+		comp->threshold = THRESHOLD;
+		comp->slope = 1.0f - 1.0f / RATIO;
+		comp->output_gain = 1.0f;
+
+		memset(gate, 0, sizeof(*gate));
+		gate->sample_rate_i = 1.0f / rate;
+		gate->open_threshold = db_to_mul(-26.0f);
+		gate->close_threshold = db_to_mul(-32.0f);
+		gate->attack_rate = 1.0f / (0.025f * rate);
+		gate->release_rate = 1.0f / (0.150f * rate);
+		gate->decay_rate = (gate->open_threshold -
+				gate->close_threshold) / (rate / 75.0f);
+		gate->hold_time = 0.2f;
+	}
+}
+
+static void init_dynamics_data(struct dynamics_data *data)
+{
+	static const float amplitudes[NUM_INPUTS] = {
+		0.9f, 0.5f, 0.02f, 0.001f, 0.3f, 0.05f, 0.7f, 0.005f
+	};
+	uint32_t seed = 1;
+
+	for (size_t i = 0; i < NUM_INPUTS; i++) {
+		for (size_t ch = 0; ch < CHANNELS; ch++)
+			data->inputs[i][ch] = alloc_buffer(seed++,
+					amplitudes[i]);
+	}
+
+	for (size_t i = 0; i < NUM_SOURCES; i++) {
+		for (size_t ch = 0; ch < CHANNELS; ch++)
+			data->work[i][ch] = bmalloc(
+					AUDIO_OUTPUT_FRAMES * sizeof(float));
+	}
+
+	init_states(data);
+}
+
+static void free_dynamics_data(struct dynamics_data *data)
+{
+	for (size_t i = 0; i < NUM_INPUTS; i++) {
+		for (size_t ch = 0; ch < CHANNELS; ch++)
+			bfree(data->inputs[i][ch]);
+	}
+
+	for (size_t i = 0; i < NUM_SOURCES; i++) {
+		for (size_t ch = 0; ch < CHANNELS; ch++)
+			bfree(data->work[i][ch]);
+	}
+}
+
+static inline void load_block(struct dynamics_data *data, size_t source,
+		size_t input_idx)
+{
+	float **input = data->inputs[input_idx % NUM_INPUTS];
+
+	for (size_t ch = 0; ch < CHANNELS; ch++)
+		memcpy(data->work[source][ch], input[ch],
+				AUDIO_OUTPUT_FRAMES * sizeof(float));
+}
+
+/* ------------------------------------------------------------------------- */
+/* previous filter code                                                      */
+
+static void compress_scalar(struct dynamics_data *data,
+		struct compressor_state *cd, float **samples)
+{
+	float *env_buf = data->env_buf;
+
+	memset(env_buf, 0, AUDIO_OUTPUT_FRAMES * sizeof(float));
+	for (size_t chan = 0; chan < CHANNELS; ++chan) {
+		float env = cd->envelope;
+		for (size_t i = 0; i < AUDIO_OUTPUT_FRAMES; ++i) {
+			const float env_in = fabsf(samples[chan][i]);
+			if (env < env_in)
+				env = env_in + cd->attack_gain * (env - env_in);
+			else
+				env = env_in + cd->release_gain *
+					(env - env_in);
+			env_buf[i] = fmaxf(env_buf[i], env);
+		}
+	}
+	cd->envelope = env_buf[AUDIO_OUTPUT_FRAMES - 1];
+
+	for (size_t i = 0; i < AUDIO_OUTPUT_FRAMES; ++i) {
+		const float env_db = mul_to_db(env_buf[i]);
+		float gain = cd->slope * (cd->threshold - env_db);
+		gain = db_to_mul(fminf(0, gain));
+
+		for (size_t c = 0; c < CHANNELS; ++c)
+			samples[c][i] *= gain * cd->output_gain;
+	}
+}
+
+static void gate_scalar(struct gate_state *ng, float **adata)
+{
+	for (size_t i = 0; i < AUDIO_OUTPUT_FRAMES; i++) {
+		float cur_level = fmaxf(fabsf(adata[0][i]),
+				fabsf(adata[1][i]));
+
+		if (cur_level > ng->open_threshold && !ng->is_open)
+			ng->is_open = true;
+		if (ng->level < ng->close_threshold && ng->is_open) {
+			ng->held_time = 0.0f;
+			ng->is_open = false;
+		}
+
+		ng->level = fmaxf(ng->level, cur_level) - ng->decay_rate;
+
+		if (ng->is_open) {
+			ng->attenuation = fminf(1.0f,
+					ng->attenuation + ng->attack_rate);
+		} else {
+			ng->held_time += ng->sample_rate_i;
+			if (ng->held_time > ng->hold_time)
+				ng->attenuation = fmaxf(0.0f,
+						ng->attenuation -
+						ng->release_rate);
+		}
+
+		for (size_t c = 0; c < CHANNELS; c++)
+			adata[c][i] *= ng->attenuation;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* kernel based filter code                                                  */
+
+static void compress_simd(struct dynamics_data *data,
+		struct compressor_state *cd, float **samples)
+{
+	audio_dyn_envelope(data->env_buf, samples, CHANNELS,
+			AUDIO_OUTPUT_FRAMES, cd->attack_gain, cd->release_gain,
+			&cd->envelope);
+	audio_dyn_compress_gain(data->gain_buf, data->env_buf,
+			AUDIO_OUTPUT_FRAMES, cd->threshold, cd->slope,
+			cd->output_gain);
+
+	for (size_t c = 0; c < CHANNELS; c++)
+		audio_mix_gain_ramp(samples[c], data->gain_buf,
+				AUDIO_OUTPUT_FRAMES);
+}
+
+static void gate_simd(struct dynamics_data *data, struct gate_state *ng,
+		float **adata)
+{
+	audio_dyn_peak(data->env_buf, adata, CHANNELS, AUDIO_OUTPUT_FRAMES);
+
+	for (size_t i = 0; i < AUDIO_OUTPUT_FRAMES; i++) {
+		float cur_level = data->env_buf[i];
+
+		if (cur_level > ng->open_threshold && !ng->is_open)
+			ng->is_open = true;
+		if (ng->level < ng->close_threshold && ng->is_open) {
+			ng->held_time = 0.0f;
+			ng->is_open = false;
+		}
+
+		ng->level = fmaxf(ng->level, cur_level) - ng->decay_rate;
+
+		if (ng->is_open) {
+			ng->attenuation = fminf(1.0f,
+					ng->attenuation + ng->attack_rate);
+		} else {
+			ng->held_time += ng->sample_rate_i;
+			if (ng->held_time > ng->hold_time)
+				ng->attenuation = fmaxf(0.0f,
+						ng->attenuation -
+						ng->release_rate);
+		}
+
+		data->gain_buf[i] = ng->attenuation;
+	}
+
+	for (size_t c = 0; c < CHANNELS; c++)
+		audio_mix_gain_ramp(adata[c], data->gain_buf,
+				AUDIO_OUTPUT_FRAMES);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void run_compressor_scalar(void *param, size_t iterations)
+{
+	struct dynamics_data *data = param;
+
+	for (size_t it = 0; it < iterations; it++) {
+		for (size_t i = 0; i < NUM_SOURCES; i++) {
+			load_block(data, i, it + i);
+			compress_scalar(data, &data->comp[i], data->work[i]);
+			data->result += data->work[i][0][0];
+		}
+	}
+}
+
+static void run_compressor_simd(void *param, size_t iterations)
+{
+	struct dynamics_data *data = param;
+
+	for (size_t it = 0; it < iterations; it++) {
+		for (size_t i = 0; i < NUM_SOURCES; i++) {
+			load_block(data, i, it + i);
+			compress_simd(data, &data->comp[i], data->work[i]);
+			data->result += data->work[i][0][0];
+		}
+	}
+}
+
+static void run_gate_scalar(void *param, size_t iterations)
+{
+	struct dynamics_data *data = param;
+
+	for (size_t it = 0; it < iterations; it++) {
+		for (size_t i = 0; i < NUM_SOURCES; i++) {
+			load_block(data, i, it + i);
+			gate_scalar(&data->gate[i], data->work[i]);
+			data->result += data->work[i][0][0];
+		}
+	}
+}
+
+static void run_gate_simd(void *param, size_t iterations)
+{
+	struct dynamics_data *data = param;
+
+	for (size_t it = 0; it < iterations; it++) {
+		for (size_t i = 0; i < NUM_SOURCES; i++) {
+			load_block(data, i, it + i);
+			gate_simd(data, &data->gate[i], data->work[i]);
+			data->result += data->work[i][0][0];
+		}
+	}
+}
+
+static float max_difference(float **a, float **b)
+{
+	float diff = 0.0f;
+
+	for (size_t ch = 0; ch < CHANNELS; ch++) {
+		for (size_t i = 0; i < AUDIO_OUTPUT_FRAMES; i++)
+			diff = fmaxf(diff, fabsf(a[ch][i] - b[ch][i]));
+	}
+
+	return diff;
+}
+
+/* feeds all blocks through source 0 (reference) and source 1 (kernels) */
+static void check_outputs(struct dynamics_data *data)
+{
+	float comp_diff = 0.0f;
+	float gate_diff = 0.0f;
+
+	init_states(data);
+
+	for (size_t block = 0; block < NUM_BLOCKS; block++) {
+		load_block(data, 0, block);
+		load_block(data, 1, block);
+
+		compress_scalar(data, &data->comp[0], data->work[0]);
+		compress_simd(data, &data->comp[1], data->work[1]);
+		comp_diff = fmaxf(comp_diff,
+				max_difference(data->work[0], data->work[1]));
+
+		load_block(data, 0, block);
+		load_block(data, 1, block);
+
+		gate_scalar(&data->gate[0], data->work[0]);
+		gate_simd(data, &data->gate[1], data->work[1]);
+		gate_diff = fmaxf(gate_diff,
+				max_difference(data->work[0], data->work[1]));
+	}
+
+	bench_note("compressor: max output difference %g over %d blocks",
+			comp_diff, NUM_BLOCKS);
+	bench_note("noise gate: max output difference %g over %d blocks",
+			gate_diff, NUM_BLOCKS);
+
+	if (comp_diff > 1e-4f)
+		bench_error("audio_dynamics: compressor output mismatch (%g)",
+				comp_diff);
+	if (gate_diff > 1e-6f)
+		bench_error("audio_dynamics: noise gate output mismatch (%g)",
+				gate_diff);
+
+	init_states(data);
+}
+
+/* ------------------------------------------------------------------------- */
+
+void bench_audio_dynamics(void)
+{
+	struct dynamics_data data = {0};
+
+	init_dynamics_data(&data);
+	check_outputs(&data);
+
+	bench_run("audio_dynamics", "scalar compressor, 20 sources",
+			run_compressor_scalar, &data, NUM_BLOCKS);
+	bench_run("audio_dynamics", "simd compressor, 20 sources",
+			run_compressor_simd, &data, NUM_BLOCKS);
+	bench_run("audio_dynamics", "scalar noise gate, 20 sources",
+			run_gate_scalar, &data, NUM_BLOCKS);
+	bench_run("audio_dynamics", "simd noise gate, 20 sources",
+			run_gate_simd, &data, NUM_BLOCKS);
+
+	free_dynamics_data(&data);
+}
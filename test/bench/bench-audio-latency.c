@@ -0,0 +1,332 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <obs.h>
+#include "bench.h"
+
+/*
+ * Measures end-to-end audio latency through a running libobs core for each
+ * audio block size: an async audio source outputs 5ms packets with
+ * obs_source_output_audio, and every so often a packet starts with an
+ * impulse.  The time from outputting that packet to the impulse reaching an
+ * audio encoder's encode callback is the latency, which includes audio
+ * buffering, mixing, and the encoder input thread.
+ *
+ * The encoder takes one tick worth of frames per encode so that its own
+ * framing does not add to the results.
+ */
+
+#define SAMPLE_RATE       48000
+#define PACKET_FRAMES     240
+#define PACKETS_PER_PULSE 10
+#define WARMUP_PULSES     5
+#define NUM_PULSES        40
+
+struct latency_data {
+	obs_source_t      *source;
+	uint64_t          sent[NUM_PULSES];
+	uint64_t          latency[NUM_PULSES];
+	volatile long     received;
+};
+
+static struct latency_data *cur_data = NULL;
+
+static int cmp_uint64(const void *a, const void *b)
+{
+	uint64_t val_a = *(const uint64_t*)a;
+	uint64_t val_b = *(const uint64_t*)b;
+	return val_a < val_b ? -1 : (val_a > val_b ? 1 : 0);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static const char *latency_source_get_name(void *type_data)
+{
+	UNUSED_PARAMETER(type_data);
+	return "bench_latency_source";
+}
+
+static void *latency_source_create(obs_data_t *settings, obs_source_t *source)
+{
+	UNUSED_PARAMETER(settings);
+	return source;
+}
+
+static void latency_source_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static struct obs_source_info latency_source_info = {
+	.id           = "bench_latency_source",
+	.type         = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_AUDIO,
+	.get_name     = latency_source_get_name,
+	.create       = latency_source_create,
+	.destroy      = latency_source_destroy,
+};
+
+/* ------------------------------------------------------------------------- */
+
+static const char *latency_encoder_get_name(void *type_data)
+{
+	UNUSED_PARAMETER(type_data);
+	return "bench_latency_encoder";
+}
+
+static void *latency_encoder_create(obs_data_t *settings,
+		obs_encoder_t *encoder)
+{
+	UNUSED_PARAMETER(settings);
+	return encoder;
+}
+
+static void latency_encoder_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static bool latency_encoder_encode(void *data, struct encoder_frame *frame,
+		struct encoder_packet *packet, bool *received_packet)
+{
+	struct latency_data *ld = cur_data;
+	const float *samples = (const float*)frame->data[0];
+	uint64_t t = os_gettime_ns();
+
+	for (uint32_t i = 0; i < frame->frames; i++) {
+		long idx;
+
+		if (samples[i] < 0.5f)
+			continue;
+
+		idx = os_atomic_load_long(&ld->received);
+		if (idx < NUM_PULSES) {
+			ld->latency[idx] = t - ld->sent[idx];
+			os_atomic_set_long(&ld->received, idx + 1);
+		}
+	}
+
+	*received_packet = false;
+
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(packet);
+	return true;
+}
+
+static size_t latency_encoder_get_frame_size(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return audio_output_get_block_frames(obs_get_audio());
+}
+
+static struct obs_encoder_info latency_encoder_info = {
+	.id             = "bench_latency_encoder",
+	.type           = OBS_ENCODER_AUDIO,
+	.codec          = "pcm",
+	.get_name       = latency_encoder_get_name,
+	.create         = latency_encoder_create,
+	.destroy        = latency_encoder_destroy,
+	.encode         = latency_encoder_encode,
+	.get_frame_size = latency_encoder_get_frame_size,
+};
+
+/* ------------------------------------------------------------------------- */
+
+static const char *latency_output_get_name(void *type_data)
+{
+	UNUSED_PARAMETER(type_data);
+	return "bench_latency_output";
+}
+
+static void *latency_output_create(obs_data_t *settings, obs_output_t *output)
+{
+	UNUSED_PARAMETER(settings);
+	return output;
+}
+
+static void latency_output_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static bool latency_output_start(void *data)
+{
+	obs_output_t *output = data;
+
+	if (!obs_output_can_begin_data_capture(output, 0))
+		return false;
+	if (!obs_output_initialize_encoders(output, 0))
+		return false;
+
+	return obs_output_begin_data_capture(output, 0);
+}
+
+static void latency_output_stop(void *data, uint64_t ts)
+{
+	obs_output_end_data_capture(data);
+	UNUSED_PARAMETER(ts);
+}
+
+static void latency_output_packet(void *data, struct encoder_packet *packet)
+{
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(packet);
+}
+
+static struct obs_output_info latency_output_info = {
+	.id             = "bench_latency_output",
+	.flags          = OBS_OUTPUT_AUDIO | OBS_OUTPUT_ENCODED,
+	.get_name       = latency_output_get_name,
+	.create         = latency_output_create,
+	.destroy        = latency_output_destroy,
+	.start          = latency_output_start,
+	.stop           = latency_output_stop,
+	.encoded_packet = latency_output_packet,
+};
+
+/* ------------------------------------------------------------------------- */
+
+static void send_packets(struct latency_data *ld)
+{
+	float *samples = bzalloc(PACKET_FRAMES * sizeof(float));
+	uint64_t packet_ns = (uint64_t)PACKET_FRAMES * 1000000000ULL /
+		SAMPLE_RATE;
+	uint64_t next = os_gettime_ns();
+	size_t total = (WARMUP_PULSES + NUM_PULSES) * PACKETS_PER_PULSE;
+
+	for (size_t i = 0; i < total; i++) {
+		struct obs_source_audio audio = {0};
+		size_t pulse = i / PACKETS_PER_PULSE;
+		bool impulse = (i % PACKETS_PER_PULSE) == 0 &&
+			pulse >= WARMUP_PULSES;
+
+		if (!os_sleepto_ns(next))
+			next = os_gettime_ns();
+		next += packet_ns;
+
+		samples[0] = impulse ? 1.0f : 0.0f;
+
+		audio.data[0]         = (const uint8_t*)samples;
+		audio.data[1]         = (const uint8_t*)samples;
+		audio.frames          = PACKET_FRAMES;
+		audio.speakers        = SPEAKERS_STEREO;
+		audio.format          = AUDIO_FORMAT_FLOAT_PLANAR;
+		audio.samples_per_sec = SAMPLE_RATE;
+		audio.timestamp       = os_gettime_ns();
+
+		if (impulse)
+			ld->sent[pulse - WARMUP_PULSES] = audio.timestamp;
+
+		obs_source_output_audio(ld->source, &audio);
+	}
+
+	bfree(samples);
+}
+
+static void measure_block_size(uint32_t block_frames)
+{
+	struct obs_audio_info oai = {SAMPLE_RATE, SPEAKERS_STEREO, block_frames};
+	struct latency_data ld = {0};
+	obs_encoder_t *encoder;
+	obs_output_t *output;
+	uint64_t timeout;
+	uint32_t buffering_ms;
+	long received;
+
+	if (!obs_reset_audio(&oai)) {
+		bench_error("audio_latency: Failed to reset audio with %u "
+				"frame blocks", block_frames);
+		return;
+	}
+
+	cur_data = &ld;
+
+	ld.source = obs_source_create("bench_latency_source", "source",
+			NULL, NULL);
+	obs_set_output_source(0, ld.source);
+
+	encoder = obs_audio_encoder_create("bench_latency_encoder", "encoder",
+			NULL, 0, NULL);
+	obs_encoder_set_audio(encoder, obs_get_audio());
+
+	output = obs_output_create("bench_latency_output", "output", NULL,
+			NULL);
+	obs_output_set_audio_encoder(output, encoder, 0);
+
+	if (!obs_output_start(output)) {
+		bench_error("audio_latency: Failed to start output");
+		goto cleanup;
+	}
+
+	send_packets(&ld);
+
+	timeout = os_gettime_ns() + 2000000000ULL;
+	while (os_atomic_load_long(&ld.received) < NUM_PULSES &&
+	       os_gettime_ns() < timeout)
+		os_sleep_ms(10);
+
+	buffering_ms = obs_get_audio_buffering_ms();
+	obs_output_stop(output);
+
+	received = os_atomic_load_long(&ld.received);
+	if (received < NUM_PULSES) {
+		bench_error("audio_latency: Only %ld of %d impulses reached "
+				"the encoder with %u frame blocks",
+				received, NUM_PULSES, block_frames);
+		goto cleanup;
+	}
+
+	qsort(ld.latency, NUM_PULSES, sizeof(uint64_t), cmp_uint64);
+
+	bench_note("%4u frame blocks: median %6.2f ms, max %6.2f ms, "
+			"audio buffering %u ms", block_frames,
+			(double)ld.latency[NUM_PULSES / 2] / 1000000.0,
+			(double)ld.latency[NUM_PULSES - 1] / 1000000.0,
+			buffering_ms);
+
+cleanup:
+	obs_output_release(output);
+	obs_encoder_release(encoder);
+	obs_set_output_source(0, NULL);
+	obs_source_release(ld.source);
+	cur_data = NULL;
+}
+
+void bench_audio_latency(void)
+{
+	static const uint32_t block_sizes[] = {1024, 512, 256, 128};
+
+	if (!obs_startup("en-US", NULL, NULL)) {
+		bench_error("audio_latency: Failed to start up libobs");
+		return;
+	}
+
+	obs_register_source(&latency_source_info);
+	obs_register_encoder(&latency_encoder_info);
+	obs_register_output(&latency_output_info);
+
+	for (size_t i = 0; i < sizeof(block_sizes) / sizeof(block_sizes[0]);
+			i++)
+		measure_block_size(block_sizes[i]);
+
+	obs_shutdown();
+}
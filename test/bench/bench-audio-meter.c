@@ -0,0 +1,177 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <math.h>
+#include <util/bmem.h>
+#include <media-io/audio-io.h>
+#include <media-io/audio-meter.h>
+#include "bench.h"
+
+/*
+ * Meters one tick of audio for a number of stereo sources.  "scalar" is the
+ * previous volume meter loop (sample peak and sum of squares only), "simd"
+ * is the same measurement with the metering kernels, and "full" adds true
+ * peak and loudness.
+ */
+
+#define NUM_SOURCES 20
+#define CHANNELS    2
+
+struct meter_data {
+	float         *sources[NUM_SOURCES][MAX_AV_PLANES];
+	audio_meter_t *meters[NUM_SOURCES];
+	float         result;
+};
+
+static float *alloc_buffer(uint32_t seed)
+{
+	float *buf = bmalloc(AUDIO_OUTPUT_FRAMES * sizeof(float));
+
+	for (size_t i = 0; i < AUDIO_OUTPUT_FRAMES; i++) {
+		seed = seed * 1103515245 + 12345;
+		buf[i] = (float)(seed >> 16) / 65536.0f - 0.5f;
+	}
+
+	return buf;
+}
+
+static void init_meter_data(struct meter_data *data)
+{
+	uint32_t seed = 1;
+
+	for (size_t i = 0; i < NUM_SOURCES; i++) {
+		for (size_t ch = 0; ch < CHANNELS; ch++)
+			data->sources[i][ch] = alloc_buffer(seed++);
+
+		data->meters[i] = audio_meter_create(48000, SPEAKERS_STEREO);
+	}
+}
+
+static void free_meter_data(struct meter_data *data)
+{
+	for (size_t i = 0; i < NUM_SOURCES; i++) {
+		for (size_t ch = 0; ch < CHANNELS; ch++)
+			bfree(data->sources[i][ch]);
+
+		audio_meter_destroy(data->meters[i]);
+	}
+}
+
+static void sum_and_max_scalar(float *data[MAX_AV_PLANES], size_t frames,
+		float *sum, float *max)
+{
+	float s = *sum;
+	float m = *max;
+
+	for (size_t plane = 0; plane < MAX_AV_PLANES; plane++) {
+		if (!data[plane])
+			break;
+
+		for (float *c = data[plane]; c < data[plane] + frames; ++c) {
+			const float pow = *c * *c;
+			s += pow;
+			m  = (m > pow) ? m : pow;
+		}
+	}
+
+	*sum = s;
+	*max = m;
+}
+
+static void run_scalar(void *param, size_t iterations)
+{
+	struct meter_data *data = param;
+
+	for (size_t it = 0; it < iterations; it++) {
+		for (size_t i = 0; i < NUM_SOURCES; i++) {
+			float sum = 0.0f, max = 0.0f;
+			sum_and_max_scalar(data->sources[i],
+					AUDIO_OUTPUT_FRAMES, &sum, &max);
+			data->result += sum + max;
+		}
+	}
+}
+
+static void run_simd(void *param, size_t iterations)
+{
+	struct meter_data *data = param;
+
+	for (size_t it = 0; it < iterations; it++) {
+		for (size_t i = 0; i < NUM_SOURCES; i++) {
+			for (size_t ch = 0; ch < CHANNELS; ch++) {
+				float peak, sum;
+				audio_meter_peak_sum(data->sources[i][ch],
+						AUDIO_OUTPUT_FRAMES,
+						&peak, &sum);
+				data->result += sum + peak;
+			}
+		}
+	}
+}
+
+static void run_full(void *param, size_t iterations)
+{
+	struct meter_data *data = param;
+	struct audio_meter_levels levels;
+
+	for (size_t it = 0; it < iterations; it++) {
+		for (size_t i = 0; i < NUM_SOURCES; i++) {
+			audio_meter_process(data->meters[i], data->sources[i],
+					AUDIO_OUTPUT_FRAMES, 1.0f, &levels);
+			data->result += levels.true_peak[0];
+		}
+	}
+}
+
+static void check_peak_sum(struct meter_data *data)
+{
+	for (size_t i = 0; i < NUM_SOURCES; i++) {
+		float *plane[MAX_AV_PLANES] = {data->sources[i][0]};
+		float sum = 0.0f, max = 0.0f;
+		float peak, simd_sum;
+
+		sum_and_max_scalar(plane, AUDIO_OUTPUT_FRAMES, &sum, &max);
+		audio_meter_peak_sum(plane[0], AUDIO_OUTPUT_FRAMES, &peak,
+				&simd_sum);
+
+		if (fabsf(peak - sqrtf(max)) > 1e-6f ||
+		    fabsf(simd_sum - sum) > sum * 1e-4f) {
+			bench_error("audio_meter: peak/sum mismatch for "
+					"source %d", (int)i);
+			return;
+		}
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+void bench_audio_meter(void)
+{
+	struct meter_data data = {0};
+
+	init_meter_data(&data);
+	check_peak_sum(&data);
+
+	bench_run("audio_meter", "scalar peak/sum, 20 sources",
+			run_scalar, &data, 1000);
+	bench_run("audio_meter", "simd peak/sum, 20 sources",
+			run_simd, &data, 1000);
+	bench_run("audio_meter", "full (true peak, loudness), 20 sources",
+			run_full, &data, 200);
+
+	free_meter_data(&data);
+}
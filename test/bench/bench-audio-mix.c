@@ -0,0 +1,228 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <stdio.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <media-io/audio-io.h>
+#include <media-io/audio-mix.h>
+#include "bench.h"
+
+/*
+ * Mixes a number of stereo sources into every audio mix, the way the audio
+ * thread does each tick.  "scalar" is the previous per-sample loop over all
+ * mixes; "simd" uses the audio mix kernels, both for all mixes and with each
+ * source only routed to the first mix (the common case).
+ */
+
+#define NUM_SOURCES 40
+#define CHANNELS    2
+
+struct mix_data {
+	float    *sources[NUM_SOURCES][MAX_AUDIO_MIXES][CHANNELS];
+	float    *mixes[MAX_AUDIO_MIXES][CHANNELS];
+	float    *vol_data;
+	uint32_t routed_mixes;
+};
+
+static float *alloc_buffer(uint32_t seed)
+{
+	float *buf = bmalloc(AUDIO_OUTPUT_FRAMES * sizeof(float));
+
+	for (size_t i = 0; i < AUDIO_OUTPUT_FRAMES; i++) {
+		seed = seed * 1103515245 + 12345;
+		buf[i] = (float)(seed >> 16) / 65536.0f - 0.5f;
+	}
+
+	return buf;
+}
+
+static void init_mix_data(struct mix_data *data)
+{
+	uint32_t seed = 1;
+
+	for (size_t i = 0; i < NUM_SOURCES; i++)
+		for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++)
+			for (size_t ch = 0; ch < CHANNELS; ch++)
+				data->sources[i][mix][ch] =
+					alloc_buffer(seed++);
+
+	for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++)
+		for (size_t ch = 0; ch < CHANNELS; ch++)
+			data->mixes[mix][ch] = alloc_buffer(seed++);
+
+	/* unity gain keeps repeated runs from decaying into denormals */
+	data->vol_data = bmalloc(AUDIO_OUTPUT_FRAMES * sizeof(float));
+	for (size_t i = 0; i < AUDIO_OUTPUT_FRAMES; i++)
+		data->vol_data[i] = 1.0f;
+}
+
+static void free_mix_data(struct mix_data *data)
+{
+	for (size_t i = 0; i < NUM_SOURCES; i++)
+		for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++)
+			for (size_t ch = 0; ch < CHANNELS; ch++)
+				bfree(data->sources[i][mix][ch]);
+
+	for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++)
+		for (size_t ch = 0; ch < CHANNELS; ch++)
+			bfree(data->mixes[mix][ch]);
+
+	bfree(data->vol_data);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void run_mix_scalar(void *param, size_t iterations)
+{
+	struct mix_data *data = param;
+
+	for (size_t it = 0; it < iterations; it++) {
+		for (size_t i = 0; i < NUM_SOURCES; i++) {
+			for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++) {
+				for (size_t ch = 0; ch < CHANNELS; ch++) {
+					register float *out =
+						data->mixes[mix][ch];
+					register float *aud =
+						data->sources[i][mix][ch];
+					register float *end =
+						aud + AUDIO_OUTPUT_FRAMES;
+
+					while (aud < end)
+						*(out++) += *(aud++);
+				}
+			}
+		}
+	}
+}
+
+static void run_mix_simd(void *param, size_t iterations)
+{
+	struct mix_data *data = param;
+
+	for (size_t it = 0; it < iterations; it++) {
+		for (size_t i = 0; i < NUM_SOURCES; i++) {
+			for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++) {
+				if ((data->routed_mixes & (1 << mix)) == 0)
+					continue;
+
+				for (size_t ch = 0; ch < CHANNELS; ch++)
+					audio_mix_add(data->mixes[mix][ch],
+						data->sources[i][mix][ch],
+						AUDIO_OUTPUT_FRAMES);
+			}
+		}
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* alternate between gains that cancel out so the data neither decays into
+ * denormals nor overflows */
+static inline float get_gain(size_t iteration)
+{
+	return (iteration & 1) ? 2.0f : 0.5f;
+}
+
+static void run_gain_scalar(void *param, size_t iterations)
+{
+	struct mix_data *data = param;
+
+	for (size_t it = 0; it < iterations; it++) {
+		float gain = get_gain(it);
+
+		for (size_t i = 0; i < NUM_SOURCES; i++) {
+			register float *out = data->sources[i][0][0];
+			register float *end = out + AUDIO_OUTPUT_FRAMES;
+
+			while (out < end)
+				*(out++) *= gain;
+		}
+	}
+}
+
+static void run_gain_simd(void *param, size_t iterations)
+{
+	struct mix_data *data = param;
+
+	for (size_t it = 0; it < iterations; it++) {
+		float gain = get_gain(it);
+
+		for (size_t i = 0; i < NUM_SOURCES; i++)
+			audio_mix_gain(data->sources[i][0][0], gain,
+					AUDIO_OUTPUT_FRAMES);
+	}
+}
+
+static void run_gain_ramp_scalar(void *param, size_t iterations)
+{
+	struct mix_data *data = param;
+
+	for (size_t it = 0; it < iterations; it++) {
+		for (size_t i = 0; i < NUM_SOURCES; i++) {
+			register float *out = data->sources[i][0][0];
+			register float *end = out + AUDIO_OUTPUT_FRAMES;
+			register float *vol = data->vol_data;
+
+			while (out < end)
+				*(out++) *= *(vol++);
+		}
+	}
+}
+
+static void run_gain_ramp_simd(void *param, size_t iterations)
+{
+	struct mix_data *data = param;
+
+	for (size_t it = 0; it < iterations; it++)
+		for (size_t i = 0; i < NUM_SOURCES; i++)
+			audio_mix_gain_ramp(data->sources[i][0][0],
+					data->vol_data, AUDIO_OUTPUT_FRAMES);
+}
+
+/* ------------------------------------------------------------------------- */
+
+void bench_audio_mix(void)
+{
+	struct mix_data data = {0};
+	uint32_t features = os_get_cpu_features();
+
+	bench_note("audio mix kernels: %s",
+			(features & OS_CPU_AVX) ? "AVX" : "SSE");
+
+	init_mix_data(&data);
+
+	bench_run("audio_mix", "scalar 40 sources, all mixes",
+			run_mix_scalar, &data, 200);
+
+	data.routed_mixes = (1 << MAX_AUDIO_MIXES) - 1;
+	bench_run("audio_mix", "simd 40 sources, all mixes",
+			run_mix_simd, &data, 200);
+
+	data.routed_mixes = 1;
+	bench_run("audio_mix", "simd 40 sources, routed mixes only",
+			run_mix_simd, &data, 200);
+
+	bench_run("audio_mix", "scalar gain", run_gain_scalar, &data, 1000);
+	bench_run("audio_mix", "simd gain", run_gain_simd, &data, 1000);
+	bench_run("audio_mix", "scalar gain ramp",
+			run_gain_ramp_scalar, &data, 1000);
+	bench_run("audio_mix", "simd gain ramp",
+			run_gain_ramp_simd, &data, 1000);
+
+	free_mix_data(&data);
+}
@@ -0,0 +1,379 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <obs-data.h>
+#include <util/bmem.h>
+#include "bench.h"
+
+/*
+ * Settings are read and written constantly by sources and filters, usually
+ * with a few dozen items per settings object.
+ */
+
+#define NUM_ITEMS 32
+#define NUM_LARGE_ITEMS 256
+#define NUM_SOURCES 2000
+
+struct data_bench {
+	obs_data_t *data;
+	char       names[NUM_ITEMS][16];
+
+	obs_data_t *large;
+	char       large_names[NUM_LARGE_ITEMS][24];
+
+	char       *collection;
+	size_t     collection_size;
+};
+
+/* keeps results alive so the reads aren't optimized out */
+static volatile size_t sink;
+
+static void run_set_int(void *param, size_t iterations)
+{
+	struct data_bench *bench = param;
+
+	for (size_t i = 0; i < iterations; i++)
+		obs_data_set_int(bench->data, bench->names[i % NUM_ITEMS],
+				(long long)i);
+}
+
+static void run_get_int(void *param, size_t iterations)
+{
+	struct data_bench *bench = param;
+	long long total = 0;
+
+	for (size_t i = 0; i < iterations; i++)
+		total += obs_data_get_int(bench->data,
+				bench->names[i % NUM_ITEMS]);
+
+	sink = (size_t)total;
+}
+
+static void run_set_string(void *param, size_t iterations)
+{
+	struct data_bench *bench = param;
+
+	for (size_t i = 0; i < iterations; i++)
+		obs_data_set_string(bench->data, bench->names[i % NUM_ITEMS],
+				(i & 1) ? "some string value" : "other value");
+}
+
+static void run_get_string(void *param, size_t iterations)
+{
+	struct data_bench *bench = param;
+	size_t total = 0;
+
+	for (size_t i = 0; i < iterations; i++)
+		total += (size_t)obs_data_get_string(bench->data,
+				bench->names[i % NUM_ITEMS])[0];
+
+	sink = (size_t)total;
+}
+
+static void run_get_int_large(void *param, size_t iterations)
+{
+	struct data_bench *bench = param;
+	long long total = 0;
+
+	for (size_t i = 0; i < iterations; i++)
+		total += obs_data_get_int(bench->large,
+				bench->large_names[i % NUM_LARGE_ITEMS]);
+
+	sink = (size_t)total;
+}
+
+static void run_create_json(void *param, size_t iterations)
+{
+	struct data_bench *bench = param;
+	const char *json = obs_data_get_json(bench->data);
+
+	for (size_t i = 0; i < iterations; i++) {
+		obs_data_t *data = obs_data_create_from_json(json);
+		obs_data_release(data);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* Scene collection loading */
+
+static obs_data_t *create_source_data(int idx, bool scene)
+{
+	obs_data_t *source = obs_data_create();
+	obs_data_t *settings = obs_data_create();
+	obs_data_t *hotkeys = obs_data_create();
+	obs_data_array_t *filters = obs_data_array_create();
+	char name[64];
+
+	snprintf(name, sizeof(name), "%s %d", scene ? "Scene" : "Source", idx);
+	obs_data_set_string(source, "name", name);
+	obs_data_set_string(source, "id", scene ? "scene" : "image_source");
+	obs_data_set_double(source, "volume", 1.0);
+	obs_data_set_int(source, "sync", 0);
+	obs_data_set_int(source, "mixers", 0xF);
+	obs_data_set_int(source, "flags", 0);
+	obs_data_set_bool(source, "enabled", true);
+	obs_data_set_bool(source, "muted", false);
+	obs_data_set_bool(source, "push-to-mute", false);
+	obs_data_set_int(source, "push-to-mute-delay", 0);
+	obs_data_set_bool(source, "push-to-talk", false);
+	obs_data_set_int(source, "push-to-talk-delay", 0);
+	obs_data_set_int(source, "deinterlace_mode", 0);
+	obs_data_set_int(source, "deinterlace_field_order", 0);
+	obs_data_set_int(source, "monitoring_type", 0);
+
+	if (scene) {
+		obs_data_array_t *items = obs_data_array_create();
+
+		for (int i = 0; i < 10; i++) {
+			obs_data_t *item = obs_data_create();
+			obs_data_t *pos = obs_data_create();
+
+			snprintf(name, sizeof(name), "Source %d", idx * 10 + i);
+			obs_data_set_string(item, "name", name);
+			obs_data_set_bool(item, "visible", true);
+			obs_data_set_int(item, "align", 5);
+			obs_data_set_double(item, "rot", 0.0);
+			obs_data_set_int(item, "bounds_type", 0);
+			obs_data_set_double(pos, "x", 12.5 * i);
+			obs_data_set_double(pos, "y", 7.25 * i);
+			obs_data_set_obj(item, "pos", pos);
+			obs_data_set_obj(item, "scale", pos);
+			obs_data_array_push_back(items, item);
+
+			obs_data_release(pos);
+			obs_data_release(item);
+		}
+
+		obs_data_set_array(settings, "items", items);
+		obs_data_set_int(settings, "id_counter", 10);
+		obs_data_array_release(items);
+	} else {
+		obs_data_t *filter = obs_data_create();
+		obs_data_t *filter_settings = obs_data_create();
+
+		snprintf(name, sizeof(name), "C:/Users/user/Pictures/img%d.png",
+				idx);
+		obs_data_set_string(settings, "file", name);
+		obs_data_set_bool(settings, "unload", false);
+
+		obs_data_set_string(filter, "name", "Color Correction");
+		obs_data_set_string(filter, "id", "color_filter");
+		obs_data_set_double(filter_settings, "gamma", 0.1);
+		obs_data_set_double(filter_settings, "contrast", -0.05);
+		obs_data_set_int(filter_settings, "color", 0xFFFFFFFF);
+		obs_data_set_obj(filter, "settings", filter_settings);
+		obs_data_array_push_back(filters, filter);
+
+		obs_data_release(filter_settings);
+		obs_data_release(filter);
+	}
+
+	obs_data_set_obj(source, "settings", settings);
+	obs_data_set_obj(source, "hotkeys", hotkeys);
+	obs_data_set_array(source, "filters", filters);
+
+	obs_data_array_release(filters);
+	obs_data_release(hotkeys);
+	obs_data_release(settings);
+	return source;
+}
+
+static char *create_collection_json(size_t *size)
+{
+	obs_data_t *collection = obs_data_create();
+	obs_data_array_t *sources = obs_data_array_create();
+	char *json;
+
+	for (int i = 0; i < NUM_SOURCES; i++) {
+		bool scene = i < NUM_SOURCES / 10;
+		obs_data_t *source = create_source_data(i, scene);
+		obs_data_array_push_back(sources, source);
+		obs_data_release(source);
+	}
+
+	obs_data_set_array(collection, "sources", sources);
+	obs_data_set_string(collection, "current_scene", "Scene 0");
+	obs_data_set_string(collection, "name", "Benchmark");
+
+	json = bstrdup(obs_data_get_json(collection));
+	*size = strlen(json);
+
+	obs_data_array_release(sources);
+	obs_data_release(collection);
+	return json;
+}
+
+/* the lookups obs_load_source does for every source and filter */
+static void load_source(obs_data_t *source_data)
+{
+	obs_data_array_t *filters = obs_data_get_array(source_data, "filters");
+	obs_data_t *settings = obs_data_get_obj(source_data, "settings");
+	obs_data_t *hotkeys = obs_data_get_obj(source_data, "hotkeys");
+	size_t total = 0;
+
+	total += strlen(obs_data_get_string(source_data, "name"));
+	total += strlen(obs_data_get_string(source_data, "id"));
+
+	obs_data_set_default_double(source_data, "volume", 1.0);
+	total += (size_t)obs_data_get_double(source_data, "volume");
+	total += (size_t)obs_data_get_int(source_data, "sync");
+	obs_data_set_default_int(source_data, "mixers", 0xF);
+	total += (size_t)obs_data_get_int(source_data, "mixers");
+	obs_data_set_default_int(source_data, "flags", 0);
+	total += (size_t)obs_data_get_int(source_data, "flags");
+	obs_data_set_default_bool(source_data, "enabled", true);
+	total += obs_data_get_bool(source_data, "enabled");
+	obs_data_set_default_bool(source_data, "muted", false);
+	total += obs_data_get_bool(source_data, "muted");
+	total += (size_t)obs_data_get_int(source_data, "deinterlace_mode");
+	total += (size_t)obs_data_get_int(source_data, "monitoring_type");
+
+	for (size_t i = 0; i < obs_data_array_count(filters); i++) {
+		obs_data_t *filter = obs_data_array_item(filters, i);
+		load_source(filter);
+		obs_data_release(filter);
+	}
+
+	sink += total;
+
+	obs_data_array_release(filters);
+	obs_data_release(hotkeys);
+	obs_data_release(settings);
+}
+
+static void run_load_collection(void *param, size_t iterations)
+{
+	struct data_bench *bench = param;
+
+	for (size_t i = 0; i < iterations; i++) {
+		obs_data_t *data = obs_data_create_from_json(bench->collection);
+		obs_data_array_t *sources = obs_data_get_array(data, "sources");
+		size_t count = obs_data_array_count(sources);
+
+		for (size_t j = 0; j < count; j++) {
+			obs_data_t *source = obs_data_array_item(sources, j);
+			load_source(source);
+			obs_data_release(source);
+		}
+
+		obs_data_array_release(sources);
+		obs_data_release(data);
+	}
+}
+
+static void run_parse_collection(void *param, size_t iterations)
+{
+	struct data_bench *bench = param;
+
+	for (size_t i = 0; i < iterations; i++) {
+		obs_data_t *data = obs_data_create_from_json(bench->collection);
+		obs_data_release(data);
+	}
+}
+
+/* duplicate keys must be rejected even where nothing is stored, such as in
+ * arrays that are only validated, or when the first value was null */
+static const char *duplicate_key_json[] = {
+	"{\"a\": null, \"a\": 1}",
+	"{\"x\": {\"a\": null, \"b\": 2, \"a\": null}}",
+	"[{\"a\": 1, \"a\": 2}]",
+	"{\"x\": [[{\"a\": 1, \"a\": 2}]]}",
+	"{\"x\": [1, {\"y\": [{\"a\": 1}, {\"a\": 1, \"a\": 2}]}]}",
+};
+
+static const char *unique_key_json[] = {
+	"{\"a\": null, \"b\": null}",
+	"{\"a\": {\"a\": null}, \"x\": [{\"a\": 1}, {\"a\": 2}]}",
+	"[[{\"a\": 1}, {\"a\": 1}], {\"b\": [{\"b\": null}]}]",
+};
+
+static void check_duplicate_keys(void)
+{
+	size_t count = sizeof(duplicate_key_json) /
+		sizeof(duplicate_key_json[0]);
+	size_t unique_count = sizeof(unique_key_json) /
+		sizeof(unique_key_json[0]);
+
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *data = obs_data_create_from_json(
+				duplicate_key_json[i]);
+		if (data) {
+			bench_error("obs_data: Duplicate key accepted: %s",
+					duplicate_key_json[i]);
+			obs_data_release(data);
+		}
+	}
+
+	for (size_t i = 0; i < unique_count; i++) {
+		obs_data_t *data = obs_data_create_from_json(
+				unique_key_json[i]);
+		if (!data)
+			bench_error("obs_data: Valid json rejected: %s",
+					unique_key_json[i]);
+		obs_data_release(data);
+	}
+}
+
+void bench_obs_data(void)
+{
+	struct data_bench bench;
+
+	bench.data = obs_data_create();
+	for (size_t i = 0; i < NUM_ITEMS; i++)
+		snprintf(bench.names[i], sizeof(bench.names[i]),
+				"setting_%d", (int)i);
+
+	bench.large = obs_data_create();
+	for (size_t i = 0; i < NUM_LARGE_ITEMS; i++) {
+		snprintf(bench.large_names[i], sizeof(bench.large_names[i]),
+				"large_setting_%d", (int)i);
+		obs_data_set_int(bench.large, bench.large_names[i],
+				(long long)i);
+	}
+
+	bench.collection = create_collection_json(&bench.collection_size);
+
+	check_duplicate_keys();
+
+	bench_run("obs_data", "set_int (32 items)",
+			run_set_int, &bench, 1000000);
+	bench_run("obs_data", "get_int (32 items)",
+			run_get_int, &bench, 1000000);
+	bench_run("obs_data", "set_string (32 items)",
+			run_set_string, &bench, 1000000);
+	bench_run("obs_data", "get_string (32 items)",
+			run_get_string, &bench, 1000000);
+	bench_run("obs_data", "get_int (256 items)",
+			run_get_int_large, &bench, 1000000);
+	bench_run("obs_data", "create_from_json (32 items)",
+			run_create_json, &bench, 10000);
+
+	bench_note("scene collection: %d sources, %d KiB of JSON",
+			NUM_SOURCES, (int)(bench.collection_size / 1024));
+	bench_run_bytes("obs_data", "parse collection (2000 sources)",
+			run_parse_collection, &bench, 10,
+			bench.collection_size);
+	bench_run_bytes("obs_data", "load collection (2000 sources)",
+			run_load_collection, &bench, 10,
+			bench.collection_size);
+
+	bfree(bench.collection);
+	obs_data_release(bench.large);
+	obs_data_release(bench.data);
+}
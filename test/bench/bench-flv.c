@@ -0,0 +1,117 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <util/bmem.h>
+#include <obs.h>
+#include "flv-mux.h"
+#include "bench.h"
+
+/*
+ * Muxes typical 6mbps 60fps video and 160kbps AAC packets into FLV tags, the
+ * way the RTMP and FLV outputs do for every packet.
+ */
+
+#define VIDEO_PACKET_SIZE (6000000 / 8 / 60)
+#define AUDIO_PACKET_SIZE (160000 / 8 * 1024 / 48000)
+
+struct flv_data {
+	struct encoder_packet video;
+	struct encoder_packet audio;
+	uint8_t               *video_data;
+	uint8_t               *audio_data;
+};
+
+static void init_flv_data(struct flv_data *data)
+{
+	data->video_data = bmalloc(VIDEO_PACKET_SIZE);
+	data->audio_data = bmalloc(AUDIO_PACKET_SIZE);
+	for (size_t i = 0; i < VIDEO_PACKET_SIZE; i++)
+		data->video_data[i] = (uint8_t)(i * 13);
+	for (size_t i = 0; i < AUDIO_PACKET_SIZE; i++)
+		data->audio_data[i] = (uint8_t)(i * 17);
+
+	data->video.type          = OBS_ENCODER_VIDEO;
+	data->video.data          = data->video_data;
+	data->video.size          = VIDEO_PACKET_SIZE;
+	data->video.timebase_num  = 1;
+	data->video.timebase_den  = 60;
+	data->video.pts           = 2;
+	data->video.dts           = 1;
+	data->video.dts_usec      = 16666;
+	data->video.keyframe      = true;
+
+	data->audio.type          = OBS_ENCODER_AUDIO;
+	data->audio.data          = data->audio_data;
+	data->audio.size          = AUDIO_PACKET_SIZE;
+	data->audio.timebase_num  = 1;
+	data->audio.timebase_den  = 48000;
+	data->audio.pts           = 1024;
+	data->audio.dts           = 1024;
+	data->audio.dts_usec      = 21333;
+}
+
+static void run_mux(struct encoder_packet *packet, size_t iterations)
+{
+	uint8_t *output;
+	size_t size;
+
+	for (size_t i = 0; i < iterations; i++) {
+		flv_packet_mux(packet, &output, &size, false);
+		bfree(output);
+	}
+}
+
+static void run_mux_video(void *param, size_t iterations)
+{
+	struct flv_data *data = param;
+	run_mux(&data->video, iterations);
+}
+
+static void run_mux_audio(void *param, size_t iterations)
+{
+	struct flv_data *data = param;
+	run_mux(&data->audio, iterations);
+}
+
+static void run_header_video(void *param, size_t iterations)
+{
+	struct flv_data *data = param;
+	uint8_t header[FLV_PACKET_HEADER_MAX_SIZE];
+	uint8_t footer[FLV_PACKET_FOOTER_SIZE];
+
+	for (size_t i = 0; i < iterations; i++) {
+		size_t size = flv_packet_header(&data->video, header, false);
+		flv_packet_footer(&data->video, size, footer);
+	}
+}
+
+void bench_flv_mux(void)
+{
+	struct flv_data data = {0};
+
+	init_flv_data(&data);
+
+	bench_run_bytes("flv_mux", "mux video packet (12.5kb)",
+			run_mux_video, &data, 100000, VIDEO_PACKET_SIZE);
+	bench_run_bytes("flv_mux", "mux audio packet (426 bytes)",
+			run_mux_audio, &data, 100000, AUDIO_PACKET_SIZE);
+	bench_run("flv_mux", "video tag header/footer only",
+			run_header_video, &data, 1000000);
+
+	bfree(data.video_data);
+	bfree(data.audio_data);
+}
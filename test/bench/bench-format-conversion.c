@@ -0,0 +1,304 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/threadpool.h>
+#include <media-io/format-conversion.h>
+#include "bench.h"
+
+/*
+ * Converts a full 1080p frame between the packed UYVX output of the GPU and
+ * the planar formats handed to encoders, and back from the planar/packed
+ * formats async sources provide.  Each implementation the CPU supports is
+ * timed separately, and its output is checked against the SSE2 version.
+ * Finally the frame is split into slices and converted on a thread pool.
+ */
+
+#define WIDTH  1920
+#define HEIGHT 1080
+
+#define PLANE_SIZE  (WIDTH * HEIGHT)
+#define PACKED_SIZE (WIDTH * HEIGHT * 4)
+#define OUTPUT_SIZE (PLANE_SIZE * 3 + PACKED_SIZE)
+
+struct conversion_data {
+	uint8_t         *packed;
+	uint8_t         *packed_out;
+	uint8_t         *planes[3];
+	uint32_t        packed_linesize;
+
+	os_threadpool_t *pool;
+	size_t          slices;
+};
+
+struct conversion {
+	const char *name;
+	void       (*convert)(struct conversion_data *data,
+			uint32_t start_y, uint32_t end_y);
+};
+
+struct conversion_job {
+	struct conversion_data  *data;
+	const struct conversion *conversion;
+};
+
+static void init_conversion_data(struct conversion_data *data)
+{
+	data->packed_linesize = WIDTH * 4;
+	data->packed = bmalloc(PACKED_SIZE);
+	data->packed_out = bzalloc(PACKED_SIZE);
+
+	for (size_t i = 0; i < PACKED_SIZE; i++)
+		data->packed[i] = (uint8_t)((i * 7) ^ (i >> 11));
+
+	/* large enough for any of the planar formats */
+	for (size_t i = 0; i < 3; i++) {
+		data->planes[i] = bmalloc(PLANE_SIZE);
+
+		for (size_t j = 0; j < PLANE_SIZE; j++)
+			data->planes[i][j] = (uint8_t)((j * 13 + i) ^ (j >> 9));
+	}
+
+	data->pool = os_threadpool_create("bench: conversion thread", 0);
+	data->slices = os_threadpool_concurrency(data->pool);
+}
+
+static void free_conversion_data(struct conversion_data *data)
+{
+	os_threadpool_destroy(data->pool);
+	bfree(data->packed);
+	bfree(data->packed_out);
+	for (size_t i = 0; i < 3; i++)
+		bfree(data->planes[i]);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void convert_to_nv12(struct conversion_data *data,
+		uint32_t start_y, uint32_t end_y)
+{
+	const uint32_t linesizes[] = {WIDTH, WIDTH};
+
+	compress_uyvx_to_nv12(data->packed, data->packed_linesize,
+			start_y, end_y, data->planes, linesizes);
+}
+
+static void convert_to_i420(struct conversion_data *data,
+		uint32_t start_y, uint32_t end_y)
+{
+	const uint32_t linesizes[] = {WIDTH, WIDTH / 2, WIDTH / 2};
+
+	compress_uyvx_to_i420(data->packed, data->packed_linesize,
+			start_y, end_y, data->planes, linesizes);
+}
+
+static void convert_to_i444(struct conversion_data *data,
+		uint32_t start_y, uint32_t end_y)
+{
+	const uint32_t linesizes[] = {WIDTH, WIDTH, WIDTH};
+
+	convert_uyvx_to_i444(data->packed, data->packed_linesize,
+			start_y, end_y, data->planes, linesizes);
+}
+
+static void convert_from_nv12(struct conversion_data *data,
+		uint32_t start_y, uint32_t end_y)
+{
+	const uint8_t *const planes[] = {data->planes[0], data->planes[1]};
+	const uint32_t linesizes[] = {WIDTH, WIDTH};
+
+	decompress_nv12(planes, linesizes, start_y, end_y,
+			data->packed_out, data->packed_linesize);
+}
+
+static void convert_from_i420(struct conversion_data *data,
+		uint32_t start_y, uint32_t end_y)
+{
+	const uint8_t *const planes[] = {
+		data->planes[0], data->planes[1], data->planes[2]};
+	const uint32_t linesizes[] = {WIDTH, WIDTH / 2, WIDTH / 2};
+
+	decompress_420(planes, linesizes, start_y, end_y,
+			data->packed_out, data->packed_linesize);
+}
+
+/* the packed input is read as YUY2/UYVY */
+static void convert_from_yuy2(struct conversion_data *data,
+		uint32_t start_y, uint32_t end_y)
+{
+	decompress_422(data->packed, WIDTH * 2, start_y, end_y,
+			data->packed_out, data->packed_linesize, true);
+}
+
+static void convert_from_uyvy(struct conversion_data *data,
+		uint32_t start_y, uint32_t end_y)
+{
+	decompress_422(data->packed, WIDTH * 2, start_y, end_y,
+			data->packed_out, data->packed_linesize, false);
+}
+
+static const struct conversion conversions[] = {
+	{"uyvx -> nv12",  convert_to_nv12},
+	{"uyvx -> i420",  convert_to_i420},
+	{"uyvx -> i444",  convert_to_i444},
+	{"nv12 -> uyvx",  convert_from_nv12},
+	{"i420 -> uyvx",  convert_from_i420},
+	{"yuy2 -> uyvx",  convert_from_yuy2},
+	{"uyvy -> uyvx",  convert_from_uyvy},
+};
+
+#define NUM_CONVERSIONS (sizeof(conversions) / sizeof(conversions[0]))
+
+/* ------------------------------------------------------------------------- */
+
+static void run_conversion(void *param, size_t iterations)
+{
+	struct conversion_job *job = param;
+
+	for (size_t i = 0; i < iterations; i++)
+		job->conversion->convert(job->data, 0, HEIGHT);
+}
+
+static void convert_slice(void *param, size_t idx)
+{
+	struct conversion_job *job = param;
+	uint32_t start_y, end_y;
+
+	format_conversion_get_slice(HEIGHT, idx, job->data->slices,
+			&start_y, &end_y);
+	job->conversion->convert(job->data, start_y, end_y);
+}
+
+static void run_conversion_sliced(void *param, size_t iterations)
+{
+	struct conversion_job *job = param;
+
+	for (size_t i = 0; i < iterations; i++)
+		os_threadpool_run(job->data->pool, convert_slice, job,
+				job->data->slices);
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* runs a single conversion from a clean state and copies everything it may
+ * have written to so it can be compared */
+static void capture_output(struct conversion_job *job, bool sliced,
+		uint8_t *output)
+{
+	struct conversion_data *data = job->data;
+	uint8_t *saved[3];
+
+	/* the planes are the input of decompression, so work on copies */
+	for (size_t i = 0; i < 3; i++) {
+		saved[i] = data->planes[i];
+		data->planes[i] = bmemdup(saved[i], PLANE_SIZE);
+	}
+	memset(data->packed_out, 0, PACKED_SIZE);
+
+	if (sliced)
+		run_conversion_sliced(job, 1);
+	else
+		run_conversion(job, 1);
+
+	for (size_t i = 0; i < 3; i++) {
+		memcpy(output + PLANE_SIZE * i, data->planes[i], PLANE_SIZE);
+		bfree(data->planes[i]);
+		data->planes[i] = saved[i];
+	}
+	memcpy(output + PLANE_SIZE * 3, data->packed_out, PACKED_SIZE);
+}
+
+static const struct {
+	const char *name;
+	uint32_t   features;
+} impls[] = {
+	/* the first one is the reference for the others */
+	{"sse2",    OS_CPU_SSE2},
+	{"generic", 0},
+	{"avx2",    OS_CPU_SSE2 | OS_CPU_AVX2},
+};
+
+#define NUM_IMPLS (sizeof(impls) / sizeof(impls[0]))
+
+static void bench_conversion(struct conversion_data *data,
+		const struct conversion *conversion,
+		uint8_t *reference, uint8_t *output)
+{
+	struct conversion_job job = {data, conversion};
+	uint32_t cpu = os_get_cpu_features();
+	bool have_reference = false;
+	char name[128];
+
+	for (size_t i = 0; i < NUM_IMPLS; i++) {
+		const char *impl;
+
+		if ((cpu & impls[i].features) != impls[i].features)
+			continue;
+
+		impl = format_conversion_set_cpu_features(impls[i].features);
+		if (strcmp(impl, impls[i].name) != 0)
+			continue;
+
+		capture_output(&job, false, have_reference ? output : reference);
+		if (have_reference && memcmp(reference, output, OUTPUT_SIZE))
+			bench_error("%s (%s) does not match the %s output",
+					conversion->name, impl, impls[0].name);
+		have_reference = true;
+
+		snprintf(name, sizeof(name), "%s 1080p (%s)",
+				conversion->name, impl);
+		bench_run_bytes("format_conversion", name, run_conversion,
+				&job, 20, PACKED_SIZE);
+	}
+
+	format_conversion_set_cpu_features(cpu);
+
+	if (data->slices > 1) {
+		capture_output(&job, true, output);
+		if (have_reference && memcmp(reference, output, OUTPUT_SIZE))
+			bench_error("%s (sliced) does not match the %s output",
+					conversion->name, impls[0].name);
+
+		snprintf(name, sizeof(name), "%s 1080p (%s, %d slices)",
+				conversion->name, format_conversion_get_impl(),
+				(int)data->slices);
+		bench_run_bytes("format_conversion", name,
+				run_conversion_sliced, &job, 20, PACKED_SIZE);
+	}
+}
+
+void bench_format_conversion(void)
+{
+	struct conversion_data data = {0};
+	uint8_t *reference = bmalloc(OUTPUT_SIZE);
+	uint8_t *output = bmalloc(OUTPUT_SIZE);
+
+	init_conversion_data(&data);
+
+	bench_note("format conversion: %s, %d threads",
+			format_conversion_get_impl(), (int)data.slices);
+
+	for (size_t i = 0; i < NUM_CONVERSIONS; i++)
+		bench_conversion(&data, conversions + i, reference, output);
+
+	free_conversion_data(&data);
+	bfree(reference);
+	bfree(output);
+}
@@ -0,0 +1,201 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <stdio.h>
+#include <util/bmem.h>
+#include <util/darray.h>
+#include <obs.h>
+#include <obs-interleave.h>
+#include "bench.h"
+
+/*
+ * Feeds one video track (60 fps) and six audio tracks (48khz AAC, 1024
+ * samples per packet) through the output interleaver.  A fixed number of
+ * packets are kept buffered, and each iteration pushes one packet and pops
+ * the earliest one, which is what an output does in its steady state.
+ *
+ * Packets carry no payload so only the interleaving itself is measured.
+ *
+ * "sorted-array" is the previous implementation (a single array kept sorted
+ * with linear-search insertion and front erasure) for comparison.
+ */
+
+#define AUDIO_TRACKS     6
+#define VIDEO_FRAME_USEC 16667
+#define AUDIO_FRAME_USEC 21333
+#define AUDIO_DELAY_USEC 50000
+
+struct interleave_data {
+	size_t                      depth;
+	size_t                      num_packets;
+	struct encoder_packet       *packets;
+	int64_t                     span_usec;
+};
+
+static inline int64_t arrival_time(const int64_t *next_ts, size_t track)
+{
+	/* audio arrives later than video the way it does from real encoders */
+	return next_ts[track] + (track ? AUDIO_DELAY_USEC : 0);
+}
+
+static void generate_packets(struct interleave_data *data, size_t count)
+{
+	int64_t next_ts[AUDIO_TRACKS + 1] = {0};
+
+	data->packets = bzalloc(sizeof(struct encoder_packet) * count);
+	data->num_packets = count;
+
+	for (size_t i = 0; i < count; i++) {
+		struct encoder_packet *packet = &data->packets[i];
+		size_t track = 0;
+
+		for (size_t j = 1; j <= AUDIO_TRACKS; j++) {
+			if (arrival_time(next_ts, j) <
+			    arrival_time(next_ts, track))
+				track = j;
+		}
+
+		packet->dts_usec = next_ts[track];
+		packet->timebase_num = 1;
+		packet->timebase_den = 1000000;
+
+		if (track == 0) {
+			packet->type = OBS_ENCODER_VIDEO;
+			next_ts[track] += VIDEO_FRAME_USEC;
+		} else {
+			packet->type = OBS_ENCODER_AUDIO;
+			packet->track_idx = track - 1;
+			next_ts[track] += AUDIO_FRAME_USEC;
+		}
+
+		if (next_ts[track] > data->span_usec)
+			data->span_usec = next_ts[track];
+	}
+}
+
+static inline void get_packet(struct interleave_data *data, size_t idx,
+		struct encoder_packet *packet)
+{
+	*packet = data->packets[idx % data->num_packets];
+
+	/* keep timestamps increasing when wrapping around */
+	packet->dts_usec += (int64_t)(idx / data->num_packets) *
+		data->span_usec;
+	packet->pts = packet->dts = packet->dts_usec;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void run_heap(void *param, size_t iterations)
+{
+	struct interleave_data *data = param;
+	struct packet_interleaver pi;
+	struct encoder_packet packet;
+	size_t idx = 0;
+
+	interleaver_init(&pi);
+
+	for (; idx < data->depth; idx++) {
+		get_packet(data, idx, &packet);
+		interleaver_push(&pi, &packet);
+	}
+
+	for (size_t i = 0; i < iterations; i++, idx++) {
+		get_packet(data, idx, &packet);
+		interleaver_push(&pi, &packet);
+
+		interleaver_pop(&pi, &packet);
+		obs_encoder_packet_release(&packet);
+	}
+
+	interleaver_free(&pi);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void sorted_insert(struct darray *packets,
+		struct encoder_packet *packet)
+{
+	struct encoder_packet *array = packets->array;
+	size_t idx;
+
+	for (idx = 0; idx < packets->num; idx++) {
+		struct encoder_packet *cur = array + idx;
+
+		if (packet->dts_usec == cur->dts_usec &&
+		    packet->type == OBS_ENCODER_VIDEO)
+			break;
+		else if (packet->dts_usec < cur->dts_usec)
+			break;
+	}
+
+	darray_insert(sizeof(struct encoder_packet), packets, idx, packet);
+}
+
+static void run_sorted_array(void *param, size_t iterations)
+{
+	struct interleave_data *data = param;
+	DARRAY(struct encoder_packet) packets;
+	struct encoder_packet packet;
+	size_t idx = 0;
+
+	da_init(packets);
+
+	for (; idx < data->depth; idx++) {
+		get_packet(data, idx, &packet);
+		sorted_insert(&packets.da, &packet);
+	}
+
+	for (size_t i = 0; i < iterations; i++, idx++) {
+		get_packet(data, idx, &packet);
+		sorted_insert(&packets.da, &packet);
+
+		packet = packets.array[0];
+		da_erase(packets, 0);
+		obs_encoder_packet_release(&packet);
+	}
+
+	for (size_t i = 0; i < packets.num; i++)
+		obs_encoder_packet_release(packets.array + i);
+	da_free(packets);
+}
+
+/* ------------------------------------------------------------------------- */
+
+void bench_interleave(void)
+{
+	static const size_t depths[] = {16, 128, 1024, 8192};
+	struct interleave_data data = {0};
+
+	generate_packets(&data, 4096);
+
+	for (size_t i = 0; i < sizeof(depths) / sizeof(depths[0]); i++) {
+		char name[64];
+
+		data.depth = depths[i];
+
+		snprintf(name, sizeof(name), "heap depth=%d", (int)data.depth);
+		bench_run("interleave", name, run_heap, &data, 100000);
+
+		snprintf(name, sizeof(name), "sorted-array depth=%d",
+				(int)data.depth);
+		bench_run("interleave", name, run_sorted_array, &data,
+				data.depth >= 1024 ? 10000 : 100000);
+	}
+
+	bfree(data.packets);
+}
@@ -0,0 +1,876 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <graphics/vec2.h>
+#include <graphics/vec4.h>
+#include <obs.h>
+#include "bench.h"
+
+/*
+ * Measures the CPU side cost of rendering with the null graphics subsystem,
+ * which does no GPU or pixel work, so the results are the overhead of the
+ * scene graph, effects, matrix stacks and texrenders in libobs itself.
+ *
+ * Scenes are made of small sprite sources, optionally each with a filter
+ * that always renders its source to a texture first.  The culled scenes add
+ * sprites outside of the canvas and an opaque full canvas source on top,
+ * which leaves nothing below it to render.
+ *
+ * The main view loops render many times within one video frame, which the
+ * render cache would turn into texture copies, so the cache is disabled for
+ * them.  The overlay scene (one nested scene shown in several places) is
+ * compared with and without the cache by the video thread frame time.
+ *
+ * The texrender resize case has a number of transient texrenders changing
+ * between a few sizes every iteration, which reuses pooled render targets
+ * instead of creating textures each time.
+ *
+ * The shared sprite scenes draw one texture from every item, which sprite
+ * batching draws with a single draw call; they are run with batching on and
+ * off, with the draw calls of one main view render noted.
+ *
+ * The render cache check restarts libobs on the software adapter of the null
+ * module, which models blending, to compare cached and uncached output.
+ */
+
+#define BASE_WIDTH    1920
+#define BASE_HEIGHT   1080
+#define SPRITE_SIZE   64
+#define OVERLAY_ITEMS 30
+#define OVERLAY_USES  8
+#define NUM_RESIZED   8
+
+static const size_t scene_sizes[] = {16, 64, 256};
+
+/* ------------------------------------------------------------------------- */
+
+struct sprite_source {
+	gs_texture_t *tex;
+};
+
+static const char *sprite_get_name(void *type_data)
+{
+	UNUSED_PARAMETER(type_data);
+	return "bench_sprite_source";
+}
+
+static void *sprite_create(obs_data_t *settings, obs_source_t *source)
+{
+	struct sprite_source *sprite = bzalloc(sizeof(struct sprite_source));
+
+	obs_enter_graphics();
+	sprite->tex = gs_texture_create(SPRITE_SIZE, SPRITE_SIZE, GS_RGBA, 1,
+			NULL, 0);
+	obs_leave_graphics();
+
+	UNUSED_PARAMETER(settings);
+	UNUSED_PARAMETER(source);
+	return sprite;
+}
+
+static void sprite_destroy(void *data)
+{
+	struct sprite_source *sprite = data;
+
+	obs_enter_graphics();
+	gs_texture_destroy(sprite->tex);
+	obs_leave_graphics();
+
+	bfree(sprite);
+}
+
+static uint32_t sprite_get_size(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return SPRITE_SIZE;
+}
+
+static void sprite_render(void *data, gs_effect_t *effect)
+{
+	struct sprite_source *sprite = data;
+	obs_source_draw(sprite->tex, 0, 0, 0, 0, false);
+	UNUSED_PARAMETER(effect);
+}
+
+static gs_texture_t *shared_tex = NULL;
+
+static const char *shared_sprite_get_name(void *type_data)
+{
+	UNUSED_PARAMETER(type_data);
+	return "bench_shared_sprite_source";
+}
+
+static void *shared_sprite_create(obs_data_t *settings, obs_source_t *source)
+{
+	UNUSED_PARAMETER(settings);
+	UNUSED_PARAMETER(source);
+	return &shared_tex;
+}
+
+static void shared_sprite_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static void shared_sprite_render(void *data, gs_effect_t *effect)
+{
+	obs_source_draw(shared_tex, 0, 0, 0, 0, false);
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(effect);
+}
+
+static struct obs_source_info sprite_source_info = {
+	.id           = "bench_sprite_source",
+	.type         = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_VIDEO,
+	.get_name     = sprite_get_name,
+	.create       = sprite_create,
+	.destroy      = sprite_destroy,
+	.get_width    = sprite_get_size,
+	.get_height   = sprite_get_size,
+	.video_render = sprite_render,
+};
+
+static struct obs_source_info shared_sprite_source_info = {
+	.id           = "bench_shared_sprite_source",
+	.type         = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_VIDEO,
+	.get_name     = shared_sprite_get_name,
+	.create       = shared_sprite_create,
+	.destroy      = shared_sprite_destroy,
+	.get_width    = sprite_get_size,
+	.get_height   = sprite_get_size,
+	.video_render = shared_sprite_render,
+};
+
+static const char *cover_get_name(void *type_data)
+{
+	UNUSED_PARAMETER(type_data);
+	return "bench_cover_source";
+}
+
+static uint32_t cover_get_width(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return BASE_WIDTH;
+}
+
+static uint32_t cover_get_height(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return BASE_HEIGHT;
+}
+
+static void cover_render(void *data, gs_effect_t *effect)
+{
+	struct sprite_source *sprite = data;
+	obs_source_draw(sprite->tex, 0, 0, BASE_WIDTH, BASE_HEIGHT, false);
+	UNUSED_PARAMETER(effect);
+}
+
+static bool cover_is_opaque(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return true;
+}
+
+static struct obs_source_info cover_source_info = {
+	.id           = "bench_cover_source",
+	.type         = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_VIDEO,
+	.get_name     = cover_get_name,
+	.create       = sprite_create,
+	.destroy      = sprite_destroy,
+	.get_width    = cover_get_width,
+	.get_height   = cover_get_height,
+	.video_render = cover_render,
+	.is_opaque    = cover_is_opaque,
+};
+
+/* ------------------------------------------------------------------------- */
+
+static const char *filter_get_name(void *type_data)
+{
+	UNUSED_PARAMETER(type_data);
+	return "bench_texrender_filter";
+}
+
+static void *filter_create(obs_data_t *settings, obs_source_t *source)
+{
+	UNUSED_PARAMETER(settings);
+	return source;
+}
+
+static void filter_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static void filter_render(void *data, gs_effect_t *effect)
+{
+	obs_source_t *filter = data;
+
+	if (!obs_source_process_filter_begin(filter, GS_RGBA,
+				OBS_NO_DIRECT_RENDERING))
+		return;
+
+	obs_source_process_filter_end(filter,
+			obs_get_base_effect(OBS_EFFECT_DEFAULT), 0, 0);
+
+	UNUSED_PARAMETER(effect);
+}
+
+static struct obs_source_info texrender_filter_info = {
+	.id           = "bench_texrender_filter",
+	.type         = OBS_SOURCE_TYPE_FILTER,
+	.output_flags = OBS_SOURCE_VIDEO,
+	.get_name     = filter_get_name,
+	.create       = filter_create,
+	.destroy      = filter_destroy,
+	.video_render = filter_render,
+};
+
+/* ------------------------------------------------------------------------- */
+
+struct render_data {
+	gs_texture_t  *target;
+};
+
+static void render_main_view(void *param, size_t iterations)
+{
+	struct render_data *rd = param;
+
+	obs_enter_graphics();
+	gs_set_render_target(rd->target, NULL);
+	gs_set_viewport(0, 0, BASE_WIDTH, BASE_HEIGHT);
+	gs_ortho(0.0f, (float)BASE_WIDTH, 0.0f, (float)BASE_HEIGHT,
+			-100.0f, 100.0f);
+
+	for (size_t i = 0; i < iterations; i++) {
+		gs_begin_scene();
+		obs_render_main_view();
+		gs_end_scene();
+	}
+
+	gs_set_render_target(NULL, NULL);
+	obs_leave_graphics();
+}
+
+static void texrender_churn(void *param, size_t iterations)
+{
+	gs_texrender_t *texrender;
+	struct vec4 clear_color;
+
+	vec4_zero(&clear_color);
+
+	obs_enter_graphics();
+	texrender = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+
+	for (size_t i = 0; i < iterations; i++) {
+		gs_texrender_reset(texrender);
+		if (gs_texrender_begin(texrender, SPRITE_SIZE, SPRITE_SIZE)) {
+			gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+			gs_texrender_end(texrender);
+		}
+	}
+
+	gs_texrender_destroy(texrender);
+	obs_leave_graphics();
+
+	UNUSED_PARAMETER(param);
+}
+
+static void texrender_resize(void *param, size_t iterations)
+{
+	gs_texrender_t *texrenders[NUM_RESIZED];
+	struct vec4 clear_color;
+
+	vec4_zero(&clear_color);
+
+	obs_enter_graphics();
+	for (size_t i = 0; i < NUM_RESIZED; i++)
+		texrenders[i] = gs_texrender_create_transient(GS_RGBA,
+				GS_ZS_NONE);
+
+	for (size_t i = 0; i < iterations; i++) {
+		for (size_t j = 0; j < NUM_RESIZED; j++) {
+			uint32_t size = SPRITE_SIZE << ((i + j) % 3);
+
+			gs_texrender_reset(texrenders[j]);
+			if (gs_texrender_begin(texrenders[j], size, size)) {
+				gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+				gs_texrender_end(texrenders[j]);
+			}
+		}
+	}
+
+	for (size_t i = 0; i < NUM_RESIZED; i++)
+		gs_texrender_destroy(texrenders[i]);
+	obs_leave_graphics();
+
+	UNUSED_PARAMETER(param);
+}
+
+static void bench_texrender_pool(void)
+{
+	struct gs_texrender_pool_stats before, stats;
+
+	obs_enter_graphics();
+	gs_texrender_pool_get_stats(&before);
+	obs_leave_graphics();
+
+	bench_run("render", "texrender resize, 8 transient", texrender_resize,
+			NULL, 1000);
+
+	obs_enter_graphics();
+	gs_texrender_pool_get_stats(&stats);
+	obs_leave_graphics();
+
+	bench_note("%-44s pool hits %llu, misses %llu, %llu bytes held",
+			"texrender resize, 8 transient",
+			(unsigned long long)(stats.hits - before.hits),
+			(unsigned long long)(stats.misses - before.misses),
+			(unsigned long long)stats.bytes_held);
+}
+
+static void matrix_stack(void *param, size_t iterations)
+{
+	obs_enter_graphics();
+
+	for (size_t i = 0; i < iterations; i++) {
+		gs_matrix_push();
+		gs_matrix_translate3f((float)i, 1.0f, 0.0f);
+		gs_matrix_scale3f(2.0f, 2.0f, 1.0f);
+		gs_matrix_rotaa4f(0.0f, 0.0f, 1.0f, 0.5f);
+		gs_matrix_pop();
+	}
+
+	obs_leave_graphics();
+
+	UNUSED_PARAMETER(param);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static obs_scene_t *create_scene(const char *id, size_t num_sprites,
+		bool filtered)
+{
+	obs_scene_t *scene = obs_scene_create("bench scene");
+	size_t per_row = BASE_WIDTH / SPRITE_SIZE;
+
+	for (size_t i = 0; i < num_sprites; i++) {
+		obs_source_t *source = obs_source_create(id, "sprite", NULL,
+				NULL);
+		obs_sceneitem_t *item = obs_scene_add(scene, source);
+		struct vec2 pos;
+
+		vec2_set(&pos, (float)(i % per_row * SPRITE_SIZE),
+				(float)(i / per_row % (BASE_HEIGHT / SPRITE_SIZE) *
+					SPRITE_SIZE));
+		obs_sceneitem_set_pos(item, &pos);
+
+		if (filtered) {
+			obs_source_t *filter = obs_source_create_private(
+					"bench_texrender_filter", "filter",
+					NULL);
+			obs_source_filter_add(source, filter);
+			obs_source_release(filter);
+		}
+
+		obs_source_release(source);
+	}
+
+	return scene;
+}
+
+static void add_culled_items(obs_scene_t *scene, size_t num_sprites)
+{
+	obs_source_t *cover;
+
+	for (size_t i = 0; i < num_sprites; i++) {
+		obs_source_t *source = obs_source_create("bench_sprite_source",
+				"offscreen sprite", NULL, NULL);
+		obs_sceneitem_t *item = obs_scene_add(scene, source);
+		struct vec2 pos;
+
+		vec2_set(&pos, (float)(i * SPRITE_SIZE),
+				(float)(BASE_HEIGHT + SPRITE_SIZE));
+		obs_sceneitem_set_pos(item, &pos);
+		obs_source_release(source);
+	}
+
+	cover = obs_source_create("bench_cover_source", "cover", NULL, NULL);
+	obs_scene_add(scene, cover);
+	obs_source_release(cover);
+}
+
+static void bench_scene(struct render_data *rd, size_t num_sprites,
+		bool filtered, bool culled)
+{
+	obs_scene_t *scene = create_scene("bench_sprite_source", num_sprites,
+			filtered);
+	char name[64];
+
+	if (culled)
+		add_culled_items(scene, num_sprites);
+
+	obs_set_output_source(0, obs_scene_get_source(scene));
+
+	snprintf(name, sizeof(name), "main view, %d %s%s",
+			(int)num_sprites,
+			filtered ? "filtered sprites" : "sprites",
+			culled ? ", culled" : "");
+	bench_run("render", name, render_main_view, rd, 100);
+
+	/* let the video thread render the scene to get the frame time of the
+	 * whole pipeline, output conversion included */
+	os_sleep_ms(1000);
+	bench_note("%-44s video thread average frame time %.1f us", name,
+			(double)obs_get_average_frame_time_ns() / 1000.0);
+	if (culled)
+		bench_note("%-44s %u items culled in the last frame", name,
+				obs_get_culled_items());
+
+	obs_set_output_source(0, NULL);
+	obs_scene_release(scene);
+}
+
+static void note_frame_time(const char *name, bool cache)
+{
+	obs_set_render_cache_enabled(cache);
+	os_sleep_ms(1000);
+	bench_note("%-44s video thread average frame time %.1f us "
+			"(render cache %s)", name,
+			(double)obs_get_average_frame_time_ns() / 1000.0,
+			cache ? "on" : "off");
+}
+
+static void bench_overlay(struct render_data *rd)
+{
+	obs_scene_t *overlay = create_scene("bench_sprite_source",
+			OVERLAY_ITEMS, true);
+	obs_scene_t *scene = obs_scene_create("bench layout");
+	const char *name = "main view, overlay scene shown 8 times";
+
+	for (size_t i = 0; i < OVERLAY_USES; i++) {
+		obs_sceneitem_t *item = obs_scene_add(scene,
+				obs_scene_get_source(overlay));
+		struct vec2 pos, scale;
+
+		vec2_set(&pos, (float)(i % 4 * BASE_WIDTH / 4),
+				(float)(i / 4 * BASE_HEIGHT / 2));
+		vec2_set(&scale, 0.25f, 0.5f);
+		obs_sceneitem_set_pos(item, &pos);
+		obs_sceneitem_set_scale(item, &scale);
+	}
+
+	obs_set_output_source(0, obs_scene_get_source(scene));
+
+	bench_run("render", name, render_main_view, rd, 100);
+	note_frame_time(name, false);
+	note_frame_time(name, true);
+	obs_set_render_cache_enabled(false);
+
+	obs_set_output_source(0, NULL);
+	obs_scene_release(scene);
+	obs_scene_release(overlay);
+}
+
+static void set_sprite_batching(bool enable)
+{
+	obs_enter_graphics();
+	gs_enable_sprite_batching(enable);
+	obs_leave_graphics();
+}
+
+static uint64_t count_draw_calls(struct render_data *rd)
+{
+	struct gs_draw_stats before, after;
+
+	obs_enter_graphics();
+	gs_get_draw_stats(&before);
+	render_main_view(rd, 1);
+	gs_get_draw_stats(&after);
+	obs_leave_graphics();
+
+	return after.draw_calls - before.draw_calls;
+}
+
+static void bench_shared_sprites(struct render_data *rd, size_t num_sprites)
+{
+	obs_scene_t *scene = create_scene("bench_shared_sprite_source",
+			num_sprites, false);
+	char name[64];
+
+	obs_set_output_source(0, obs_scene_get_source(scene));
+
+	for (int batching = 0; batching < 2; batching++) {
+		set_sprite_batching(batching != 0);
+
+		snprintf(name, sizeof(name), "main view, %d shared sprites%s",
+				(int)num_sprites,
+				batching ? ", batched" : "");
+		bench_run("render", name, render_main_view, rd, 100);
+		bench_note("%-44s %llu draw calls", name,
+				(unsigned long long)count_draw_calls(rd));
+	}
+
+	obs_set_output_source(0, NULL);
+	obs_scene_release(scene);
+}
+
+static void draw_shared_sprites(size_t count)
+{
+	gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+	gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
+
+	for (size_t i = 0; i < count; i++) {
+		gs_matrix_push();
+		gs_matrix_translate3f((float)(i * SPRITE_SIZE), 0.0f, 0.0f);
+
+		while (gs_effect_loop(effect, "Draw")) {
+			gs_effect_set_texture(image, shared_tex);
+			gs_draw_sprite(shared_tex, 0, 0, 0);
+		}
+
+		gs_matrix_pop();
+	}
+}
+
+/* creating a resource can change the bindings of the graphics API (GL binds
+ * and unbinds the new texture), so pending sprites must be drawn first */
+static bool batch_flushed_by(const char *what, gs_texture_t *(*create)(void))
+{
+	struct gs_draw_stats before, pending, after;
+	gs_texture_t *tex;
+
+	gs_get_draw_stats(&before);
+	draw_shared_sprites(4);
+	gs_get_draw_stats(&pending);
+
+	tex = create();
+	gs_get_draw_stats(&after);
+	gs_texture_destroy(tex);
+
+	if (pending.draw_calls != before.draw_calls ||
+	    after.draw_calls != before.draw_calls + 1 ||
+	    after.batched_sprites != before.batched_sprites + 4) {
+		bench_error("render: Sprite batch was not flushed by %s", what);
+		return false;
+	}
+
+	return true;
+}
+
+static gs_texture_t *create_plain_texture(void)
+{
+	return gs_texture_create(SPRITE_SIZE, SPRITE_SIZE, GS_RGBA, 1, NULL,
+			0);
+}
+
+static gs_texrender_t *miss_texrender = NULL;
+
+/* a size nothing else uses, so the pool has to create a new target */
+static gs_texture_t *begin_texrender_miss(void)
+{
+	struct gs_texrender_pool_stats before, after;
+
+	gs_texrender_pool_get_stats(&before);
+	gs_texrender_begin(miss_texrender, 3, 5);
+	gs_texrender_pool_get_stats(&after);
+	gs_texrender_end(miss_texrender);
+
+	if (after.misses != before.misses + 1)
+		bench_error("render: Expected a texrender pool miss");
+
+	return NULL;
+}
+
+static void check_batch_flush(struct render_data *rd)
+{
+	struct vec4 clear_color;
+	bool batching;
+
+	vec4_zero(&clear_color);
+
+	obs_enter_graphics();
+	batching = gs_sprite_batching_enabled();
+	gs_enable_sprite_batching(true);
+	miss_texrender = gs_texrender_create_transient(GS_RGBA, GS_ZS_NONE);
+
+	gs_set_render_target(rd->target, NULL);
+	gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+
+	if (batch_flushed_by("gs_texture_create", create_plain_texture))
+		batch_flushed_by("a texrender pool miss",
+				begin_texrender_miss);
+
+	gs_set_render_target(NULL, NULL);
+	gs_texrender_destroy(miss_texrender);
+	miss_texrender = NULL;
+	gs_enable_sprite_batching(batching);
+	obs_leave_graphics();
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* adapter of the null graphics module that does pixel work */
+#define NULL_ADAPTER_SOFTWARE 1
+
+#define CHECK_COLOR_TOLERANCE 2
+
+static obs_scene_t *create_check_overlay(void)
+{
+	obs_scene_t *overlay = obs_scene_create("cache check overlay");
+
+	for (size_t i = 0; i < 2; i++) {
+		obs_source_t *source = obs_source_create(
+				"bench_shared_sprite_source", "sprite", NULL,
+				NULL);
+		obs_scene_add(overlay, source);
+		obs_source_release(source);
+	}
+
+	return overlay;
+}
+
+static bool render_check_pixel(gs_texture_t *target, gs_stagesurf_t *stage,
+		bool cache, uint8_t *pixel)
+{
+	struct gs_texrender_pool_stats before, after;
+	struct vec4 clear_color;
+	uint32_t linesize;
+	uint8_t *data;
+	bool cached;
+
+	obs_set_render_cache_enabled(cache);
+
+	/* let the video thread tick a few frames so the render counts of the
+	 * previous frame are up to date */
+	os_sleep_ms(100);
+
+	vec4_set(&clear_color, 0.0f, 0.0f, 0.0f, 1.0f);
+
+	obs_enter_graphics();
+	gs_texrender_pool_get_stats(&before);
+
+	gs_set_render_target(target, NULL);
+	gs_set_viewport(0, 0, SPRITE_SIZE, SPRITE_SIZE);
+	gs_ortho(0.0f, (float)SPRITE_SIZE, 0.0f, (float)SPRITE_SIZE,
+			-100.0f, 100.0f);
+	gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+
+	gs_begin_scene();
+	obs_render_main_view();
+	gs_end_scene();
+
+	gs_set_render_target(NULL, NULL);
+	gs_texrender_pool_get_stats(&after);
+
+	gs_stage_texture(stage, target);
+	if (gs_stagesurface_map(stage, &data, &linesize)) {
+		memcpy(pixel, data, 4);
+		gs_stagesurface_unmap(stage);
+	}
+	obs_leave_graphics();
+
+	/* the cache renders to a pooled texrender */
+	cached = after.hits + after.misses != before.hits + before.misses;
+	if (cached != cache) {
+		bench_error("render: Render cache was %s", cached ?
+				"used while disabled" : "not used");
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Checks that a semi-transparent scene drawn twice looks the same with and
+ * without the render cache.  Each draw of the software null adapter blends
+ * the first pixel of its target, so the result only depends on the blend
+ * states.
+ */
+static void check_render_cache(void)
+{
+	struct obs_video_info ovi = {0};
+	obs_scene_t *overlay, *scene;
+	gs_texture_t *target;
+	gs_stagesurf_t *stage;
+	uint8_t *sprite_data;
+	uint8_t uncached[4] = {0}, cached[4] = {0};
+
+	if (!obs_startup("en-US", NULL, NULL)) {
+		bench_error("render: Failed to start up libobs");
+		return;
+	}
+
+	ovi.graphics_module = "libobs-null";
+	ovi.adapter         = NULL_ADAPTER_SOFTWARE;
+	ovi.fps_num         = 60;
+	ovi.fps_den         = 1;
+	ovi.base_width      = SPRITE_SIZE;
+	ovi.base_height     = SPRITE_SIZE;
+	ovi.output_width    = SPRITE_SIZE;
+	ovi.output_height   = SPRITE_SIZE;
+	ovi.output_format   = VIDEO_FORMAT_NV12;
+	ovi.gpu_conversion  = true;
+	ovi.colorspace      = VIDEO_CS_709;
+	ovi.range           = VIDEO_RANGE_PARTIAL;
+	ovi.scale_type      = OBS_SCALE_BICUBIC;
+
+	if (obs_reset_video(&ovi) != OBS_VIDEO_SUCCESS) {
+		bench_error("render: Failed to reset video with the software "
+				"null adapter");
+		obs_shutdown();
+		return;
+	}
+
+	obs_register_source(&shared_sprite_source_info);
+
+	/* half transparent red */
+	sprite_data = bmalloc(SPRITE_SIZE * SPRITE_SIZE * 4);
+	for (size_t i = 0; i < SPRITE_SIZE * SPRITE_SIZE; i++) {
+		sprite_data[i * 4 + 0] = 255;
+		sprite_data[i * 4 + 1] = 0;
+		sprite_data[i * 4 + 2] = 0;
+		sprite_data[i * 4 + 3] = 128;
+	}
+
+	obs_enter_graphics();
+	shared_tex = gs_texture_create(SPRITE_SIZE, SPRITE_SIZE, GS_RGBA, 1,
+			(const uint8_t**)&sprite_data, 0);
+	target = gs_texture_create(SPRITE_SIZE, SPRITE_SIZE, GS_RGBA, 1, NULL,
+			GS_RENDER_TARGET);
+	stage = gs_stagesurface_create(SPRITE_SIZE, SPRITE_SIZE, GS_RGBA);
+	obs_leave_graphics();
+	bfree(sprite_data);
+
+	overlay = create_check_overlay();
+	scene = obs_scene_create("cache check");
+	obs_scene_add(scene, obs_scene_get_source(overlay));
+	obs_scene_add(scene, obs_scene_get_source(overlay));
+	obs_set_output_source(0, obs_scene_get_source(scene));
+
+	if (render_check_pixel(target, stage, false, uncached) &&
+	    render_check_pixel(target, stage, true, cached)) {
+		for (size_t i = 0; i < 4; i++) {
+			if (abs((int)cached[i] - (int)uncached[i]) <=
+					CHECK_COLOR_TOLERANCE)
+				continue;
+
+			bench_error("render: Cached scene output (%d, %d, %d, "
+					"%d) does not match uncached (%d, %d, "
+					"%d, %d)",
+					cached[0], cached[1], cached[2],
+					cached[3], uncached[0], uncached[1],
+					uncached[2], uncached[3]);
+			break;
+		}
+	}
+
+	obs_set_output_source(0, NULL);
+	obs_scene_release(scene);
+	obs_scene_release(overlay);
+
+	obs_enter_graphics();
+	gs_stagesurface_destroy(stage);
+	gs_texture_destroy(target);
+	gs_texture_destroy(shared_tex);
+	shared_tex = NULL;
+	obs_leave_graphics();
+
+	obs_shutdown();
+}
+
+void bench_render(void)
+{
+	struct obs_video_info ovi = {0};
+	struct render_data rd = {0};
+	int ret;
+
+	if (!obs_startup("en-US", NULL, NULL)) {
+		bench_error("render: Failed to start up libobs");
+		return;
+	}
+
+	ovi.graphics_module = "libobs-null";
+	ovi.fps_num         = 60;
+	ovi.fps_den         = 1;
+	ovi.base_width      = BASE_WIDTH;
+	ovi.base_height     = BASE_HEIGHT;
+	ovi.output_width    = BASE_WIDTH;
+	ovi.output_height   = BASE_HEIGHT;
+	ovi.output_format   = VIDEO_FORMAT_NV12;
+	ovi.gpu_conversion  = true;
+	ovi.colorspace      = VIDEO_CS_709;
+	ovi.range           = VIDEO_RANGE_PARTIAL;
+	ovi.scale_type      = OBS_SCALE_BICUBIC;
+
+	ret = obs_reset_video(&ovi);
+	if (ret != OBS_VIDEO_SUCCESS) {
+		bench_error("render: Failed to reset video with the null "
+				"graphics module (%d)", ret);
+		obs_shutdown();
+		return;
+	}
+
+	obs_register_source(&sprite_source_info);
+	obs_register_source(&shared_sprite_source_info);
+	obs_register_source(&cover_source_info);
+	obs_register_source(&texrender_filter_info);
+
+	obs_enter_graphics();
+	rd.target = gs_texture_create(BASE_WIDTH, BASE_HEIGHT, GS_RGBA, 1,
+			NULL, GS_RENDER_TARGET);
+	shared_tex = gs_texture_create(SPRITE_SIZE, SPRITE_SIZE, GS_RGBA, 1,
+			NULL, 0);
+	obs_leave_graphics();
+
+	obs_set_render_cache_enabled(false);
+
+	bench_run("render", "texrender reset/begin/end", texrender_churn,
+			NULL, 10000);
+	bench_texrender_pool();
+	check_batch_flush(&rd);
+	bench_run("render", "matrix push/transform/pop", matrix_stack,
+			NULL, 100000);
+
+	for (size_t i = 0; i < sizeof(scene_sizes) / sizeof(scene_sizes[0]);
+			i++) {
+		bench_scene(&rd, scene_sizes[i], false, false);
+		bench_scene(&rd, scene_sizes[i], true, false);
+		bench_scene(&rd, scene_sizes[i], true, true);
+		bench_shared_sprites(&rd, scene_sizes[i]);
+	}
+
+	bench_overlay(&rd);
+
+	obs_enter_graphics();
+	gs_texture_destroy(rd.target);
+	gs_texture_destroy(shared_tex);
+	shared_tex = NULL;
+	obs_leave_graphics();
+
+	obs_shutdown();
+
+	check_render_cache();
+}
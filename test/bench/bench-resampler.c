@@ -0,0 +1,115 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <string.h>
+#include <util/bmem.h>
+#include <media-io/audio-resampler.h>
+#include "bench.h"
+
+/*
+ * Resamples a second of audio in 1024 frame blocks, the way sources with a
+ * different sample rate or layout than the output are resampled.
+ */
+
+#define BLOCK_FRAMES 1024
+#define BLOCKS       47
+
+struct resampler_data {
+	audio_resampler_t *resampler;
+	float             *in[MAX_AV_PLANES];
+	size_t            channels;
+};
+
+static bool init_resampler_data(struct resampler_data *data,
+		uint32_t in_rate, enum speaker_layout in_speakers,
+		uint32_t out_rate, enum speaker_layout out_speakers)
+{
+	struct resample_info src = {
+		.samples_per_sec = in_rate,
+		.format          = AUDIO_FORMAT_FLOAT_PLANAR,
+		.speakers        = in_speakers
+	};
+	struct resample_info dst = {
+		.samples_per_sec = out_rate,
+		.format          = AUDIO_FORMAT_FLOAT_PLANAR,
+		.speakers        = out_speakers
+	};
+
+	data->resampler = audio_resampler_create(&dst, &src);
+	if (!data->resampler) {
+		bench_note("audio_resampler_create failed");
+		return false;
+	}
+
+	data->channels = get_audio_channels(in_speakers);
+	for (size_t i = 0; i < data->channels; i++) {
+		data->in[i] = bmalloc(BLOCK_FRAMES * sizeof(float));
+
+		for (size_t j = 0; j < BLOCK_FRAMES; j++)
+			data->in[i][j] = (float)((int)((j * 31 + i) % 200)
+					- 100) / 100.0f;
+	}
+
+	return true;
+}
+
+static void free_resampler_data(struct resampler_data *data)
+{
+	audio_resampler_destroy(data->resampler);
+	for (size_t i = 0; i < data->channels; i++)
+		bfree(data->in[i]);
+}
+
+static void run_resample(void *param, size_t iterations)
+{
+	struct resampler_data *data = param;
+	const uint8_t *in[MAX_AV_PLANES] = {0};
+	uint8_t *out[MAX_AV_PLANES];
+	uint32_t out_frames;
+	uint64_t ts_offset;
+
+	for (size_t i = 0; i < data->channels; i++)
+		in[i] = (const uint8_t*)data->in[i];
+
+	for (size_t i = 0; i < iterations; i++) {
+		for (size_t j = 0; j < BLOCKS; j++)
+			audio_resampler_resample(data->resampler, out,
+					&out_frames, &ts_offset, in,
+					BLOCK_FRAMES);
+	}
+}
+
+void bench_audio_resampler(void)
+{
+	struct resampler_data data = {0};
+
+	if (init_resampler_data(&data, 44100, SPEAKERS_STEREO,
+				48000, SPEAKERS_STEREO)) {
+		bench_run("audio_resampler", "44.1khz -> 48khz stereo (1 sec)",
+				run_resample, &data, 10);
+		free_resampler_data(&data);
+	}
+
+	memset(&data, 0, sizeof(data));
+
+	if (init_resampler_data(&data, 48000, SPEAKERS_5POINT1,
+				48000, SPEAKERS_STEREO)) {
+		bench_run("audio_resampler", "48khz 5.1 -> stereo (1 sec)",
+				run_resample, &data, 10);
+		free_resampler_data(&data);
+	}
+}
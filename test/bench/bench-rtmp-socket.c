@@ -0,0 +1,287 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "bench.h"
+
+#ifdef __linux__
+#include "rtmp-stream.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+/*
+ * Runs the Linux RTMP socket thread against a loopback TCP sink.  The data is
+ * queued into the write buffer the same way socket_queue_data does, paced
+ * like encoder packets, while the sink stalls for a while before reading so
+ * the socket fills up.  The sink checks that every byte arrives in order.
+ *
+ * Low latency mode is used so that each send is much smaller than the write
+ * buffer, which then still has room while the socket is full.  Queuing must
+ * not wait long on the write buffer mutex in that case, which means the
+ * socket thread must not hold it while blocked on a full socket.
+ *
+ * This exercises the socket loop only; there is no RTMP handshake, as the
+ * loop just forwards whatever librtmp has written into the buffer.
+ */
+
+#define WRITE_BUF_SIZE   131072
+#define CHUNK_SIZE       4096
+#define TOTAL_SIZE       (4 * 1024 * 1024)
+#define SOCKET_BUF_SIZE  65536
+#define SINK_STALL_MS    500
+#define MAX_LOCK_WAIT_MS 100
+
+struct sink_data {
+	int               sock;
+	size_t            received;
+	size_t            mismatches;
+};
+
+static inline uint8_t pattern_byte(size_t offset)
+{
+	return (uint8_t)(offset * 7 + (offset >> 12));
+}
+
+static void *sink_thread(void *param)
+{
+	struct sink_data *sink = param;
+	uint8_t buf[16384];
+
+	os_sleep_ms(SINK_STALL_MS);
+
+	for (;;) {
+		ssize_t ret = recv(sink->sock, buf, sizeof(buf), 0);
+		if (ret <= 0)
+			break;
+
+		for (ssize_t i = 0; i < ret; i++) {
+			if (buf[i] != pattern_byte(sink->received + i))
+				sink->mismatches++;
+		}
+		sink->received += (size_t)ret;
+	}
+
+	return NULL;
+}
+
+static bool connect_loopback(int *client, int *server)
+{
+	struct sockaddr_in addr = {0};
+	socklen_t addr_len = sizeof(addr);
+	int buf_size = SOCKET_BUF_SIZE;
+	int on = 1;
+	int listener;
+
+	listener = socket(AF_INET, SOCK_STREAM, 0);
+	if (listener == -1)
+		return false;
+
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	/* small socket buffers so that the stall actually fills the socket;
+	 * set before connecting so that the window is sized to match */
+	setsockopt(listener, SOL_SOCKET, SO_RCVBUF, &buf_size,
+			sizeof(buf_size));
+
+	if (bind(listener, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+	    getsockname(listener, (struct sockaddr*)&addr, &addr_len) != 0 ||
+	    listen(listener, 1) != 0)
+		goto fail;
+
+	/* blocking with TCP_NODELAY, like librtmp's socket */
+	*client = socket(AF_INET, SOCK_STREAM, 0);
+	if (*client == -1)
+		goto fail;
+
+	setsockopt(*client, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+	setsockopt(*client, SOL_SOCKET, SO_SNDBUF, &buf_size,
+			sizeof(buf_size));
+
+	if (connect(*client, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+		close(*client);
+		goto fail;
+	}
+
+	*server = accept(listener, NULL, NULL);
+	if (*server == -1) {
+		close(*client);
+		goto fail;
+	}
+
+	close(listener);
+	return true;
+
+fail:
+	close(listener);
+	return false;
+}
+
+static bool init_stream(struct rtmp_stream *stream, int sock)
+{
+	pthread_mutex_init_value(&stream->write_buf_mutex);
+
+	stream->rtmp.m_sb.sb_socket = sock;
+	stream->low_latency_mode = true;
+	stream->write_buf_size = WRITE_BUF_SIZE;
+	stream->write_buf = bmalloc(WRITE_BUF_SIZE);
+	stream->socket_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	return stream->socket_wake_fd != -1 &&
+		pthread_mutex_init(&stream->write_buf_mutex, NULL) == 0 &&
+		os_event_init(&stream->stop_event,
+			OS_EVENT_TYPE_MANUAL) == 0 &&
+		os_event_init(&stream->buffer_space_available_event,
+			OS_EVENT_TYPE_AUTO) == 0 &&
+		os_event_init(&stream->send_thread_signaled_exit,
+			OS_EVENT_TYPE_MANUAL) == 0;
+}
+
+static void free_stream(struct rtmp_stream *stream)
+{
+	if (stream->socket_wake_fd != -1)
+		close(stream->socket_wake_fd);
+	if (stream->rtmp.m_sb.sb_socket != -1)
+		close(stream->rtmp.m_sb.sb_socket);
+
+	os_event_destroy(stream->stop_event);
+	os_event_destroy(stream->buffer_space_available_event);
+	os_event_destroy(stream->send_thread_signaled_exit);
+	pthread_mutex_destroy(&stream->write_buf_mutex);
+	bfree(stream->write_buf);
+}
+
+/* same as socket_queue_data in rtmp-stream.c, but records how long it waits
+ * for the write buffer mutex */
+static bool queue_data(struct rtmp_stream *stream, const uint8_t *data,
+		size_t len, uint64_t *max_lock_wait)
+{
+	for (;;) {
+		uint64_t start = os_gettime_ns();
+		uint64_t wait;
+
+		pthread_mutex_lock(&stream->write_buf_mutex);
+
+		wait = os_gettime_ns() - start;
+		if (wait > *max_lock_wait)
+			*max_lock_wait = wait;
+
+		if (stream->rtmp.m_sb.sb_socket == -1) {
+			pthread_mutex_unlock(&stream->write_buf_mutex);
+			return false;
+		}
+
+		if (stream->write_buf_len + len <= stream->write_buf_size)
+			break;
+
+		pthread_mutex_unlock(&stream->write_buf_mutex);
+		os_event_wait(stream->buffer_space_available_event);
+	}
+
+	memcpy(stream->write_buf + stream->write_buf_len, data, len);
+	stream->write_buf_len += len;
+
+	pthread_mutex_unlock(&stream->write_buf_mutex);
+
+	eventfd_write(stream->socket_wake_fd, 1);
+	return true;
+}
+
+void bench_rtmp_socket(void)
+{
+	struct rtmp_stream *stream = bzalloc(sizeof(struct rtmp_stream));
+	struct sink_data sink = {0};
+	pthread_t sink_thr, socket_thr;
+	uint8_t chunk[CHUNK_SIZE];
+	uint64_t max_lock_wait = 0;
+	uint64_t start, elapsed;
+	int client;
+
+	stream->rtmp.m_sb.sb_socket = -1;
+	stream->socket_wake_fd = -1;
+
+	if (!connect_loopback(&client, &sink.sock)) {
+		bench_error("rtmp_socket: Failed to connect loopback sink, "
+				"errno %d", errno);
+		bfree(stream);
+		return;
+	}
+
+	if (!init_stream(stream, client)) {
+		bench_error("rtmp_socket: Failed to initialize stream");
+		close(client);
+		close(sink.sock);
+		free_stream(stream);
+		bfree(stream);
+		return;
+	}
+
+	pthread_create(&sink_thr, NULL, sink_thread, &sink);
+	pthread_create(&socket_thr, NULL, socket_thread_linux, stream);
+
+	start = os_gettime_ns();
+
+	for (size_t offset = 0; offset < TOTAL_SIZE; offset += CHUNK_SIZE) {
+		for (size_t i = 0; i < CHUNK_SIZE; i++)
+			chunk[i] = pattern_byte(offset + i);
+
+		if (!queue_data(stream, chunk, CHUNK_SIZE, &max_lock_wait))
+			break;
+
+		os_sleep_ms(1);
+	}
+
+	os_event_signal(stream->send_thread_signaled_exit);
+	eventfd_write(stream->socket_wake_fd, 1);
+	pthread_join(socket_thr, NULL);
+
+	if (stream->rtmp.m_sb.sb_socket != -1)
+		shutdown(stream->rtmp.m_sb.sb_socket, SHUT_WR);
+	pthread_join(sink_thr, NULL);
+
+	elapsed = os_gettime_ns() - start;
+
+	if (sink.received != TOTAL_SIZE || sink.mismatches)
+		bench_error("rtmp_socket: Sink received %zu of %d bytes, "
+				"%zu mismatched", sink.received, TOTAL_SIZE,
+				sink.mismatches);
+
+	if (max_lock_wait > MAX_LOCK_WAIT_MS * 1000000ULL)
+		bench_error("rtmp_socket: Queuing waited %.1f ms for the "
+				"write buffer mutex",
+				(double)max_lock_wait / 1000000.0);
+
+	bench_note("%d MB through loopback sink in %.1f ms (%d ms stall), "
+			"max write buffer lock wait %.3f ms",
+			TOTAL_SIZE / (1024 * 1024),
+			(double)elapsed / 1000000.0, SINK_STALL_MS,
+			(double)max_lock_wait / 1000000.0);
+
+	close(sink.sock);
+	free_stream(stream);
+	bfree(stream);
+}
+
+#else
+
+void bench_rtmp_socket(void)
+{
+	bench_note("rtmp_socket: Only implemented for the Linux socket loop");
+}
+
+#endif
@@ -0,0 +1,287 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <callback/calldata.h>
+#include <callback/signal.h>
+#include "bench.h"
+
+/*
+ * Signals are emitted for nearly every source state change, often with a
+ * few handlers connected.  Calldata is built on the stack for each call the
+ * same way libobs does it.
+ */
+
+#define NUM_HANDLERS 4
+
+static const char *signals[] = {
+	"void update(ptr source)",
+	"void volume(in out ptr source, in out float volume)",
+	"void rename(ptr source, string new_name, string prev_name)",
+	NULL
+};
+
+static volatile long long sink;
+
+static void volume_handler(void *param, calldata_t *data)
+{
+	double volume = calldata_float(data, "volume");
+	calldata_set_float(data, "volume", volume * 0.5);
+	UNUSED_PARAMETER(param);
+}
+
+static void update_handler(void *param, calldata_t *data)
+{
+	sink += (long long)(uintptr_t)calldata_ptr(data, "source");
+	UNUSED_PARAMETER(param);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Dispatch across many sources */
+
+#define NUM_SOURCES 200
+
+/* same declarations as a source's signal handler */
+static const char *source_signals[] = {
+	"void destroy(ptr source)",
+	"void remove(ptr source)",
+	"void save(ptr source)",
+	"void load(ptr source)",
+	"void activate(ptr source)",
+	"void deactivate(ptr source)",
+	"void show(ptr source)",
+	"void hide(ptr source)",
+	"void mute(ptr source, bool muted)",
+	"void push_to_mute_changed(ptr source, bool enabled)",
+	"void push_to_mute_delay(ptr source, int delay)",
+	"void push_to_talk_changed(ptr source, bool enabled)",
+	"void push_to_talk_delay(ptr source, int delay)",
+	"void enable(ptr source, bool enabled)",
+	"void rename(ptr source, string new_name, string prev_name)",
+	"void volume(ptr source, in out float volume)",
+	"void update_properties(ptr source)",
+	"void update_flags(ptr source, int flags)",
+	"void audio_sync(ptr source, int out int offset)",
+	"void audio_mixers(ptr source, in out int mixers)",
+	"void filter_add(ptr source, ptr filter)",
+	"void filter_remove(ptr source, ptr filter)",
+	"void reorder_filters(ptr source)",
+	"void transition_start(ptr source)",
+	"void transition_video_stop(ptr source)",
+	"void transition_stop(ptr source)",
+	NULL
+};
+
+struct source_signals {
+	signal_handler_t *handler;
+	signal_handle_t  *volume;
+	signal_handle_t  *update_flags;
+};
+
+static void source_volume_handler(void *param, calldata_t *data)
+{
+	sink += (long long)calldata_float(data, "volume");
+	sink += (long long)(uintptr_t)calldata_ptr(data, "source");
+	UNUSED_PARAMETER(param);
+}
+
+static void source_volume_handler_key(void *param, calldata_t *data)
+{
+	static calldata_key_t volume_key = CALLDATA_KEY("volume");
+	static calldata_key_t source_key = CALLDATA_KEY("source");
+
+	sink += (long long)calldata_float_key(data, &volume_key);
+	sink += (long long)(uintptr_t)calldata_ptr_key(data, &source_key);
+	UNUSED_PARAMETER(param);
+}
+
+/* the volume signal has a fader and a volume meter connected, like a mixer
+ * entry in the frontend, while update_flags has nothing connected */
+static void run_sources_by_name(void *param, size_t iterations)
+{
+	struct source_signals *sources = param;
+	struct calldata data;
+	uint8_t stack[128];
+
+	for (size_t i = 0; i < iterations; i++) {
+		for (size_t j = 0; j < NUM_SOURCES; j++) {
+			signal_handler_t *handler = sources[j].handler;
+
+			calldata_init_fixed(&data, stack, sizeof(stack));
+			calldata_set_ptr(&data, "source", handler);
+			calldata_set_float(&data, "volume", 1.0);
+			signal_handler_signal(handler, "volume", &data);
+
+			calldata_init_fixed(&data, stack, sizeof(stack));
+			calldata_set_ptr(&data, "source", handler);
+			calldata_set_int(&data, "flags", 0);
+			signal_handler_signal(handler, "update_flags", &data);
+		}
+	}
+}
+
+static void run_sources_by_handle(void *param, size_t iterations)
+{
+	struct source_signals *sources = param;
+	struct calldata data;
+	uint8_t stack[128];
+
+	for (size_t i = 0; i < iterations; i++) {
+		for (size_t j = 0; j < NUM_SOURCES; j++) {
+			signal_handler_t *handler = sources[j].handler;
+
+			calldata_init_fixed(&data, stack, sizeof(stack));
+			calldata_set_ptr(&data, "source", handler);
+			calldata_set_float(&data, "volume", 1.0);
+			signal_handle_signal(sources[j].volume, &data);
+
+			calldata_init_fixed(&data, stack, sizeof(stack));
+			calldata_set_ptr(&data, "source", handler);
+			calldata_set_int(&data, "flags", 0);
+			signal_handle_signal(sources[j].update_flags, &data);
+		}
+	}
+}
+
+static void bench_signal_sources(void)
+{
+	struct source_signals sources[NUM_SOURCES];
+
+	for (size_t i = 0; i < NUM_SOURCES; i++) {
+		signal_handler_t *handler = signal_handler_create();
+
+		signal_handler_add_array(handler, source_signals);
+		sources[i].handler = handler;
+		sources[i].volume = signal_handler_get_handle(handler,
+				"volume");
+		sources[i].update_flags = signal_handler_get_handle(handler,
+				"update_flags");
+	}
+
+	for (size_t i = 0; i < NUM_SOURCES; i++)
+		for (size_t j = 0; j < 2; j++)
+			signal_handler_connect(sources[i].handler, "volume",
+					source_volume_handler,
+					(void*)(uintptr_t)j);
+
+	bench_run("signal", "200 sources, by name",
+			run_sources_by_name, sources, 2000);
+
+	for (size_t i = 0; i < NUM_SOURCES; i++) {
+		for (size_t j = 0; j < 2; j++) {
+			signal_handler_disconnect(sources[i].handler, "volume",
+					source_volume_handler,
+					(void*)(uintptr_t)j);
+			signal_handler_connect(sources[i].handler, "volume",
+					source_volume_handler_key,
+					(void*)(uintptr_t)j);
+		}
+	}
+
+	bench_run("signal", "200 sources, handles + keys",
+			run_sources_by_handle, sources, 2000);
+
+	for (size_t i = 0; i < NUM_SOURCES; i++)
+		signal_handler_destroy(sources[i].handler);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void run_calldata(void *param, size_t iterations)
+{
+	struct calldata data;
+	uint8_t stack[128];
+	long long total = 0;
+
+	for (size_t i = 0; i < iterations; i++) {
+		calldata_init_fixed(&data, stack, sizeof(stack));
+		calldata_set_ptr(&data, "source", param);
+		calldata_set_int(&data, "sec", (long long)i);
+		calldata_set_string(&data, "name", "source name");
+		total += calldata_int(&data, "sec");
+		total += (long long)(uintptr_t)calldata_ptr(&data, "source");
+	}
+
+	sink = total;
+}
+
+static void run_signal_volume(void *param, size_t iterations)
+{
+	signal_handler_t *handler = param;
+	struct calldata data;
+	uint8_t stack[128];
+
+	for (size_t i = 0; i < iterations; i++) {
+		calldata_init_fixed(&data, stack, sizeof(stack));
+		calldata_set_ptr(&data, "source", handler);
+		calldata_set_float(&data, "volume", 1.0);
+		signal_handler_signal(handler, "volume", &data);
+	}
+}
+
+static void run_signal_update(void *param, size_t iterations)
+{
+	signal_handler_t *handler = param;
+	struct calldata data;
+	uint8_t stack[128];
+
+	for (size_t i = 0; i < iterations; i++) {
+		calldata_init_fixed(&data, stack, sizeof(stack));
+		calldata_set_ptr(&data, "source", handler);
+		signal_handler_signal(handler, "update", &data);
+	}
+}
+
+static void run_signal_unconnected(void *param, size_t iterations)
+{
+	signal_handler_t *handler = param;
+	struct calldata data;
+	uint8_t stack[128];
+
+	for (size_t i = 0; i < iterations; i++) {
+		calldata_init_fixed(&data, stack, sizeof(stack));
+		calldata_set_ptr(&data, "source", handler);
+		calldata_set_string(&data, "new_name", "new");
+		calldata_set_string(&data, "prev_name", "old");
+		signal_handler_signal(handler, "rename", &data);
+	}
+}
+
+void bench_signal(void)
+{
+	signal_handler_t *handler = signal_handler_create();
+
+	signal_handler_add_array(handler, signals);
+	for (size_t i = 0; i < NUM_HANDLERS; i++) {
+		signal_handler_connect(handler, "volume", volume_handler,
+				(void*)(uintptr_t)i);
+		signal_handler_connect(handler, "update", update_handler,
+				(void*)(uintptr_t)i);
+	}
+
+	bench_run("signal", "calldata set/get (3 params)",
+			run_calldata, handler, 1000000);
+	bench_run("signal", "signal 4 handlers (volume)",
+			run_signal_volume, handler, 1000000);
+	bench_run("signal", "signal 4 handlers (update)",
+			run_signal_update, handler, 1000000);
+	bench_run("signal", "signal no handlers (rename)",
+			run_signal_unconnected, handler, 1000000);
+
+	signal_handler_destroy(handler);
+
+	bench_signal_sources();
+}
@@ -0,0 +1,102 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <util/bmem.h>
+#include <util/circlebuf.h>
+#include <util/darray.h>
+#include "bench.h"
+
+/*
+ * Exercises the containers used on the hot paths: circlebufs for audio and
+ * packet queues, darrays for everything else.
+ */
+
+#define AUDIO_BLOCK (1024 * sizeof(float))
+
+struct util_data {
+	struct circlebuf buf;
+	float            block[1024];
+	DARRAY(uint64_t) array;
+};
+
+static void run_circlebuf_audio(void *param, size_t iterations)
+{
+	struct util_data *data = param;
+
+	for (size_t i = 0; i < iterations; i++) {
+		circlebuf_push_back(&data->buf, data->block, AUDIO_BLOCK);
+		circlebuf_push_back(&data->buf, data->block, AUDIO_BLOCK);
+		circlebuf_pop_front(&data->buf, data->block, AUDIO_BLOCK);
+		circlebuf_pop_front(&data->buf, data->block, AUDIO_BLOCK);
+	}
+}
+
+static void run_circlebuf_small(void *param, size_t iterations)
+{
+	struct util_data *data = param;
+	uint64_t val = 0;
+
+	for (size_t i = 0; i < iterations; i++) {
+		circlebuf_push_back(&data->buf, &i, sizeof(i));
+		circlebuf_pop_front(&data->buf, &val, sizeof(val));
+	}
+}
+
+static void run_darray_push(void *param, size_t iterations)
+{
+	struct util_data *data = param;
+
+	for (size_t i = 0; i < iterations; i++) {
+		uint64_t val = i;
+		da_push_back(data->array, &val);
+	}
+
+	da_resize(data->array, 0);
+}
+
+static void run_darray_insert_erase(void *param, size_t iterations)
+{
+	struct util_data *data = param;
+
+	da_resize(data->array, 256);
+
+	for (size_t i = 0; i < iterations; i++) {
+		uint64_t val = i;
+		da_insert(data->array, i & 0xFF, &val);
+		da_erase(data->array, (i * 7) & 0xFF);
+	}
+}
+
+void bench_util(void)
+{
+	struct util_data data = {0};
+
+	circlebuf_init(&data.buf);
+	da_init(data.array);
+
+	bench_run_bytes("util", "circlebuf push/pop 4kb",
+			run_circlebuf_audio, &data, 100000, AUDIO_BLOCK * 2);
+	bench_run("util", "circlebuf push/pop 8 bytes",
+			run_circlebuf_small, &data, 1000000);
+	bench_run("util", "darray push_back",
+			run_darray_push, &data, 1000000);
+	bench_run("util", "darray insert/erase (256 items)",
+			run_darray_insert_erase, &data, 1000000);
+
+	circlebuf_free(&data.buf);
+	da_free(data.array);
+}
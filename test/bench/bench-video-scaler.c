@@ -0,0 +1,198 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <util/bmem.h>
+#include <media-io/video-scaler.h>
+#include "bench.h"
+
+/*
+ * Scales NV12 frames the way video output does when the output resolution
+ * differs from the canvas, and converts async NV12 source frames to I420.
+ * Sliced scalers are also checked against a single full-frame scale, as
+ * slices must not leave seams at their edges.
+ */
+
+#define NUM_SLICES 4
+
+struct scaler_data {
+	video_scaler_t *scaler;
+	uint8_t        *in[2];
+	uint32_t       in_linesize[2];
+	uint8_t        *out[3];
+	uint32_t       out_linesize[3];
+};
+
+static bool init_scaler_data(struct scaler_data *data,
+		uint32_t in_cx, uint32_t in_cy,
+		enum video_format out_format, uint32_t out_cx, uint32_t out_cy,
+		enum video_scale_type type, size_t max_slices)
+{
+	struct video_scale_info src = {
+		.format     = VIDEO_FORMAT_NV12,
+		.width      = in_cx,
+		.height     = in_cy,
+		.range      = VIDEO_RANGE_PARTIAL,
+		.colorspace = VIDEO_CS_709
+	};
+	struct video_scale_info dst = src;
+	int ret;
+
+	dst.format = out_format;
+	dst.width  = out_cx;
+	dst.height = out_cy;
+
+	ret = video_scaler_create_sliced(&data->scaler, &dst, &src, type,
+			max_slices);
+	if (ret != VIDEO_SCALER_SUCCESS) {
+		bench_note("video_scaler_create failed (%d)", ret);
+		return false;
+	}
+
+	data->in_linesize[0] = in_cx;
+	data->in_linesize[1] = in_cx;
+	data->in[0] = bmalloc(in_cx * in_cy);
+	data->in[1] = bmalloc(in_cx * in_cy / 2);
+
+	for (uint32_t i = 0; i < in_cx * in_cy; i++)
+		data->in[0][i] = (uint8_t)(i * 3);
+	for (uint32_t i = 0; i < in_cx * in_cy / 2; i++)
+		data->in[1][i] = (uint8_t)(i * 5);
+
+	data->out_linesize[0] = out_cx;
+	data->out_linesize[1] = out_cx;
+	data->out_linesize[2] = out_cx;
+	for (size_t i = 0; i < 3; i++)
+		data->out[i] = bzalloc(out_cx * out_cy);
+
+	return true;
+}
+
+static void free_scaler_data(struct scaler_data *data)
+{
+	video_scaler_destroy(data->scaler);
+	for (size_t i = 0; i < 2; i++)
+		bfree(data->in[i]);
+	for (size_t i = 0; i < 3; i++)
+		bfree(data->out[i]);
+}
+
+static void run_scale(void *param, size_t iterations)
+{
+	struct scaler_data *data = param;
+	const uint8_t *const in[] = {data->in[0], data->in[1]};
+
+	for (size_t i = 0; i < iterations; i++)
+		video_scaler_scale(data->scaler, data->out, data->out_linesize,
+				in, data->in_linesize);
+}
+
+/* when the scale factor isn't exact in fixed point (720p -> 1080p), a slice
+ * starts out in phase where the full frame has drifted slightly, which can
+ * change a noisy pixel by a couple of steps.  anything more is a seam. */
+#define MAX_SLICE_DIFF 2
+
+static void check_slices(const char *name,
+		uint32_t in_cx, uint32_t in_cy,
+		enum video_format out_format, uint32_t out_cx, uint32_t out_cy,
+		enum video_scale_type type)
+{
+	struct scaler_data full = {0};
+	struct scaler_data sliced = {0};
+	const uint8_t *in[2];
+	size_t slices;
+	int max_diff = 0;
+
+	if (!init_scaler_data(&full, in_cx, in_cy, out_format, out_cx, out_cy,
+				type, 1))
+		return;
+	if (!init_scaler_data(&sliced, in_cx, in_cy, out_format, out_cx,
+				out_cy, type, NUM_SLICES)) {
+		free_scaler_data(&full);
+		return;
+	}
+
+	in[0] = full.in[0];
+	in[1] = full.in[1];
+	video_scaler_scale(full.scaler, full.out, full.out_linesize,
+			in, full.in_linesize);
+	video_scaler_scale(sliced.scaler, sliced.out, sliced.out_linesize,
+			in, sliced.in_linesize);
+
+	for (size_t i = 0; i < 3; i++) {
+		for (uint32_t j = 0; j < out_cx * out_cy; j++) {
+			int diff = abs((int)full.out[i][j] -
+					(int)sliced.out[i][j]);
+			if (diff > max_diff)
+				max_diff = diff;
+		}
+	}
+
+	slices = video_scaler_get_slices(sliced.scaler);
+	if (max_diff > MAX_SLICE_DIFF)
+		bench_error("video_scaler: %s with %zu slices differs from "
+				"the full frame by up to %d", name, slices,
+				max_diff);
+	else
+		bench_note("%s: %zu slices match the full frame "
+				"(max diff %d)", name, slices, max_diff);
+
+	free_scaler_data(&full);
+	free_scaler_data(&sliced);
+}
+
+void bench_video_scaler(void)
+{
+	struct scaler_data data = {0};
+
+	if (init_scaler_data(&data, 1920, 1080, VIDEO_FORMAT_NV12, 1280, 720,
+				VIDEO_SCALE_BILINEAR, 1)) {
+		bench_run("video_scaler", "nv12 1080p -> nv12 720p bilinear",
+				run_scale, &data, 20);
+		free_scaler_data(&data);
+	}
+
+	memset(&data, 0, sizeof(data));
+
+	if (init_scaler_data(&data, 1920, 1080, VIDEO_FORMAT_NV12, 1280, 720,
+				VIDEO_SCALE_BILINEAR, NUM_SLICES)) {
+		bench_run("video_scaler",
+				"nv12 1080p -> nv12 720p bilinear sliced",
+				run_scale, &data, 20);
+		free_scaler_data(&data);
+	}
+
+	memset(&data, 0, sizeof(data));
+
+	if (init_scaler_data(&data, 1920, 1080, VIDEO_FORMAT_I420, 1920, 1080,
+				VIDEO_SCALE_BILINEAR, 1)) {
+		bench_run("video_scaler", "nv12 1080p -> i420 1080p",
+				run_scale, &data, 20);
+		free_scaler_data(&data);
+	}
+
+	check_slices("nv12 1080p -> nv12 720p bilinear",
+			1920, 1080, VIDEO_FORMAT_NV12, 1280, 720,
+			VIDEO_SCALE_BILINEAR);
+	check_slices("nv12 720p -> nv12 1080p bicubic",
+			1280, 720, VIDEO_FORMAT_NV12, 1920, 1080,
+			VIDEO_SCALE_BICUBIC);
+	check_slices("nv12 1080p -> i420 1080p",
+			1920, 1080, VIDEO_FORMAT_I420, 1920, 1080,
+			VIDEO_SCALE_BILINEAR);
+}
@@ -0,0 +1,298 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <util/bmem.h>
+#include <util/darray.h>
+#include <util/platform.h>
+#include <obs.h>
+#include "bench.h"
+
+#define DEFAULT_RUNS 5
+#define MAX_RUNS     101
+
+struct bench_group {
+	const char *name;
+	void       (*run)(void);
+};
+
+static const struct bench_group groups[] = {
+	{"interleave",        bench_interleave},
+	{"audio_mix",         bench_audio_mix},
+	{"audio_meter",       bench_audio_meter},
+	{"audio_dynamics",    bench_audio_dynamics},
+	{"audio_latency",     bench_audio_latency},
+	{"render",            bench_render},
+	{"format_conversion", bench_format_conversion},
+	{"video_scaler",      bench_video_scaler},
+	{"audio_resampler",   bench_audio_resampler},
+	{"util",              bench_util},
+	{"obs_data",          bench_obs_data},
+	{"signal",            bench_signal},
+	{"flv_mux",           bench_flv_mux},
+	{"rtmp_socket",       bench_rtmp_socket},
+};
+
+#define NUM_GROUPS (sizeof(groups) / sizeof(groups[0]))
+
+struct bench_result {
+	char     *group;
+	char     *name;
+	size_t   iterations;
+	size_t   bytes_per_iteration;
+	double   best_ns;
+	double   median_ns;
+};
+
+static DARRAY(struct bench_result) results;
+static bool json = false;
+static bool failed = false;
+static int runs = DEFAULT_RUNS;
+
+/* progress goes to stderr in JSON mode so stdout only contains the JSON */
+static inline FILE *text_out(void)
+{
+	return json ? stderr : stdout;
+}
+
+static int cmp_uint64(const void *a, const void *b)
+{
+	uint64_t val_a = *(const uint64_t*)a;
+	uint64_t val_b = *(const uint64_t*)b;
+	return val_a < val_b ? -1 : (val_a > val_b ? 1 : 0);
+}
+
+void bench_run_bytes(const char *group, const char *name,
+		bench_func_t func, void *param, size_t iterations,
+		size_t bytes_per_iteration)
+{
+	uint64_t times[MAX_RUNS];
+	struct bench_result *result;
+
+	/* warm up caches/pools before timing */
+	func(param, iterations);
+
+	for (int i = 0; i < runs; i++) {
+		uint64_t start = os_gettime_ns();
+		func(param, iterations);
+		times[i] = os_gettime_ns() - start;
+	}
+
+	qsort(times, runs, sizeof(uint64_t), cmp_uint64);
+
+	result = da_push_back_new(results);
+	result->group = bstrdup(group);
+	result->name = bstrdup(name);
+	result->iterations = iterations;
+	result->bytes_per_iteration = bytes_per_iteration;
+	result->best_ns = (double)times[0] / (double)iterations;
+	result->median_ns = (double)times[runs / 2] / (double)iterations;
+
+	fprintf(text_out(), "%-18s %-44s %12.1f ns/iter", group, name,
+			result->best_ns);
+	if (bytes_per_iteration)
+		fprintf(text_out(), " %10.1f MB/s",
+				(double)bytes_per_iteration * 1000.0 /
+				result->best_ns);
+	fprintf(text_out(), "\n");
+	fflush(text_out());
+}
+
+void bench_run(const char *group, const char *name,
+		bench_func_t func, void *param, size_t iterations)
+{
+	bench_run_bytes(group, name, func, param, iterations, 0);
+}
+
+void bench_note(const char *format, ...)
+{
+	va_list args;
+
+	va_start(args, format);
+	vfprintf(text_out(), format, args);
+	fprintf(text_out(), "\n");
+	va_end(args);
+}
+
+void bench_error(const char *format, ...)
+{
+	va_list args;
+
+	va_start(args, format);
+	fprintf(stderr, "error: ");
+	vfprintf(stderr, format, args);
+	fprintf(stderr, "\n");
+	va_end(args);
+
+	failed = true;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void print_json_str(const char *str)
+{
+	putchar('"');
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\')
+			printf("\\%c", *str);
+		else if ((unsigned char)*str < 0x20)
+			printf("\\u%04x", (unsigned char)*str);
+		else
+			putchar(*str);
+	}
+	putchar('"');
+}
+
+static void print_cpu_features(void)
+{
+	static const struct {
+		uint32_t   feature;
+		const char *name;
+	} features[] = {
+		{OS_CPU_SSE2,  "sse2"},
+		{OS_CPU_SSSE3, "ssse3"},
+		{OS_CPU_SSE41, "sse4.1"},
+		{OS_CPU_AVX,   "avx"},
+		{OS_CPU_AVX2,  "avx2"},
+		{OS_CPU_FMA3,  "fma3"},
+	};
+	uint32_t cpu = os_get_cpu_features();
+	bool first = true;
+
+	printf("[");
+	for (size_t i = 0; i < sizeof(features) / sizeof(features[0]); i++) {
+		if ((cpu & features[i].feature) == 0)
+			continue;
+
+		printf(first ? "" : ", ");
+		print_json_str(features[i].name);
+		first = false;
+	}
+	printf("]");
+}
+
+static void print_json(void)
+{
+	printf("{\n");
+	printf("\t\"version\": ");
+	print_json_str(obs_get_version_string());
+	printf(",\n\t\"logical_cores\": %d,\n", os_get_logical_cores());
+	printf("\t\"cpu_features\": ");
+	print_cpu_features();
+	printf(",\n\t\"runs\": %d,\n", runs);
+	printf("\t\"results\": [");
+
+	for (size_t i = 0; i < results.num; i++) {
+		struct bench_result *result = results.array + i;
+
+		printf(i ? ",\n\t\t{" : "\n\t\t{");
+		printf("\"group\": ");
+		print_json_str(result->group);
+		printf(", \"name\": ");
+		print_json_str(result->name);
+		printf(", \"iterations\": %llu",
+				(unsigned long long)result->iterations);
+		printf(", \"best_ns\": %.1f", result->best_ns);
+		printf(", \"median_ns\": %.1f", result->median_ns);
+		if (result->bytes_per_iteration)
+			printf(", \"bytes_per_iteration\": %llu",
+				(unsigned long long)result->bytes_per_iteration);
+		printf("}");
+	}
+
+	printf("\n\t]\n}\n");
+}
+
+static void free_results(void)
+{
+	for (size_t i = 0; i < results.num; i++) {
+		bfree(results.array[i].group);
+		bfree(results.array[i].name);
+	}
+	da_free(results);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void print_usage(const char *exe)
+{
+	fprintf(stderr, "usage: %s [--json] [--runs N] [--list] "
+			"[group...]\n", exe);
+}
+
+static bool group_selected(const char *name, int argc, char *argv[],
+		bool any_groups)
+{
+	if (!any_groups)
+		return true;
+
+	for (int i = 1; i < argc; i++) {
+		if (argv[i] && strcmp(argv[i], name) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+int main(int argc, char *argv[])
+{
+	bool any_groups = false;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--json") == 0) {
+			json = true;
+			argv[i] = NULL;
+
+		} else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+			runs = atoi(argv[i + 1]);
+			if (runs < 1)
+				runs = 1;
+			else if (runs > MAX_RUNS)
+				runs = MAX_RUNS;
+			argv[i++] = NULL;
+			argv[i] = NULL;
+
+		} else if (strcmp(argv[i], "--list") == 0) {
+			for (size_t j = 0; j < NUM_GROUPS; j++)
+				printf("%s\n", groups[j].name);
+			return 0;
+
+		} else if (argv[i][0] == '-') {
+			print_usage(argv[0]);
+			return 1;
+
+		} else {
+			any_groups = true;
+		}
+	}
+
+	da_init(results);
+
+	for (size_t i = 0; i < NUM_GROUPS; i++) {
+		if (group_selected(groups[i].name, argc, argv, any_groups))
+			groups[i].run();
+	}
+
+	if (json)
+		print_json();
+
+	free_results();
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,73 @@
+/******************************************************************************
+    Copyright (C) 2017 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <util/c99defs.h>
+
+/*
+ * Minimal benchmark harness for libobs internals.  Each benchmark function
+ * runs a fixed number of iterations of its workload; the harness repeats it
+ * a few times and records the fastest and median run.  Results are printed
+ * as text, or as JSON with --json so they can be compared across versions.
+ */
+
+typedef void (*bench_func_t)(void *param, size_t iterations);
+
+/**
+ * Runs a benchmark and records its time per iteration.
+ *
+ * @param  group       Name of the group the benchmark belongs to
+ * @param  name        Name of the benchmark
+ * @param  func        Benchmark workload
+ * @param  param       Workload parameter
+ * @param  iterations  Number of iterations per timed run
+ */
+extern void bench_run(const char *group, const char *name,
+		bench_func_t func, void *param, size_t iterations);
+
+/**
+ * Same as bench_run, but also reports throughput based on the number of
+ * bytes processed by each iteration.
+ */
+extern void bench_run_bytes(const char *group, const char *name,
+		bench_func_t func, void *param, size_t iterations,
+		size_t bytes_per_iteration);
+
+/** Prints a note about the current group (not included in results) */
+extern void bench_note(const char *format, ...);
+
+/**
+ * Reports a failed consistency check (for example, an optimized function not
+ * matching its reference output).  The benchmark will exit with an error.
+ */
+extern void bench_error(const char *format, ...);
+
+extern void bench_interleave(void);
+extern void bench_audio_mix(void);
+extern void bench_audio_meter(void);
+extern void bench_audio_dynamics(void);
+extern void bench_audio_latency(void);
+extern void bench_render(void);
+extern void bench_format_conversion(void);
+extern void bench_video_scaler(void);
+extern void bench_audio_resampler(void);
+extern void bench_util(void);
+extern void bench_obs_data(void);
+extern void bench_signal(void);
+extern void bench_flv_mux(void);
+extern void bench_rtmp_socket(void);